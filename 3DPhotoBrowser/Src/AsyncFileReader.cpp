@@ -0,0 +1,246 @@
+/**
+ * @file AsyncFileReader.cpp
+ * @brief AsyncFileReader implementation file
+ */
+
+#include "AsyncFileReader.h"
+#include "CompletionPortReader.h"
+#include "ThreadPoolReader.h"
+
+/**
+ * OPEN_FILE_CACHE_EXTRA
+ * Open files kept beyond one per read in flight. There is always a file no read is using to replace
+ */
+#define OPEN_FILE_CACHE_EXTRA 8
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * RoundUpToPowerOfTwo
+ * The completion ring needs a power of two capacity
+ */
+static unsigned RoundUpToPowerOfTwo(unsigned in_Value)
+{
+	unsigned l_Result = 1;
+	while(l_Result < in_Value)
+	{
+		l_Result <<= 1;
+	}
+	return l_Result;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// AsyncFileReader
+
+AsyncFileReader* AsyncFileReader::Create(unsigned in_MaxInFlight, HANDLE in_NotifyEvent, bool in_UseThreadPool)
+{
+	in_MaxInFlight = max(1u, in_MaxInFlight);
+
+	if(!in_UseThreadPool)
+	{
+		CompletionPortReader* l_Reader = new CompletionPortReader(in_MaxInFlight, in_NotifyEvent);
+		if(l_Reader->IsValid())
+		{
+			return l_Reader;
+		}
+		delete l_Reader;
+		logf("Failed to create an I/O completion port, falling back to a read thread pool");
+	}
+
+	return new ThreadPoolReader(in_MaxInFlight, in_NotifyEvent);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+AsyncFileReader::AsyncFileReader(unsigned in_MaxInFlight, HANDLE in_NotifyEvent)
+: mReads(in_MaxInFlight)
+, mInFlightCount(0)
+, mFiles(in_MaxInFlight + OPEN_FILE_CACHE_EXTRA)
+, mUseCounter(0)
+, mCompletions(RoundUpToPowerOfTwo(in_MaxInFlight))
+, mNotifyEvent(in_NotifyEvent)
+{
+	mFreeReads.reserve(in_MaxInFlight);
+	for(unsigned i = 0; i < in_MaxInFlight; i++)
+	{
+		mFreeReads.push_back(&mReads[i]);
+	}
+
+	for(unsigned i = 0; i < mFiles.size(); i++)
+	{
+		mFiles[i].Filename[0] = '\0';
+		mFiles[i].File = INVALID_HANDLE_VALUE;
+		mFiles[i].InFlight = 0;
+		mFiles[i].LastUse = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+AsyncFileReader::~AsyncFileReader()
+{
+	// The backend has already stopped, so nothing can be using the files
+	for(unsigned i = 0; i < mFiles.size(); i++)
+	{
+		if(mFiles[i].File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mFiles[i].File);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool AsyncFileReader::Submit(const char* in_Filename, unsigned in_Offset, unsigned in_Size, unsigned char* out_Buffer, void* in_UserData,
+							 unsigned in_MinSize)
+{
+	if(mFreeReads.empty())
+	{
+		return false;
+	}
+
+	ReadData* l_Read = mFreeReads.back();
+	mFreeReads.pop_back();
+	mInFlightCount++;
+
+	memset(&l_Read->Overlapped, 0, sizeof(l_Read->Overlapped));
+	l_Read->Overlapped.Offset = in_Offset;
+	l_Read->Size = in_Size;
+	l_Read->MinSize = in_MinSize > 0 ? min(in_MinSize, in_Size) : in_Size;
+	l_Read->BytesRead = 0;
+	l_Read->Buffer = out_Buffer;
+	l_Read->UserData = in_UserData;
+	l_Read->FileSlot = OpenFile(in_Filename);
+
+	if(l_Read->FileSlot < 0)
+	{
+		CompleteRead(l_Read, false, 0);
+		return true;
+	}
+
+	l_Read->File = mFiles[l_Read->FileSlot].File;
+	mFiles[l_Read->FileSlot].InFlight++;
+
+	if(!StartRead(l_Read))
+	{
+		logf("Failed to start reading %u bytes at offset %u in '%s'", in_Size, in_Offset, in_Filename);
+		CompleteRead(l_Read, false, 0);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool AsyncFileReader::PollCompletion(void*& out_UserData, bool& out_Success, unsigned* out_BytesRead)
+{
+	CompletionData l_Completion;
+	if(!mCompletions.TryPop(l_Completion))
+	{
+		return false;
+	}
+
+	ReadData* l_Read = l_Completion.Read;
+	if(l_Read->FileSlot >= 0)
+	{
+		mFiles[l_Read->FileSlot].InFlight--;
+	}
+	out_UserData = l_Read->UserData;
+	out_Success = l_Completion.Success;
+	if(out_BytesRead)
+	{
+		*out_BytesRead = l_Read->BytesRead;
+	}
+
+	mFreeReads.push_back(l_Read);
+	mInFlightCount--;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void AsyncFileReader::Drain()
+{
+	void* l_UserData;
+	bool l_Success;
+	while(mInFlightCount > 0)
+	{
+		if(!PollCompletion(l_UserData, l_Success))
+		{
+#ifdef WIN32
+			WaitForSingleObject(mNotifyEvent, INFINITE);
+#else
+			#error Your platform event wait goes here
+#endif // WIN32
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void AsyncFileReader::CompleteRead(ReadData* in_Read, bool in_Success, unsigned in_BytesRead)
+{
+	// The ring holds one entry per read, so it is never full
+	in_Read->BytesRead = in_BytesRead;
+	CompletionData l_Completion;
+	l_Completion.Read = in_Read;
+	l_Completion.Success = in_Success && in_BytesRead >= in_Read->MinSize;
+	mCompletions.TryPush(l_Completion);
+
+#ifdef WIN32
+	SetEvent(mNotifyEvent);
+#else
+	#error Your platform event signal goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int AsyncFileReader::OpenFile(const char* in_Filename)
+{
+	// Already open?
+	int l_Replace = -1;
+	for(unsigned i = 0; i < mFiles.size(); i++)
+	{
+		if(mFiles[i].File != INVALID_HANDLE_VALUE && strcmp(mFiles[i].Filename, in_Filename) == 0)
+		{
+			mFiles[i].LastUse = ++mUseCounter;
+			return (int)i;
+		}
+		if(mFiles[i].InFlight == 0 && (l_Replace < 0 || mFiles[i].LastUse < mFiles[l_Replace].LastUse))
+		{
+			l_Replace = (int)i;
+		}
+	}
+
+	// There is one more slot than reads in flight, so one of them must be free
+	FileData& l_File = mFiles[l_Replace];
+	if(l_File.File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(l_File.File);
+		l_File.File = INVALID_HANDLE_VALUE;
+	}
+
+#ifdef WIN32
+	HANDLE l_Handle = CreateFileA(in_Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | GetOpenFlags(), NULL);
+#else
+	#error Your platform file open goes here
+#endif // WIN32
+
+	if(l_Handle == INVALID_HANDLE_VALUE)
+	{
+		logf("Failed to open thumbnail file '%s'", in_Filename);
+		return -1;
+	}
+	if(!AttachFile(l_Handle))
+	{
+		logf("Failed to attach thumbnail file '%s' to the %s reader", in_Filename, GetName());
+		CloseHandle(l_Handle);
+		return -1;
+	}
+
+	strncpy(l_File.Filename, in_Filename, MAX_PATH - 1);
+	l_File.Filename[MAX_PATH - 1] = '\0';
+	l_File.File = l_Handle;
+	l_File.LastUse = ++mUseCounter;
+	return l_Replace;
+}
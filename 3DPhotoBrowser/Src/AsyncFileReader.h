@@ -0,0 +1,149 @@
+/**
+ * @file AsyncFileReader.h
+ * @brief AsyncFileReader class header file
+ */
+
+#ifndef ASYNCFILEREADER_H_
+#define ASYNCFILEREADER_H_
+
+#include "Global.h"
+#include "LockFreeRing.h"
+
+/**
+ * AsyncFileReader
+ * Keeps several file reads in flight for a single submitting thread. Reads are submitted with Submit and the finished
+ * ones collected with PollCompletion, in whatever order they finish. When a read finishes the notify event is
+ * signalled, so the submitting thread can sleep on the same event it waits for other work on.
+ * Open files are kept in a small cache, so reading the same containers over and over doesn't reopen them.
+ * The backends differ in how the reads get done
+ */
+class AsyncFileReader
+{
+public:
+
+	/**
+	 * Create
+	 * Create the best backend available, or the thread pool backend if in_UseThreadPool is set.
+	 * At most in_MaxInFlight reads may be in flight at once
+	 */
+	static AsyncFileReader* Create(unsigned in_MaxInFlight, HANDLE in_NotifyEvent, bool in_UseThreadPool);
+
+	virtual ~AsyncFileReader();
+
+	/**
+	 * GetName
+	 * Name of the backend, for logging
+	 */
+	virtual const char* GetName() const = 0;
+
+	/**
+	 * Submit
+	 * Start reading in_Size bytes at in_Offset in in_Filename into out_Buffer, which must stay valid until the read
+	 * completes. in_UserData comes back with the completion. Returns false if too many reads are in flight already.
+	 * A read that fails to start still completes, unsuccessfully. A read that stops short at the end of the file
+	 * succeeds if at least in_MinSize bytes arrived, 0 means all of in_Size must arrive
+	 */
+	bool Submit(const char* in_Filename, unsigned in_Offset, unsigned in_Size, unsigned char* out_Buffer, void* in_UserData,
+				unsigned in_MinSize = 0);
+
+	/**
+	 * PollCompletion
+	 * Take a finished read without waiting. Returns false if no read has finished
+	 */
+	bool PollCompletion(void*& out_UserData, bool& out_Success, unsigned* out_BytesRead = NULL);
+
+	/**
+	 * Drain
+	 * Wait for every read in flight to finish, throwing away the results
+	 */
+	void Drain();
+
+	/**
+	 * GetInFlightCount / IsFull
+	 * Reads submitted but not yet collected by PollCompletion
+	 */
+	unsigned GetInFlightCount() const { return mInFlightCount; }
+	bool IsFull() const { return mInFlightCount == mReads.size(); }
+
+protected:
+
+	/**
+	 * ReadData
+	 * A read in flight. The OVERLAPPED comes first so a completed OVERLAPPED* can be turned back into its read
+	 */
+	struct ReadData
+	{
+		OVERLAPPED Overlapped;		// Holds the file offset
+		HANDLE File;
+		unsigned Size;
+		unsigned MinSize;			// The read fails if fewer bytes than this arrive
+		unsigned BytesRead;
+		unsigned char* Buffer;
+		void* UserData;
+		int FileSlot;				// Entry in the open file cache, which can't be closed while the read is in flight
+	};
+
+	AsyncFileReader(unsigned in_MaxInFlight, HANDLE in_NotifyEvent);
+
+	/**
+	 * Backend interface
+	 * GetOpenFlags: extra CreateFile flags the backend needs.
+	 * AttachFile: called once for each newly opened file.
+	 * StartRead: start a read, returning false if it couldn't be started. Once started, the backend must call
+	 * CompleteRead when it finishes, from any thread
+	 */
+	virtual DWORD GetOpenFlags() const { return 0; }
+	virtual bool AttachFile(HANDLE in_File) { return true; }
+	virtual bool StartRead(ReadData* io_Read) = 0;
+
+	/**
+	 * CompleteRead
+	 * Hand a finished read back to the submitting thread. It succeeded if in_Success is set and enough bytes arrived
+	 */
+	void CompleteRead(ReadData* in_Read, bool in_Success, unsigned in_BytesRead);
+
+private:
+
+	/**
+	 * FileData
+	 * An entry in the open file cache
+	 */
+	struct FileData
+	{
+		char Filename[MAX_PATH];
+		HANDLE File;
+		unsigned InFlight;			// Reads using the file
+		unsigned LastUse;			// For least recently used replacement
+	};
+
+	/**
+	 * CompletionData
+	 * A finished read on its way back to the submitting thread
+	 */
+	struct CompletionData
+	{
+		ReadData* Read;
+		bool Success;
+	};
+
+	/**
+	 * OpenFile
+	 * Find or open a file in the cache, returning its slot or -1 if it couldn't be opened
+	 */
+	int OpenFile(const char* in_Filename);
+
+	vector<ReadData> mReads;					// Never resized, the OVERLAPPEDs must not move
+	vector<ReadData*> mFreeReads;
+	unsigned mInFlightCount;
+
+	vector<FileData> mFiles;
+	unsigned mUseCounter;
+
+	MpscRing<CompletionData> mCompletions;		// Written by whichever thread finishes a read
+	HANDLE mNotifyEvent;						// Owned by the submitting thread
+
+	AsyncFileReader(const AsyncFileReader&);
+	const AsyncFileReader& operator=(const AsyncFileReader&);
+};
+
+#endif // ASYNCFILEREADER_H_
@@ -0,0 +1,92 @@
+/**
+ * @file Atomic.h
+ * @brief Atomic operations used by the lock-free containers
+ */
+
+#ifndef ATOMIC_H_
+#define ATOMIC_H_
+
+#include "Global.h"
+
+/**
+ * AtomicLong
+ * A 32 bit value shared between threads. Plain reads of an AtomicLong have acquire semantics
+ */
+#ifdef WIN32
+	typedef volatile LONG AtomicLong;
+#else
+	#error Your platform atomic type goes here
+#endif // WIN32
+
+/**
+ * AtomicStore
+ * Store a value with a full memory barrier, so every write before it is visible to a thread that reads the value
+ */
+inline void AtomicStore(AtomicLong* io_Target, LONG in_Value)
+{
+#ifdef WIN32
+	InterlockedExchange(io_Target, in_Value);
+#else
+	#error Your platform atomic store goes here
+#endif // WIN32
+}
+
+/**
+ * AtomicCompareExchange
+ * Set the target to in_Exchange if it equals in_Comparand. Returns the previous value of the target
+ */
+inline LONG AtomicCompareExchange(AtomicLong* io_Target, LONG in_Exchange, LONG in_Comparand)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange(io_Target, in_Exchange, in_Comparand);
+#else
+	#error Your platform atomic compare exchange goes here
+#endif // WIN32
+}
+
+/**
+ * AtomicIncrement
+ * Increment the target and return the new value
+ */
+inline LONG AtomicIncrement(AtomicLong* io_Target)
+{
+#ifdef WIN32
+	return InterlockedIncrement(io_Target);
+#else
+	#error Your platform atomic increment goes here
+#endif // WIN32
+}
+
+/**
+ * AtomicDecrement
+ * Decrement the target and return the new value
+ */
+inline LONG AtomicDecrement(AtomicLong* io_Target)
+{
+#ifdef WIN32
+	return InterlockedDecrement(io_Target);
+#else
+	#error Your platform atomic decrement goes here
+#endif // WIN32
+}
+
+/**
+ * AtomicAdd
+ * Add to the target and return the new value
+ */
+inline LONG AtomicAdd(AtomicLong* io_Target, LONG in_Value)
+{
+#ifdef WIN32
+	return InterlockedExchangeAdd(io_Target, in_Value) + in_Value;
+#else
+	#error Your platform atomic add goes here
+#endif // WIN32
+}
+
+/**
+ * CACHE_LINE_SIZE
+ * Values written by different threads are kept this far apart so they don't share a cache line
+ */
+#define CACHE_LINE_SIZE 64
+
+#endif // ATOMIC_H_
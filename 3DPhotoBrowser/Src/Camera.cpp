@@ -44,13 +44,43 @@ Camera::~Camera()
 
 void Camera::GetVisibleWorldBounds(float& out_MinWorldX, float& out_MinWorldY, float& out_MaxWorldX, float& out_MaxWorldY)
 {
-	float l_HalfHeight = mTanHalfFovy * mPosZ;
+	GetVisibleWorldBounds(mPosX, mPosY, mPosZ, out_MinWorldX, out_MinWorldY, out_MaxWorldX, out_MaxWorldY);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Camera::GetVisibleWorldBounds(float in_PosX, float in_PosY, float in_PosZ, float& out_MinWorldX, float& out_MinWorldY, float& out_MaxWorldX, float& out_MaxWorldY)
+{
+	float l_HalfHeight = mTanHalfFovy * in_PosZ;
 	float l_HalfWidth = l_HalfHeight * mAspectRatio;
 	
-	out_MinWorldX = mPosX - l_HalfWidth;
-	out_MinWorldY = mPosY - l_HalfHeight;
-	out_MaxWorldX = mPosX + l_HalfWidth;
-	out_MaxWorldY = mPosY + l_HalfHeight;
+	out_MinWorldX = in_PosX - l_HalfWidth;
+	out_MinWorldY = in_PosY - l_HalfHeight;
+	out_MaxWorldX = in_PosX + l_HalfWidth;
+	out_MaxWorldY = in_PosY + l_HalfHeight;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Camera::GetRestingPosition(float& out_PosX, float& out_PosY, float& out_PosZ)
+{
+	// An animated move ends exactly at its destination
+	if(mMoveTime > 0)
+	{
+		out_PosX = mMoveToX;
+		out_PosY = mMoveToY;
+		out_PosZ = mMoveToZ;
+		return;
+	}
+
+	// Otherwise the camera coasts to a stop, but never past its boundaries (see UpdateVelocityComponent)
+	out_PosX = GetRestingComponent(mVelocityX, mPosX, GetPanDecceleration());
+	out_PosY = GetRestingComponent(mVelocityY, mPosY, GetPanDecceleration());
+	out_PosZ = GetRestingComponent(mVelocityZ, mPosZ, GetZoomDecceleration());
+
+	if(mVelocityX != 0) out_PosX = min(max(out_PosX, mMinBoundaryX), mMaxBoundaryX);
+	if(mVelocityY != 0) out_PosY = min(max(out_PosY, mMinBoundaryY), mMaxBoundaryY);
+	if(mVelocityZ != 0) out_PosZ = min(max(out_PosZ, mMinBoundaryZ), mMaxBoundaryZ);
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -385,7 +415,7 @@ void Camera::UpdateVelocityComponent(float& in_VelComponent, float in_PosCompone
 	if(in_VelComponent > 0)
 	{
 		// Compute the camera's resting position at the current velocity and decceleration
-		float l_RestingPosition = in_PosComponent + (in_VelComponent * in_VelComponent - 0) / ( 2 * in_Decceleration);
+		float l_RestingPosition = GetRestingComponent(in_VelComponent, in_PosComponent, in_Decceleration);
 
 		// If our current resting position is past the lateral boundary,
 		// we need to adjust our decceleration appropriately
@@ -408,7 +438,7 @@ void Camera::UpdateVelocityComponent(float& in_VelComponent, float in_PosCompone
 	else if(in_VelComponent < 0)
 	{
 		// Compute the camera's resting position at the current velocity and decceleration
-		float l_RestingPosition = in_PosComponent - (in_VelComponent * in_VelComponent - 0) / ( 2 * in_Decceleration);
+		float l_RestingPosition = GetRestingComponent(in_VelComponent, in_PosComponent, in_Decceleration);
 
 		// If our current resting position is past the lateral boundary,
 		// we need to adjust our decceleration appropriately
@@ -429,3 +459,19 @@ void Camera::UpdateVelocityComponent(float& in_VelComponent, float in_PosCompone
 		in_VelComponent = min(0, in_VelComponent + in_Decceleration * in_DeltaTime);
 	}
 }
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+float Camera::GetRestingComponent(float in_VelComponent, float in_PosComponent, float in_Decceleration)
+{
+	// No velocity, no movement
+	if(in_VelComponent == 0)
+	{
+		return in_PosComponent;
+	}
+
+	// 1D acceleration formula, solved for the distance travelled until v = 0
+	// s = (v^2 - u^2) / ( 2 * a )
+	float l_Distance = (in_VelComponent * in_VelComponent - 0) / ( 2 * in_Decceleration);
+	return in_VelComponent > 0 ? in_PosComponent + l_Distance : in_PosComponent - l_Distance;
+}
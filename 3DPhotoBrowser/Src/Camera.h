@@ -167,6 +167,25 @@ public:
 	 */
 	void GetVisibleWorldBounds(float& out_MinWorldX, float& out_MinWorldY, float& out_MaxWorldX, float& out_MaxWorldY);
 
+	/**
+	 * GetVisibleWorldBounds
+	 * Get the visible world (in the xy plane) if the camera were at the specified position
+	 */
+	void GetVisibleWorldBounds(float in_PosX, float in_PosY, float in_PosZ, float& out_MinWorldX, float& out_MinWorldY, float& out_MaxWorldX, float& out_MaxWorldY);
+
+	/**
+	 * GetRestingPosition
+	 * Get the position where the camera will come to rest if it is left alone, taking the current
+	 * velocity, decceleration and boundaries into account. Returns the current position if the camera isn't moving
+	 */
+	void GetRestingPosition(float& out_PosX, float& out_PosY, float& out_PosZ);
+
+	/**
+	 * IsMoving
+	 * Is the camera still travelling under its own momentum, or animating towards a MoveTo position?
+	 */
+	bool IsMoving() const { return mMoveTime > 0 || mVelocityX != 0 || mVelocityY != 0 || mVelocityZ != 0; }
+
 	/**
 	 * GetImagePlaneWorldPosition
 	 * Return the xy world coordinates for a set of screen coordinates in the image plane
@@ -268,6 +287,7 @@ private:
 	void SavePosition();
 	void UpdateVelocity(float in_DeltaTime);
 	void UpdateVelocityComponent(float& in_VelComponent, float in_PosComponent, float in_Decceleration, float in_PosMin, float in_PosMax, float in_DeltaTime);
+	static float GetRestingComponent(float in_VelComponent, float in_PosComponent, float in_Decceleration);
 
 	float GetPixelWorldConversionRatio()
 	{
@@ -0,0 +1,95 @@
+/**
+ * @file CompletionPortReader.cpp
+ * @brief CompletionPortReader implementation file
+ */
+
+#include "CompletionPortReader.h"
+#include "Tracer.h"
+
+/**
+ * READ_COMPLETION_KEY
+ * Completion key of the files attached to the port. Anything else tells the completion thread to stop
+ */
+#define READ_COMPLETION_KEY 1
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// CompletionPortReader
+
+CompletionPortReader::CompletionPortReader(unsigned in_MaxInFlight, HANDLE in_NotifyEvent)
+: AsyncFileReader(in_MaxInFlight, in_NotifyEvent)
+, mPort(NULL)
+, mThreadDone(false)
+{
+#ifdef WIN32
+	mPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+#else
+	#error Your platform completion queue goes here
+#endif // WIN32
+
+	if(mPort)
+	{
+		Start(false);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+CompletionPortReader::~CompletionPortReader()
+{
+	if(mPort)
+	{
+		// Every read must have been collected by now, so the stop packet is the only one left
+		PostQueuedCompletionStatus(mPort, 0, 0, NULL);
+		while(!mThreadDone)
+		{
+			Sleep(0); // Yield timeslice
+		}
+		CloseHandle(mPort);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void CompletionPortReader::Run()
+{
+	Tracer::Instance()->SetThreadName("CompletionPort");
+	for(;;)
+	{
+		DWORD l_BytesRead = 0;
+		ULONG_PTR l_Key = 0;
+		OVERLAPPED* l_Overlapped = NULL;
+		BOOL l_Result = GetQueuedCompletionStatus(mPort, &l_BytesRead, &l_Key, &l_Overlapped, INFINITE);
+
+		if(l_Key != READ_COMPLETION_KEY || !l_Overlapped)
+		{
+			break;
+		}
+
+		ReadData* l_Read = (ReadData*)l_Overlapped;
+		CompleteRead(l_Read, l_Result != FALSE, l_BytesRead);
+	}
+
+	mThreadDone = true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+DWORD CompletionPortReader::GetOpenFlags() const
+{
+	return FILE_FLAG_OVERLAPPED;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool CompletionPortReader::AttachFile(HANDLE in_File)
+{
+	return CreateIoCompletionPort(in_File, mPort, READ_COMPLETION_KEY, 0) == mPort;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool CompletionPortReader::StartRead(ReadData* io_Read)
+{
+	// A read that finishes straight away still queues a completion packet
+	return ReadFile(io_Read->File, io_Read->Buffer, io_Read->Size, NULL, &io_Read->Overlapped) || GetLastError() == ERROR_IO_PENDING;
+}
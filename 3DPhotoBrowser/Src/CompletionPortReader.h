@@ -0,0 +1,56 @@
+/**
+ * @file CompletionPortReader.h
+ * @brief CompletionPortReader class header file
+ */
+
+#ifndef COMPLETIONPORTREADER_H_
+#define COMPLETIONPORTREADER_H_
+
+#include "Global.h"
+#include "AsyncFileReader.h"
+#include "Thread.h"
+
+/**
+ * CompletionPortReader
+ * Overlapped reads, finished through an I/O completion port. The OS keeps every read in flight at once, a single
+ * thread collects the finished reads from the port and hands them back
+ */
+class CompletionPortReader : public AsyncFileReader, public Thread
+{
+public:
+
+	CompletionPortReader(unsigned in_MaxInFlight, HANDLE in_NotifyEvent);
+	virtual ~CompletionPortReader();
+
+	/**
+	 * IsValid
+	 * Was the completion port created?
+	 */
+	bool IsValid() const { return mPort != NULL; }
+
+	/**
+	 * AsyncFileReader interface
+	 */
+	virtual const char* GetName() const { return "completion port"; }
+
+	/**
+	 * Thread interface
+	 */
+	virtual void Run();
+
+protected:
+
+	/**
+	 * AsyncFileReader backend interface
+	 */
+	virtual DWORD GetOpenFlags() const;
+	virtual bool AttachFile(HANDLE in_File);
+	virtual bool StartRead(ReadData* io_Read);
+
+private:
+
+	HANDLE mPort;
+	volatile bool mThreadDone;
+};
+
+#endif // COMPLETIONPORTREADER_H_
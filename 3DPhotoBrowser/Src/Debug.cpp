@@ -10,8 +10,9 @@
 
 void Debug::Logf(const char* in_Fmt, ...)
 {
-	static const int l_BuffSize = 100;
-	static char l_Buff[l_BuffSize+2];
+	// On the stack, as worker threads log too
+	static const int l_BuffSize = 256;
+	char l_Buff[l_BuffSize+2];
 
 	// Get the variadic arguments
 	va_list l_Args;
@@ -26,6 +27,13 @@ void Debug::Logf(const char* in_Fmt, ...)
 #ifdef WIN32
 	#pragma warning (pop)
 #endif // WIN32
+	va_end(l_Args);
+
+	// Long lines are cut short. The C runtime's vsnprintf returns -1 for them, C99's the length it would have written
+	if(l_LineLength < 0 || l_LineLength >= l_BuffSize)
+	{
+		l_LineLength = l_BuffSize - 1;
+	}
 
 	// Terminate the line
 	l_Buff[l_LineLength+0] = '\n';
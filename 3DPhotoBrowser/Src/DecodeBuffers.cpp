@@ -0,0 +1,185 @@
+/**
+ * @file DecodeBuffers.cpp
+ * @brief DecodeArena and StagingBufferPool implementation file
+ */
+
+#include "DecodeBuffers.h"
+
+/**
+ * ARENA_ALIGNMENT
+ * Alignment of every arena allocation, enough for SSE2 loads and stores
+ */
+#define ARENA_ALIGNMENT 16
+
+/**
+ * ARENA_GRANULARITY
+ * The arena block is grown in multiples of this size
+ */
+#define ARENA_GRANULARITY (64 * 1024)
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// DecodeArena
+
+DecodeArena::DecodeArena()
+: mBlock(NULL)
+, mBlockStart(NULL)
+, mBlockSize(0)
+, mUsed(0)
+, mHighWater(0)
+, mOverflowSize(0)
+, mHeapAllocationCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+DecodeArena::~DecodeArena()
+{
+	for(unsigned i = 0; i < mOverflow.size(); i++)
+	{
+		delete [] mOverflow[i];
+	}
+	delete [] mBlock;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+unsigned char* DecodeArena::AllocateBlock(unsigned in_Size, unsigned char*& out_Aligned)
+{
+	unsigned char* l_Block = new unsigned char[in_Size + ARENA_ALIGNMENT - 1];
+	out_Aligned = (unsigned char*)(((size_t)l_Block + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1));
+	return l_Block;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void* DecodeArena::Allocate(unsigned in_Size)
+{
+	in_Size = (in_Size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+	if(mUsed + in_Size <= mBlockSize)
+	{
+		void* l_Memory = mBlockStart + mUsed;
+		mUsed += in_Size;
+		mHighWater = max(mHighWater, mUsed + mOverflowSize);
+		return l_Memory;
+	}
+
+	// Doesn't fit, use the heap until the next Reset grows the block
+	if(mOverflow.empty())
+	{
+		mOverflow.reserve(8);
+	}
+	unsigned char* l_Aligned;
+	mOverflow.push_back(AllocateBlock(in_Size, l_Aligned));
+	mOverflowSize += in_Size;
+	mHighWater = max(mHighWater, mUsed + mOverflowSize);
+	mHeapAllocationCount++;
+	return l_Aligned;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void DecodeArena::Reset()
+{
+	if(!mOverflow.empty())
+	{
+		for(unsigned i = 0; i < mOverflow.size(); i++)
+		{
+			delete [] mOverflow[i];
+		}
+		mOverflow.clear();
+
+		// Grow the block so everything the last image needed fits in it
+		unsigned l_Size = (mHighWater + ARENA_GRANULARITY - 1) / ARENA_GRANULARITY * ARENA_GRANULARITY;
+		delete [] mBlock;
+		mBlock = AllocateBlock(l_Size, mBlockStart);
+		mBlockSize = l_Size;
+		mOverflowSize = 0;
+		mHeapAllocationCount++;
+	}
+
+	mUsed = 0;
+	mHighWater = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// StagingBufferPool
+
+StagingBufferPool::StagingBufferPool()
+: mHeapAllocationCount(0)
+{
+	// Release must never allocate, so the free lists are sized up front
+	for(int i = 0; i < SizeClassCount; i++)
+	{
+		mFreeBuffers[i].reserve(MaxBuffersPerClass);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void StagingBufferPool::Acquire(unsigned in_Size, vector<unsigned char>& io_Buffer)
+{
+	if(io_Buffer.capacity() < in_Size)
+	{
+		// Give the current buffer back and take one from the smallest class that holds in_Size bytes
+		Release(io_Buffer);
+
+		int l_Class = MinSizeClass;
+		while(l_Class < SizeClassCount && (1u << l_Class) < in_Size)
+		{
+			l_Class++;
+		}
+
+		mLock.Lock();
+		if(l_Class < SizeClassCount && !mFreeBuffers[l_Class].empty())
+		{
+			io_Buffer.swap(mFreeBuffers[l_Class].back());
+			mFreeBuffers[l_Class].pop_back();
+		}
+		else
+		{
+			mHeapAllocationCount++;
+		}
+		mLock.Unlock();
+
+		if(io_Buffer.capacity() < in_Size)
+		{
+			io_Buffer.reserve(l_Class < SizeClassCount ? (1u << l_Class) : in_Size);
+		}
+	}
+
+	io_Buffer.resize(in_Size);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void StagingBufferPool::Release(vector<unsigned char>& io_Buffer)
+{
+	unsigned l_Capacity = io_Buffer.capacity();
+	if(l_Capacity < (1u << MinSizeClass))
+	{
+		vector<unsigned char>().swap(io_Buffer);
+		return;
+	}
+
+	// The largest class the buffer can serve
+	int l_Class = MinSizeClass;
+	while(l_Class + 1 < SizeClassCount && (1u << (l_Class + 1)) <= l_Capacity)
+	{
+		l_Class++;
+	}
+
+	io_Buffer.clear();
+
+	mLock.Lock();
+	if(mFreeBuffers[l_Class].size() < MaxBuffersPerClass)
+	{
+		mFreeBuffers[l_Class].push_back(vector<unsigned char>());
+		mFreeBuffers[l_Class].back().swap(io_Buffer);
+	}
+	mLock.Unlock();
+
+	// The class is full (or the buffer wasn't taken), free it
+	vector<unsigned char>().swap(io_Buffer);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file DecodeBuffers.h
+ * @brief DecodeArena and StagingBufferPool class header file
+ */
+
+#ifndef DECODEBUFFERS_H_
+#define DECODEBUFFERS_H_
+
+#include "Global.h"
+#include "Semaphore.h"
+
+/**
+ * DecodeArena
+ * Scratch memory for decoding one image at a time: the compressed data, component planes and row buffers.
+ * Allocations are carved out of a single block and all released together by Reset. When an image needs more
+ * than the block holds, the extra comes from the heap and the block grows to fit at the next Reset, so once
+ * the largest image has been seen no more heap allocations are made. Each worker thread owns its own arena
+ */
+class DecodeArena
+{
+public:
+
+	DecodeArena();
+	~DecodeArena();
+
+	/**
+	 * Allocate
+	 * Allocate in_Size bytes, 16 byte aligned. The memory is uninitialized and valid until the next Reset
+	 */
+	void* Allocate(unsigned in_Size);
+
+	/**
+	 * Reset
+	 * Release everything allocated since the last Reset
+	 */
+	void Reset();
+
+	/**
+	 * GetMark / Rewind
+	 * Rewind releases everything allocated since GetMark returned in_Mark, keeping earlier allocations.
+	 * Used to decode several images out of one buffer that stays allocated
+	 */
+	unsigned GetMark() const { return mUsed; }
+	void Rewind(unsigned in_Mark) { mUsed = in_Mark; }
+
+	/**
+	 * GetHeapAllocationCount
+	 * Number of times the arena has had to go to the heap, used to check that decoding has reached a steady state
+	 */
+	unsigned GetHeapAllocationCount() const { return mHeapAllocationCount; }
+
+private:
+
+	static unsigned char* AllocateBlock(unsigned in_Size, unsigned char*& out_Aligned);
+
+	unsigned char* mBlock;				// Heap block, as returned by new
+	unsigned char* mBlockStart;			// First 16 byte aligned byte of the block
+	unsigned mBlockSize;
+	unsigned mUsed;						// Bytes of the block handed out since the last Reset
+	unsigned mHighWater;				// Most bytes in use at once since the last Reset, including the overflow
+
+	vector<unsigned char*> mOverflow;	// Heap blocks for allocations that didn't fit, freed by Reset
+	unsigned mOverflowSize;				// Total size of the overflow allocations
+	unsigned mHeapAllocationCount;
+
+	DecodeArena(const DecodeArena&);
+	const DecodeArena& operator=(const DecodeArena&);
+};
+
+/**
+ * StagingBufferPool
+ * Recycles the system memory buffers decoded pixels are written to before they are uploaded to graphics memory.
+ * Buffers are kept in power of two size classes, so each thumbnail LOD settles into its own class.
+ * The pool is thread-safe
+ */
+class StagingBufferPool
+{
+public:
+
+	StagingBufferPool();
+
+	/**
+	 * Acquire
+	 * Size io_Buffer to in_Size bytes, swapping in a pooled buffer if its current capacity is too small.
+	 * The contents of the buffer are undefined
+	 */
+	void Acquire(unsigned in_Size, vector<unsigned char>& io_Buffer);
+
+	/**
+	 * Release
+	 * Return io_Buffer's memory to the pool, leaving io_Buffer empty
+	 */
+	void Release(vector<unsigned char>& io_Buffer);
+
+	/**
+	 * GetHeapAllocationCount
+	 * Number of buffers the pool has had to allocate
+	 */
+	unsigned GetHeapAllocationCount() const { return mHeapAllocationCount; }
+
+private:
+
+	static const int MinSizeClass = 12;				// 4KB, smaller buffers are rounded up
+	static const int SizeClassCount = 27;			// Up to 64MB, larger buffers aren't pooled
+	static const unsigned MaxBuffersPerClass = 8;	// Enough for a few loads in flight per LOD
+
+	Semaphore mLock;
+	vector< vector<unsigned char> > mFreeBuffers[SizeClassCount];
+	unsigned mHeapAllocationCount;			// Protected by mLock
+};
+
+#endif // DECODEBUFFERS_H_
@@ -0,0 +1,566 @@
+/**
+ * @file DecodedCache.cpp
+ * @brief DecodedCache implementation file
+ */
+
+#include "DecodedCache.h"
+#include "ContainerFormat.h"
+#include "TextureCompression.h"
+#include "Tracer.h"
+#include "Metrics.h"
+
+/**
+ * DECODED_CACHE_MAGIC / DECODED_CACHE_VERSION
+ * Identify a cache file, "PDDC" in the file
+ */
+#define DECODED_CACHE_MAGIC 0x43444450
+#define DECODED_CACHE_VERSION 1
+
+/**
+ * DECODED_RECORD_MAGIC
+ * Starts every record, "PDDR" in the file
+ */
+#define DECODED_RECORD_MAGIC 0x52444450
+
+/**
+ * MAX_QUEUED_WRITES
+ * Thumbnails waiting for the writer beyond this are dropped, they are stored the next time they are decoded
+ */
+#define MAX_QUEUED_WRITES 64
+
+/**
+ * DecodedCacheHeader
+ * Start of a cache file
+ */
+struct DecodedCacheHeader
+{
+	unsigned Magic;
+	unsigned Version;
+	unsigned SourceStamp[3];		// Size and last write time of the container the file was made from
+};
+
+/**
+ * DecodedCacheRecord
+ * Comes before each thumbnail's pixels in a cache file
+ */
+struct DecodedCacheRecord
+{
+	unsigned Magic;
+	unsigned SourceOffset;
+	unsigned SourceSize;
+	int ScaleShift;
+	int Width;
+	int Height;
+	int Format;						// TextureFormat
+	unsigned DataSize;
+	unsigned Checksum;				// ContainerChecksum of the pixels
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * ConvertPixels
+ * Convert RGB or RGBA pixels to RGBA or RGB565
+ */
+static void ConvertPixels(const DecodedImage& in_Image, TextureFormat in_Format, unsigned char* out_Pixels)
+{
+	const unsigned char* l_Source = &in_Image.Pixels[0];
+	int l_SourceBytesPerPixel = in_Image.Format == TextureFormat_RGBA ? 4 : 3;
+	unsigned l_PixelCount = in_Image.Width * in_Image.Height;
+
+	for(unsigned i = 0; i < l_PixelCount; i++, l_Source += l_SourceBytesPerPixel)
+	{
+		if(in_Format == TextureFormat_RGB565)
+		{
+			unsigned short l_Pixel = (unsigned short)(((l_Source[0] >> 3) << 11) | ((l_Source[1] >> 2) << 5) | (l_Source[2] >> 3));
+			memcpy(out_Pixels, &l_Pixel, 2);
+			out_Pixels += 2;
+		}
+		else
+		{
+			out_Pixels[0] = l_Source[0];
+			out_Pixels[1] = l_Source[1];
+			out_Pixels[2] = l_Source[2];
+			out_Pixels[3] = l_SourceBytesPerPixel == 4 ? l_Source[3] : 255;
+			out_Pixels += 4;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// DecodedCache
+
+DecodedCache::DecodedCache(const char* in_Directory, TextureFormat in_Format, int in_MaxSize, StagingBufferPool* in_Pool)
+: mDirectory(in_Directory)
+, mFormat(in_Format == TextureFormat_RGB565 || in_Format == TextureFormat_BC1 ? in_Format : TextureFormat_RGBA)
+, mMaxSize(in_MaxSize)
+, mPool(in_Pool)
+, mLastContainer(NULL)
+, mReadContainer(NULL)
+, mWriteContainer(NULL)
+, mJobs(MAX_QUEUED_WRITES)
+, mJobHead(0)
+, mJobCount(0)
+, mStopThread(false)
+, mThreadDone(false)
+, mHitCount(0)
+, mMissCount(0)
+, mWriteCount(0)
+, mDroppedCount(0)
+{
+#ifdef WIN32
+	CreateDirectoryA(mDirectory.c_str(), NULL);
+	mReadFile = INVALID_HANDLE_VALUE;
+	mWriteFile = INVALID_HANDLE_VALUE;
+	mJobSemaphore = CreateSemaphore(NULL, 0, MAX_QUEUED_WRITES + 1, NULL);
+#else
+	#error Your platform directory and semaphore creation goes here
+#endif // WIN32
+
+	Start(false);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+DecodedCache::~DecodedCache()
+{
+	// The writer finishes what is queued before it stops
+	mStopThread = true;
+#ifdef WIN32
+	ReleaseSemaphore(mJobSemaphore, 1, NULL);
+#else
+	#error Your platform semaphore signal goes here
+#endif // WIN32
+	while(!mThreadDone)
+	{
+		Sleep(0); // Yield timeslice
+	}
+
+#ifdef WIN32
+	if(mReadFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mReadFile);
+	}
+	if(mWriteFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mWriteFile);
+	}
+	CloseHandle(mJobSemaphore);
+#else
+	#error Your platform file and semaphore destruction goes here
+#endif // WIN32
+
+	for(map<string, ContainerData*>::iterator It = mContainers.begin(); It != mContainers.end(); It++)
+	{
+		delete It->second;
+	}
+	for(unsigned i = 0; i < mJobs.size(); i++)
+	{
+		mPool->Release(mJobs[i].Pixels);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool DecodedCache::Load(const char* in_Filename, unsigned in_Offset, unsigned in_Size, int in_ScaleShift, DecodedImage& out_Image)
+{
+	ContainerData* l_Container = FindContainer(in_Filename);
+
+	BlobKey l_Key;
+	l_Key.Offset = in_Offset;
+	l_Key.Size = in_Size;
+	l_Key.ScaleShift = in_ScaleShift;
+
+	mLock.Lock();
+	map<BlobKey, EntryData>::iterator l_Found = l_Container->Entries.find(l_Key);
+	bool l_Cached = l_Found != l_Container->Entries.end();
+	EntryData l_Entry;
+	if(l_Cached)
+	{
+		l_Entry = l_Found->second;
+	}
+	mLock.Unlock();
+
+	if(!l_Cached)
+	{
+		mMissCount++;
+		METRIC_ADD(Metric_DecodedCacheMisses, 1)
+		return false;
+	}
+
+	// Keep the cache file open while the thumbnails come from the same container
+#ifdef WIN32
+	if(mReadContainer != l_Container)
+	{
+		if(mReadFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mReadFile);
+		}
+		mReadFile = CreateFileA(l_Container->CacheFilename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		mReadContainer = l_Container;
+	}
+
+	out_Image.Allocate(l_Entry.Width, l_Entry.Height, l_Entry.Format);
+	OVERLAPPED l_Overlapped;
+	memset(&l_Overlapped, 0, sizeof(l_Overlapped));
+	l_Overlapped.Offset = l_Entry.DataOffset;
+	DWORD l_BytesRead = 0;
+	bool l_Read = mReadFile != INVALID_HANDLE_VALUE && ReadFile(mReadFile, &out_Image.Pixels[0], l_Entry.DataSize, &l_BytesRead, &l_Overlapped) &&
+				  l_BytesRead == l_Entry.DataSize;
+#else
+	#error Your platform file read goes here
+#endif // WIN32
+
+	if(!l_Read || ContainerChecksum(&out_Image.Pixels[0], l_Entry.DataSize) != l_Entry.Checksum)
+	{
+		logf("Decoded cache entry at offset %u in '%s' is unreadable", l_Entry.DataOffset, l_Container->CacheFilename.c_str());
+		mMissCount++;
+		METRIC_ADD(Metric_DecodedCacheMisses, 1)
+		return false;
+	}
+
+	mHitCount++;
+	METRIC_ADD(Metric_DecodedCacheHits, 1)
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void DecodedCache::Store(const char* in_Filename, unsigned in_Offset, unsigned in_Size, int in_ScaleShift, const DecodedImage& in_Image)
+{
+	if(in_Image.Width > mMaxSize || in_Image.Height > mMaxSize ||
+	   (in_Image.Format != TextureFormat_RGB && in_Image.Format != TextureFormat_RGBA && in_Image.Format != mFormat))
+	{
+		return;
+	}
+
+	WriteJob l_Job;
+	l_Job.Container = FindContainer(in_Filename);
+	l_Job.Key.Offset = in_Offset;
+	l_Job.Key.Size = in_Size;
+	l_Job.Key.ScaleShift = in_ScaleShift;
+	l_Job.Width = in_Image.Width;
+	l_Job.Height = in_Image.Height;
+
+	// Converting here keeps the writer thread to disk work
+	unsigned l_DataSize = GetTextureDataSize(in_Image.Width, in_Image.Height, mFormat);
+	if(in_Image.Format == mFormat)
+	{
+		mPool->Acquire(l_DataSize, l_Job.Pixels);
+		memcpy(&l_Job.Pixels[0], &in_Image.Pixels[0], l_DataSize);
+	}
+	else if(mFormat == TextureFormat_BC1)
+	{
+		DecodedImage l_Compressed(mPool);
+		CompressImage(in_Image, mFormat, l_Compressed);
+		l_Job.Pixels.swap(l_Compressed.Pixels);
+	}
+	else
+	{
+		mPool->Acquire(l_DataSize, l_Job.Pixels);
+		ConvertPixels(in_Image, mFormat, &l_Job.Pixels[0]);
+	}
+
+	mLock.Lock();
+	bool l_Queued = mJobCount < mJobs.size();
+	if(l_Queued)
+	{
+		WriteJob& l_Slot = mJobs[(mJobHead + mJobCount) % mJobs.size()];
+		l_Slot.Container = l_Job.Container;
+		l_Slot.Key = l_Job.Key;
+		l_Slot.Width = l_Job.Width;
+		l_Slot.Height = l_Job.Height;
+		l_Slot.Pixels.swap(l_Job.Pixels);
+		mJobCount++;
+	}
+	mLock.Unlock();
+
+	if(l_Queued)
+	{
+#ifdef WIN32
+		ReleaseSemaphore(mJobSemaphore, 1, NULL);
+#else
+		#error Your platform semaphore signal goes here
+#endif // WIN32
+	}
+	else
+	{
+		mDroppedCount++;
+	}
+
+	// The slot's old buffer, or the job's if it was dropped
+	mPool->Release(l_Job.Pixels);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void DecodedCache::Run()
+{
+	Tracer::Instance()->SetThreadName("DecodedCache");
+	WriteJob l_Job;
+	for(;;)
+	{
+#ifdef WIN32
+		WaitForSingleObject(mJobSemaphore, INFINITE);
+#else
+		#error Your platform semaphore wait goes here
+#endif // WIN32
+
+		mLock.Lock();
+		bool l_HaveJob = mJobCount > 0;
+		if(l_HaveJob)
+		{
+			WriteJob& l_Slot = mJobs[mJobHead];
+			l_Job.Container = l_Slot.Container;
+			l_Job.Key = l_Slot.Key;
+			l_Job.Width = l_Slot.Width;
+			l_Job.Height = l_Slot.Height;
+			l_Job.Pixels.swap(l_Slot.Pixels);
+			mJobHead = (mJobHead + 1) % mJobs.size();
+			mJobCount--;
+		}
+		mLock.Unlock();
+
+		if(l_HaveJob)
+		{
+			WriteRecord(l_Job);
+			mPool->Release(l_Job.Pixels);
+		}
+		else if(mStopThread)
+		{
+			break;
+		}
+	}
+
+	mThreadDone = true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+DecodedCache::ContainerData* DecodedCache::FindContainer(const char* in_Filename)
+{
+	if(mLastContainer && strcmp(mLastContainer->Filename.c_str(), in_Filename) == 0)
+	{
+		return mLastContainer;
+	}
+
+	map<string, ContainerData*>::iterator l_Found = mContainers.find(in_Filename);
+	if(l_Found != mContainers.end())
+	{
+		mLastContainer = l_Found->second;
+		return mLastContainer;
+	}
+
+	// The cache file is named after the container's path
+	ContainerData* l_Container = new ContainerData();
+	l_Container->Filename = in_Filename;
+	l_Container->CacheFilename = in_Filename;
+	for(unsigned i = 0; i < l_Container->CacheFilename.size(); i++)
+	{
+		char& l_Char = l_Container->CacheFilename[i];
+		if(l_Char == '/' || l_Char == '\\' || l_Char == ':')
+		{
+			l_Char = '_';
+		}
+	}
+	l_Container->CacheFilename = mDirectory + "/" + l_Container->CacheFilename + ".cache";
+	ReadIndex(l_Container);
+
+	mContainers[in_Filename] = l_Container;
+	mLastContainer = l_Container;
+	return l_Container;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void DecodedCache::ReadIndex(ContainerData* io_Container)
+{
+	// Until the file checks out, the writer starts it again
+	io_Container->Stale = true;
+	io_Container->ValidEnd = 0;
+
+	unsigned l_Stamp[3];
+	if(!GetSourceStamp(io_Container->Filename.c_str(), l_Stamp))
+	{
+		return;
+	}
+
+#ifdef WIN32
+	HANDLE l_File = CreateFileA(io_Container->CacheFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(l_File == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	unsigned l_FileSize = GetFileSize(l_File, NULL);
+
+	DecodedCacheHeader l_Header;
+	DWORD l_BytesRead = 0;
+	if(!ReadFile(l_File, &l_Header, sizeof(l_Header), &l_BytesRead, NULL) || l_BytesRead != sizeof(l_Header) ||
+	   l_Header.Magic != DECODED_CACHE_MAGIC || l_Header.Version != DECODED_CACHE_VERSION || memcmp(l_Header.SourceStamp, l_Stamp, sizeof(l_Stamp)) != 0)
+	{
+		CloseHandle(l_File);
+		return;
+	}
+
+	// Read the records up to the first one that didn't get written whole. The writer carries on from there
+	unsigned l_Position = sizeof(l_Header);
+	DecodedCacheRecord l_Record;
+	while(l_Position + sizeof(l_Record) <= l_FileSize)
+	{
+		OVERLAPPED l_Overlapped;
+		memset(&l_Overlapped, 0, sizeof(l_Overlapped));
+		l_Overlapped.Offset = l_Position;
+		if(!ReadFile(l_File, &l_Record, sizeof(l_Record), &l_BytesRead, &l_Overlapped) || l_BytesRead != sizeof(l_Record) ||
+		   l_Record.Magic != DECODED_RECORD_MAGIC || l_Record.DataSize > l_FileSize - l_Position - sizeof(l_Record) ||
+		   l_Record.DataSize != GetTextureDataSize(l_Record.Width, l_Record.Height, TextureFormat(l_Record.Format)))
+		{
+			break;
+		}
+
+		BlobKey l_Key;
+		l_Key.Offset = l_Record.SourceOffset;
+		l_Key.Size = l_Record.SourceSize;
+		l_Key.ScaleShift = l_Record.ScaleShift;
+
+		EntryData& l_Entry = io_Container->Entries[l_Key];
+		l_Entry.DataOffset = l_Position + sizeof(l_Record);
+		l_Entry.DataSize = l_Record.DataSize;
+		l_Entry.Width = l_Record.Width;
+		l_Entry.Height = l_Record.Height;
+		l_Entry.Format = TextureFormat(l_Record.Format);
+		l_Entry.Checksum = l_Record.Checksum;
+
+		l_Position += sizeof(l_Record) + l_Record.DataSize;
+	}
+	CloseHandle(l_File);
+#else
+	#error Your platform file read goes here
+#endif // WIN32
+
+	io_Container->Stale = false;
+	io_Container->ValidEnd = l_Position;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool DecodedCache::WriteRecord(WriteJob& io_Job)
+{
+	TRACE_SCOPE("CacheWrite")
+	ContainerData* l_Container = io_Job.Container;
+
+	// A thumbnail decoded twice before its first copy was written
+	mLock.Lock();
+	bool l_Present = l_Container->Entries.find(io_Job.Key) != l_Container->Entries.end();
+	mLock.Unlock();
+	if(l_Present)
+	{
+		return true;
+	}
+
+#ifdef WIN32
+	if(mWriteContainer != l_Container)
+	{
+		if(mWriteFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mWriteFile);
+		}
+		mWriteFile = CreateFileA(l_Container->CacheFilename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		mWriteContainer = l_Container;
+		if(mWriteFile == INVALID_HANDLE_VALUE)
+		{
+			logf("Failed to open decoded cache file '%s'", l_Container->CacheFilename.c_str());
+			return false;
+		}
+
+		// Start a stale file again. Otherwise cut off anything after the last whole record, so new records follow it
+		if(l_Container->Stale)
+		{
+			DecodedCacheHeader l_Header;
+			l_Header.Magic = DECODED_CACHE_MAGIC;
+			l_Header.Version = DECODED_CACHE_VERSION;
+			DWORD l_Written = 0;
+			if(!GetSourceStamp(l_Container->Filename.c_str(), l_Header.SourceStamp) || SetFilePointer(mWriteFile, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+			   !SetEndOfFile(mWriteFile) || !WriteFile(mWriteFile, &l_Header, sizeof(l_Header), &l_Written, NULL) || l_Written != sizeof(l_Header))
+			{
+				CloseHandle(mWriteFile);
+				mWriteFile = INVALID_HANDLE_VALUE;
+				return false;
+			}
+			l_Container->Stale = false;
+			l_Container->ValidEnd = sizeof(l_Header);
+		}
+		else if(SetFilePointer(mWriteFile, l_Container->ValidEnd, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER || !SetEndOfFile(mWriteFile))
+		{
+			CloseHandle(mWriteFile);
+			mWriteFile = INVALID_HANDLE_VALUE;
+			return false;
+		}
+	}
+	if(mWriteFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	DecodedCacheRecord l_Record;
+	l_Record.Magic = DECODED_RECORD_MAGIC;
+	l_Record.SourceOffset = io_Job.Key.Offset;
+	l_Record.SourceSize = io_Job.Key.Size;
+	l_Record.ScaleShift = io_Job.Key.ScaleShift;
+	l_Record.Width = io_Job.Width;
+	l_Record.Height = io_Job.Height;
+	l_Record.Format = mFormat;
+	l_Record.DataSize = (unsigned)io_Job.Pixels.size();
+	l_Record.Checksum = ContainerChecksum(&io_Job.Pixels[0], l_Record.DataSize);
+
+	// The file pointer is always at the end of the last whole record
+	DWORD l_RecordWritten = 0;
+	DWORD l_PixelsWritten = 0;
+	bool l_Written = WriteFile(mWriteFile, &l_Record, sizeof(l_Record), &l_RecordWritten, NULL) && l_RecordWritten == sizeof(l_Record) &&
+					 WriteFile(mWriteFile, &io_Job.Pixels[0], l_Record.DataSize, &l_PixelsWritten, NULL) && l_PixelsWritten == l_Record.DataSize;
+#else
+	#error Your platform file write goes here
+#endif // WIN32
+
+	if(!l_Written)
+	{
+		// Put the pointer back so a later record doesn't land after a torn one
+		logf("Failed to write to decoded cache file '%s'", l_Container->CacheFilename.c_str());
+		SetFilePointer(mWriteFile, l_Container->ValidEnd, NULL, FILE_BEGIN);
+		return false;
+	}
+
+	EntryData l_Entry;
+	l_Entry.DataOffset = l_Container->ValidEnd + sizeof(l_Record);
+	l_Entry.DataSize = l_Record.DataSize;
+	l_Entry.Width = l_Record.Width;
+	l_Entry.Height = l_Record.Height;
+	l_Entry.Format = mFormat;
+	l_Entry.Checksum = l_Record.Checksum;
+	l_Container->ValidEnd += sizeof(l_Record) + l_Record.DataSize;
+
+	mLock.Lock();
+	l_Container->Entries[io_Job.Key] = l_Entry;
+	mLock.Unlock();
+
+	mWriteCount++;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool DecodedCache::GetSourceStamp(const char* in_Filename, unsigned out_Stamp[3])
+{
+#ifdef WIN32
+	WIN32_FILE_ATTRIBUTE_DATA l_Attributes;
+	if(!GetFileAttributesExA(in_Filename, GetFileExInfoStandard, &l_Attributes))
+	{
+		return false;
+	}
+	out_Stamp[0] = l_Attributes.nFileSizeLow;
+	out_Stamp[1] = l_Attributes.ftLastWriteTime.dwLowDateTime;
+	out_Stamp[2] = l_Attributes.ftLastWriteTime.dwHighDateTime;
+	return true;
+#else
+	#error Your platform file attributes go here
+#endif // WIN32
+}
@@ -0,0 +1,188 @@
+/**
+ * @file DecodedCache.h
+ * @brief DecodedCache class header file
+ */
+
+#ifndef DECODEDCACHE_H_
+#define DECODEDCACHE_H_
+
+#include "Global.h"
+#include "Thread.h"
+#include "Semaphore.h"
+#include "ImageDecoder.h"
+
+/**
+ * DecodedCache
+ * On-disk cache of decoded thumbnails, stored ready to upload, so a thumbnail seen in an earlier session costs a read
+ * and no decode. Each thumbnail container has a cache file of its own in the cache directory, keyed by the offset,
+ * size and scale of each thumbnail. A cache file is started again when its container changes.
+ * Load and Store are called from the texture loader's worker thread, or from the main thread when loading synchronously. Stored thumbnails are converted to the cache
+ * format and written out by a thread of the cache's own, so storing never waits on the disk
+ */
+class DecodedCache : public Thread
+{
+	/**
+	 * BlobKey
+	 * A thumbnail within its container, and the scale it was decoded at
+	 */
+	struct BlobKey
+	{
+		bool operator<(const BlobKey& in_Other) const
+		{
+			if(Offset != in_Other.Offset)
+				return Offset < in_Other.Offset;
+			if(Size != in_Other.Size)
+				return Size < in_Other.Size;
+			return ScaleShift < in_Other.ScaleShift;
+		}
+
+		unsigned Offset;
+		unsigned Size;
+		int ScaleShift;
+	};
+
+	/**
+	 * EntryData
+	 * A decoded thumbnail in a cache file
+	 */
+	struct EntryData
+	{
+		unsigned DataOffset;
+		unsigned DataSize;
+		int Width;
+		int Height;
+		TextureFormat Format;
+		unsigned Checksum;
+	};
+
+	/**
+	 * ContainerData
+	 * The cache file of one container
+	 */
+	struct ContainerData
+	{
+		string Filename;						// The container
+		string CacheFilename;
+		map<BlobKey, EntryData> Entries;		// Thumbnails written to the cache file (under mLock)
+		unsigned ValidEnd;						// End of the last whole record, where the next one is written (writer thread)
+		bool Stale;								// The cache file is missing or out of date, the writer starts it again
+	};
+
+	/**
+	 * WriteJob
+	 * A converted thumbnail waiting for the writer thread
+	 */
+	struct WriteJob
+	{
+		ContainerData* Container;
+		BlobKey Key;
+		int Width;
+		int Height;
+		vector<unsigned char> Pixels;			// From the staging pool, in the cache format
+	};
+
+public:
+
+	/**
+	 * Constructor
+	 * Cache thumbnails no bigger than in_MaxSize in either direction in in_Directory, stored as in_Format
+	 * (TextureFormat_RGBA, TextureFormat_RGB565 or TextureFormat_BC1). Write buffers come from in_Pool
+	 */
+	DecodedCache(const char* in_Directory, TextureFormat in_Format, int in_MaxSize, StagingBufferPool* in_Pool);
+	virtual ~DecodedCache();
+
+	/**
+	 * Load
+	 * Read a cached thumbnail into out_Image. Returns false if it isn't cached or can't be read
+	 */
+	bool Load(const char* in_Filename, unsigned in_Offset, unsigned in_Size, int in_ScaleShift, DecodedImage& out_Image);
+
+	/**
+	 * Store
+	 * Queue a decoded thumbnail to be written to the cache. in_Image is RGB, RGBA or already in the cache format.
+	 * Thumbnails that are too big are ignored, and the thumbnail is dropped if the writer has too much queued already
+	 */
+	void Store(const char* in_Filename, unsigned in_Offset, unsigned in_Size, int in_ScaleShift, const DecodedImage& in_Image);
+
+	/**
+	 * GetFormat
+	 * Format the thumbnails are cached in
+	 */
+	TextureFormat GetFormat() const { return mFormat; }
+
+	/**
+	 * Statistics
+	 */
+	unsigned GetHitCount() const { return mHitCount; }
+	unsigned GetMissCount() const { return mMissCount; }
+	unsigned GetWriteCount() const { return mWriteCount; }
+	unsigned GetDroppedCount() const { return mDroppedCount; }
+
+	/**
+	 * Thread interface
+	 * The writer thread
+	 */
+	virtual void Run();
+
+private:
+
+	/**
+	 * FindContainer
+	 * Find the cache of a container, reading the cache file's index the first time the container is seen
+	 */
+	ContainerData* FindContainer(const char* in_Filename);
+
+	/**
+	 * ReadIndex
+	 * Read the records of a container's cache file into its entries, checking the file was made from the
+	 * container as it is now
+	 */
+	void ReadIndex(ContainerData* io_Container);
+
+	/**
+	 * WriteRecord
+	 * Append a thumbnail to its container's cache file and add it to the entries (writer thread only)
+	 */
+	bool WriteRecord(WriteJob& io_Job);
+
+	/**
+	 * GetSourceStamp
+	 * Size and last write time of a container, which a cache file must match to be used
+	 */
+	static bool GetSourceStamp(const char* in_Filename, unsigned out_Stamp[3]);
+
+	string mDirectory;
+	TextureFormat mFormat;
+	int mMaxSize;
+	StagingBufferPool* mPool;
+
+	map<string, ContainerData*> mContainers;	// Every container seen (worker thread only)
+	ContainerData* mLastContainer;				// Most recent FindContainer result, the next one is usually the same
+
+	ContainerData* mReadContainer;				// Cache file open for reading (worker thread only)
+	ContainerData* mWriteContainer;				// Cache file open for writing (writer thread only)
+
+	Semaphore mLock;							// Protects the entries and the job queue
+	vector<WriteJob> mJobs;						// Circular queue of thumbnails waiting to be written
+	unsigned mJobHead;
+	unsigned mJobCount;
+
+	volatile bool mStopThread;
+	volatile bool mThreadDone;
+
+	unsigned mHitCount;
+	unsigned mMissCount;
+	unsigned mWriteCount;
+	unsigned mDroppedCount;
+
+#ifdef WIN32
+	HANDLE mReadFile;
+	HANDLE mWriteFile;
+	HANDLE mJobSemaphore;						// Counts the jobs, the writer sleeps on it
+#endif // WIN32
+
+	DecodedCache(const DecodedCache&);
+	const DecodedCache& operator=(const DecodedCache&);
+};
+
+#endif // DECODEDCACHE_H_
@@ -0,0 +1,62 @@
+/**
+ * @file DevILDecoder.cpp
+ * @brief DevILDecoder implementation file
+ */
+
+#include "DevILDecoder.h"
+#include "IL/il.h"
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// DevILDecoder
+
+bool DevILDecoder::Decode(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena* in_Arena,
+						  const OutputFormat& in_Format)
+{
+	bool l_Success = false;
+
+	mDecodeLock.Lock();
+
+	// Get DevIL to handle the dirty image loading details
+	unsigned l_ImageHandle;
+	ilGenImages(1, &l_ImageHandle);
+	ilBindImage(l_ImageHandle);
+	if(ilLoadL(IL_TYPE_UNKNOWN, (void*)in_Data, in_Size))
+	{
+		// DevIL can pad RGB out to RGBA as it copies. It has no 16 bit formats, those stay RGB
+		int l_Format = ilGetInteger(IL_IMAGE_FORMAT);
+		if(l_Format != IL_RGBA && in_Format.Choose(ilGetInteger(IL_IMAGE_WIDTH), ilGetInteger(IL_IMAGE_HEIGHT)) == TextureFormat_RGBA)
+		{
+			ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+			l_Format = IL_RGBA;
+		}
+
+		switch(l_Format)
+		{
+		case IL_RGB: l_Format = TextureFormat_RGB; break;
+		case IL_RGBA: l_Format = TextureFormat_RGBA; break;
+		default:
+
+			// Let DevIL convert anything unusual (luminance, BGR, palettes) to something we can upload
+			ilConvertImage(IL_RGB, IL_UNSIGNED_BYTE);
+			l_Format = TextureFormat_RGB;
+			break;
+		}
+
+		// Copy the pixels out of DevIL
+		out_Image.Allocate(ilGetInteger(IL_IMAGE_WIDTH), ilGetInteger(IL_IMAGE_HEIGHT), TextureFormat(l_Format));
+		memcpy(&out_Image.Pixels[0], ilGetData(), out_Image.Pixels.size());
+		l_Success = true;
+	}
+	else
+	{
+		ILenum l_Error =  ilGetError();
+		logf("Failed to load texture: ilError=%d", l_Error);
+	}
+
+	// Free DevIL resources
+	ilDeleteImages(1, &l_ImageHandle);
+
+	mDecodeLock.Unlock();
+
+	return l_Success;
+}
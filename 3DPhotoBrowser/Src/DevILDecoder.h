@@ -0,0 +1,35 @@
+/**
+ * @file DevILDecoder.h
+ * @brief DevILDecoder class header file
+ */
+
+#ifndef DEVILDECODER_H_
+#define DEVILDECODER_H_
+
+#include "Global.h"
+#include "ImageDecoder.h"
+#include "Semaphore.h"
+
+/**
+ * DevILDecoder
+ * Decodes any format DevIL understands. Used as the fallback for anything the faster decoders reject.
+ * DevIL keeps global state (the bound image), so decodes are serialized. ilInit must have been called
+ */
+class DevILDecoder : public ImageDecoder
+{
+public:
+
+	/**
+	 * ImageDecoder interface
+	 */
+	virtual const char* GetName() const { return "DevIL"; }
+	virtual bool CanDecode(const unsigned char* in_Data, unsigned in_Size) const { return in_Size > 0; }
+	virtual bool Decode(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena* in_Arena = NULL,
+						const OutputFormat& in_Format = OutputFormat());
+
+private:
+
+	Semaphore mDecodeLock;	// Only one thread may use DevIL at a time
+};
+
+#endif // DEVILDECODER_H_
@@ -9,7 +9,12 @@
 #define DEG_TO_RAD	0.017453292519943295769
 #define RAD_TO_DEG	57.295779513082320876798
 
-#define USE_THREADED_TEXTURE_LOADING 0
+// Without threaded loading every 64x64 thumbnail is loaded on the main thread at startup, and the request queues,
+// read scheduling, asynchronous reads and streamed uploads all go unused
+#define USE_THREADED_TEXTURE_LOADING 1
+#define USE_PROFILER 1
+#define USE_TRACING 1
+#define USE_METRICS 1
 
 // Platform Dependent Header Files
 #ifdef WIN32
@@ -33,9 +38,11 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <deque>
 #include <queue>
 #include <stack>
 #include <map>
+#include <algorithm>
 using namespace std;
 
 // Application Header Files
@@ -45,13 +52,17 @@ using namespace std;
 #include "Graphics.h"
 #include "UserPreferences.h"
 
-// Macros
-#define PROFILE_BLOCK(executionTime, code) \
+// Macros, for files that include Profiler.h
+#if USE_PROFILER
+	#define PROFILE_SCOPE(phase) ProfileScope l_ProfileScope(phase);
+#else
+	#define PROFILE_SCOPE(phase)
+#endif // USE_PROFILER
+
+#define PROFILE_BLOCK(phase, code) \
 { \
-	double l_Time = Timer::Instance()->GetSeconds(); \
+	PROFILE_SCOPE(phase) \
 	code \
-	extern double executionTime; \
-	executionTime = Timer::Instance()->GetSeconds() - l_Time; \
 }
 
 #endif // GLOBAL_H_
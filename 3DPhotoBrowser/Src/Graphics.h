@@ -21,7 +21,47 @@ typedef unsigned TextureHandle;
 enum TextureFormat
 {
 	TextureFormat_RGB,
-	TextureFormat_RGBA
+	TextureFormat_RGBA,
+	TextureFormat_RGB565,		// 16 bit pixels, red in the top 5 bits
+	TextureFormat_BC1,			// 4x4 blocks of 8 bytes, opaque (DXT1)
+	TextureFormat_BC3			// 4x4 blocks of 16 bytes, with alpha (DXT5)
+};
+
+/**
+ * IsCompressedTextureFormat
+ * Is the format made of compressed blocks rather than pixels?
+ */
+inline bool IsCompressedTextureFormat(TextureFormat in_Format)
+{
+	return in_Format == TextureFormat_BC1 || in_Format == TextureFormat_BC3;
+}
+
+/**
+ * GetTextureDataSize
+ * Size in bytes of a texture's pixels, with the rows tightly packed. Compressed formats round up to whole blocks
+ */
+inline unsigned GetTextureDataSize(int in_Width, int in_Height, TextureFormat in_Format)
+{
+	switch(in_Format)
+	{
+	case TextureFormat_RGBA:	return in_Width * in_Height * 4;
+	case TextureFormat_RGB565:	return in_Width * in_Height * 2;
+	case TextureFormat_BC1:		return ((in_Width + 3) / 4) * ((in_Height + 3) / 4) * 8;
+	case TextureFormat_BC3:		return ((in_Width + 3) / 4) * ((in_Height + 3) / 4) * 16;
+	default:					return in_Width * in_Height * 3;
+	}
+}
+
+/**
+ * UploadSpan
+ * Space reserved in the graphics upload buffer. The buffer stays mapped, so texture data can be written straight into
+ * it from any thread
+ */
+struct UploadSpan
+{
+	unsigned char* Data;		// Where the texture data goes
+	unsigned Offset;			// Of Data within the upload buffer
+	unsigned End;				// Position in the upload stream just past the span, for releasing it
 };
 
 /**
@@ -121,6 +161,33 @@ public:
 	 */
 	virtual TextureHandle CreateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels) = 0;
 
+	/**
+	 * SupportsTextureFormat
+	 * Can CreateTexture take this format? Every uncompressed format is supported
+	 */
+	virtual bool SupportsTextureFormat(TextureFormat in_Format) = 0;
+
+	/**
+	 * GetUploadFormat
+	 * Uncompressed format the graphics card takes without converting it on upload, for full color textures or, with
+	 * in_Reduced, where 16 bit color will do
+	 */
+	virtual TextureFormat GetUploadFormat(bool in_Reduced) = 0;
+
+	/**
+	 * ReserveUpload
+	 * Reserve in_Size bytes of the upload buffer. May be called from any thread. Returns false if streaming uploads
+	 * aren't supported or the buffer is full, the texture should then go through CreateTexture
+	 */
+	virtual bool ReserveUpload(unsigned in_Size, UploadSpan& out_Span) = 0;
+
+	/**
+	 * CreateTextureFromUpload
+	 * Create a texture from the data written to a reserved span. The copy to graphics memory happens asynchronously.
+	 * Spans are released in the order they were reserved. Main thread only
+	 */
+	virtual TextureHandle CreateTextureFromUpload(int in_Width, int in_Height, TextureFormat in_Format, const UploadSpan& in_Span) = 0;
+
 	/**
 	 * BindTexture
 	 * Bind a texture for rendering
@@ -159,6 +226,15 @@ public:
 						  float in_ColorR, float in_ColorG, float in_ColorB, 
 						  float in_Width, float in_Height) = 0;
 
+	/**
+	 * DrawQuad
+	 * Draw a single quad in the xy plane, textured with a sub-rectangle of the bound texture
+	 */
+	virtual void DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ,
+						  float in_ColorR, float in_ColorG, float in_ColorB, 
+						  float in_Width, float in_Height,
+						  float in_MinU, float in_MinV, float in_MaxU, float in_MaxV) = 0;
+
 	/**
 	 * DrawQuads
 	 * Draw a set of quads.
@@ -180,6 +256,13 @@ public:
 	 */
 	virtual void Flush() = 0;
 
+	/**
+	 * EndFrame
+	 * Called once a frame after the buffers are swapped. Fences the uploads made during the frame and releases the
+	 * upload buffer space of earlier frames the graphics card has finished with
+	 */
+	virtual void EndFrame() = 0;
+
 protected:
 
 	/**
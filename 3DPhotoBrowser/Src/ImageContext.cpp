@@ -5,6 +5,7 @@
 
 #include "ImageContext.h"
 #include "ImageTile.h"
+#include "ContainerFormat.h"
 
 //-----------------------------------------------------------------------------------------------------------------------------
 // ImageContext
@@ -100,9 +101,9 @@ bool ImageContext::CreateContext()
 
 			// The ThumbContainerIndex is bit packed to store two values:
 			//	- The lower 3 bits are the thumbnail size index
-			//	- The remaining bits are the container file index
+			//	- The remaining bits are the container file index, apart from the top bit which marks a container of LOD chains
 			unsigned l_ThumbnailSizeIndex = l_Data.Thumbnails[i].ThumbContainerIndex & 0x07;
-			unsigned l_ThumbnailContainerIndex = l_Data.Thumbnails[i].ThumbContainerIndex >> 3;
+			unsigned l_ThumbnailContainerIndex = (l_Data.Thumbnails[i].ThumbContainerIndex & ~CONTAINER_LOD_CHAIN_FLAG) >> 3;
 
 			// The ThumbnailSizeIndex has the following meaning
 			// Beginning at 1024x1024, each time the index increases, the power of two is decreased
@@ -121,15 +122,25 @@ bool ImageContext::CreateContext()
 			}
 
 			// The thumbnails are stored in subdirectories of the data folder
-			// They are of the form: data/thumbnail32/container00000.dat
+			// They are of the form: data/thumbnail32/container00000.dat, or data/thumbnails/container00000.dat for LOD chains
 			// We precalculate the folder name here to save the ImageTile from doing this work later
-			sprintf(l_Buff, "data/thumbnails%d/container%05d.dat", 32 << l_ThumbnailSize, l_ThumbnailContainerIndex);
+			if(l_Data.Thumbnails[i].ThumbContainerIndex & CONTAINER_LOD_CHAIN_FLAG)
+			{
+				sprintf(l_Buff, "data/thumbnails/container%05d.dat", l_ThumbnailContainerIndex);
+			}
+			else
+			{
+				sprintf(l_Buff, "data/thumbnails%d/container%05d.dat", 32 << l_ThumbnailSize, l_ThumbnailContainerIndex);
+			}
 
 			// Add this information to the ImageTile.
 			// It can later use this information to load the thumbnail on the fly
 			l_Tile->AddThumbnailInfo(l_ThumbnailSize, l_Buff,
 				l_Data.Thumbnails[i].ThumbFileOffset, l_Data.Thumbnails[i].ThumbImageSize);
 		}
+
+		// The index often skips sizes, produce those from the next stored size up
+		l_Tile->SynthesizeMissingThumbnails();
 	}
 
 #ifdef WIN32
@@ -139,13 +150,118 @@ bool ImageContext::CreateContext()
 	// Close the file
 	l_File.close();
 
+	// Previews are optional, the tiles simply use their average color until a thumbnail loads
+	if(!LoadPreviews())
+	{
+		logf("No image previews available");
+	}
+
 	return true;
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
+bool ImageContext::LoadPreviews()
+{
+	// Open the preview file written by the index sorting tool
+	ifstream l_File;
+	l_File.open("data/photo_index_previews.dat", ios_base::in | ios_base::binary);
+	if(l_File.fail())
+	{
+		return false;
+	}
+
+	// The previews are stored in the same order as the index file, so the counts must match
+	unsigned l_ImageCount = 0;
+	unsigned l_PreviewSize = 0;
+	l_File.read((char*)&l_ImageCount, 4);
+	l_File.read((char*)&l_PreviewSize, 4);
+	if(l_File.fail() || l_ImageCount != mImageTileCount || l_PreviewSize == 0 || l_PreviewSize > PREVIEW_ATLAS_SIZE)
+	{
+		logf("Image preview file doesn't match the photo index file");
+		return false;
+	}
+
+	// Pack the previews into as few atlas pages as possible
+	const unsigned l_PreviewsPerRow = PREVIEW_ATLAS_SIZE / l_PreviewSize;
+	const unsigned l_PreviewsPerPage = l_PreviewsPerRow * l_PreviewsPerRow;
+	const unsigned l_PreviewBytes = l_PreviewSize * l_PreviewSize * 3;
+
+	// Inset the texture coordinates by half a texel so linear filtering doesn't bleed in the neighbouring preview
+	const float l_TexelSize = 1.0f / PREVIEW_ATLAS_SIZE;
+	const float l_HalfTexel = l_TexelSize * 0.5f;
+
+	vector<unsigned char> l_Preview(l_PreviewBytes);
+	vector<unsigned char> l_Page;
+	for(unsigned l_First = 0; l_First < l_ImageCount; l_First += l_PreviewsPerPage)
+	{
+		unsigned l_Count = min(l_ImageCount - l_First, l_PreviewsPerPage);
+		l_Page.assign(PREVIEW_ATLAS_SIZE * PREVIEW_ATLAS_SIZE * 3, 0);
+
+		for(unsigned i = 0; i < l_Count; i++)
+		{
+			l_File.read((char*)&l_Preview[0], l_PreviewBytes);
+			if(l_File.fail())
+			{
+				logf("Image preview file is truncated");
+				DestroyPreviews();
+				return false;
+			}
+
+			// Copy the preview into its cell, row by row
+			unsigned l_CellX = (i % l_PreviewsPerRow) * l_PreviewSize;
+			unsigned l_CellY = (i / l_PreviewsPerRow) * l_PreviewSize;
+			for(unsigned y = 0; y < l_PreviewSize; y++)
+			{
+				memcpy(&l_Page[((l_CellY + y) * PREVIEW_ATLAS_SIZE + l_CellX) * 3], &l_Preview[y * l_PreviewSize * 3], l_PreviewSize * 3);
+			}
+
+			// Point the tile at its cell
+			ImageTile* l_Tile = &mImageTiles[l_First + i];
+			l_Tile->mPreviewMinU = l_CellX * l_TexelSize + l_HalfTexel;
+			l_Tile->mPreviewMinV = l_CellY * l_TexelSize + l_HalfTexel;
+			l_Tile->mPreviewMaxU = (l_CellX + l_PreviewSize) * l_TexelSize - l_HalfTexel;
+			l_Tile->mPreviewMaxV = (l_CellY + l_PreviewSize) * l_TexelSize - l_HalfTexel;
+		}
+
+		// Upload the page and hand it to the tiles that use it
+		TextureHandle l_Handle = Graphics::Instance()->CreateTexture(PREVIEW_ATLAS_SIZE, PREVIEW_ATLAS_SIZE, TextureFormat_RGB, &l_Page[0]);
+		mPreviewPages.push_back(l_Handle);
+		for(unsigned i = 0; i < l_Count; i++)
+		{
+			mImageTiles[l_First + i].mPreviewTexture = l_Handle;
+		}
+	}
+
+	l_File.close();
+
+	logf("Loaded %u image previews into %u atlas pages", l_ImageCount, (unsigned)mPreviewPages.size());
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void ImageContext::DestroyPreviews()
+{
+	for(unsigned i = 0; i < mPreviewPages.size(); i++)
+	{
+		Graphics::Instance()->FreeTexture(mPreviewPages[i]);
+	}
+	mPreviewPages.clear();
+
+	for(unsigned i = 0; i < mImageTileCount; i++)
+	{
+		mImageTiles[i].mPreviewTexture = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
 bool ImageContext::DestroyContext()
 {
+	// Free the preview atlas
+	DestroyPreviews();
+
 	// Delete dynamically allocated ImageTiles
 	delete [] mImageTiles;
 
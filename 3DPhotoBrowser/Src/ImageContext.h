@@ -91,6 +91,27 @@ public:
 
 private:
 
+	/**
+	 * LoadPreviews
+	 * Load the micro-thumbnails written by the index sorting tool into atlas textures, and point each ImageTile
+	 * at its preview. Returns false if there is no preview file or it doesn't match the index file
+	 */
+	bool LoadPreviews();
+
+	/**
+	 * DestroyPreviews
+	 * Free the preview atlas textures
+	 */
+	void DestroyPreviews();
+
+	/**
+	 * PREVIEW_ATLAS_SIZE
+	 * The width and height of each preview atlas page, in pixels
+	 */
+	static const int PREVIEW_ATLAS_SIZE = 1024;
+
+	vector<TextureHandle> mPreviewPages;	// Preview atlas textures
+
 	int mMinYear;
 	int mMaxYear;
 
@@ -0,0 +1,85 @@
+/**
+ * @file ImageDecoder.cpp
+ * @brief ImageDecoder implementation file
+ */
+
+#include "ImageDecoder.h"
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// ImageDecoder
+
+bool ImageDecoder::DecodeScaled(const unsigned char* in_Data, unsigned in_Size, int in_ScaleShift, DecodedImage& out_Image, DecodeArena* in_Arena,
+								const OutputFormat& in_Format)
+{
+	if(!Decode(in_Data, in_Size, out_Image, in_Arena))
+	{
+		return false;
+	}
+
+	ShrinkImage(out_Image, in_ScaleShift);
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// DecodedImage
+
+void DecodedImage::Allocate(int in_Width, int in_Height, TextureFormat in_Format)
+{
+	Width = in_Width;
+	Height = in_Height;
+	Format = in_Format;
+
+	unsigned l_Size = GetTextureDataSize(in_Width, in_Height, in_Format);
+	if(Pool)
+	{
+		Pool->Acquire(l_Size, Pixels);
+	}
+	else
+	{
+		Pixels.resize(l_Size);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void ShrinkImage(DecodedImage& io_Image, int in_ScaleShift)
+{
+	if(in_ScaleShift <= 0)
+	{
+		return;
+	}
+
+	int l_Factor = 1 << in_ScaleShift;
+	int l_BytesPerPixel = io_Image.Format == TextureFormat_RGBA ? 4 : 3;
+	int l_Width = (io_Image.Width + l_Factor - 1) / l_Factor;
+	int l_Height = (io_Image.Height + l_Factor - 1) / l_Factor;
+
+	// Average each factor x factor box, clipping the boxes on the right and bottom edges to the image.
+	// This is done in place: each box is read before its output pixel, which never lies past the box, is written
+	unsigned char* l_Pixels = &io_Image.Pixels[0];
+	for(int y = 0; y < l_Height; y++)
+	{
+		int l_MaxY = min((y + 1) * l_Factor, io_Image.Height);
+		for(int x = 0; x < l_Width; x++)
+		{
+			int l_MaxX = min((x + 1) * l_Factor, io_Image.Width);
+			int l_Count = (l_MaxY - y * l_Factor) * (l_MaxX - x * l_Factor);
+			for(int c = 0; c < l_BytesPerPixel; c++)
+			{
+				int l_Sum = 0;
+				for(int sy = y * l_Factor; sy < l_MaxY; sy++)
+				{
+					for(int sx = x * l_Factor; sx < l_MaxX; sx++)
+					{
+						l_Sum += io_Image.Pixels[(sy * io_Image.Width + sx) * l_BytesPerPixel + c];
+					}
+				}
+				l_Pixels[(y * l_Width + x) * l_BytesPerPixel + c] = (unsigned char)((l_Sum + l_Count / 2) / l_Count);
+			}
+		}
+	}
+
+	io_Image.Width = l_Width;
+	io_Image.Height = l_Height;
+	io_Image.Pixels.resize(l_Width * l_Height * l_BytesPerPixel);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file ImageDecoder.h
+ * @brief ImageDecoder interface header file
+ */
+
+#ifndef IMAGEDECODER_H_
+#define IMAGEDECODER_H_
+
+#include "Global.h"
+#include "DecodeBuffers.h"
+
+/**
+ * DecodedImage
+ * An image decoded into system memory
+ */
+struct DecodedImage
+{
+	DecodedImage(StagingBufferPool* in_Pool = NULL)
+		: Width(0), Height(0), Format(TextureFormat_RGB), Pool(in_Pool) {}
+	~DecodedImage() { if(Pool) Pool->Release(Pixels); }
+
+	/**
+	 * Allocate
+	 * Set the image size and format and size the pixel buffer to match. Decoders use this rather than
+	 * resizing Pixels themselves so the buffer comes from the pool
+	 */
+	void Allocate(int in_Width, int in_Height, TextureFormat in_Format);
+
+	int Width;
+	int Height;
+	TextureFormat Format;
+	vector<unsigned char> Pixels;	// Rows are tightly packed, in the same order they are uploaded to graphics memory
+	StagingBufferPool* Pool;		// Pixels is taken from and returned to this pool, NULL to use the heap
+};
+
+/**
+ * OutputFormat
+ * Layout a caller wants decoded pixels in, normally the one the graphics card takes without converting. Images no
+ * bigger than SmallSize in either direction use SmallFormat, the rest Format. Each is RGB, RGBA (opaque, so every
+ * pixel is 4 byte aligned) or RGB565. A decoder that can't write the layout uses RGB or RGBA instead
+ */
+struct OutputFormat
+{
+	OutputFormat(TextureFormat in_Format = TextureFormat_RGB, TextureFormat in_SmallFormat = TextureFormat_RGB, int in_SmallSize = 0)
+		: Format(in_Format), SmallFormat(in_SmallFormat), SmallSize(in_SmallSize) {}
+
+	/**
+	 * Choose
+	 * Format for an image of this size
+	 */
+	TextureFormat Choose(int in_Width, int in_Height) const
+	{
+		return in_Width <= SmallSize && in_Height <= SmallSize ? SmallFormat : Format;
+	}
+
+	bool operator!=(const OutputFormat& in_Other) const
+	{
+		return Format != in_Other.Format || SmallFormat != in_Other.SmallFormat || SmallSize != in_Other.SmallSize;
+	}
+
+	TextureFormat Format;
+	TextureFormat SmallFormat;
+	int SmallSize;
+};
+
+/**
+ * ImageDecoder
+ * Interface for the decoders used to turn compressed thumbnail data into pixels.
+ * Decoders are registered with the TextureLoader, which tries them in registration order.
+ * Decode may be called from several threads at once, so implementations must be thread-safe.
+ * Scratch memory should come from in_Arena when one is given; the caller resets it between images
+ */
+class ImageDecoder
+{
+public:
+
+	/**
+	 * Destructor
+	 */
+	virtual ~ImageDecoder() {}
+
+	/**
+	 * GetName
+	 * Name of the decoder, used for logging and benchmarks
+	 */
+	virtual const char* GetName() const = 0;
+
+	/**
+	 * CanDecode
+	 * Quick check of the data signature. Returns false if this decoder definitely can't decode the data
+	 */
+	virtual bool CanDecode(const unsigned char* in_Data, unsigned in_Size) const = 0;
+
+	/**
+	 * Decode
+	 * Decode the data into out_Image, in in_Format where the decoder can. Rows are stored in the order they appear
+	 * in the file. Returns false if the data is corrupt or uses features the decoder doesn't support
+	 */
+	virtual bool Decode(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena* in_Arena = NULL,
+						const OutputFormat& in_Format = OutputFormat()) = 0;
+
+	/**
+	 * DecodeScaled
+	 * Decode the data at 1/2^in_ScaleShift of its stored size (in_ScaleShift 0-3), rounding the size up.
+	 * The default implementation decodes at full size and box filters the result down; decoders that
+	 * can skip work for smaller output should override it. The box filter needs RGB or RGBA, so the default ignores in_Format
+	 */
+	virtual bool DecodeScaled(const unsigned char* in_Data, unsigned in_Size, int in_ScaleShift, DecodedImage& out_Image, DecodeArena* in_Arena = NULL,
+							  const OutputFormat& in_Format = OutputFormat());
+};
+
+/**
+ * ShrinkImage
+ * Box filter an image down to 1/2^in_ScaleShift of its size, rounding the size up
+ */
+void ShrinkImage(DecodedImage& io_Image, int in_ScaleShift);
+
+#endif // IMAGEDECODER_H_
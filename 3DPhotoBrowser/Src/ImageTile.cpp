@@ -21,8 +21,9 @@ ImageTile::ImageTile()
 , mYear(0)
 , mAverageRed(1), mAverageGreen(1), mAverageBlue(1)
 , mActiveThumbnail(0)
+, mPreviewTexture(0)
+, mPreviewMinU(0), mPreviewMinV(0), mPreviewMaxU(1), mPreviewMaxV(1)
 {
-	memset(mThumbnailInfo, 0, sizeof(mThumbnailInfo));
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -49,6 +50,20 @@ void ImageTile::Draw()
 		// Render white so we don't tint the texture
 		l_ColorRed = l_ColorGreen = l_ColorBlue = 1.0f;
 	}
+	// Otherwise fall back on the preview from the atlas, which is better than a flat color
+	else if(mPreviewTexture && UserPreferences::Instance()->ShowImagePreviews())
+	{
+		Graphics::Instance()->BindTexture(mPreviewTexture);
+		Graphics::Instance()->DrawQuad
+		(
+			mPosX, mPosY, mPosZ,					// Position in xy-plane
+			1.0f, 1.0f, 1.0f,						// Color
+			mSizeX, mSizeY,							// Width/Height
+			mPreviewMinU, mPreviewMinV,				// Atlas texture coordinates
+			mPreviewMaxU, mPreviewMaxV
+		);
+		return;
+	}
 	else
 	{
 		// No texture
@@ -120,9 +135,45 @@ void ImageTile::OnLoadComplete(TextureHandle in_Handle, void* in_UserData)
 {
 	ThumbnailInfo* l_Info = (ThumbnailInfo*)in_UserData;
 
-	// Make this loaded thumbnail active
+	// Make this loaded thumbnail active, unless it was only prefetched
 	l_Info->TexHandle = in_Handle;
-	mActiveThumbnail = l_Info;
+	if(!l_Info->Prefetch)
+	{
+		mActiveThumbnail = l_Info;
+	}
+	l_Info->Prefetch = false;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void ImageTile::OnLoadCancelled(void* in_UserData)
+{
+	ThumbnailInfo* l_Info = (ThumbnailInfo*)in_UserData;
+
+	// Allow the thumbnail to be requested again
+	l_Info->LoadPending = false;
+	l_Info->Prefetch = false;
+
+	// If the tile was waiting on this thumbnail, it isn't any more
+	if(mActiveThumbnail == l_Info && !l_Info->TexHandle)
+	{
+		mActiveThumbnail = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void ImageTile::OnLeaveView()
+{
+	// Prefetches are left alone, they are already behind every visible load
+	for(int i = 0; i < ThumbnailSize_MAX; i++)
+	{
+		ThumbnailInfo* l_Info = &mThumbnailInfo[i];
+		if(l_Info->LoadPending && !l_Info->TexHandle && !l_Info->Prefetch)
+		{
+			TextureLoader::Instance()->CancelRequest((void*)l_Info);
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -138,14 +189,27 @@ void ImageTile::ActivateThumbnail(ThumbnailSize in_ThumbnailSize)
 		return;
 	}
 
+	// If the texture is already queued as a prefetch, it is needed now
+	if(l_Info && l_Info->LoadPending && l_Info->Prefetch)
+	{
+		l_Info->Prefetch = false;
+		TextureLoader::Instance()->PromoteRequest((void*)l_Info, LoadPriority_Visible);
+
+		// The prefetch may have finished while we were promoting it
+		if(l_Info->TexHandle)
+		{
+			mActiveThumbnail = l_Info;
+		}
+	}
 	// If we don't have the texture loaded, request an async load for it
-	if(l_Info && !l_Info->TexHandle && !l_Info->LoadPending)
+	else if(l_Info && !l_Info->TexHandle && !l_Info->LoadPending)
 	{
 #if USE_THREADED_TEXTURE_LOADING
-		l_Info->LoadPending = true;
-		TextureLoader::Instance()->LoadTexture(l_Info->Filename.c_str(), l_Info->Offset, l_Info->Size, this, (void*)l_Info);
+		// If the loader is swamped nothing is pending, and the visible set update asks again next frame
+		l_Info->LoadPending = TextureLoader::Instance()->LoadTexture(l_Info->Filename.c_str(), l_Info->Offset, l_Info->Size, this, (void*)l_Info,
+			LoadPriority_Visible, l_Info->ScaleShift);
 #else
-		l_Info->TexHandle = TextureLoader::Instance()->LoadTexture(l_Info->Filename.c_str(), l_Info->Offset, l_Info->Size);
+		l_Info->TexHandle = TextureLoader::Instance()->LoadTexture(l_Info->Filename.c_str(), l_Info->Offset, l_Info->Size, l_Info->ScaleShift);
 		mActiveThumbnail = l_Info;
 #endif // USE_THREADED_TEXTURE_LOADING
 	}
@@ -158,6 +222,28 @@ void ImageTile::ActivateThumbnail(ThumbnailSize in_ThumbnailSize)
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
+bool ImageTile::PrefetchThumbnail(ThumbnailSize in_ThumbnailSize, LoadPriority in_Priority)
+{
+#if USE_THREADED_TEXTURE_LOADING
+	// Nothing to do if the thumbnail doesn't exist, is already loaded, or is on its way
+	ThumbnailInfo* l_Info = in_ThumbnailSize > ThumbnailSize_None ? &mThumbnailInfo[in_ThumbnailSize] : NULL;
+	if(!l_Info || l_Info->Size == 0 || l_Info->TexHandle || l_Info->LoadPending)
+	{
+		return false;
+	}
+
+	l_Info->LoadPending = TextureLoader::Instance()->LoadTexture(l_Info->Filename.c_str(), l_Info->Offset, l_Info->Size, this, (void*)l_Info,
+		in_Priority, l_Info->ScaleShift);
+	l_Info->Prefetch = l_Info->LoadPending;
+	return l_Info->LoadPending;
+#else
+	// Synchronous loads would stall the frame, and every thumbnail in use is loaded at startup anyway
+	return false;
+#endif // USE_THREADED_TEXTURE_LOADING
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
 void ImageTile::AddThumbnailInfo(ThumbnailSize in_ThumbSize, const string& in_Filename, unsigned in_Offset, unsigned in_Size)
 {
 	// Add the new info
@@ -165,4 +251,34 @@ void ImageTile::AddThumbnailInfo(ThumbnailSize in_ThumbSize, const string& in_Fi
 	l_Info->Filename = in_Filename;
 	l_Info->Offset = in_Offset;
 	l_Info->Size = in_Size;
+	l_Info->ScaleShift = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void ImageTile::SynthesizeMissingThumbnails()
+{
+	// Each thumbnail size is twice the previous one, so a stored thumbnail N sizes up is decoded at 1/2^N
+	const int l_MaxScaleShift = 3;
+	for(int i = 0; i < ThumbnailSize_MAX; i++)
+	{
+		ThumbnailInfo* l_Info = &mThumbnailInfo[i];
+		if(l_Info->Size != 0)
+		{
+			continue;
+		}
+
+		for(int l_Shift = 1; l_Shift <= l_MaxScaleShift && i + l_Shift < ThumbnailSize_MAX; l_Shift++)
+		{
+			const ThumbnailInfo* l_Source = &mThumbnailInfo[i + l_Shift];
+			if(l_Source->Size != 0 && l_Source->ScaleShift == 0)
+			{
+				l_Info->Filename = l_Source->Filename;
+				l_Info->Offset = l_Source->Offset;
+				l_Info->Size = l_Source->Size;
+				l_Info->ScaleShift = l_Shift;
+				break;
+			}
+		}
+	}
 }
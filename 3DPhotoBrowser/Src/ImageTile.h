@@ -47,14 +47,17 @@ class ImageTile : public TextureLoaderListener
 		 * Default initialization
 		 */
 		ThumbnailInfo()
-			: Offset(0), Size(0), TexHandle(0), LoadPending(false) {}
+			: Offset(0), Size(0), ScaleShift(0), TexHandle(0), LoadPending(false), Prefetch(false) {}
 
 		string Filename;			// Of the form data/thumbnail32/container00000.dat
 		unsigned Offset;			// Offset into the file (in bytes) where the thumbnail begins
 		unsigned Size;				// Size of thumbnail data (in bytes) within Filename, beginning at Offset
+		int ScaleShift;				// The stored thumbnail is decoded at 1/2^ScaleShift of its size. Non-zero when
+									// this size is missing from the index and is produced from a larger thumbnail
 	
 		TextureHandle TexHandle;	// The graphics texture handle
 		bool LoadPending;			// Does this thumbnail already have a load pending?
+		bool Prefetch;				// Is the pending load a prefetch? Prefetched thumbnails aren't activated when they finish loading
 	};
 
 public:
@@ -119,6 +122,53 @@ public:
 		out_PosZ = mMoveToGoalZ;
 	}
 
+	/**
+	 * IsMoving
+	 * Is this image tile still animating towards its goal position?
+	 */
+	bool IsMoving() const { return mMoveTime > 0; }
+
+	/**
+	 * IsTextured
+	 * Is this image tile drawn with the thumbnail of the given size, rather than another size, a preview or its average color?
+	 */
+	bool IsTextured(ThumbnailSize in_ThumbnailSize) const
+	{
+		return in_ThumbnailSize > ThumbnailSize_None && mActiveThumbnail == &mThumbnailInfo[in_ThumbnailSize] && mActiveThumbnail->TexHandle;
+	}
+
+	/**
+	 * NeedsThumbnailRequest
+	 * Is the thumbnail of the given size neither active nor on its way as a visible load? A visible tile ends up like
+	 * this when the loader was too full to take its request, or when the cancellation from it leaving the view
+	 * arrived after it came back. ActivateThumbnail must be called again
+	 */
+	bool NeedsThumbnailRequest(ThumbnailSize in_ThumbnailSize) const
+	{
+		const ThumbnailInfo* l_Info = in_ThumbnailSize > ThumbnailSize_None ? &mThumbnailInfo[in_ThumbnailSize] : NULL;
+		return l_Info && mActiveThumbnail != l_Info && (!l_Info->LoadPending || l_Info->Prefetch);
+	}
+
+	/**
+	 * GetThumbnailInfo
+	 * Get the container location of a thumbnail, and the scale it must be decoded at to give the requested size.
+	 * Returns false if the thumbnail size doesn't exist for this image
+	 */
+	bool GetThumbnailInfo(ThumbnailSize in_ThumbnailSize, string& out_Filename, unsigned& out_Offset, unsigned& out_Size, int& out_ScaleShift) const
+	{
+		const ThumbnailInfo& l_Info = mThumbnailInfo[in_ThumbnailSize];
+		if(l_Info.Size == 0)
+		{
+			return false;
+		}
+
+		out_Filename = l_Info.Filename;
+		out_Offset = l_Info.Offset;
+		out_Size = l_Info.Size;
+		out_ScaleShift = l_Info.ScaleShift;
+		return true;
+	}
+
 	/**
 	 * SetSize
 	 * Set the size of this image tile
@@ -161,6 +211,20 @@ public:
 	 */
 	void ActivateThumbnail(ThumbnailSize in_ThumbnailSize);
 
+	/**
+	 * PrefetchThumbnail
+	 * Request a low priority load of a thumbnail that is expected to be needed soon, without activating it.
+	 * Returns true if a load was requested
+	 */
+	bool PrefetchThumbnail(ThumbnailSize in_ThumbnailSize, LoadPriority in_Priority = LoadPriority_Prefetch);
+
+	/**
+	 * OnLeaveView
+	 * Called when this tile leaves the visible set. A queued visible load for it is no longer urgent,
+	 * so it is cancelled. Loaded textures are kept
+	 */
+	void OnLeaveView();
+
 	/**
 	 * Draw
 	 * Draw this ImageTile
@@ -184,6 +248,7 @@ public:
 	 * TextureLoaderListener interface
 	 */
 	void OnLoadComplete(TextureHandle in_Handle, void* in_UserData);
+	void OnLoadCancelled(void* in_UserData);
 
 private:
 
@@ -194,6 +259,14 @@ private:
 	 */
 	void AddThumbnailInfo(ThumbnailSize in_ThumbSize, const string& in_Filename, unsigned in_Offset, unsigned in_Size);
 
+	/**
+	 * SynthesizeMissingThumbnails
+	 * Fill in each thumbnail size missing from the index with the nearest larger stored thumbnail, decoded at a
+	 * reduced scale. Decoders can only scale down by up to 8, so sizes further from a stored one stay missing.
+	 * Used by the ImageContext singleton once all of an image's thumbnail info has been added
+	 */
+	void SynthesizeMissingThumbnails();
+
 private:
 
 	float mMoveToStartX, mMoveToStartY, mMoveToStartZ;	// Image move to position
@@ -205,6 +278,11 @@ private:
 	float mSizeX, mSizeY;							// Image draw position
 	ThumbnailInfo* mActiveThumbnail;				// The thumbnail actively being used for rendering
 
+	// Micro-thumbnail drawn until a real thumbnail has loaded. The preview lives in an atlas page owned by the ImageContext
+	TextureHandle mPreviewTexture;					// Atlas page holding the preview (0 if there is no preview)
+	float mPreviewMinU, mPreviewMinV;				// Preview texture coordinates within the atlas page
+	float mPreviewMaxU, mPreviewMaxV;
+
 	// Static image data
 	float mAspectRatio;								// Native image aspect ratio
 	unsigned mTimeOfDay;							// Time of day: Units: 1/1000 seconds
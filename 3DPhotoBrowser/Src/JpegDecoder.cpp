@@ -0,0 +1,1543 @@
+/**
+ * @file JpegDecoder.cpp
+ * @brief JpegDecoder implementation file
+ */
+
+#include "JpegDecoder.h"
+
+#if USE_SSE2_JPEG
+	#include <emmintrin.h>
+#endif // USE_SSE2_JPEG
+
+/**
+ * JPEG_FAST_BITS
+ * Huffman codes up to this length are decoded with a single table lookup
+ */
+#define JPEG_FAST_BITS 9
+
+/**
+ * JPEG_MAX_DIMENSION
+ * Refuse anything larger than this, it isn't a thumbnail
+ */
+#define JPEG_MAX_DIMENSION 16384
+
+/**
+ * s_ZigZag
+ * Maps the coefficient order in the file to natural (row major) order. The extra entries
+ * keep a corrupt run length from indexing past the end of the block
+ */
+static const unsigned char s_ZigZag[64 + 16] =
+{
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63,
+	63, 63, 63, 63, 63, 63, 63, 63,
+	63, 63, 63, 63, 63, 63, 63, 63
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Huffman decoding
+
+/**
+ * JpegHuffmanTable
+ * A DHT table, expanded for decoding
+ */
+struct JpegHuffmanTable
+{
+	JpegHuffmanTable() : Present(false) {}
+
+	bool Present;
+	unsigned short Fast[1 << JPEG_FAST_BITS];	// (code length << 8) | symbol index, 0 if the code is longer than JPEG_FAST_BITS
+	unsigned char Symbols[256];					// Symbols in code order
+	int MaxCode[17];							// Largest code of each length, -1 if there are no codes of that length
+	int ValueOffset[17];						// Symbol index = code + ValueOffset[length]
+	short FastAc[1 << JPEG_FAST_BITS];			// AC tables only: (value << 8) | (run << 4) | total length, for codes whose
+												// length plus value bits fit in JPEG_FAST_BITS, 0 otherwise
+
+	/**
+	 * Build
+	 * Build the decoding tables from the DHT code counts. Returns false if the counts are invalid
+	 */
+	bool Build(const unsigned char* in_Counts, const unsigned char* in_Symbols)
+	{
+		unsigned char l_Lengths[256];
+		unsigned short l_Codes[256];
+
+		int l_Code = 0;
+		int l_Count = 0;
+		for(int l_Length = 1; l_Length <= 16; l_Length++)
+		{
+			ValueOffset[l_Length] = l_Count - l_Code;
+			for(int i = 0; i < in_Counts[l_Length - 1]; i++)
+			{
+				if(l_Count >= 256)
+				{
+					return false;
+				}
+				l_Lengths[l_Count] = (unsigned char)l_Length;
+				l_Codes[l_Count] = (unsigned short)l_Code;
+				Symbols[l_Count] = in_Symbols[l_Count];
+				l_Code++;
+				l_Count++;
+			}
+
+			// Codes of this length must fit in this many bits
+			if(l_Code > (1 << l_Length))
+			{
+				return false;
+			}
+			MaxCode[l_Length] = in_Counts[l_Length - 1] ? l_Code - 1 : -1;
+			l_Code <<= 1;
+		}
+
+		// Fill the fast lookup table with every short code, padded out with every possible trailing bit pattern
+		memset(Fast, 0, sizeof(Fast));
+		for(int i = 0; i < l_Count; i++)
+		{
+			int l_Length = l_Lengths[i];
+			if(l_Length <= JPEG_FAST_BITS)
+			{
+				int l_First = l_Codes[i] << (JPEG_FAST_BITS - l_Length);
+				int l_Fill = 1 << (JPEG_FAST_BITS - l_Length);
+				for(int j = 0; j < l_Fill; j++)
+				{
+					Fast[l_First + j] = (unsigned short)((l_Length << 8) | i);
+				}
+			}
+		}
+
+		Present = true;
+		return true;
+	}
+
+	/**
+	 * BuildFastAc
+	 * Build the combined AC lookup, which decodes a short code and its value in one step
+	 */
+	void BuildFastAc()
+	{
+		for(int i = 0; i < (1 << JPEG_FAST_BITS); i++)
+		{
+			FastAc[i] = 0;
+			unsigned l_Entry = Fast[i];
+			if(!l_Entry)
+			{
+				continue;
+			}
+
+			int l_Symbol = Symbols[l_Entry & 0xFF];
+			int l_Run = l_Symbol >> 4;
+			int l_Size = l_Symbol & 15;
+			int l_Length = (l_Entry >> 8) + l_Size;
+			if(l_Size == 0 || l_Length > JPEG_FAST_BITS)
+			{
+				continue;
+			}
+
+			// Sign extend the value bits that follow the code
+			int l_Value = (i >> (JPEG_FAST_BITS - l_Length)) & ((1 << l_Size) - 1);
+			if(l_Value < (1 << (l_Size - 1)))
+			{
+				l_Value += 1 - (1 << l_Size);
+			}
+			if(l_Value >= -128 && l_Value <= 127)
+			{
+				FastAc[i] = (short)((l_Value << 8) | (l_Run << 4) | l_Length);
+			}
+		}
+	}
+};
+
+/**
+ * JpegBitReader
+ * Reads bits from the entropy coded segment, removing stuffed bytes and stopping at markers
+ */
+struct JpegBitReader
+{
+	const unsigned char* Data;	// Next byte to read
+	const unsigned char* End;	// End of the file
+	unsigned Bits;				// Bit buffer, the next bit to read is the most significant
+	int BitCount;				// Number of valid bits in the buffer
+	bool HitMarker;				// Has the reader reached a marker? If so, Data points at it and zeros are returned
+
+	void Reset(const unsigned char* in_Data, const unsigned char* in_End)
+	{
+		Data = in_Data;
+		End = in_End;
+		Bits = 0;
+		BitCount = 0;
+		HitMarker = false;
+	}
+
+	void Fill()
+	{
+		while(BitCount <= 24)
+		{
+			unsigned l_Byte = 0;
+			if(!HitMarker && Data < End)
+			{
+				l_Byte = *Data;
+				if(l_Byte == 0xFF)
+				{
+					// 0xFF00 is a stuffed 0xFF, anything else is a marker
+					if(Data + 1 < End && Data[1] == 0)
+					{
+						Data += 2;
+					}
+					else
+					{
+						HitMarker = true;
+						l_Byte = 0;
+					}
+				}
+				else
+				{
+					Data++;
+				}
+			}
+			Bits |= l_Byte << (24 - BitCount);
+			BitCount += 8;
+		}
+	}
+
+	int GetBits(int in_Count)
+	{
+		if(BitCount < in_Count)
+		{
+			Fill();
+		}
+		unsigned l_Value = Bits >> (32 - in_Count);
+		Bits <<= in_Count;
+		BitCount -= in_Count;
+		return (int)l_Value;
+	}
+
+	/**
+	 * Receive
+	 * Read a in_Count bit value and sign extend it (JPEG spec F.2.2.1)
+	 */
+	int Receive(int in_Count)
+	{
+		if(in_Count == 0)
+		{
+			return 0;
+		}
+		int l_Value = GetBits(in_Count);
+		return l_Value < (1 << (in_Count - 1)) ? l_Value - (1 << in_Count) + 1 : l_Value;
+	}
+
+	/**
+	 * DecodeSymbol
+	 * Returns -1 if the bits don't form a valid code
+	 */
+	int DecodeSymbol(const JpegHuffmanTable& in_Table)
+	{
+		if(BitCount < 16)
+		{
+			Fill();
+		}
+
+		unsigned l_Entry = in_Table.Fast[Bits >> (32 - JPEG_FAST_BITS)];
+		if(l_Entry)
+		{
+			int l_Length = l_Entry >> 8;
+			Bits <<= l_Length;
+			BitCount -= l_Length;
+			return in_Table.Symbols[l_Entry & 0xFF];
+		}
+
+		for(int l_Length = JPEG_FAST_BITS + 1; l_Length <= 16; l_Length++)
+		{
+			int l_Code = (int)(Bits >> (32 - l_Length));
+			if(l_Code <= in_Table.MaxCode[l_Length])
+			{
+				Bits <<= l_Length;
+				BitCount -= l_Length;
+				return in_Table.Symbols[l_Code + in_Table.ValueOffset[l_Length]];
+			}
+		}
+
+		return -1;
+	}
+
+	/**
+	 * Restart
+	 * Skip the RSTn marker at the end of a restart interval. Returns false if there isn't one
+	 */
+	bool Restart()
+	{
+		// Any bits left in the buffer are padding
+		Bits = 0;
+		BitCount = 0;
+
+		// Find the marker, skipping any fill bytes
+		while(!HitMarker && Data < End && *Data != 0xFF)
+		{
+			Data++;
+		}
+		while(Data + 1 < End && Data[1] == 0xFF)
+		{
+			Data++;
+		}
+
+		if(Data + 1 >= End || Data[0] != 0xFF || Data[1] < 0xD0 || Data[1] > 0xD7)
+		{
+			return false;
+		}
+
+		Data += 2;
+		HitMarker = false;
+		return true;
+	}
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Inverse DCT
+//
+// Both versions implement the accurate integer IDCT from the IJG jidctint.c with 12 bit constants,
+// factored so the SSE2 version can do each rotation with a pair of multiply-adds. They give the same results
+
+#define JPEG_FIX(x)			((int)((x) * 4096.0f + 0.5f))
+#define JPEG_PASS1_SHIFT	10
+#define JPEG_PASS2_SHIFT	17
+
+static inline short ClampShort(int in_Value)
+{
+	return (short)(in_Value < -32768 ? -32768 : (in_Value > 32767 ? 32767 : in_Value));
+}
+
+static inline unsigned char ClampByte(int in_Value)
+{
+	return (unsigned char)(in_Value < 0 ? 0 : (in_Value > 255 ? 255 : in_Value));
+}
+
+/**
+ * Idct1D
+ * One dimensional IDCT of 8 values. The outputs are scaled up by 2^12 and must be descaled by the caller
+ */
+static inline void Idct1D(int s0, int s1, int s2, int s3, int s4, int s5, int s6, int s7, int* out_Values)
+{
+	// Even part
+	int l_T2 = s2 * (JPEG_FIX(0.5411961f)) + s6 * (JPEG_FIX(0.5411961f) + JPEG_FIX(-1.847759065f));
+	int l_T3 = s2 * (JPEG_FIX(0.5411961f) + JPEG_FIX(0.765366865f)) + s6 * (JPEG_FIX(0.5411961f));
+	int l_T0 = (s0 + s4) << 12;
+	int l_T1 = (s0 - s4) << 12;
+	int l_X0 = l_T0 + l_T3;
+	int l_X3 = l_T0 - l_T3;
+	int l_X1 = l_T1 + l_T2;
+	int l_X2 = l_T1 - l_T2;
+
+	// Odd part
+	int l_Sum17 = s1 + s7;
+	int l_Sum35 = s3 + s5;
+	int l_Y0 = s7 * (JPEG_FIX(-1.961570560f) + JPEG_FIX(0.298631336f)) + s3 * (JPEG_FIX(-1.961570560f));
+	int l_Y2 = s7 * (JPEG_FIX(-1.961570560f)) + s3 * (JPEG_FIX(-1.961570560f) + JPEG_FIX(3.072711026f));
+	int l_Y1 = s5 * (JPEG_FIX(-0.390180644f) + JPEG_FIX(2.053119869f)) + s1 * (JPEG_FIX(-0.390180644f));
+	int l_Y3 = s5 * (JPEG_FIX(-0.390180644f)) + s1 * (JPEG_FIX(-0.390180644f) + JPEG_FIX(1.501321110f));
+	int l_Y4 = l_Sum17 * (JPEG_FIX(1.175875602f) + JPEG_FIX(-0.899976223f)) + l_Sum35 * (JPEG_FIX(1.175875602f));
+	int l_Y5 = l_Sum17 * (JPEG_FIX(1.175875602f)) + l_Sum35 * (JPEG_FIX(1.175875602f) + JPEG_FIX(-2.562915447f));
+	int l_X4 = l_Y0 + l_Y4;
+	int l_X5 = l_Y1 + l_Y5;
+	int l_X6 = l_Y2 + l_Y5;
+	int l_X7 = l_Y3 + l_Y4;
+
+	out_Values[0] = l_X0 + l_X7;
+	out_Values[7] = l_X0 - l_X7;
+	out_Values[1] = l_X1 + l_X6;
+	out_Values[6] = l_X1 - l_X6;
+	out_Values[2] = l_X2 + l_X5;
+	out_Values[5] = l_X2 - l_X5;
+	out_Values[3] = l_X3 + l_X4;
+	out_Values[4] = l_X3 - l_X4;
+}
+
+/**
+ * IdctBlockScalar
+ * Inverse DCT of a dequantized block (natural order) into 8x8 pixels
+ */
+static void IdctBlockScalar(const short* in_Coefs, unsigned char* out_Pixels, int in_Stride)
+{
+	short l_Temp[64];
+	int l_Values[8];
+
+	// Columns
+	for(int x = 0; x < 8; x++)
+	{
+		const short* c = in_Coefs + x;
+		Idct1D(c[0], c[8], c[16], c[24], c[32], c[40], c[48], c[56], l_Values);
+		for(int y = 0; y < 8; y++)
+		{
+			l_Temp[y * 8 + x] = ClampShort((l_Values[y] + (1 << (JPEG_PASS1_SHIFT - 1))) >> JPEG_PASS1_SHIFT);
+		}
+	}
+
+	// Rows, removing the level shift
+	const int l_Bias = (1 << (JPEG_PASS2_SHIFT - 1)) + (128 << JPEG_PASS2_SHIFT);
+	for(int y = 0; y < 8; y++)
+	{
+		const short* r = l_Temp + y * 8;
+		Idct1D(r[0], r[1], r[2], r[3], r[4], r[5], r[6], r[7], l_Values);
+		unsigned char* l_Out = out_Pixels + y * in_Stride;
+		for(int x = 0; x < 8; x++)
+		{
+			l_Out[x] = ClampByte(ClampShort((l_Values[x] + l_Bias) >> JPEG_PASS2_SHIFT));
+		}
+	}
+}
+
+#if USE_SSE2_JPEG
+
+/**
+ * PairConstant
+ * Constant used to multiply interleaved pairs (a, b) into a * in_A + b * in_B
+ */
+static inline __m128i PairConstant(int in_A, int in_B)
+{
+	return _mm_setr_epi16((short)in_A, (short)in_B, (short)in_A, (short)in_B, (short)in_A, (short)in_B, (short)in_A, (short)in_B);
+}
+
+/**
+ * Rotate
+ * For each of the 8 lanes: out_0 = x * c0.a + y * c0.b, out_1 = x * c1.a + y * c1.b, as 32 bit values
+ */
+static inline void Rotate(__m128i in_X, __m128i in_Y, __m128i in_C0, __m128i in_C1,
+						  __m128i& out_0Lo, __m128i& out_0Hi, __m128i& out_1Lo, __m128i& out_1Hi)
+{
+	__m128i l_Lo = _mm_unpacklo_epi16(in_X, in_Y);
+	__m128i l_Hi = _mm_unpackhi_epi16(in_X, in_Y);
+	out_0Lo = _mm_madd_epi16(l_Lo, in_C0);
+	out_0Hi = _mm_madd_epi16(l_Hi, in_C0);
+	out_1Lo = _mm_madd_epi16(l_Lo, in_C1);
+	out_1Hi = _mm_madd_epi16(l_Hi, in_C1);
+}
+
+/**
+ * Butterfly
+ * out_Sum = (a + b + bias) >> shift, out_Difference = (a - b + bias) >> shift, saturated to 16 bits
+ */
+static inline void Butterfly(__m128i in_ALo, __m128i in_AHi, __m128i in_BLo, __m128i in_BHi, __m128i in_Bias, int in_Shift,
+							 __m128i& out_Sum, __m128i& out_Difference)
+{
+	__m128i l_ALo = _mm_add_epi32(in_ALo, in_Bias);
+	__m128i l_AHi = _mm_add_epi32(in_AHi, in_Bias);
+	out_Sum = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(l_ALo, in_BLo), in_Shift), _mm_srai_epi32(_mm_add_epi32(l_AHi, in_BHi), in_Shift));
+	out_Difference = _mm_packs_epi32(_mm_srai_epi32(_mm_sub_epi32(l_ALo, in_BLo), in_Shift), _mm_srai_epi32(_mm_sub_epi32(l_AHi, in_BHi), in_Shift));
+}
+
+/**
+ * Idct1DSSE2
+ * Eight one dimensional IDCTs at once, one per lane, see Idct1D
+ */
+static inline void Idct1DSSE2(__m128i* io_Rows, __m128i in_Bias, int in_Shift)
+{
+	const __m128i l_Rot0_0 = PairConstant(JPEG_FIX(0.5411961f), JPEG_FIX(0.5411961f) + JPEG_FIX(-1.847759065f));
+	const __m128i l_Rot0_1 = PairConstant(JPEG_FIX(0.5411961f) + JPEG_FIX(0.765366865f), JPEG_FIX(0.5411961f));
+	const __m128i l_Rot1_0 = PairConstant(JPEG_FIX(1.175875602f) + JPEG_FIX(-0.899976223f), JPEG_FIX(1.175875602f));
+	const __m128i l_Rot1_1 = PairConstant(JPEG_FIX(1.175875602f), JPEG_FIX(1.175875602f) + JPEG_FIX(-2.562915447f));
+	const __m128i l_Rot2_0 = PairConstant(JPEG_FIX(-1.961570560f) + JPEG_FIX(0.298631336f), JPEG_FIX(-1.961570560f));
+	const __m128i l_Rot2_1 = PairConstant(JPEG_FIX(-1.961570560f), JPEG_FIX(-1.961570560f) + JPEG_FIX(3.072711026f));
+	const __m128i l_Rot3_0 = PairConstant(JPEG_FIX(-0.390180644f) + JPEG_FIX(2.053119869f), JPEG_FIX(-0.390180644f));
+	const __m128i l_Rot3_1 = PairConstant(JPEG_FIX(-0.390180644f), JPEG_FIX(-0.390180644f) + JPEG_FIX(1.501321110f));
+	const __m128i l_Zero = _mm_setzero_si128();
+
+	// Even part
+	__m128i l_T2Lo, l_T2Hi, l_T3Lo, l_T3Hi;
+	Rotate(io_Rows[2], io_Rows[6], l_Rot0_0, l_Rot0_1, l_T2Lo, l_T2Hi, l_T3Lo, l_T3Hi);
+
+	// Widen to 32 bits and scale up by 2^12 in one go: (x << 16) >> 4
+	__m128i l_Sum04 = _mm_add_epi16(io_Rows[0], io_Rows[4]);
+	__m128i l_Dif04 = _mm_sub_epi16(io_Rows[0], io_Rows[4]);
+	__m128i l_T0Lo = _mm_srai_epi32(_mm_unpacklo_epi16(l_Zero, l_Sum04), 4);
+	__m128i l_T0Hi = _mm_srai_epi32(_mm_unpackhi_epi16(l_Zero, l_Sum04), 4);
+	__m128i l_T1Lo = _mm_srai_epi32(_mm_unpacklo_epi16(l_Zero, l_Dif04), 4);
+	__m128i l_T1Hi = _mm_srai_epi32(_mm_unpackhi_epi16(l_Zero, l_Dif04), 4);
+
+	__m128i l_X0Lo = _mm_add_epi32(l_T0Lo, l_T3Lo), l_X0Hi = _mm_add_epi32(l_T0Hi, l_T3Hi);
+	__m128i l_X3Lo = _mm_sub_epi32(l_T0Lo, l_T3Lo), l_X3Hi = _mm_sub_epi32(l_T0Hi, l_T3Hi);
+	__m128i l_X1Lo = _mm_add_epi32(l_T1Lo, l_T2Lo), l_X1Hi = _mm_add_epi32(l_T1Hi, l_T2Hi);
+	__m128i l_X2Lo = _mm_sub_epi32(l_T1Lo, l_T2Lo), l_X2Hi = _mm_sub_epi32(l_T1Hi, l_T2Hi);
+
+	// Odd part
+	__m128i l_Y0Lo, l_Y0Hi, l_Y1Lo, l_Y1Hi, l_Y2Lo, l_Y2Hi, l_Y3Lo, l_Y3Hi, l_Y4Lo, l_Y4Hi, l_Y5Lo, l_Y5Hi;
+	Rotate(io_Rows[7], io_Rows[3], l_Rot2_0, l_Rot2_1, l_Y0Lo, l_Y0Hi, l_Y2Lo, l_Y2Hi);
+	Rotate(io_Rows[5], io_Rows[1], l_Rot3_0, l_Rot3_1, l_Y1Lo, l_Y1Hi, l_Y3Lo, l_Y3Hi);
+	Rotate(_mm_add_epi16(io_Rows[1], io_Rows[7]), _mm_add_epi16(io_Rows[3], io_Rows[5]), l_Rot1_0, l_Rot1_1, l_Y4Lo, l_Y4Hi, l_Y5Lo, l_Y5Hi);
+
+	__m128i l_X4Lo = _mm_add_epi32(l_Y0Lo, l_Y4Lo), l_X4Hi = _mm_add_epi32(l_Y0Hi, l_Y4Hi);
+	__m128i l_X5Lo = _mm_add_epi32(l_Y1Lo, l_Y5Lo), l_X5Hi = _mm_add_epi32(l_Y1Hi, l_Y5Hi);
+	__m128i l_X6Lo = _mm_add_epi32(l_Y2Lo, l_Y5Lo), l_X6Hi = _mm_add_epi32(l_Y2Hi, l_Y5Hi);
+	__m128i l_X7Lo = _mm_add_epi32(l_Y3Lo, l_Y4Lo), l_X7Hi = _mm_add_epi32(l_Y3Hi, l_Y4Hi);
+
+	Butterfly(l_X0Lo, l_X0Hi, l_X7Lo, l_X7Hi, in_Bias, in_Shift, io_Rows[0], io_Rows[7]);
+	Butterfly(l_X1Lo, l_X1Hi, l_X6Lo, l_X6Hi, in_Bias, in_Shift, io_Rows[1], io_Rows[6]);
+	Butterfly(l_X2Lo, l_X2Hi, l_X5Lo, l_X5Hi, in_Bias, in_Shift, io_Rows[2], io_Rows[5]);
+	Butterfly(l_X3Lo, l_X3Hi, l_X4Lo, l_X4Hi, in_Bias, in_Shift, io_Rows[3], io_Rows[4]);
+}
+
+/**
+ * Transpose8x8
+ * Transpose an 8x8 block of 16 bit values held one row per register
+ */
+static inline void Transpose8x8(__m128i* io_Rows)
+{
+	__m128i l_A0 = _mm_unpacklo_epi16(io_Rows[0], io_Rows[1]);
+	__m128i l_A1 = _mm_unpackhi_epi16(io_Rows[0], io_Rows[1]);
+	__m128i l_A2 = _mm_unpacklo_epi16(io_Rows[2], io_Rows[3]);
+	__m128i l_A3 = _mm_unpackhi_epi16(io_Rows[2], io_Rows[3]);
+	__m128i l_A4 = _mm_unpacklo_epi16(io_Rows[4], io_Rows[5]);
+	__m128i l_A5 = _mm_unpackhi_epi16(io_Rows[4], io_Rows[5]);
+	__m128i l_A6 = _mm_unpacklo_epi16(io_Rows[6], io_Rows[7]);
+	__m128i l_A7 = _mm_unpackhi_epi16(io_Rows[6], io_Rows[7]);
+
+	__m128i l_B0 = _mm_unpacklo_epi32(l_A0, l_A2);
+	__m128i l_B1 = _mm_unpackhi_epi32(l_A0, l_A2);
+	__m128i l_B2 = _mm_unpacklo_epi32(l_A1, l_A3);
+	__m128i l_B3 = _mm_unpackhi_epi32(l_A1, l_A3);
+	__m128i l_B4 = _mm_unpacklo_epi32(l_A4, l_A6);
+	__m128i l_B5 = _mm_unpackhi_epi32(l_A4, l_A6);
+	__m128i l_B6 = _mm_unpacklo_epi32(l_A5, l_A7);
+	__m128i l_B7 = _mm_unpackhi_epi32(l_A5, l_A7);
+
+	io_Rows[0] = _mm_unpacklo_epi64(l_B0, l_B4);
+	io_Rows[1] = _mm_unpackhi_epi64(l_B0, l_B4);
+	io_Rows[2] = _mm_unpacklo_epi64(l_B1, l_B5);
+	io_Rows[3] = _mm_unpackhi_epi64(l_B1, l_B5);
+	io_Rows[4] = _mm_unpacklo_epi64(l_B2, l_B6);
+	io_Rows[5] = _mm_unpackhi_epi64(l_B2, l_B6);
+	io_Rows[6] = _mm_unpacklo_epi64(l_B3, l_B7);
+	io_Rows[7] = _mm_unpackhi_epi64(l_B3, l_B7);
+}
+
+/**
+ * IdctBlockSSE2
+ * SSE2 version of IdctBlockScalar
+ */
+static void IdctBlockSSE2(const short* in_Coefs, unsigned char* out_Pixels, int in_Stride)
+{
+	__m128i l_Rows[8];
+	for(int i = 0; i < 8; i++)
+	{
+		l_Rows[i] = _mm_loadu_si128((const __m128i*)(in_Coefs + i * 8));
+	}
+
+	// Columns (each lane is a column), then rows
+	Idct1DSSE2(l_Rows, _mm_set1_epi32(1 << (JPEG_PASS1_SHIFT - 1)), JPEG_PASS1_SHIFT);
+	Transpose8x8(l_Rows);
+	Idct1DSSE2(l_Rows, _mm_set1_epi32((1 << (JPEG_PASS2_SHIFT - 1)) + (128 << JPEG_PASS2_SHIFT)), JPEG_PASS2_SHIFT);
+	Transpose8x8(l_Rows);
+
+	// Saturate to bytes and store two rows at a time
+	for(int i = 0; i < 8; i += 2)
+	{
+		__m128i l_Packed = _mm_packus_epi16(l_Rows[i], l_Rows[i + 1]);
+		_mm_storel_epi64((__m128i*)(out_Pixels + i * in_Stride), l_Packed);
+		_mm_storel_epi64((__m128i*)(out_Pixels + (i + 1) * in_Stride), _mm_srli_si128(l_Packed, 8));
+	}
+}
+
+#endif // USE_SSE2_JPEG
+
+/**
+ * s_ReducedIdct4, s_ReducedIdct2
+ * Bases of the 4 and 2 point IDCTs used for scaled decoding, scaled by 2^12. Entry [x][u] is C(u) times the average of
+ * cos((2i + 1) * u * pi / 16) over the 8/N samples i that output x covers, so the result is exactly the block's full
+ * size IDCT box filtered down to NxN, without computing it. Frequency 4 averages out to zero at both sizes
+ */
+static const int s_ReducedIdct4[4][8] =
+{
+	{  2896,  3711,  2676,  1303,     0,  -871, -1108,  -738 },
+	{  2896,  1537, -2676, -3146,     0,  2102,  1108,  -306 },
+	{  2896, -1537, -2676,  3146,     0, -2102,  1108,   306 },
+	{  2896, -3711,  2676, -1303,     0,   871, -1108,   738 },
+};
+
+static const int s_ReducedIdct2[2][8] =
+{
+	{  2896,  2624,     0,  -922,     0,   616,     0,  -522 },
+	{  2896, -2624,     0,   922,     0,  -616,     0,   522 },
+};
+
+/**
+ * IdctBlockReduced
+ * Inverse DCT of a block into in_Size x in_Size pixels, using one of the reduced bases
+ */
+static inline void IdctBlockReduced(const short* in_Coefs, const int* in_Basis, int in_Size, unsigned char* out_Pixels, int in_Stride)
+{
+	int l_Temp[4 * 8];
+
+	// Columns, skipping the ones with no coefficients (most of the high frequency ones)
+	for(int u = 0; u < 8; u++)
+	{
+		const short* c = in_Coefs + u;
+		if(!(c[0] | c[8] | c[16] | c[24] | c[40] | c[48] | c[56]))
+		{
+			for(int y = 0; y < in_Size; y++)
+			{
+				l_Temp[y * 8 + u] = 0;
+			}
+			continue;
+		}
+
+		for(int y = 0; y < in_Size; y++)
+		{
+			const int* l_Basis = in_Basis + y * 8;
+			int l_Sum = l_Basis[0] * c[0] + l_Basis[1] * c[8] + l_Basis[2] * c[16] + l_Basis[3] * c[24] +
+						l_Basis[5] * c[40] + l_Basis[6] * c[48] + l_Basis[7] * c[56];
+			l_Temp[y * 8 + u] = (l_Sum + (1 << (JPEG_PASS1_SHIFT - 1))) >> JPEG_PASS1_SHIFT;
+		}
+	}
+
+	// Rows, removing the level shift. The two passes together carry the same 2^16 scale as the full size IDCT
+	const int l_Bias = (1 << 15) + (128 << 16);
+	for(int y = 0; y < in_Size; y++)
+	{
+		const int* t = l_Temp + y * 8;
+		unsigned char* l_Out = out_Pixels + y * in_Stride;
+		for(int x = 0; x < in_Size; x++)
+		{
+			const int* l_Basis = in_Basis + x * 8;
+			int l_Sum = l_Basis[0] * t[0] + l_Basis[1] * t[1] + l_Basis[2] * t[2] + l_Basis[3] * t[3] +
+						l_Basis[5] * t[5] + l_Basis[6] * t[6] + l_Basis[7] * t[7];
+			l_Out[x] = ClampByte((l_Sum + l_Bias) >> 16);
+		}
+	}
+}
+
+static void IdctBlock4x4(const short* in_Coefs, unsigned char* out_Pixels, int in_Stride)
+{
+	IdctBlockReduced(in_Coefs, &s_ReducedIdct4[0][0], 4, out_Pixels, in_Stride);
+}
+
+static void IdctBlock2x2(const short* in_Coefs, unsigned char* out_Pixels, int in_Stride)
+{
+	IdctBlockReduced(in_Coefs, &s_ReducedIdct2[0][0], 2, out_Pixels, in_Stride);
+}
+
+static void IdctBlock1x1(const short* in_Coefs, unsigned char* out_Pixels, int in_Stride)
+{
+	// The DC coefficient is 8 times the block average
+	out_Pixels[0] = ClampByte(((in_Coefs[0] + 4) >> 3) + 128);
+}
+
+/**
+ * IdctFunction
+ * Inverse DCT of one block into a square of pixels
+ */
+typedef void (*IdctFunction)(const short* in_Coefs, unsigned char* out_Pixels, int in_Stride);
+
+/**
+ * GetIdctFunction
+ * Get the IDCT that produces in_BlockSize x in_BlockSize pixels per block
+ */
+static IdctFunction GetIdctFunction(int in_BlockSize)
+{
+	switch(in_BlockSize)
+	{
+	case 4: return IdctBlock4x4;
+	case 2: return IdctBlock2x2;
+	case 1: return IdctBlock1x1;
+	default:
+		// The block planes are sized for in_BlockSize, anything but a full 8x8 block would overrun them
+		assert(in_BlockSize == 8);
+#if USE_SSE2_JPEG
+		return IdctBlockSSE2;
+#else
+		return IdctBlockScalar;
+#endif // USE_SSE2_JPEG
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Upsampling and color conversion
+//
+// Chroma is upsampled with the same triangle filter libjpeg calls "fancy upsampling", so the output matches DevIL closely
+
+/**
+ * UpsampleRowH2
+ * Double the width of a row: out[2x] = (3 * in[x] + in[x - 1]) / 4, out[2x + 1] = (3 * in[x] + in[x + 1]) / 4
+ */
+static void UpsampleRowH2(const unsigned char* in_Row, int in_Width, unsigned char* out_Row)
+{
+	if(in_Width == 1)
+	{
+		out_Row[0] = out_Row[1] = in_Row[0];
+		return;
+	}
+
+	out_Row[0] = in_Row[0];
+	out_Row[1] = (unsigned char)((in_Row[0] * 3 + in_Row[1] + 2) >> 2);
+	for(int x = 1; x < in_Width - 1; x++)
+	{
+		int l_Center = in_Row[x] * 3;
+		out_Row[x * 2] = (unsigned char)((l_Center + in_Row[x - 1] + 1) >> 2);
+		out_Row[x * 2 + 1] = (unsigned char)((l_Center + in_Row[x + 1] + 2) >> 2);
+	}
+	int l_Last = in_Width - 1;
+	out_Row[l_Last * 2] = (unsigned char)((in_Row[l_Last] * 3 + in_Row[l_Last - 1] + 1) >> 2);
+	out_Row[l_Last * 2 + 1] = in_Row[l_Last];
+}
+
+/**
+ * UpsampleRowH2V2
+ * Double the width and height: in_Near is the chroma row closest to the output row, in_Far the next closest
+ */
+static void UpsampleRowH2V2(const unsigned char* in_Near, const unsigned char* in_Far, int in_Width, unsigned char* out_Row)
+{
+	if(in_Width == 1)
+	{
+		int l_Sum = in_Near[0] * 3 + in_Far[0];
+		out_Row[0] = (unsigned char)((l_Sum * 4 + 8) >> 4);
+		out_Row[1] = (unsigned char)((l_Sum * 4 + 7) >> 4);
+		return;
+	}
+
+	int l_Previous = in_Near[0] * 3 + in_Far[0];
+	int l_Current = l_Previous;
+	int l_Next = in_Near[1] * 3 + in_Far[1];
+	out_Row[0] = (unsigned char)((l_Current * 4 + 8) >> 4);
+	out_Row[1] = (unsigned char)((l_Current * 3 + l_Next + 7) >> 4);
+	for(int x = 1; x < in_Width - 1; x++)
+	{
+		l_Previous = l_Current;
+		l_Current = l_Next;
+		l_Next = in_Near[x + 1] * 3 + in_Far[x + 1];
+		out_Row[x * 2] = (unsigned char)((l_Current * 3 + l_Previous + 8) >> 4);
+		out_Row[x * 2 + 1] = (unsigned char)((l_Current * 3 + l_Next + 7) >> 4);
+	}
+	int l_Last = in_Width - 1;
+	out_Row[l_Last * 2] = (unsigned char)((l_Next * 3 + l_Current + 8) >> 4);
+	out_Row[l_Last * 2 + 1] = (unsigned char)((l_Next * 4 + 7) >> 4);
+}
+
+/**
+ * UpsampleRowReplicate
+ * Any other integer ratio: repeat each sample in_Factor times
+ */
+static void UpsampleRowReplicate(const unsigned char* in_Row, int in_Width, int in_Factor, unsigned char* out_Row)
+{
+	for(int x = 0; x < in_Width; x++)
+	{
+		for(int i = 0; i < in_Factor; i++)
+		{
+			*out_Row++ = in_Row[x];
+		}
+	}
+}
+
+// YCbCr -> RGB constants, scaled by 2^13. The products are taken with a 16 bit multiply-high so
+// the results carry 4 fractional bits, which are rounded off at the end
+#define JPEG_CR_TO_R	11485	// 1.40200
+#define JPEG_CB_TO_G	2819	// 0.34414
+#define JPEG_CR_TO_G	5850	// 0.71414
+#define JPEG_CB_TO_B	14516	// 1.77200
+
+/**
+ * ConvertPixelYCbCr
+ * Convert one pixel. Matches the SSE2 arithmetic exactly
+ */
+static inline void ConvertPixelYCbCr(int in_Y, int in_Cb, int in_Cr, unsigned char* out_Pixel)
+{
+	int l_Y = (in_Y << 4) + 8;
+	int l_Cb = (in_Cb - 128) << 7;
+	int l_Cr = (in_Cr - 128) << 7;
+	out_Pixel[0] = ClampByte((l_Y + ((l_Cr * JPEG_CR_TO_R) >> 16)) >> 4);
+	out_Pixel[1] = ClampByte((l_Y - ((l_Cb * JPEG_CB_TO_G) >> 16) - ((l_Cr * JPEG_CR_TO_G) >> 16)) >> 4);
+	out_Pixel[2] = ClampByte((l_Y + ((l_Cb * JPEG_CB_TO_B) >> 16)) >> 4);
+}
+
+/**
+ * StorePixel
+ * Write pixel in_X of a row in the output format: RGB, opaque RGBA or RGB565
+ */
+static inline void StorePixel(int in_R, int in_G, int in_B, TextureFormat in_Format, unsigned char* out_Row, int in_X)
+{
+	if(in_Format == TextureFormat_RGBA)
+	{
+		unsigned char* l_Pixel = out_Row + in_X * 4;
+		l_Pixel[0] = (unsigned char)in_R;
+		l_Pixel[1] = (unsigned char)in_G;
+		l_Pixel[2] = (unsigned char)in_B;
+		l_Pixel[3] = 255;
+	}
+	else if(in_Format == TextureFormat_RGB565)
+	{
+		unsigned short l_Pixel = (unsigned short)(((in_R >> 3) << 11) | ((in_G >> 2) << 5) | (in_B >> 3));
+		memcpy(out_Row + in_X * 2, &l_Pixel, 2);
+	}
+	else
+	{
+		unsigned char* l_Pixel = out_Row + in_X * 3;
+		l_Pixel[0] = (unsigned char)in_R;
+		l_Pixel[1] = (unsigned char)in_G;
+		l_Pixel[2] = (unsigned char)in_B;
+	}
+}
+
+/**
+ * ConvertRowYCbCr
+ * Convert a row of full resolution Y, Cb and Cr samples to interleaved pixels in the output format
+ */
+static void ConvertRowYCbCr(const unsigned char* in_Y, const unsigned char* in_Cb, const unsigned char* in_Cr, int in_Width, TextureFormat in_Format,
+							unsigned char* out_Row)
+{
+	int x = 0;
+
+#if USE_SSE2_JPEG
+	const __m128i l_Zero = _mm_setzero_si128();
+	const __m128i l_Round = _mm_set1_epi16(8);
+	const __m128i l_Center = _mm_set1_epi16(128);
+	const __m128i l_CrToR = _mm_set1_epi16(JPEG_CR_TO_R);
+	const __m128i l_CbToG = _mm_set1_epi16(JPEG_CB_TO_G);
+	const __m128i l_CrToG = _mm_set1_epi16(JPEG_CR_TO_G);
+	const __m128i l_CbToB = _mm_set1_epi16(JPEG_CB_TO_B);
+
+	const __m128i l_Alpha = _mm_set1_epi8((char)0xFF);
+	const __m128i l_RedMask = _mm_set1_epi16(0xF8);
+	const __m128i l_GreenMask = _mm_set1_epi16(0xFC);
+
+	// SSE2 has no byte shuffle, so compute 16 pixels of each channel, then interleave them. Four byte pixels interleave
+	// with unpacks, 16 bit pixels are packed in registers and three byte pixels go through the stack
+	unsigned char l_Planar[3][16];
+	for(; x + 16 <= in_Width; x += 16)
+	{
+		__m128i l_Y8 = _mm_loadu_si128((const __m128i*)(in_Y + x));
+		__m128i l_Cb8 = _mm_loadu_si128((const __m128i*)(in_Cb + x));
+		__m128i l_Cr8 = _mm_loadu_si128((const __m128i*)(in_Cr + x));
+
+		__m128i l_Channels[3][2];
+		for(int l_Half = 0; l_Half < 2; l_Half++)
+		{
+			__m128i l_Y = l_Half ? _mm_unpackhi_epi8(l_Y8, l_Zero) : _mm_unpacklo_epi8(l_Y8, l_Zero);
+			__m128i l_Cb = l_Half ? _mm_unpackhi_epi8(l_Cb8, l_Zero) : _mm_unpacklo_epi8(l_Cb8, l_Zero);
+			__m128i l_Cr = l_Half ? _mm_unpackhi_epi8(l_Cr8, l_Zero) : _mm_unpacklo_epi8(l_Cr8, l_Zero);
+
+			l_Y = _mm_add_epi16(_mm_slli_epi16(l_Y, 4), l_Round);
+			l_Cb = _mm_slli_epi16(_mm_sub_epi16(l_Cb, l_Center), 7);
+			l_Cr = _mm_slli_epi16(_mm_sub_epi16(l_Cr, l_Center), 7);
+
+			__m128i l_R = _mm_add_epi16(l_Y, _mm_mulhi_epi16(l_Cr, l_CrToR));
+			__m128i l_G = _mm_sub_epi16(_mm_sub_epi16(l_Y, _mm_mulhi_epi16(l_Cb, l_CbToG)), _mm_mulhi_epi16(l_Cr, l_CrToG));
+			__m128i l_B = _mm_add_epi16(l_Y, _mm_mulhi_epi16(l_Cb, l_CbToB));
+
+			l_Channels[0][l_Half] = _mm_srai_epi16(l_R, 4);
+			l_Channels[1][l_Half] = _mm_srai_epi16(l_G, 4);
+			l_Channels[2][l_Half] = _mm_srai_epi16(l_B, 4);
+		}
+
+		// Saturate to bytes, which also clamps the channels for the 16 bit packing
+		__m128i l_R8 = _mm_packus_epi16(l_Channels[0][0], l_Channels[0][1]);
+		__m128i l_G8 = _mm_packus_epi16(l_Channels[1][0], l_Channels[1][1]);
+		__m128i l_B8 = _mm_packus_epi16(l_Channels[2][0], l_Channels[2][1]);
+
+		if(in_Format == TextureFormat_RGBA)
+		{
+			__m128i l_RGLow = _mm_unpacklo_epi8(l_R8, l_G8);
+			__m128i l_RGHigh = _mm_unpackhi_epi8(l_R8, l_G8);
+			__m128i l_BALow = _mm_unpacklo_epi8(l_B8, l_Alpha);
+			__m128i l_BAHigh = _mm_unpackhi_epi8(l_B8, l_Alpha);
+
+			__m128i* l_Out = (__m128i*)(out_Row + x * 4);
+			_mm_storeu_si128(l_Out + 0, _mm_unpacklo_epi16(l_RGLow, l_BALow));
+			_mm_storeu_si128(l_Out + 1, _mm_unpackhi_epi16(l_RGLow, l_BALow));
+			_mm_storeu_si128(l_Out + 2, _mm_unpacklo_epi16(l_RGHigh, l_BAHigh));
+			_mm_storeu_si128(l_Out + 3, _mm_unpackhi_epi16(l_RGHigh, l_BAHigh));
+		}
+		else if(in_Format == TextureFormat_RGB565)
+		{
+			__m128i* l_Out = (__m128i*)(out_Row + x * 2);
+			for(int l_Half = 0; l_Half < 2; l_Half++)
+			{
+				__m128i l_R = l_Half ? _mm_unpackhi_epi8(l_R8, l_Zero) : _mm_unpacklo_epi8(l_R8, l_Zero);
+				__m128i l_G = l_Half ? _mm_unpackhi_epi8(l_G8, l_Zero) : _mm_unpacklo_epi8(l_G8, l_Zero);
+				__m128i l_B = l_Half ? _mm_unpackhi_epi8(l_B8, l_Zero) : _mm_unpacklo_epi8(l_B8, l_Zero);
+				__m128i l_Pixels = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_and_si128(l_R, l_RedMask), 8),
+															 _mm_slli_epi16(_mm_and_si128(l_G, l_GreenMask), 3)),
+												_mm_srli_epi16(l_B, 3));
+				_mm_storeu_si128(l_Out + l_Half, l_Pixels);
+			}
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*)l_Planar[0], l_R8);
+			_mm_storeu_si128((__m128i*)l_Planar[1], l_G8);
+			_mm_storeu_si128((__m128i*)l_Planar[2], l_B8);
+
+			unsigned char* l_Out = out_Row + x * 3;
+			for(int i = 0; i < 16; i++)
+			{
+				l_Out[0] = l_Planar[0][i];
+				l_Out[1] = l_Planar[1][i];
+				l_Out[2] = l_Planar[2][i];
+				l_Out += 3;
+			}
+		}
+	}
+#endif // USE_SSE2_JPEG
+
+	for(; x < in_Width; x++)
+	{
+		unsigned char l_Pixel[3];
+		ConvertPixelYCbCr(in_Y[x], in_Cb[x], in_Cr[x], l_Pixel);
+		StorePixel(l_Pixel[0], l_Pixel[1], l_Pixel[2], in_Format, out_Row, x);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Decoding
+
+/**
+ * JpegComponent
+ * Per component frame, scan and decoding state
+ */
+struct JpegComponent
+{
+	int Id;
+	int SamplingX, SamplingY;		// Sampling factors
+	int QuantTable;
+	int DcTable, AcTable;
+	int DcPrediction;
+
+	int BlockSize;					// Output samples per block side
+	int Width, Height;				// Size of the component in output samples, before upsampling
+	int BlocksX, BlocksY;			// Number of blocks covering the component, used by non-interleaved scans
+	int Stride;						// Width of the plane, a whole number of MCUs
+	unsigned char* Plane;			// Decoded samples, allocated from the arena
+};
+
+/**
+ * JpegState
+ * Everything needed to decode one image. Lives on the stack of the decoding thread
+ */
+struct JpegState
+{
+	JpegState(DecodeArena& in_Arena) : Arena(in_Arena), BlockSize(8), Width(0), Height(0), ComponentCount(0), RestartInterval(0), Transform(-1), FrameFound(false) {}
+
+	DecodeArena& Arena;				// Scratch memory for the component planes and row buffers
+
+	int BlockSize;					// Output pixels per block side: 8 for a full size decode, 4, 2 or 1 for a scaled decode
+	int Width, Height;				// Output size
+	int ComponentCount;
+	int MaxSamplingX, MaxSamplingY;
+	int McusX, McusY;
+	int RestartInterval;
+	int Transform;					// Adobe color transform, -1 if there is no Adobe marker
+	bool FrameFound;
+
+	unsigned short Quant[4][64];	// Quantization tables, natural order
+	JpegHuffmanTable DcTables[4];
+	JpegHuffmanTable AcTables[4];
+	JpegComponent Components[3];
+
+	int ScanCount;					// Components in the scan
+	int ScanComponents[3];			// Indices into Components, in scan order
+};
+
+/**
+ * DecodeBlock
+ * Decode and dequantize one block into natural order
+ */
+static bool DecodeBlock(JpegBitReader& in_Reader, JpegState& in_State, JpegComponent& in_Component, short* out_Coefs)
+{
+	const JpegHuffmanTable& l_DcTable = in_State.DcTables[in_Component.DcTable];
+	const JpegHuffmanTable& l_AcTable = in_State.AcTables[in_Component.AcTable];
+	const unsigned short* l_Quant = in_State.Quant[in_Component.QuantTable];
+
+	memset(out_Coefs, 0, 64 * sizeof(short));
+
+	// DC coefficient is coded as the difference from the previous block
+	int l_Size = in_Reader.DecodeSymbol(l_DcTable);
+	if(l_Size < 0 || l_Size > 11)
+	{
+		return false;
+	}
+	in_Component.DcPrediction += in_Reader.Receive(l_Size);
+	out_Coefs[0] = ClampShort(in_Component.DcPrediction * l_Quant[0]);
+
+	// AC coefficients are run length coded
+	for(int k = 1; k < 64;)
+	{
+		// Most coefficients are small, so try to decode the code and value with one lookup
+		if(in_Reader.BitCount < 16)
+		{
+			in_Reader.Fill();
+		}
+		int l_Fast = l_AcTable.FastAc[in_Reader.Bits >> (32 - JPEG_FAST_BITS)];
+		if(l_Fast)
+		{
+			int l_Length = l_Fast & 15;
+			in_Reader.Bits <<= l_Length;
+			in_Reader.BitCount -= l_Length;
+			k += (l_Fast >> 4) & 15;
+			int l_Index = s_ZigZag[k++];
+			out_Coefs[l_Index] = ClampShort((l_Fast >> 8) * l_Quant[l_Index]);
+			continue;
+		}
+
+		int l_Symbol = in_Reader.DecodeSymbol(l_AcTable);
+		if(l_Symbol < 0)
+		{
+			return false;
+		}
+
+		int l_Run = l_Symbol >> 4;
+		l_Size = l_Symbol & 15;
+		if(l_Size == 0)
+		{
+			// End of block, or a run of 16 zeros
+			if(l_Run != 15)
+			{
+				break;
+			}
+			k += 16;
+			continue;
+		}
+
+		k += l_Run;
+		if(k > 63)
+		{
+			return false;
+		}
+		int l_Index = s_ZigZag[k++];
+		out_Coefs[l_Index] = ClampShort(in_Reader.Receive(l_Size) * l_Quant[l_Index]);
+	}
+
+	return true;
+}
+
+/**
+ * DecodeScan
+ * Decode the entropy coded data of a baseline scan into the component planes
+ */
+static bool DecodeScan(JpegState& in_State, const unsigned char* in_Data, const unsigned char* in_End)
+{
+	JpegBitReader l_Reader;
+	l_Reader.Reset(in_Data, in_End);
+
+	// Scaled decodes reconstruct each block at a smaller size
+	IdctFunction l_Idct[3];
+	for(int c = 0; c < in_State.ComponentCount; c++)
+	{
+		l_Idct[c] = GetIdctFunction(in_State.Components[c].BlockSize);
+	}
+
+	short l_Coefs[64];
+	int l_McusUntilRestart = in_State.RestartInterval;
+
+	// A single component scan isn't interleaved: each MCU is one block, covering only the component's own size
+	bool l_Interleaved = in_State.ScanCount > 1;
+	int l_McusX = in_State.McusX;
+	int l_McusY = in_State.McusY;
+	if(!l_Interleaved)
+	{
+		const JpegComponent& l_Component = in_State.Components[in_State.ScanComponents[0]];
+		l_McusX = l_Component.BlocksX;
+		l_McusY = l_Component.BlocksY;
+	}
+
+	for(int l_McuY = 0; l_McuY < l_McusY; l_McuY++)
+	{
+		for(int l_McuX = 0; l_McuX < l_McusX; l_McuX++)
+		{
+			// Handle restart markers
+			if(in_State.RestartInterval)
+			{
+				if(l_McusUntilRestart == 0)
+				{
+					if(!l_Reader.Restart())
+					{
+						return false;
+					}
+					for(int c = 0; c < in_State.ComponentCount; c++)
+					{
+						in_State.Components[c].DcPrediction = 0;
+					}
+					l_McusUntilRestart = in_State.RestartInterval;
+				}
+				l_McusUntilRestart--;
+			}
+
+			for(int s = 0; s < in_State.ScanCount; s++)
+			{
+				int l_ComponentIndex = in_State.ScanComponents[s];
+				JpegComponent& l_Component = in_State.Components[l_ComponentIndex];
+				int l_BlockSize = l_Component.BlockSize;
+				int l_BlocksX = l_Interleaved ? l_Component.SamplingX : 1;
+				int l_BlocksY = l_Interleaved ? l_Component.SamplingY : 1;
+
+				for(int l_BlockY = 0; l_BlockY < l_BlocksY; l_BlockY++)
+				{
+					for(int l_BlockX = 0; l_BlockX < l_BlocksX; l_BlockX++)
+					{
+						if(!DecodeBlock(l_Reader, in_State, l_Component, l_Coefs))
+						{
+							return false;
+						}
+
+						int l_X = (l_McuX * l_BlocksX + l_BlockX) * l_BlockSize;
+						int l_Y = (l_McuY * l_BlocksY + l_BlockY) * l_BlockSize;
+						l_Idct[l_ComponentIndex](l_Coefs, &l_Component.Plane[l_Y * l_Component.Stride + l_X], l_Component.Stride);
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * ConvertColors
+ * Upsample the component planes and convert them to interleaved pixels in the output format, which saves the
+ * driver converting them on upload
+ */
+static bool ConvertColors(JpegState& in_State, const OutputFormat& in_Format, DecodedImage& out_Image)
+{
+	TextureFormat l_Format = in_Format.Choose(in_State.Width, in_State.Height);
+	if(l_Format != TextureFormat_RGBA && l_Format != TextureFormat_RGB565)
+	{
+		l_Format = TextureFormat_RGB;
+	}
+	out_Image.Allocate(in_State.Width, in_State.Height, l_Format);
+	unsigned l_RowSize = GetTextureDataSize(in_State.Width, 1, l_Format);
+
+	// Grayscale
+	if(in_State.ComponentCount == 1)
+	{
+		const JpegComponent& l_Component = in_State.Components[0];
+		for(int y = 0; y < in_State.Height; y++)
+		{
+			const unsigned char* l_In = &l_Component.Plane[y * l_Component.Stride];
+			unsigned char* l_Out = &out_Image.Pixels[y * l_RowSize];
+			for(int x = 0; x < in_State.Width; x++)
+			{
+				StorePixel(l_In[x], l_In[x], l_In[x], l_Format, l_Out, x);
+			}
+		}
+		return true;
+	}
+
+	// Full resolution rows for each component
+	int l_RowWidth = in_State.McusX * in_State.MaxSamplingX * in_State.BlockSize;
+	unsigned char* l_Rows = (unsigned char*)in_State.Arena.Allocate(l_RowWidth * 3);
+	const unsigned char* l_Channels[3];
+
+	for(int y = 0; y < in_State.Height; y++)
+	{
+		for(int c = 0; c < 3; c++)
+		{
+			const JpegComponent& l_Component = in_State.Components[c];
+			int l_FactorX = (in_State.MaxSamplingX * in_State.BlockSize) / (l_Component.SamplingX * l_Component.BlockSize);
+			int l_FactorY = (in_State.MaxSamplingY * in_State.BlockSize) / (l_Component.SamplingY * l_Component.BlockSize);
+			unsigned char* l_Row = &l_Rows[c * l_RowWidth];
+
+			// Full resolution components are used directly
+			if(l_FactorX == 1 && l_FactorY == 1)
+			{
+				l_Channels[c] = &l_Component.Plane[y * l_Component.Stride];
+				continue;
+			}
+
+			int l_SourceY = y / l_FactorY;
+			const unsigned char* l_Near = &l_Component.Plane[l_SourceY * l_Component.Stride];
+			if(l_FactorX == 2 && l_FactorY == 2)
+			{
+				// The far row is above the output row for even rows, below it for odd rows, clamped to the image
+				int l_FarY = (y & 1) ? min(l_SourceY + 1, l_Component.Height - 1) : max(l_SourceY - 1, 0);
+				UpsampleRowH2V2(l_Near, &l_Component.Plane[l_FarY * l_Component.Stride], l_Component.Width, l_Row);
+			}
+			else if(l_FactorX == 2 && l_FactorY == 1)
+			{
+				UpsampleRowH2(l_Near, l_Component.Width, l_Row);
+			}
+			else
+			{
+				UpsampleRowReplicate(l_Near, l_Component.Width, l_FactorX, l_Row);
+			}
+			l_Channels[c] = l_Row;
+		}
+
+		unsigned char* l_Out = &out_Image.Pixels[y * l_RowSize];
+
+		// Adobe files with no transform are stored as RGB
+		if(in_State.Transform == 0)
+		{
+			for(int x = 0; x < in_State.Width; x++)
+			{
+				StorePixel(l_Channels[0][x], l_Channels[1][x], l_Channels[2][x], l_Format, l_Out, x);
+			}
+		}
+		else
+		{
+			ConvertRowYCbCr(l_Channels[0], l_Channels[1], l_Channels[2], in_State.Width, l_Format, l_Out);
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Markers
+
+/**
+ * ReadFrameHeader
+ * Parse a SOF0/SOF1 segment and allocate the component planes
+ */
+static bool ReadFrameHeader(JpegState& in_State, const unsigned char* in_Segment, int in_Length)
+{
+	if(in_Length < 6 || in_Segment[0] != 8 || in_State.FrameFound)
+	{
+		return false;
+	}
+
+	int l_Height = (in_Segment[1] << 8) | in_Segment[2];
+	int l_Width = (in_Segment[3] << 8) | in_Segment[4];
+	in_State.ComponentCount = in_Segment[5];
+
+	// A zero height means the height comes later in a DNL marker, which nobody uses
+	if(l_Width <= 0 || l_Height <= 0 || l_Width > JPEG_MAX_DIMENSION || l_Height > JPEG_MAX_DIMENSION)
+	{
+		return false;
+	}
+	if((in_State.ComponentCount != 1 && in_State.ComponentCount != 3) || in_Length < 6 + in_State.ComponentCount * 3)
+	{
+		return false;
+	}
+
+	in_State.MaxSamplingX = 1;
+	in_State.MaxSamplingY = 1;
+	for(int c = 0; c < in_State.ComponentCount; c++)
+	{
+		JpegComponent& l_Component = in_State.Components[c];
+		const unsigned char* l_Data = in_Segment + 6 + c * 3;
+		l_Component.Id = l_Data[0];
+		l_Component.SamplingX = l_Data[1] >> 4;
+		l_Component.SamplingY = l_Data[1] & 15;
+		l_Component.QuantTable = l_Data[2];
+		l_Component.DcPrediction = 0;
+		if(l_Component.SamplingX < 1 || l_Component.SamplingX > 4 || l_Component.SamplingY < 1 || l_Component.SamplingY > 4 || l_Component.QuantTable > 3)
+		{
+			return false;
+		}
+		in_State.MaxSamplingX = max(in_State.MaxSamplingX, l_Component.SamplingX);
+		in_State.MaxSamplingY = max(in_State.MaxSamplingY, l_Component.SamplingY);
+	}
+
+	// Grayscale images are never interleaved, so sampling factors don't matter
+	if(in_State.ComponentCount == 1)
+	{
+		in_State.Components[0].SamplingX = in_State.Components[0].SamplingY = 1;
+		in_State.MaxSamplingX = in_State.MaxSamplingY = 1;
+	}
+
+	int l_McuWidth = in_State.MaxSamplingX * 8;
+	int l_McuHeight = in_State.MaxSamplingY * 8;
+	in_State.McusX = (l_Width + l_McuWidth - 1) / l_McuWidth;
+	in_State.McusY = (l_Height + l_McuHeight - 1) / l_McuHeight;
+
+	// Each 8x8 block produces BlockSize x BlockSize pixels, rounding the output size up like libjpeg does
+	int l_BlockSize = in_State.BlockSize;
+	in_State.Width = (l_Width * l_BlockSize + 7) / 8;
+	in_State.Height = (l_Height * l_BlockSize + 7) / 8;
+
+	for(int c = 0; c < in_State.ComponentCount; c++)
+	{
+		JpegComponent& l_Component = in_State.Components[c];
+
+		// Only whole ratios can be upsampled
+		if(in_State.MaxSamplingX % l_Component.SamplingX || in_State.MaxSamplingY % l_Component.SamplingY)
+		{
+			return false;
+		}
+
+		// When scaling down, subsampled components are reconstructed at larger blocks instead of being upsampled
+		// afterwards, e.g. 4:2:0 chroma at half size is decoded at 8x8 per block. That keeps the chroma detail
+		// the full size decode would have, and skips upsampling. There are only IDCTs for power of two block sizes,
+		// so other factors (3x3 sampling) are upsampled as they are at full size
+		int l_FactorX = in_State.MaxSamplingX / l_Component.SamplingX;
+		int l_FactorY = in_State.MaxSamplingY / l_Component.SamplingY;
+		int l_PromotedSize = l_BlockSize * l_FactorX;
+		l_Component.BlockSize = l_BlockSize;
+		if(l_FactorX == l_FactorY && l_PromotedSize <= 8 && (l_PromotedSize & (l_PromotedSize - 1)) == 0)
+		{
+			l_Component.BlockSize = l_PromotedSize;
+		}
+
+		int l_FullWidth = (l_Width * l_Component.SamplingX + in_State.MaxSamplingX - 1) / in_State.MaxSamplingX;
+		int l_FullHeight = (l_Height * l_Component.SamplingY + in_State.MaxSamplingY - 1) / in_State.MaxSamplingY;
+		l_Component.BlocksX = (l_FullWidth + 7) / 8;
+		l_Component.BlocksY = (l_FullHeight + 7) / 8;
+		l_Component.Width = (l_FullWidth * l_Component.BlockSize + 7) / 8;
+		l_Component.Height = (l_FullHeight * l_Component.BlockSize + 7) / 8;
+		l_Component.Stride = in_State.McusX * l_Component.SamplingX * l_Component.BlockSize;
+		l_Component.Plane = (unsigned char*)in_State.Arena.Allocate(l_Component.Stride * in_State.McusY * l_Component.SamplingY * l_Component.BlockSize);
+	}
+
+	in_State.FrameFound = true;
+	return true;
+}
+
+/**
+ * ReadQuantTables
+ * Parse a DQT segment
+ */
+static bool ReadQuantTables(JpegState& in_State, const unsigned char* in_Segment, int in_Length)
+{
+	while(in_Length > 0)
+	{
+		int l_Precision = in_Segment[0] >> 4;
+		int l_Table = in_Segment[0] & 15;
+		int l_Size = 1 + 64 * (l_Precision ? 2 : 1);
+		if(l_Table > 3 || l_Precision > 1 || in_Length < l_Size)
+		{
+			return false;
+		}
+
+		for(int i = 0; i < 64; i++)
+		{
+			in_State.Quant[l_Table][s_ZigZag[i]] = (unsigned short)(l_Precision ?
+				(in_Segment[1 + i * 2] << 8) | in_Segment[2 + i * 2] : in_Segment[1 + i]);
+		}
+
+		in_Segment += l_Size;
+		in_Length -= l_Size;
+	}
+	return true;
+}
+
+/**
+ * ReadHuffmanTables
+ * Parse a DHT segment
+ */
+static bool ReadHuffmanTables(JpegState& in_State, const unsigned char* in_Segment, int in_Length)
+{
+	while(in_Length > 17)
+	{
+		int l_Class = in_Segment[0] >> 4;
+		int l_Table = in_Segment[0] & 15;
+		if(l_Class > 1 || l_Table > 3)
+		{
+			return false;
+		}
+
+		int l_SymbolCount = 0;
+		for(int i = 0; i < 16; i++)
+		{
+			l_SymbolCount += in_Segment[1 + i];
+		}
+		if(l_SymbolCount > 256 || in_Length < 17 + l_SymbolCount)
+		{
+			return false;
+		}
+
+		JpegHuffmanTable& l_Huffman = l_Class ? in_State.AcTables[l_Table] : in_State.DcTables[l_Table];
+		if(!l_Huffman.Build(in_Segment + 1, in_Segment + 17))
+		{
+			return false;
+		}
+		if(l_Class)
+		{
+			l_Huffman.BuildFastAc();
+		}
+
+		in_Segment += 17 + l_SymbolCount;
+		in_Length -= 17 + l_SymbolCount;
+	}
+	return in_Length == 0;
+}
+
+/**
+ * ReadScanHeader
+ * Parse a SOS segment
+ */
+static bool ReadScanHeader(JpegState& in_State, const unsigned char* in_Segment, int in_Length)
+{
+	if(!in_State.FrameFound || in_Length < 1)
+	{
+		return false;
+	}
+
+	// The image must be in a single scan, otherwise leave it to DevIL
+	in_State.ScanCount = in_Segment[0];
+	if(in_State.ScanCount != in_State.ComponentCount || in_Length < 4 + in_State.ScanCount * 2)
+	{
+		return false;
+	}
+
+	for(int s = 0; s < in_State.ScanCount; s++)
+	{
+		int l_Id = in_Segment[1 + s * 2];
+		int l_Tables = in_Segment[2 + s * 2];
+
+		int l_Index = -1;
+		for(int c = 0; c < in_State.ComponentCount; c++)
+		{
+			if(in_State.Components[c].Id == l_Id)
+			{
+				l_Index = c;
+			}
+		}
+		if(l_Index < 0)
+		{
+			return false;
+		}
+
+		JpegComponent& l_Component = in_State.Components[l_Index];
+		l_Component.DcTable = l_Tables >> 4;
+		l_Component.AcTable = l_Tables & 15;
+		if(l_Component.DcTable > 3 || l_Component.AcTable > 3 ||
+			!in_State.DcTables[l_Component.DcTable].Present || !in_State.AcTables[l_Component.AcTable].Present)
+		{
+			return false;
+		}
+		in_State.ScanComponents[s] = l_Index;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// JpegDecoder
+
+bool JpegDecoder::CanDecode(const unsigned char* in_Data, unsigned in_Size) const
+{
+	// SOI followed by another marker
+	return in_Size >= 4 && in_Data[0] == 0xFF && in_Data[1] == 0xD8 && in_Data[2] == 0xFF;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool JpegDecoder::Decode(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena* in_Arena, const OutputFormat& in_Format)
+{
+	return DecodeScaled(in_Data, in_Size, 0, out_Image, in_Arena, in_Format);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool JpegDecoder::DecodeScaled(const unsigned char* in_Data, unsigned in_Size, int in_ScaleShift, DecodedImage& out_Image, DecodeArena* in_Arena,
+							   const OutputFormat& in_Format)
+{
+	if(!CanDecode(in_Data, in_Size) || in_ScaleShift < 0 || in_ScaleShift > 3)
+	{
+		return false;
+	}
+
+	// Without a caller supplied arena the scratch memory only lives for this call
+	DecodeArena l_LocalArena;
+	JpegState l_State(in_Arena ? *in_Arena : l_LocalArena);
+	l_State.BlockSize = 8 >> in_ScaleShift;
+	const unsigned char* l_Data = in_Data + 2;
+	const unsigned char* l_End = in_Data + in_Size;
+
+	// Walk the markers up to the first scan
+	while(l_Data < l_End)
+	{
+		if(*l_Data != 0xFF)
+		{
+			return false;
+		}
+
+		// Skip fill bytes
+		while(l_Data < l_End && *l_Data == 0xFF)
+		{
+			l_Data++;
+		}
+		if(l_Data >= l_End)
+		{
+			return false;
+		}
+
+		int l_Marker = *l_Data++;
+
+		// Markers without a segment
+		if(l_Marker == 0x01 || (l_Marker >= 0xD0 && l_Marker <= 0xD8))
+		{
+			continue;
+		}
+		if(l_Marker == 0xD9)
+		{
+			return false;
+		}
+
+		if(l_Data + 2 > l_End)
+		{
+			return false;
+		}
+		int l_Length = ((l_Data[0] << 8) | l_Data[1]) - 2;
+		const unsigned char* l_Segment = l_Data + 2;
+		if(l_Length < 0 || l_Segment + l_Length > l_End)
+		{
+			return false;
+		}
+		l_Data = l_Segment + l_Length;
+
+		switch(l_Marker)
+		{
+		case 0xC0:	// Baseline
+		case 0xC1:	// Extended sequential, huffman coded
+
+			if(!ReadFrameHeader(l_State, l_Segment, l_Length))
+			{
+				return false;
+			}
+			break;
+
+		// Progressive, lossless, hierarchical and arithmetic coded frames are left to DevIL
+		case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+		case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+
+			return false;
+
+		case 0xC4:
+
+			if(!ReadHuffmanTables(l_State, l_Segment, l_Length))
+			{
+				return false;
+			}
+			break;
+
+		case 0xDB:
+
+			if(!ReadQuantTables(l_State, l_Segment, l_Length))
+			{
+				return false;
+			}
+			break;
+
+		case 0xDD:
+
+			if(l_Length < 2)
+			{
+				return false;
+			}
+			l_State.RestartInterval = (l_Segment[0] << 8) | l_Segment[1];
+			break;
+
+		case 0xEE:	// APP14, Adobe
+
+			if(l_Length >= 12 && memcmp(l_Segment, "Adobe", 5) == 0)
+			{
+				l_State.Transform = l_Segment[11];
+			}
+			break;
+
+		case 0xDA:
+
+			// Everything needed has been read, decode the image
+			return ReadScanHeader(l_State, l_Segment, l_Length) &&
+				   DecodeScan(l_State, l_Data, l_End) &&
+				   ConvertColors(l_State, in_Format, out_Image);
+
+		default:
+
+			// APPn, COM and anything else we don't need
+			break;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file JpegDecoder.h
+ * @brief JpegDecoder class header file
+ */
+
+#ifndef JPEGDECODER_H_
+#define JPEGDECODER_H_
+
+#include "Global.h"
+#include "ImageDecoder.h"
+
+/**
+ * USE_SSE2_JPEG
+ * Use the SSE2 IDCT and color conversion. The scalar versions produce the same output
+ */
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#define USE_SSE2_JPEG 1
+#else
+	#define USE_SSE2_JPEG 0
+#endif
+
+/**
+ * JpegDecoder
+ * Decoder for baseline (sequential, huffman coded, 8 bit) JPEG files, which is what every thumbnail
+ * container holds. Progressive and arithmetic coded files are rejected so the DevIL decoder can take them.
+ * The decoder keeps no state between calls, so any number of threads may decode at once
+ */
+class JpegDecoder : public ImageDecoder
+{
+public:
+
+	/**
+	 * ImageDecoder interface
+	 */
+	virtual const char* GetName() const { return "JPEG"; }
+	virtual bool CanDecode(const unsigned char* in_Data, unsigned in_Size) const;
+	virtual bool Decode(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena* in_Arena = NULL,
+						const OutputFormat& in_Format = OutputFormat());
+
+	/**
+	 * DecodeScaled
+	 * Scaling is done in the DCT domain: each 8x8 block is reconstructed at 4x4, 2x2 or 1x1 from its
+	 * low frequency coefficients, so the IDCT, upsampling and color conversion cost scales with the output size.
+	 * Every output format is written directly by the color conversion
+	 */
+	virtual bool DecodeScaled(const unsigned char* in_Data, unsigned in_Size, int in_ScaleShift, DecodedImage& out_Image, DecodeArena* in_Arena = NULL,
+							  const OutputFormat& in_Format = OutputFormat());
+};
+
+#endif // JPEGDECODER_H_
@@ -0,0 +1,206 @@
+/**
+ * @file LockFreeRing.h
+ * @brief MpscRing and SpscRing class header file
+ */
+
+#ifndef LOCKFREERING_H_
+#define LOCKFREERING_H_
+
+#include "Global.h"
+#include "Atomic.h"
+
+/**
+ * MpscRing
+ * Bounded lock-free queue for any number of producer threads and a single consumer thread.
+ * Each slot carries a sequence number saying whether it is ready to be written or read, so a producer only
+ * contends with other producers, on a single compare exchange to claim a slot. Push and pop never block;
+ * they fail when the ring is full or empty. T must be copyable without allocating to keep that guarantee
+ */
+template <typename T>
+class MpscRing
+{
+	/**
+	 * Slot
+	 * The sequence is the position the slot can next be written at, or that position + 1 once it holds a value
+	 */
+	struct Slot
+	{
+		AtomicLong Sequence;
+		T Value;
+	};
+
+public:
+
+	/**
+	 * Constructor
+	 * in_Capacity must be a power of two
+	 */
+	MpscRing(unsigned in_Capacity)
+		: mSlots(new Slot[in_Capacity]), mMask(in_Capacity - 1), mWritePosition(0), mReadPosition(0), mRetryCount(0)
+	{
+		assert((in_Capacity & mMask) == 0 && "MpscRing capacity must be a power of two");
+		for(unsigned i = 0; i < in_Capacity; i++)
+		{
+			mSlots[i].Sequence = (LONG)i;
+		}
+	}
+
+	~MpscRing() { delete [] mSlots; }
+
+	/**
+	 * TryPush
+	 * Add a value to the ring. Returns false if the ring is full. May be called from any thread
+	 */
+	bool TryPush(const T& in_Value)
+	{
+		Slot* l_Slot;
+		LONG l_Position = mWritePosition;
+		for(;;)
+		{
+			l_Slot = &mSlots[l_Position & mMask];
+			LONG l_Difference = (LONG)((unsigned long)l_Slot->Sequence - (unsigned long)l_Position);
+			if(l_Difference == 0)
+			{
+				// The slot is free, try to claim it
+				LONG l_Previous = AtomicCompareExchange(&mWritePosition, l_Position + 1, l_Position);
+				if(l_Previous == l_Position)
+				{
+					break;
+				}
+				l_Position = l_Previous;
+				AtomicIncrement(&mRetryCount);
+			}
+			else if(l_Difference < 0)
+			{
+				// The consumer hasn't read this slot since the last lap, the ring is full
+				return false;
+			}
+			else
+			{
+				// Another producer claimed the slot
+				l_Position = mWritePosition;
+			}
+		}
+
+		// The slot is ours until the sequence says it holds a value
+		l_Slot->Value = in_Value;
+		AtomicStore(&l_Slot->Sequence, l_Position + 1);
+		return true;
+	}
+
+	/**
+	 * TryPop
+	 * Remove the oldest value from the ring. Returns false if the ring is empty. Only the consumer thread may call this
+	 */
+	bool TryPop(T& out_Value)
+	{
+		Slot* l_Slot = &mSlots[mReadPosition & mMask];
+		if((LONG)((unsigned long)l_Slot->Sequence - (unsigned long)(mReadPosition + 1)) < 0)
+		{
+			return false;
+		}
+
+		out_Value = l_Slot->Value;
+
+		// Hand the slot back to the producers for the next lap
+		AtomicStore(&l_Slot->Sequence, mReadPosition + mMask + 1);
+		mReadPosition++;
+		return true;
+	}
+
+	/**
+	 * GetRetryCount
+	 * Number of times a producer lost the race for a slot and had to try again, a measure of contention
+	 */
+	unsigned GetRetryCount() const { return (unsigned)mRetryCount; }
+
+private:
+
+	Slot* mSlots;
+	LONG mMask;
+
+	// Producer and consumer state are kept on separate cache lines
+	char mPadding0[CACHE_LINE_SIZE];
+	AtomicLong mWritePosition;				// Next position to claim (producers)
+	char mPadding1[CACHE_LINE_SIZE];
+	LONG mReadPosition;						// Next position to read (consumer)
+	char mPadding2[CACHE_LINE_SIZE];
+	AtomicLong mRetryCount;
+
+	MpscRing(const MpscRing&);
+	const MpscRing& operator=(const MpscRing&);
+};
+
+/**
+ * SpscRing
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread. Each side only writes its own
+ * position, so push and pop are wait-free. T must be copyable without allocating to keep that guarantee
+ */
+template <typename T>
+class SpscRing
+{
+public:
+
+	/**
+	 * Constructor
+	 * in_Capacity must be a power of two
+	 */
+	SpscRing(unsigned in_Capacity)
+		: mValues(new T[in_Capacity]), mMask(in_Capacity - 1), mWritePosition(0), mReadPosition(0)
+	{
+		assert((in_Capacity & mMask) == 0 && "SpscRing capacity must be a power of two");
+	}
+
+	~SpscRing() { delete [] mValues; }
+
+	/**
+	 * TryPush
+	 * Add a value to the ring. Returns false if the ring is full. Only the producer thread may call this
+	 */
+	bool TryPush(const T& in_Value)
+	{
+		LONG l_Position = mWritePosition;
+		if((unsigned long)l_Position - (unsigned long)mReadPosition > (unsigned long)mMask)
+		{
+			return false;
+		}
+
+		mValues[l_Position & mMask] = in_Value;
+		AtomicStore(&mWritePosition, l_Position + 1);
+		return true;
+	}
+
+	/**
+	 * TryPop
+	 * Remove the oldest value from the ring. Returns false if the ring is empty. Only the consumer thread may call this
+	 */
+	bool TryPop(T& out_Value)
+	{
+		LONG l_Position = mReadPosition;
+		if(l_Position == mWritePosition)
+		{
+			return false;
+		}
+
+		out_Value = mValues[l_Position & mMask];
+		AtomicStore(&mReadPosition, l_Position + 1);
+		return true;
+	}
+
+private:
+
+	T* mValues;
+	LONG mMask;
+
+	// Producer and consumer state are kept on separate cache lines
+	char mPadding0[CACHE_LINE_SIZE];
+	AtomicLong mWritePosition;				// Written by the producer
+	char mPadding1[CACHE_LINE_SIZE];
+	AtomicLong mReadPosition;				// Written by the consumer
+	char mPadding2[CACHE_LINE_SIZE];
+
+	SpscRing(const SpscRing&);
+	const SpscRing& operator=(const SpscRing&);
+};
+
+#endif // LOCKFREERING_H_
@@ -159,6 +159,8 @@ void MSWindow::TranslateKey(unsigned& in_Key)
 	case VK_PRIOR: in_Key = KeyboardListener::VirtualKey_PageUp; break;
 	case VK_NEXT: in_Key = KeyboardListener::VirtualKey_PageDown; break;
 	case VK_F1: in_Key = KeyboardListener::VirtualKey_F1; break;
+	case VK_F2: in_Key = KeyboardListener::VirtualKey_F2; break;
+	case VK_F3: in_Key = KeyboardListener::VirtualKey_F3; break;
 	}
 }
 
@@ -0,0 +1,168 @@
+/**
+ * @file MappedContainer.cpp
+ * @brief MappedContainer implementation file
+ */
+
+#include "MappedContainer.h"
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// MappedContainer
+
+MappedContainer::MappedContainer()
+: mView(NULL)
+, mSize(0)
+, mEntries(NULL)
+, mEntryCount(0)
+#ifdef WIN32
+, mFile(INVALID_HANDLE_VALUE)
+, mMapping(NULL)
+#endif // WIN32
+{
+	mFilename[0] = '\0';
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+MappedContainer::~MappedContainer()
+{
+	Close();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool MappedContainer::Open(const char* in_Filename)
+{
+	Close();
+
+#ifdef WIN32
+	mFile = CreateFileA(in_Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(mFile == INVALID_HANDLE_VALUE)
+	{
+		logf("Failed to open thumbnail file '%s'", in_Filename);
+		return false;
+	}
+
+	// An empty file can't be mapped, and has nothing to load anyway
+	mSize = GetFileSize(mFile, NULL);
+	if(mSize == 0 || mSize == INVALID_FILE_SIZE)
+	{
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	mView = mMapping ? (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+	#error Your platform file mapping goes here
+#endif // WIN32
+
+	if(!mView)
+	{
+		logf("Failed to map thumbnail file '%s'", in_Filename);
+		Close();
+		return false;
+	}
+
+	strncpy(mFilename, in_Filename, MAX_PATH - 1);
+	mFilename[MAX_PATH - 1] = '\0';
+
+	// A version 2 container must have an intact table of contents, every blob is found through it
+	if(IsContainerV2(mView, mSize))
+	{
+		const ContainerHeader* l_Header = (const ContainerHeader*)mView;
+		unsigned l_TocSize = l_Header->EntryCount * sizeof(ContainerEntry);
+		if(l_Header->EntryCount > (mSize - sizeof(ContainerHeader)) / sizeof(ContainerEntry) ||
+		   ContainerChecksum(mView + sizeof(ContainerHeader), l_TocSize) != l_Header->TocChecksum)
+		{
+			logf("Thumbnail file '%s' has a damaged table of contents", in_Filename);
+			Close();
+			return false;
+		}
+
+		mEntries = (const ContainerEntry*)(mView + sizeof(ContainerHeader));
+		mEntryCount = l_Header->EntryCount;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void MappedContainer::Close()
+{
+#ifdef WIN32
+	if(mView)
+	{
+		UnmapViewOfFile(mView);
+	}
+	if(mMapping)
+	{
+		CloseHandle(mMapping);
+	}
+	if(mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+	}
+	mMapping = NULL;
+	mFile = INVALID_HANDLE_VALUE;
+#else
+	#error Your platform file unmapping goes here
+#endif // WIN32
+
+	mView = NULL;
+	mSize = 0;
+	mEntries = NULL;
+	mEntryCount = 0;
+	mFilename[0] = '\0';
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+const unsigned char* MappedContainer::GetData(unsigned in_Offset, unsigned in_Size) const
+{
+	if(!mView || in_Offset > mSize || in_Size > mSize - in_Offset)
+	{
+		return NULL;
+	}
+	return mView + in_Offset;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int MappedContainer::FindEntry(unsigned in_Offset) const
+{
+	// The entries are sorted by offset
+	unsigned l_Low = 0;
+	unsigned l_High = mEntryCount;
+	while(l_Low < l_High)
+	{
+		unsigned l_Middle = (l_Low + l_High) / 2;
+		if(mEntries[l_Middle].Offset < in_Offset)
+		{
+			l_Low = l_Middle + 1;
+		}
+		else
+		{
+			l_High = l_Middle;
+		}
+	}
+	return l_Low < mEntryCount && mEntries[l_Low].Offset == in_Offset ? (int)l_Low : -1;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool MappedContainer::VerifyBlob(unsigned in_Offset, unsigned in_Size) const
+{
+	const unsigned char* l_Data = GetData(in_Offset, in_Size);
+	if(!l_Data)
+	{
+		return false;
+	}
+	if(!mEntries)
+	{
+		return true;
+	}
+
+	int l_Entry = FindEntry(in_Offset);
+	return l_Entry >= 0 && mEntries[l_Entry].Size == in_Size && ContainerChecksum(l_Data, in_Size) == mEntries[l_Entry].Checksum;
+}
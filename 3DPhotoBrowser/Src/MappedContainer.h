@@ -0,0 +1,93 @@
+/**
+ * @file MappedContainer.h
+ * @brief MappedContainer class header file
+ */
+
+#ifndef MAPPEDCONTAINER_H_
+#define MAPPEDCONTAINER_H_
+
+#include "Global.h"
+#include "ContainerFormat.h"
+
+/**
+ * MappedContainer
+ * A thumbnail container mapped read only into memory. Blobs are decoded straight out of the mapping, nothing is
+ * copied. Both container versions can be mapped; a version 2 container's table of contents is checked when it is
+ * opened and gives each blob's checksum
+ */
+class MappedContainer
+{
+public:
+
+	MappedContainer();
+	~MappedContainer();
+
+	/**
+	 * Open
+	 * Map a container file, closing any container already open. Returns false if it can't be mapped or
+	 * its table of contents is damaged
+	 */
+	bool Open(const char* in_Filename);
+
+	/**
+	 * Close
+	 * Unmap the container. Pointers returned by GetData become invalid
+	 */
+	void Close();
+
+	/**
+	 * IsOpen / HasTableOfContents
+	 */
+	bool IsOpen() const { return mView != NULL; }
+	bool HasTableOfContents() const { return mEntries != NULL; }
+
+	/**
+	 * GetFilename / GetSize
+	 */
+	const char* GetFilename() const { return mFilename; }
+	unsigned GetSize() const { return mSize; }
+
+	/**
+	 * GetData
+	 * Pointer into the mapping for in_Size bytes at in_Offset, or NULL if they aren't all in the file
+	 */
+	const unsigned char* GetData(unsigned in_Offset, unsigned in_Size) const;
+
+	/**
+	 * GetEntryCount / GetEntry
+	 * The table of contents, empty for a version 1 container
+	 */
+	unsigned GetEntryCount() const { return mEntryCount; }
+	const ContainerEntry& GetEntry(unsigned in_Index) const { return mEntries[in_Index]; }
+
+	/**
+	 * FindEntry
+	 * Index of the entry for the blob at in_Offset, or -1 if there isn't one
+	 */
+	int FindEntry(unsigned in_Offset) const;
+
+	/**
+	 * VerifyBlob
+	 * Check the blob at in_Offset against its checksum. Version 1 containers have nothing to check against,
+	 * so any blob inside the file passes
+	 */
+	bool VerifyBlob(unsigned in_Offset, unsigned in_Size) const;
+
+private:
+
+	char mFilename[MAX_PATH];
+	const unsigned char* mView;
+	unsigned mSize;
+	const ContainerEntry* mEntries;		// Points into the mapping, NULL for a version 1 container
+	unsigned mEntryCount;
+
+#ifdef WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#endif // WIN32
+
+	MappedContainer(const MappedContainer&);
+	const MappedContainer& operator=(const MappedContainer&);
+};
+
+#endif // MAPPEDCONTAINER_H_
@@ -0,0 +1,358 @@
+/**
+ * @file Metrics.cpp
+ * @brief Runtime metrics registry implementation file
+ */
+
+#include "Metrics.h"
+
+// Stats file, written to the temporary file first so a reader never sees half of it
+#define STATS_FILENAME "data/Stats.txt"
+#define STATS_TEMP_FILENAME "data/Stats.tmp"
+
+/**
+ * HISTOGRAM_SUB_BUCKETS
+ * Histogram buckets per octave. Values below twice this have a bucket each
+ */
+#define HISTOGRAM_SUB_BUCKETS 4
+#define HISTOGRAM_BUCKETS 128
+
+/**
+ * MetricInfo
+ * Name and type of each metric
+ */
+struct MetricInfo
+{
+	const char* Name;
+	MetricType Type;
+};
+
+static const MetricInfo s_Metrics[Metric_MAX] =
+{
+	{ "TexturesResident",		MetricType_Gauge },
+	{ "TextureKB",				MetricType_Gauge },
+	{ "DrawCalls",				MetricType_Counter },
+	{ "TilesDrawn",				MetricType_Counter },
+	{ "TilesCulled",			MetricType_Counter },
+	{ "QueueDepth",				MetricType_Gauge },
+	{ "LoadLatency",			MetricType_Histogram },
+	{ "LoadsCompleted",			MetricType_Counter },
+	{ "LoadsCancelled",			MetricType_Counter },
+	{ "Reads",					MetricType_Counter },
+	{ "ReadKB",					MetricType_Counter },
+	{ "ReadAheadHits",			MetricType_Counter },
+	{ "DecodedCacheHits",		MetricType_Counter },
+	{ "DecodedCacheMisses",		MetricType_Counter },
+	{ "Decodes",				MetricType_Counter },
+	{ "DecodedKB",				MetricType_Counter },
+};
+
+/**
+ * HitRateInfo
+ * Hit rates derived from a pair of counters
+ */
+struct HitRateInfo
+{
+	const char* Name;
+	MetricId Hits;
+	MetricId Misses;
+};
+
+static const HitRateInfo s_HitRates[] =
+{
+	{ "ReadAheadHitRate",		Metric_ReadAheadHits,		Metric_Reads },
+	{ "DecodedCacheHitRate",	Metric_DecodedCacheHits,	Metric_DecodedCacheMisses },
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetBucket
+ * The histogram bucket of a value
+ */
+static unsigned GetBucket(unsigned in_Value)
+{
+	if(in_Value < 2 * HISTOGRAM_SUB_BUCKETS)
+	{
+		return in_Value;
+	}
+
+	// Shift the value down until only its top bits are left, they pick the bucket within the octave
+	unsigned l_Shift = 0;
+	while((in_Value >> l_Shift) >= 2 * HISTOGRAM_SUB_BUCKETS)
+	{
+		l_Shift++;
+	}
+	return (l_Shift + 1) * HISTOGRAM_SUB_BUCKETS + (in_Value >> l_Shift) - HISTOGRAM_SUB_BUCKETS;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetBucketTop
+ * The value just past the top of a histogram bucket
+ */
+static double GetBucketTop(unsigned in_Bucket)
+{
+	if(in_Bucket < 2 * HISTOGRAM_SUB_BUCKETS)
+	{
+		return in_Bucket + 1.0;
+	}
+	unsigned l_Shift = in_Bucket / HISTOGRAM_SUB_BUCKETS - 1;
+	return (double)(HISTOGRAM_SUB_BUCKETS + in_Bucket % HISTOGRAM_SUB_BUCKETS + 1) * (double)(1u << l_Shift);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Metrics
+
+Metrics::Metrics()
+: mInterval(0.0)
+, mStartTime(Timer::Instance()->GetSeconds())
+, mLastWriteTime(mStartTime)
+, mFrameCount(0)
+, mLastFrameCount(0)
+{
+	for(int i = 0; i < Metric_MAX; i++)
+	{
+		MetricData& l_Metric = mMetrics[i];
+		l_Metric.Value = 0;
+		l_Metric.Max = 0;
+		l_Metric.Buckets = NULL;
+		l_Metric.LastValue = 0;
+		l_Metric.LastBuckets = NULL;
+		if(s_Metrics[i].Type == MetricType_Histogram)
+		{
+			l_Metric.Buckets = new AtomicLong[HISTOGRAM_BUCKETS];
+			l_Metric.LastBuckets = new LONG[HISTOGRAM_BUCKETS];
+			for(unsigned b = 0; b < HISTOGRAM_BUCKETS; b++)
+			{
+				l_Metric.Buckets[b] = 0;
+				l_Metric.LastBuckets[b] = 0;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+Metrics::~Metrics()
+{
+	for(int i = 0; i < Metric_MAX; i++)
+	{
+		delete [] mMetrics[i].Buckets;
+		delete [] mMetrics[i].LastBuckets;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Metrics::Configure()
+{
+#if USE_METRICS
+	double l_Interval = max(0.0f, UserPreferences::Instance()->MetricsInterval());
+#else
+	double l_Interval = 0.0;
+#endif // USE_METRICS
+	if(l_Interval != mInterval && l_Interval > 0.0)
+	{
+		logf("Metrics: writing '%s' every %.1f seconds", STATS_FILENAME, l_Interval);
+	}
+	mInterval = l_Interval;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Metrics::Record(MetricId in_Metric, unsigned in_Value)
+{
+	MetricData& l_Metric = mMetrics[in_Metric];
+	AtomicIncrement(&l_Metric.Buckets[GetBucket(in_Value)]);
+	AtomicIncrement(&l_Metric.Value);
+
+	// Raise the maximum unless another thread raised it past this value first
+	LONG l_Max = l_Metric.Max;
+	while((unsigned)l_Max < in_Value && AtomicCompareExchange(&l_Metric.Max, (LONG)in_Value, l_Max) != l_Max)
+	{
+		l_Max = l_Metric.Max;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Metrics::EndFrame()
+{
+	mFrameCount++;
+	if(mInterval > 0.0 && Timer::Instance()->GetSeconds() - mLastWriteTime >= mInterval)
+	{
+		WriteStats();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Metrics::Summarize(MetricId in_Metric, HistogramSummary& out_Summary) const
+{
+	const MetricData& l_Metric = mMetrics[in_Metric];
+	if(!l_Metric.Buckets)
+	{
+		return false;
+	}
+
+	LONG l_Buckets[HISTOGRAM_BUCKETS];
+	for(unsigned b = 0; b < HISTOGRAM_BUCKETS; b++)
+	{
+		l_Buckets[b] = l_Metric.Buckets[b];
+	}
+	return Summarize(l_Buckets, l_Metric.Max, out_Summary);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Metrics::Summarize(const LONG* in_Buckets, LONG in_Max, HistogramSummary& out_Summary)
+{
+	memset(&out_Summary, 0, sizeof(out_Summary));
+	for(unsigned b = 0; b < HISTOGRAM_BUCKETS; b++)
+	{
+		out_Summary.Count += in_Buckets[b];
+	}
+	if(out_Summary.Count == 0)
+	{
+		return false;
+	}
+
+	// Nearest rank percentiles, capped by the largest value so a sparse top bucket doesn't overstate them
+	const float l_Fractions[] = { 0.50f, 0.95f, 0.99f, 1.0f };
+	float* l_Results[] = { &out_Summary.P50, &out_Summary.P95, &out_Summary.P99, &out_Summary.Max };
+	for(unsigned i = 0; i < sizeof(l_Fractions) / sizeof(l_Fractions[0]); i++)
+	{
+		unsigned l_Rank = max(1u, (unsigned)ceil(l_Fractions[i] * out_Summary.Count));
+		unsigned l_Total = 0;
+		unsigned b = 0;
+		while(b < HISTOGRAM_BUCKETS - 1 && l_Total + in_Buckets[b] < l_Rank)
+		{
+			l_Total += in_Buckets[b++];
+		}
+		*l_Results[i] = (float)(min(GetBucketTop(b), (double)(unsigned)in_Max) / 1000.0);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+string Metrics::FormatStats(bool in_NewInterval)
+{
+	// Each metric is read once, so the values reported and the base of the next interval agree
+	double l_Now = Timer::Instance()->GetSeconds();
+	double l_Interval = max(l_Now - mLastWriteTime, 0.001);
+	unsigned l_Frames = mFrameCount - mLastFrameCount;
+	LONG l_Deltas[Metric_MAX];
+
+	stringstream l_Stats;
+	l_Stats << fixed << setprecision(3);
+	l_Stats << "Time " << l_Now - mStartTime << endl;
+	l_Stats << "Interval " << l_Interval << endl;
+	l_Stats << "Frames " << mFrameCount << endl;
+	l_Stats << "Frames.PerSecond " << l_Frames / l_Interval << endl;
+
+	for(int i = 0; i < Metric_MAX; i++)
+	{
+		MetricData& l_Metric = mMetrics[i];
+		LONG l_Value = l_Metric.Value;
+		l_Deltas[i] = l_Value - l_Metric.LastValue;
+		switch(s_Metrics[i].Type)
+		{
+		case MetricType_Counter:
+
+			l_Stats << s_Metrics[i].Name << " " << l_Value << endl;
+			l_Stats << s_Metrics[i].Name << ".PerSecond " << l_Deltas[i] / l_Interval << endl;
+			l_Stats << s_Metrics[i].Name << ".PerFrame " << (l_Frames ? (double)l_Deltas[i] / l_Frames : 0.0) << endl;
+			break;
+
+		case MetricType_Gauge:
+
+			l_Stats << s_Metrics[i].Name << " " << l_Value << endl;
+			break;
+
+		case MetricType_Histogram:
+			{
+				LONG l_Buckets[HISTOGRAM_BUCKETS];
+				for(unsigned b = 0; b < HISTOGRAM_BUCKETS; b++)
+				{
+					LONG l_Count = l_Metric.Buckets[b];
+					l_Buckets[b] = l_Count - l_Metric.LastBuckets[b];
+					if(in_NewInterval)
+					{
+						l_Metric.LastBuckets[b] = l_Count;
+					}
+				}
+
+				HistogramSummary l_Summary;
+				Summarize(l_Buckets, l_Metric.Max, l_Summary);
+				l_Stats << s_Metrics[i].Name << ".Count " << l_Summary.Count << endl;
+				l_Stats << s_Metrics[i].Name << ".P50 " << l_Summary.P50 << endl;
+				l_Stats << s_Metrics[i].Name << ".P95 " << l_Summary.P95 << endl;
+				l_Stats << s_Metrics[i].Name << ".P99 " << l_Summary.P99 << endl;
+				l_Stats << s_Metrics[i].Name << ".Max " << l_Summary.Max << endl;
+			}
+			break;
+		}
+
+		if(in_NewInterval)
+		{
+			l_Metric.LastValue = l_Value;
+		}
+	}
+
+	for(unsigned i = 0; i < sizeof(s_HitRates) / sizeof(s_HitRates[0]); i++)
+	{
+		LONG l_Lookups = l_Deltas[s_HitRates[i].Hits] + l_Deltas[s_HitRates[i].Misses];
+		l_Stats << s_HitRates[i].Name << " " << (l_Lookups ? (double)l_Deltas[s_HitRates[i].Hits] / l_Lookups : 0.0) << endl;
+	}
+
+	if(in_NewInterval)
+	{
+		mLastWriteTime = l_Now;
+		mLastFrameCount = mFrameCount;
+	}
+	return l_Stats.str();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Metrics::WriteStats()
+{
+	string l_Stats = FormatStats(true);
+
+	ofstream l_File;
+	l_File.open(STATS_TEMP_FILENAME);
+	l_File << l_Stats;
+	l_File.close();
+	if(l_File.fail())
+	{
+		logf("Metrics: failed to write '%s'", STATS_TEMP_FILENAME);
+		return false;
+	}
+
+#ifdef WIN32
+	if(!MoveFileExA(STATS_TEMP_FILENAME, STATS_FILENAME, MOVEFILE_REPLACE_EXISTING))
+	{
+		logf("Metrics: failed to replace '%s'", STATS_FILENAME);
+		return false;
+	}
+#else
+	#error Your platform file replace goes here
+#endif // WIN32
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+const char* Metrics::GetMetricName(MetricId in_Metric)
+{
+	return s_Metrics[in_Metric].Name;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+MetricType Metrics::GetMetricType(MetricId in_Metric)
+{
+	return s_Metrics[in_Metric].Type;
+}
@@ -0,0 +1,186 @@
+/**
+ * @file Metrics.h
+ * @brief Runtime metrics registry header file
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "Global.h"
+#include "Atomic.h"
+
+/**
+ * MetricType
+ * How a metric is recorded and reported
+ */
+enum MetricType
+{
+	MetricType_Counter,			// A running total, reported with its rate per second and per frame
+	MetricType_Gauge,			// A current value
+	MetricType_Histogram,		// A distribution of values, reported as percentiles
+};
+
+/**
+ * MetricId
+ * The metrics the browser records
+ */
+enum MetricId
+{
+	// Graphics
+	Metric_TexturesResident,	// Gauge: textures created and not yet freed
+	Metric_TextureKB,			// Gauge: kilobytes of their texture data
+	Metric_DrawCalls,			// Counter
+
+	// Main thread
+	Metric_TilesDrawn,			// Counter: image tiles drawn on their own, rather than as part of the overview
+	Metric_TilesCulled,			// Counter: image tiles outside the view
+
+	// Texture loader
+	Metric_QueueDepth,			// Gauge: loads requested that haven't started
+	Metric_LoadLatency,			// Histogram: microseconds from requesting a visible load to handing its texture to the tile
+	Metric_LoadsCompleted,		// Counter
+	Metric_LoadsCancelled,		// Counter
+	Metric_Reads,				// Counter: container reads of a batch or a single thumbnail, or batches decoded straight from a mapping
+	Metric_ReadKB,				// Counter: kilobytes those batches read, or took from the mapping
+	Metric_ReadAheadHits,		// Counter: batches served from the data read ahead of the last read
+	Metric_DecodedCacheHits,	// Counter: thumbnails found in the decoded cache
+	Metric_DecodedCacheMisses,	// Counter
+	Metric_Decodes,				// Counter: thumbnails decoded
+	Metric_DecodedKB,			// Counter: kilobytes of decoded pixels
+
+	Metric_MAX,
+};
+
+/**
+ * HistogramSummary
+ * Statistics of a histogram metric, in milliseconds. Percentiles are the top of the bucket they fall in, which is
+ * within a quarter octave of the value
+ */
+struct HistogramSummary
+{
+	unsigned Count;
+	float P50;
+	float P95;
+	float P99;
+	float Max;
+};
+
+/**
+ * Metrics
+ * Singleton registry of counters, gauges and histograms describing what the browser is doing. Metrics may be
+ * recorded from any thread; each is a single atomic operation, so they are always on.
+ * The main thread can query them at any time, and every MetricsInterval seconds the whole set is written to the
+ * stats file, replacing the last one, with rates and percentiles covering the interval since
+ */
+class Metrics
+{
+	/**
+	 * MetricData
+	 * The recorded state of one metric
+	 */
+	struct MetricData
+	{
+		AtomicLong Value;			// Counter total, gauge value or histogram count
+		AtomicLong Max;				// Largest value recorded, for histograms
+		AtomicLong* Buckets;		// Histogram buckets, NULL for other types
+		LONG LastValue;				// Value and buckets when the stats file was last written (main thread only)
+		LONG* LastBuckets;
+	};
+
+public:
+
+	/**
+	 * Instance
+	 * Get the singleton instance
+	 */
+	static Metrics* Instance() { static Metrics l_Instance; return &l_Instance; }
+
+	/**
+	 * Configure
+	 * Apply the MetricsInterval preference
+	 */
+	void Configure();
+
+	/**
+	 * Add / Set / Record
+	 * Add to a counter or gauge, set a gauge, or record a value in microseconds in a histogram. May be called from
+	 * any thread
+	 */
+	void Add(MetricId in_Metric, LONG in_Value) { AtomicAdd(&mMetrics[in_Metric].Value, in_Value); }
+	void Set(MetricId in_Metric, LONG in_Value) { AtomicStore(&mMetrics[in_Metric].Value, in_Value); }
+	void Record(MetricId in_Metric, unsigned in_Value);
+
+	/**
+	 * EndFrame
+	 * Count a frame, and write the stats file when the interval is up. Main thread only
+	 */
+	void EndFrame();
+
+	/**
+	 * GetValue
+	 * The counter total, gauge value or histogram count of a metric
+	 */
+	LONG GetValue(MetricId in_Metric) const { return mMetrics[in_Metric].Value; }
+
+	/**
+	 * Summarize
+	 * The statistics of everything recorded in a histogram. Returns false if nothing has been
+	 */
+	bool Summarize(MetricId in_Metric, HistogramSummary& out_Summary) const;
+
+	/**
+	 * GetStats
+	 * The stats file contents: one "Name Value" line per value, with the rates and percentiles over the interval since
+	 * the file was last written. Main thread only
+	 */
+	string GetStats() { return FormatStats(false); }
+
+	/**
+	 * WriteStats
+	 * Write the stats file and start a new interval. Main thread only
+	 */
+	bool WriteStats();
+
+	/**
+	 * GetMetricName / GetMetricType
+	 * How a metric is named in the stats file, and its type
+	 */
+	static const char* GetMetricName(MetricId in_Metric);
+	static MetricType GetMetricType(MetricId in_Metric);
+
+private:
+
+	/**
+	 * Helpers
+	 */
+	string FormatStats(bool in_NewInterval);
+	static bool Summarize(const LONG* in_Buckets, LONG in_Max, HistogramSummary& out_Summary);
+
+	/**
+	 * Singleton implementation
+	 */
+	Metrics();
+	~Metrics();
+	Metrics(const Metrics&);
+	Metrics& operator=(const Metrics&);
+
+	MetricData mMetrics[Metric_MAX];
+	double mInterval;					// Seconds between stats files, 0 to write none
+	double mStartTime;					// Timer seconds when recording started
+	double mLastWriteTime;				// When the stats file was last written
+	unsigned mFrameCount;				// Frames since recording started (main thread only)
+	unsigned mLastFrameCount;			// And when the stats file was last written
+};
+
+// Macros
+#if USE_METRICS
+	#define METRIC_ADD(metric, value) Metrics::Instance()->Add(metric, value);
+	#define METRIC_SET(metric, value) Metrics::Instance()->Set(metric, value);
+	#define METRIC_RECORD(metric, value) Metrics::Instance()->Record(metric, value);
+#else
+	#define METRIC_ADD(metric, value)
+	#define METRIC_SET(metric, value)
+	#define METRIC_RECORD(metric, value)
+#endif // USE_METRICS
+
+#endif // METRICS_H_
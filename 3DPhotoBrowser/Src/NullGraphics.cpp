@@ -0,0 +1,342 @@
+/**
+ * @file NullGraphics.cpp
+ * @brief Headless graphics implementation file
+ */
+
+#include "NullGraphics.h"
+#include "Metrics.h"
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// NullGraphics
+
+void NullGraphics::Init()
+{
+	// Identity transforms until the camera sets them up
+	for(int i = 0; i < 16; i++)
+	{
+		mProjection[i] = mModelview[i] = (i % 5 == 0) ? 1.0 : 0.0;
+	}
+	mViewportSizeX = 1;
+	mViewportSizeY = 1;
+
+	mNextTexture = 1;
+	mTextureCreateCount = 0;
+	mDrawCallCount = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::Shutdown()
+{
+	logf("NullGraphics: %u textures created, %u not freed", mTextureCreateCount, (unsigned)mTextureSizes.size());
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool NullGraphics::GetLastError(string& out_Error)
+{
+	return false;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::SetupViewport(int in_SizeX, int in_SizeY)
+{
+	mViewportSizeX = in_SizeX > 0 ? in_SizeX : 1;
+	mViewportSizeY = in_SizeY > 0 ? in_SizeY : 1;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::SetupProjectionMatrix(float in_FOV, float in_AspectRatio, float in_ClipNear, float in_ClipFar)
+{
+	// gluPerspective
+	double l_F = 1.0 / tan(in_FOV * 0.5 * DEG_TO_RAD);
+	double l_Depth = (double)in_ClipNear - in_ClipFar;
+
+	memset(mProjection, 0, sizeof(mProjection));
+	mProjection[0] = l_F / in_AspectRatio;
+	mProjection[5] = l_F;
+	mProjection[10] = (in_ClipFar + in_ClipNear) / l_Depth;
+	mProjection[11] = 2.0 * in_ClipFar * in_ClipNear / l_Depth;
+	mProjection[14] = -1.0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::SetupCamera(float in_EyeX, float in_EyeY, float in_EyeZ, float in_LookAtX, float in_LookAtY, float in_LookAtZ, float in_UpX, float in_UpY, float in_UpZ)
+{
+	// gluLookAt: the forward direction, then side = forward x up and up = side x forward
+	double l_F[3] = { in_LookAtX - in_EyeX, in_LookAtY - in_EyeY, in_LookAtZ - in_EyeZ };
+	double l_Length = sqrt(l_F[0] * l_F[0] + l_F[1] * l_F[1] + l_F[2] * l_F[2]);
+	if(l_Length == 0)
+	{
+		return;
+	}
+	l_F[0] /= l_Length; l_F[1] /= l_Length; l_F[2] /= l_Length;
+
+	double l_S[3] = { l_F[1] * in_UpZ - l_F[2] * in_UpY, l_F[2] * in_UpX - l_F[0] * in_UpZ, l_F[0] * in_UpY - l_F[1] * in_UpX };
+	l_Length = sqrt(l_S[0] * l_S[0] + l_S[1] * l_S[1] + l_S[2] * l_S[2]);
+	if(l_Length == 0)
+	{
+		return;
+	}
+	l_S[0] /= l_Length; l_S[1] /= l_Length; l_S[2] /= l_Length;
+
+	double l_U[3] = { l_S[1] * l_F[2] - l_S[2] * l_F[1], l_S[2] * l_F[0] - l_S[0] * l_F[2], l_S[0] * l_F[1] - l_S[1] * l_F[0] };
+
+	// The rotation, followed by the translation of the eye to the origin
+	for(int i = 0; i < 3; i++)
+	{
+		mModelview[i] = l_S[i];
+		mModelview[4 + i] = l_U[i];
+		mModelview[8 + i] = -l_F[i];
+		mModelview[12 + i] = 0;
+	}
+	mModelview[3] = -(l_S[0] * in_EyeX + l_S[1] * in_EyeY + l_S[2] * in_EyeZ);
+	mModelview[7] = -(l_U[0] * in_EyeX + l_U[1] * in_EyeY + l_U[2] * in_EyeZ);
+	mModelview[11] = l_F[0] * in_EyeX + l_F[1] * in_EyeY + l_F[2] * in_EyeZ;
+	mModelview[15] = 1;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::Unproject(float in_ScreenX, float in_ScreenY, float in_ScreenZ, float& out_WorldX, float& out_WorldY, float& out_WorldZ)
+{
+	// gluUnProject: window coordinates to normalized device coordinates, back through the inverse transform
+	double l_Transform[16];
+	double l_Inverse[16];
+	Multiply(mProjection, mModelview, l_Transform);
+	if(!Invert(l_Transform, l_Inverse))
+	{
+		out_WorldX = out_WorldY = out_WorldZ = 0;
+		return;
+	}
+
+	double l_In[4] =
+	{
+		2.0 * in_ScreenX / mViewportSizeX - 1.0,
+		2.0 * in_ScreenY / mViewportSizeY - 1.0,
+		2.0 * in_ScreenZ - 1.0,
+		1.0
+	};
+	double l_Out[4];
+	for(int i = 0; i < 4; i++)
+	{
+		l_Out[i] = l_Inverse[i * 4] * l_In[0] + l_Inverse[i * 4 + 1] * l_In[1] + l_Inverse[i * 4 + 2] * l_In[2] + l_Inverse[i * 4 + 3] * l_In[3];
+	}
+	if(l_Out[3] == 0)
+	{
+		out_WorldX = out_WorldY = out_WorldZ = 0;
+		return;
+	}
+
+	out_WorldX = (float)(l_Out[0] / l_Out[3]);
+	out_WorldY = (float)(l_Out[1] / l_Out[3]);
+	out_WorldZ = (float)(l_Out[2] / l_Out[3]);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle NullGraphics::CreateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels)
+{
+	unsigned l_TextureSize = GetTextureDataSize(in_Width, in_Height, in_Format);
+	METRIC_ADD(Metric_TexturesResident, 1)
+	METRIC_ADD(Metric_TextureKB, (l_TextureSize + 1023) / 1024)
+
+	mTextureLock.Lock();
+	TextureHandle l_Handle = mNextTexture++;
+	mTextureSizes[l_Handle] = l_TextureSize;
+	mTextureCreateCount++;
+	mTextureLock.Unlock();
+
+	return l_Handle;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool NullGraphics::SupportsTextureFormat(TextureFormat in_Format)
+{
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureFormat NullGraphics::GetUploadFormat(bool in_Reduced)
+{
+	// The formats a card with ARB_ES2_compatibility takes, so the loader decodes as it would for one
+	return in_Reduced ? TextureFormat_RGB565 : TextureFormat_RGBA;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool NullGraphics::ReserveUpload(unsigned in_Size, UploadSpan& out_Span)
+{
+	// There is no upload buffer, the loader hands over its decoded pixels instead
+	return false;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle NullGraphics::CreateTextureFromUpload(int in_Width, int in_Height, TextureFormat in_Format, const UploadSpan& in_Span)
+{
+	return CreateTexture(in_Width, in_Height, in_Format, in_Span.Data);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::BindTexture(TextureHandle in_Handle)
+{
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::FreeTexture(TextureHandle in_Handle)
+{
+	mTextureLock.Lock();
+	map<TextureHandle, unsigned>::iterator l_Found = mTextureSizes.find(in_Handle);
+	if(l_Found != mTextureSizes.end())
+	{
+		METRIC_ADD(Metric_TexturesResident, -1)
+		METRIC_ADD(Metric_TextureKB, -(LONG)((l_Found->second + 1023) / 1024))
+		mTextureSizes.erase(l_Found);
+	}
+	mTextureLock.Unlock();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::DrawQuadOutline2D(float in_ScreenX, float in_ScreenY, float in_ColorR, float in_ColorG, float in_ColorB, float in_Width, float in_Height)
+{
+	mDrawCallCount++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::DrawQuadOutline(float in_CenterX, float in_CenterY, float in_CenterZ, float in_ColorR, float in_ColorG, float in_ColorB, float in_Width, float in_Height)
+{
+	mDrawCallCount++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ, float in_ColorR, float in_ColorG, float in_ColorB, float in_Width, float in_Height)
+{
+	mDrawCallCount++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ, float in_ColorR, float in_ColorG, float in_ColorB, float in_Width, float in_Height,
+							float in_MinU, float in_MinV, float in_MaxU, float in_MaxV)
+{
+	mDrawCallCount++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::DrawQuads(float* in_Verticies, float* in_TexCoords, unsigned short* in_Indicies, unsigned in_NumQuads)
+{
+	mDrawCallCount++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::ClearBuffers()
+{
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::Flush()
+{
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::EndFrame()
+{
+	METRIC_ADD(Metric_DrawCalls, mDrawCallCount)
+	mDrawCallCount = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void NullGraphics::Multiply(const double* in_A, const double* in_B, double* out_Result)
+{
+	for(int l_Row = 0; l_Row < 4; l_Row++)
+	{
+		for(int l_Column = 0; l_Column < 4; l_Column++)
+		{
+			out_Result[l_Row * 4 + l_Column] = in_A[l_Row * 4] * in_B[l_Column] + in_A[l_Row * 4 + 1] * in_B[4 + l_Column] +
+											   in_A[l_Row * 4 + 2] * in_B[8 + l_Column] + in_A[l_Row * 4 + 3] * in_B[12 + l_Column];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool NullGraphics::Invert(const double* in_Matrix, double* out_Inverse)
+{
+	// Gauss-Jordan elimination with partial pivoting, on a copy of the matrix alongside the identity
+	double l_Work[4][8];
+	for(int i = 0; i < 4; i++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			l_Work[i][j] = in_Matrix[i * 4 + j];
+			l_Work[i][4 + j] = (i == j) ? 1.0 : 0.0;
+		}
+	}
+
+	for(int l_Column = 0; l_Column < 4; l_Column++)
+	{
+		// Bring up the row with the largest value in this column
+		int l_Pivot = l_Column;
+		for(int i = l_Column + 1; i < 4; i++)
+		{
+			if(fabs(l_Work[i][l_Column]) > fabs(l_Work[l_Pivot][l_Column]))
+			{
+				l_Pivot = i;
+			}
+		}
+		if(l_Work[l_Pivot][l_Column] == 0)
+		{
+			return false;
+		}
+		if(l_Pivot != l_Column)
+		{
+			for(int j = 0; j < 8; j++)
+			{
+				swap(l_Work[l_Pivot][j], l_Work[l_Column][j]);
+			}
+		}
+
+		// Scale it to a leading one, then clear the column from every other row
+		double l_Scale = 1.0 / l_Work[l_Column][l_Column];
+		for(int j = 0; j < 8; j++)
+		{
+			l_Work[l_Column][j] *= l_Scale;
+		}
+		for(int i = 0; i < 4; i++)
+		{
+			if(i != l_Column && l_Work[i][l_Column] != 0)
+			{
+				double l_Factor = l_Work[i][l_Column];
+				for(int j = 0; j < 8; j++)
+				{
+					l_Work[i][j] -= l_Factor * l_Work[l_Column][j];
+				}
+			}
+		}
+	}
+
+	for(int i = 0; i < 4; i++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			out_Inverse[i * 4 + j] = l_Work[i][4 + j];
+		}
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file NullGraphics.h
+ * @brief Headless graphics class file
+ */
+
+#ifndef NULLGRAPHICS_H_
+#define NULLGRAPHICS_H_
+
+#include "Graphics.h"
+#include "Semaphore.h"
+
+/**
+ * NullGraphics
+ * A Graphics implementation that draws nothing, for running the browser headless. Textures are handles with only their
+ * size kept, and draws are only counted. The camera transforms are kept in software, exactly as OpenGL builds them,
+ * so Unproject gives the same answers the OpenGL renderer does
+ */
+class NullGraphics : public Graphics
+{
+public:
+
+	/**
+	 * Graphics interface
+	 */
+	virtual void Init();
+	virtual void Shutdown();
+	virtual bool GetLastError(string& out_Error);
+	virtual void SetupViewport(int in_SizeX, int in_SizeY);
+	virtual void SetupProjectionMatrix(float in_FOV, float in_AspectRatio, float in_ClipNear, float in_ClipFar);
+	virtual void SetupCamera(float in_EyeX, float in_EyeY, float in_EyeZ,
+							 float in_LookAtX, float in_LookAtY, float in_LookAtZ,
+							 float in_UpX, float in_UpY, float in_UpZ);
+	virtual void Unproject(float in_ScreenX, float in_ScreenY, float in_ScreenZ, float& out_WorldX, float& out_WorldY, float& out_WorldZ);
+	virtual TextureHandle CreateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels);
+	virtual bool SupportsTextureFormat(TextureFormat in_Format);
+	virtual TextureFormat GetUploadFormat(bool in_Reduced);
+	virtual bool ReserveUpload(unsigned in_Size, UploadSpan& out_Span);
+	virtual TextureHandle CreateTextureFromUpload(int in_Width, int in_Height, TextureFormat in_Format, const UploadSpan& in_Span);
+	virtual void BindTexture(TextureHandle in_Handle);
+	virtual void FreeTexture(TextureHandle in_Handle);
+	virtual void DrawQuadOutline2D(float in_ScreenX, float in_ScreenY,
+								   float in_ColorR, float in_ColorG, float in_ColorB,
+								   float in_Width, float in_Height);
+	virtual void DrawQuadOutline(float in_CenterX, float in_CenterY, float in_CenterZ,
+								 float in_ColorR, float in_ColorG, float in_ColorB,
+								 float in_Width, float in_Height);
+	virtual void DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ,
+						  float in_ColorR, float in_ColorG, float in_ColorB,
+						  float in_Width, float in_Height);
+	virtual void DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ,
+						  float in_ColorR, float in_ColorG, float in_ColorB,
+						  float in_Width, float in_Height,
+						  float in_MinU, float in_MinV, float in_MaxU, float in_MaxV);
+	virtual void DrawQuads(float* in_Verticies, float* in_TexCoords, unsigned short* in_Indicies, unsigned in_NumQuads);
+	virtual void ClearBuffers();
+	virtual void Flush();
+	virtual void EndFrame();
+
+private:
+
+	/**
+	 * Helpers
+	 */
+	static void Multiply(const double* in_A, const double* in_B, double* out_Result);
+	static bool Invert(const double* in_Matrix, double* out_Inverse);
+
+	// Transforms, row major, as gluPerspective and gluLookAt would build them
+	double mProjection[16];
+	double mModelview[16];
+	int mViewportSizeX;
+	int mViewportSizeY;
+
+	// Textures are created and freed from both the main and the texture loading thread
+	Semaphore mTextureLock;
+	map<TextureHandle, unsigned> mTextureSizes;		// Bytes of texture data of every texture not yet freed
+	TextureHandle mNextTexture;
+	unsigned mTextureCreateCount;
+
+	unsigned mDrawCallCount;						// Draws issued this frame (main thread only)
+};
+
+#endif // NULLGRAPHICS_H_
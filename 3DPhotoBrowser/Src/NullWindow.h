@@ -0,0 +1,47 @@
+/**
+ * @file NullWindow.h
+ * @brief Headless window class header file
+ */
+
+#ifndef NULLWINDOW_H_
+#define NULLWINDOW_H_
+
+#include "Window.h"
+
+/**
+ * NullWindow
+ * A window that is never shown and never receives any input, for running the browser headless. Its OpenGL contexts
+ * are handles with nothing behind them, so it must be paired with the NullGraphics renderer
+ */
+class NullWindow : public Window
+{
+public:
+
+	/**
+	 * Constructor
+	 */
+	NullWindow() : mContextCount(0) {}
+
+	/**
+	 * Window interface
+	 */
+	virtual bool Init(const string& in_Title, int in_SizeX, int in_SizeY) { return true; }
+	virtual void SetTitle(const string& in_Title) {}
+	virtual	bool Destroy() { return true; }
+	virtual void ProcessMessages() {}
+	virtual void SwapBuffers() {}
+	virtual void EnableVerticalSync(bool in_Enable) {}
+	virtual void TranslateKey(unsigned& in_Key) {}
+	virtual void ShowUserPreferencesDialog(bool in_Show) {}
+	virtual bool IsUserPreferencesDialogVisible() { return false; }
+	virtual GLContext CreateGLContext() { return ++mContextCount; }
+	virtual bool ShareGLContexts(GLContext in_Context1, GLContext in_Context2) { return true; }
+	virtual bool AcquireGLContext(GLContext in_Context) { return true; }
+	virtual bool ReleaseGLContext(GLContext in_Context) { return true; }
+
+private:
+
+	unsigned mContextCount;		// Contexts handed out, so each gets a handle of its own
+};
+
+#endif // NULLWINDOW_H_
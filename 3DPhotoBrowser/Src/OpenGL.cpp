@@ -4,9 +4,62 @@
  */
 
 #include "OpenGL.h"
+#include "Metrics.h"
 #include <GL/GL.h>
 #include <GL/GLU.h>
 
+// OpenGL 1.2 packed pixels, which the Windows headers stop short of
+#ifndef GL_UNSIGNED_SHORT_5_6_5
+	#define GL_UNSIGNED_SHORT_5_6_5 0x8363
+#endif // GL_UNSIGNED_SHORT_5_6_5
+
+// The 5:6:5 sized internal format, from ARB_ES2_compatibility. GL_RGB5 is 5:5:5 and makes drivers convert the pixels
+#ifndef GL_RGB565
+	#define GL_RGB565 0x8D62
+#endif // GL_RGB565
+
+// S3TC compressed formats, from EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+	#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+
+// OpenGL 1.3 compressed texture uploads, fetched from the driver at run time
+typedef void (APIENTRY* CompressedTexImage2DFunction)(GLenum in_Target, GLint in_Level, GLenum in_InternalFormat, GLsizei in_Width, GLsizei in_Height,
+													   GLint in_Border, GLsizei in_ImageSize, const GLvoid* in_Data);
+typedef void (APIENTRY* CompressedTexSubImage2DFunction)(GLenum in_Target, GLint in_Level, GLint in_OffsetX, GLint in_OffsetY, GLsizei in_Width,
+														  GLsizei in_Height, GLenum in_Format, GLsizei in_ImageSize, const GLvoid* in_Data);
+
+// Pixel buffer objects, persistent mappings and fences, from OpenGL 3.2 and ARB_buffer_storage
+#ifndef GL_PIXEL_UNPACK_BUFFER
+	#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif // GL_PIXEL_UNPACK_BUFFER
+#ifndef GL_MAP_PERSISTENT_BIT
+	#define GL_MAP_WRITE_BIT 0x0002
+	#define GL_MAP_PERSISTENT_BIT 0x0040
+	#define GL_MAP_COHERENT_BIT 0x0080
+#endif // GL_MAP_PERSISTENT_BIT
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+	#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+	#define GL_ALREADY_SIGNALED 0x911A
+	#define GL_CONDITION_SATISFIED 0x911C
+#endif // GL_SYNC_GPU_COMMANDS_COMPLETE
+
+typedef void (APIENTRY* GenBuffersFunction)(GLsizei in_Count, GLuint* out_Buffers);
+typedef void (APIENTRY* BindBufferFunction)(GLenum in_Target, GLuint in_Buffer);
+typedef void (APIENTRY* DeleteBuffersFunction)(GLsizei in_Count, const GLuint* in_Buffers);
+typedef void (APIENTRY* BufferStorageFunction)(GLenum in_Target, ptrdiff_t in_Size, const GLvoid* in_Data, GLbitfield in_Flags);
+typedef GLvoid* (APIENTRY* MapBufferRangeFunction)(GLenum in_Target, ptrdiff_t in_Offset, ptrdiff_t in_Length, GLbitfield in_Access);
+typedef void* (APIENTRY* FenceSyncFunction)(GLenum in_Condition, GLbitfield in_Flags);
+typedef GLenum (APIENTRY* ClientWaitSyncFunction)(void* in_Sync, GLbitfield in_Flags, ULONGLONG in_Timeout);
+typedef void (APIENTRY* DeleteSyncFunction)(void* in_Sync);
+
+/**
+ * UPLOAD_ALIGNMENT
+ * Upload buffer spans start on a cache line, so the loader thread's copies into them don't share lines
+ */
+#define UPLOAD_ALIGNMENT 64
+
 // Debugging
 #ifdef DEBUG
 	#define CHECK_ERRORS { if(glGetError() != GL_NO_ERROR) { assert(false); } }
@@ -14,6 +67,50 @@
 	#define CHECK_ERRORS
 #endif // DEBUG
 
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetGLFormats
+ * OpenGL internal format, pixel format and pixel type for a texture format. Compressed formats only have an internal format
+ */
+static void GetGLFormats(TextureFormat in_Format, GLint& out_InternalFormat, GLenum& out_Format, GLenum& out_Type)
+{
+	out_Format = 0;
+	out_Type = GL_UNSIGNED_BYTE;
+	switch(in_Format)
+	{
+	// Sized internal formats, so the driver doesn't pick a layout that needs the pixels converted
+	case TextureFormat_RGB:
+
+		out_InternalFormat = GL_RGB8;
+		out_Format = GL_RGB;
+		break;
+
+	case TextureFormat_RGBA:
+
+		out_InternalFormat = GL_RGBA8;
+		out_Format = GL_RGBA;
+		break;
+
+	case TextureFormat_RGB565:
+
+		out_InternalFormat = GL_RGB565;
+		out_Format = GL_RGB;
+		out_Type = GL_UNSIGNED_SHORT_5_6_5;
+		break;
+
+	case TextureFormat_BC1:
+
+		out_InternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		break;
+
+	case TextureFormat_BC3:
+
+		out_InternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	}
+}
+
 //-----------------------------------------------------------------------------------------------------------------------------
 // OpenGL
 
@@ -36,13 +133,118 @@ void OpenGL::Init()
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
+	// Compressed textures need the extension and the upload entry points
+	const char* l_Extensions = (const char*)glGetString(GL_EXTENSIONS);
+	mSupportsS3TC = l_Extensions && strstr(l_Extensions, "GL_EXT_texture_compression_s3tc") != NULL;
+#ifdef WIN32
+	mCompressedTexImage2D = wglGetProcAddress("glCompressedTexImage2D");
+	mCompressedTexSubImage2D = wglGetProcAddress("glCompressedTexSubImage2D");
+	if(!mCompressedTexImage2D || !mCompressedTexSubImage2D)
+	{
+		mCompressedTexImage2D = wglGetProcAddress("glCompressedTexImage2DARB");
+		mCompressedTexSubImage2D = wglGetProcAddress("glCompressedTexSubImage2DARB");
+	}
+	mSupportsS3TC = mSupportsS3TC && mCompressedTexImage2D != NULL && mCompressedTexSubImage2D != NULL;
+#else
+	#error Your platform extension function lookup goes here
+#endif // WIN32
+	logf("OpenGL: S3TC texture compression %s", mSupportsS3TC ? "supported" : "not supported");
+
+	// 16 bit textures are only worth it where the card keeps them as 5:6:5, otherwise every upload is converted
+	mSupportsRGB565 = l_Extensions && strstr(l_Extensions, "GL_ARB_ES2_compatibility") != NULL;
+	logf("OpenGL: RGB565 textures %s", mSupportsRGB565 ? "supported" : "not supported");
+
+	// Textures of each size and format are allocated in groups and reused
+	mTexturePoolSize = (unsigned)max(0, UserPreferences::Instance()->TexturePoolSize()) * 1024;
+	mTextureAllocationCount = 0;
+	mTextureUploadCount = 0;
+	mDrawCallCount = 0;
+
+	InitUploadBuffer();
+
 	CHECK_ERRORS;
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
+void OpenGL::InitUploadBuffer()
+{
+	mUploadBuffer = 0;
+	mUploadData = NULL;
+	mUploadSize = (unsigned)max(0, UserPreferences::Instance()->StreamingUploadBufferSize()) * 1024;
+	mUploadWrite = 0;
+	mUploadHead = 0;
+	mUploadTail = 0;
+	mUploadUsed = 0;
+	mUploadFenced = 0;
+	mStreamedUploadCount = 0;
+	mUploadFullCount = 0;
+	if(mUploadSize == 0)
+	{
+		return;
+	}
+
+	// The buffer is mapped once and written while the card reads from it, which needs persistent coherent mappings
+	const char* l_Extensions = (const char*)glGetString(GL_EXTENSIONS);
+	bool l_Supported = l_Extensions && strstr(l_Extensions, "GL_ARB_buffer_storage") != NULL;
+#ifdef WIN32
+	mGenBuffers = wglGetProcAddress("glGenBuffers");
+	mBindBuffer = wglGetProcAddress("glBindBuffer");
+	mDeleteBuffers = wglGetProcAddress("glDeleteBuffers");
+	mBufferStorage = wglGetProcAddress("glBufferStorage");
+	mMapBufferRange = wglGetProcAddress("glMapBufferRange");
+	mFenceSync = wglGetProcAddress("glFenceSync");
+	mClientWaitSync = wglGetProcAddress("glClientWaitSync");
+	mDeleteSync = wglGetProcAddress("glDeleteSync");
+	l_Supported = l_Supported && mGenBuffers && mBindBuffer && mDeleteBuffers && mBufferStorage && mMapBufferRange && mFenceSync &&
+				  mClientWaitSync && mDeleteSync;
+#else
+	#error Your platform extension function lookup goes here
+#endif // WIN32
+	if(!l_Supported)
+	{
+		logf("OpenGL: streaming uploads not supported");
+		return;
+	}
+
+	GLbitfield l_Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	((GenBuffersFunction)mGenBuffers)(1, &mUploadBuffer);
+	((BindBufferFunction)mBindBuffer)(GL_PIXEL_UNPACK_BUFFER, mUploadBuffer);
+	((BufferStorageFunction)mBufferStorage)(GL_PIXEL_UNPACK_BUFFER, mUploadSize, NULL, l_Flags);
+	mUploadData = (unsigned char*)((MapBufferRangeFunction)mMapBufferRange)(GL_PIXEL_UNPACK_BUFFER, 0, mUploadSize, l_Flags);
+	((BindBufferFunction)mBindBuffer)(GL_PIXEL_UNPACK_BUFFER, 0);
+	if(!mUploadData)
+	{
+		logf("OpenGL: couldn't map a %u KB upload buffer, streaming uploads off", mUploadSize / 1024);
+		((DeleteBuffersFunction)mDeleteBuffers)(1, &mUploadBuffer);
+		mUploadBuffer = 0;
+		return;
+	}
+	logf("OpenGL: streaming uploads through a %u KB buffer", mUploadSize / 1024);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
 void OpenGL::Shutdown()
 {
+	logf("OpenGL: %u textures allocated, %u uploads into pooled textures, %u texture sizes", mTextureAllocationCount, mTextureUploadCount,
+		 (unsigned)mTexturePools.size());
+
+	if(mUploadBuffer)
+	{
+		logf("OpenGL: %u textures streamed through the upload buffer, %u sent the slow way because it was full", mStreamedUploadCount,
+			 mUploadFullCount);
+
+		// Deleting the buffer unmaps it
+		for(unsigned i = 0; i < mUploadFences.size(); i++)
+		{
+			((DeleteSyncFunction)mDeleteSync)(mUploadFences[i].Sync);
+		}
+		mUploadFences.clear();
+		((DeleteBuffersFunction)mDeleteBuffers)(1, &mUploadBuffer);
+		mUploadBuffer = 0;
+		mUploadData = NULL;
+	}
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -127,6 +329,64 @@ void OpenGL::Unproject(float in_ScreenX, float in_ScreenY, float in_ScreenZ, flo
 //-----------------------------------------------------------------------------------------------------------------------------
 
 TextureHandle OpenGL::CreateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels)
+{
+	return CreatePooledTexture(in_Width, in_Height, in_Format, in_Pixels, 0);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle OpenGL::CreatePooledTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels, unsigned in_UnpackBuffer)
+{
+	TextureKey l_Key;
+	l_Key.Width = in_Width;
+	l_Key.Height = in_Height;
+	l_Key.Format = in_Format;
+	unsigned l_TextureSize = GetTextureDataSize(in_Width, in_Height, in_Format);
+	METRIC_ADD(Metric_TexturesResident, 1)
+	METRIC_ADD(Metric_TextureKB, (l_TextureSize + 1023) / 1024)
+
+	if(mTexturePoolSize == 0)
+	{
+		// Pooling is off, every texture gets storage of its own along with its pixels. Its key is still kept, so
+		// freeing it can account for its size
+		TextureHandle l_Handle = AllocateTexture(in_Width, in_Height, in_Format, in_Pixels, in_UnpackBuffer);
+		mTextureLock.Lock();
+		mTextureKeys[l_Handle] = l_Key;
+		mTexturePools[l_Key].Allocated++;
+		mTextureAllocationCount++;
+		mTextureLock.Unlock();
+		return l_Handle;
+	}
+
+	mTextureLock.Lock();
+	TexturePool& l_Pool = mTexturePools[l_Key];
+	if(l_Pool.Free.empty())
+	{
+		// Grow the pool, doubling each time until a growth would pass the pool size. Sizes that only turn up
+		// once or twice don't hold much storage
+		unsigned l_Count = max(1u, min(l_Pool.Allocated, mTexturePoolSize / l_TextureSize));
+		for(unsigned i = 0; i < l_Count; i++)
+		{
+			TextureHandle l_Handle = AllocateTexture(in_Width, in_Height, in_Format, NULL, 0);
+			l_Pool.Free.push_back(l_Handle);
+			mTextureKeys[l_Handle] = l_Key;
+		}
+		l_Pool.Allocated += l_Count;
+		mTextureAllocationCount += l_Count;
+	}
+	TextureHandle l_Handle = l_Pool.Free.back();
+	l_Pool.Free.pop_back();
+	mTextureUploadCount++;
+	mTextureLock.Unlock();
+
+	// Only the pixels go up, the storage is already there
+	UploadTexture(l_Handle, in_Width, in_Height, in_Format, in_Pixels, in_UnpackBuffer);
+	return l_Handle;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle OpenGL::AllocateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels, unsigned in_UnpackBuffer)
 {
 	TextureHandle l_TextureHandle;
 
@@ -142,28 +402,129 @@ TextureHandle OpenGL::CreateTexture(int in_Width, int in_Height, TextureFormat i
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 
-	// Fill texture memory
-	int l_BytesPerPixel = 0;
-	int l_GLFormat = 0;
-	switch(in_Format)
+	// Fill texture memory, or just allocate it when there are no pixels
+	GLint l_InternalFormat;
+	GLenum l_GLFormat;
+	GLenum l_GLType;
+	GetGLFormats(in_Format, l_InternalFormat, l_GLFormat, l_GLType);
+	if(in_UnpackBuffer)
 	{
-	case TextureFormat_RGB:
+		((BindBufferFunction)mBindBuffer)(GL_PIXEL_UNPACK_BUFFER, in_UnpackBuffer);
+	}
+	if(IsCompressedTextureFormat(in_Format))
+	{
+		// The blocks go up as they are. Sizes that aren't a multiple of 4 end in part used blocks
+		assert(mSupportsS3TC && "Compressed texture created without driver support");
+		((CompressedTexImage2DFunction)mCompressedTexImage2D)(GL_TEXTURE_2D, 0, l_InternalFormat, in_Width, in_Height, 0,
+															   GetTextureDataSize(in_Width, in_Height, in_Format), in_Pixels);
+	}
+	else
+	{
+		// Rows are tightly packed, whatever their width
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, l_InternalFormat, in_Width, in_Height, 0, l_GLFormat, l_GLType, in_Pixels);
+	}
+	if(in_UnpackBuffer)
+	{
+		((BindBufferFunction)mBindBuffer)(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 
-		l_BytesPerPixel = 3;
-		l_GLFormat = GL_RGB;
-		break;
+	CHECK_ERRORS;
+	return l_TextureHandle;
+}
 
-	case TextureFormat_RGBA:
+//-----------------------------------------------------------------------------------------------------------------------------
 
-		l_BytesPerPixel = 4;
-		l_GLFormat = GL_RGBA;
-		break;
-	}
+void OpenGL::UploadTexture(TextureHandle in_Handle, int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels,
+						   unsigned in_UnpackBuffer)
+{
+	GLint l_InternalFormat;
+	GLenum l_GLFormat;
+	GLenum l_GLType;
+	GetGLFormats(in_Format, l_InternalFormat, l_GLFormat, l_GLType);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, l_BytesPerPixel, in_Width, in_Height, 0, l_GLFormat, GL_UNSIGNED_BYTE, in_Pixels);
+	// From a pixel buffer object the update is queued and the card copies the pixels when it gets to it
+	glBindTexture(GL_TEXTURE_2D, in_Handle);
+	if(in_UnpackBuffer)
+	{
+		((BindBufferFunction)mBindBuffer)(GL_PIXEL_UNPACK_BUFFER, in_UnpackBuffer);
+	}
+	if(IsCompressedTextureFormat(in_Format))
+	{
+		((CompressedTexSubImage2DFunction)mCompressedTexSubImage2D)(GL_TEXTURE_2D, 0, 0, 0, in_Width, in_Height, l_InternalFormat,
+																	 GetTextureDataSize(in_Width, in_Height, in_Format), in_Pixels);
+	}
+	else
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, in_Width, in_Height, l_GLFormat, l_GLType, in_Pixels);
+	}
+	if(in_UnpackBuffer)
+	{
+		((BindBufferFunction)mBindBuffer)(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 
 	CHECK_ERRORS;
-	return l_TextureHandle;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OpenGL::SupportsTextureFormat(TextureFormat in_Format)
+{
+	return !IsCompressedTextureFormat(in_Format) || mSupportsS3TC;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureFormat OpenGL::GetUploadFormat(bool in_Reduced)
+{
+	// Cards store RGB as four bytes a pixel, so padded RGBA goes up as it is. RGB565 is stored as it comes
+	return in_Reduced && mSupportsRGB565 ? TextureFormat_RGB565 : TextureFormat_RGBA;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OpenGL::ReserveUpload(unsigned in_Size, UploadSpan& out_Span)
+{
+	if(!mUploadBuffer)
+	{
+		return false;
+	}
+
+	// A span that doesn't fit before the end of the buffer starts again at the beginning, skipping the rest
+	unsigned l_Size = (in_Size + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+	mUploadLock.Lock();
+	unsigned l_Offset = mUploadWrite;
+	unsigned l_Skip = l_Offset + l_Size > mUploadSize ? mUploadSize - l_Offset : 0;
+	if(l_Size > mUploadSize || mUploadHead + l_Skip + l_Size - mUploadTail > mUploadSize)
+	{
+		mUploadFullCount++;
+		mUploadLock.Unlock();
+		return false;
+	}
+	if(l_Skip)
+	{
+		l_Offset = 0;
+	}
+	mUploadHead += l_Skip + l_Size;
+	mUploadWrite = (l_Offset + l_Size) % mUploadSize;
+	out_Span.End = mUploadHead;
+	mUploadLock.Unlock();
+
+	out_Span.Offset = l_Offset;
+	out_Span.Data = mUploadData + l_Offset;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle OpenGL::CreateTextureFromUpload(int in_Width, int in_Height, TextureFormat in_Format, const UploadSpan& in_Span)
+{
+	// The pixels pointer is an offset into the bound upload buffer
+	TextureHandle l_Handle = CreatePooledTexture(in_Width, in_Height, in_Format, (const unsigned char*)NULL + in_Span.Offset, mUploadBuffer);
+	mUploadUsed = in_Span.End;
+	mStreamedUploadCount++;
+	return l_Handle;
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -178,6 +539,27 @@ void OpenGL::BindTexture(TextureHandle in_Handle)
 
 void OpenGL::FreeTexture(TextureHandle in_Handle)
 {
+	// A pooled texture goes back to its pool, unless the pool already holds its size in free textures
+	mTextureLock.Lock();
+	map<TextureHandle, TextureKey>::iterator l_Found = mTextureKeys.find(in_Handle);
+	if(l_Found != mTextureKeys.end())
+	{
+		const TextureKey& l_Key = l_Found->second;
+		TexturePool& l_Pool = mTexturePools[l_Key];
+		unsigned l_TextureSize = GetTextureDataSize(l_Key.Width, l_Key.Height, l_Key.Format);
+		METRIC_ADD(Metric_TexturesResident, -1)
+		METRIC_ADD(Metric_TextureKB, -(LONG)((l_TextureSize + 1023) / 1024))
+		if((l_Pool.Free.size() + 1) * l_TextureSize <= mTexturePoolSize)
+		{
+			l_Pool.Free.push_back(in_Handle);
+			mTextureLock.Unlock();
+			return;
+		}
+		l_Pool.Allocated--;
+		mTextureKeys.erase(l_Found);
+	}
+	mTextureLock.Unlock();
+
 	glDeleteTextures(1, &in_Handle);
 	CHECK_ERRORS;
 }
@@ -223,6 +605,14 @@ void OpenGL::DrawQuadOutline2D(float in_ScreenX, float in_ScreenY, float in_Colo
 //-----------------------------------------------------------------------------------------------------------------------------
 
 void OpenGL::DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ, float in_ColorR, float in_ColorG, float in_ColorB, float in_Width, float in_Height)
+{
+	DrawQuad(in_CenterX, in_CenterY, in_CenterZ, in_ColorR, in_ColorG, in_ColorB, in_Width, in_Height, 0, 0, 1, 1);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OpenGL::DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ, float in_ColorR, float in_ColorG, float in_ColorB, float in_Width, float in_Height,
+					  float in_MinU, float in_MinV, float in_MaxU, float in_MaxV)
 {
 	float l_HalfWidth = in_Width * 0.5f;
 	float l_HalfHeight = in_Height * 0.5f;
@@ -232,12 +622,13 @@ void OpenGL::DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ, floa
 	float l_Bottom = -l_HalfHeight + in_CenterY;
 
 
+	mDrawCallCount++;
 	glColor3f(in_ColorR, in_ColorG, in_ColorB);
 	glBegin(GL_QUADS);
-		glTexCoord2f(0, 1); glVertex3f(l_Left,  l_Top,    in_CenterZ); // Top left
-		glTexCoord2f(0, 0); glVertex3f(l_Left,  l_Bottom, in_CenterZ); // Bottom left
-		glTexCoord2f(1, 0); glVertex3f(l_Right, l_Bottom, in_CenterZ); // Bottom right
-		glTexCoord2f(1, 1); glVertex3f(l_Right, l_Top,    in_CenterZ); // Top right
+		glTexCoord2f(in_MinU, in_MaxV); glVertex3f(l_Left,  l_Top,    in_CenterZ); // Top left
+		glTexCoord2f(in_MinU, in_MinV); glVertex3f(l_Left,  l_Bottom, in_CenterZ); // Bottom left
+		glTexCoord2f(in_MaxU, in_MinV); glVertex3f(l_Right, l_Bottom, in_CenterZ); // Bottom right
+		glTexCoord2f(in_MaxU, in_MaxV); glVertex3f(l_Right, l_Top,    in_CenterZ); // Top right
 	glEnd();	
 }
 
@@ -256,6 +647,7 @@ void OpenGL::DrawQuadOutline(float in_CenterX, float in_CenterY, float in_Center
 	glPolygonMode(GL_FRONT, GL_LINE);	// Draw outline only
 	glDisable(GL_TEXTURE_2D);			// Do not texture the outline
 
+	mDrawCallCount++;
 	glColor3f(in_ColorR, in_ColorG, in_ColorB);
 	glBegin(GL_QUADS);
 		glTexCoord2f(0, 1); glVertex3f(l_Left,  l_Top,    in_CenterZ); // Top left
@@ -270,6 +662,7 @@ void OpenGL::DrawQuadOutline(float in_CenterX, float in_CenterY, float in_Center
 
 void OpenGL::DrawQuads(float* in_Verticies, float* in_TexCoords, unsigned short* in_Indicies, unsigned in_NumQuads)
 {
+	mDrawCallCount++;
 	glVertexPointer(4, GL_FLOAT, 0, in_Verticies);
 	glTexCoordPointer(2, GL_FLOAT, 0, in_TexCoords);
 	glDrawElements(GL_QUADS, in_NumQuads, GL_UNSIGNED_SHORT, in_Indicies);
@@ -290,3 +683,42 @@ void OpenGL::Flush()
 	glFlush();
 	CHECK_ERRORS;
 }
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OpenGL::EndFrame()
+{
+	METRIC_ADD(Metric_DrawCalls, mDrawCallCount)
+	mDrawCallCount = 0;
+
+	if(!mUploadBuffer)
+	{
+		return;
+	}
+
+	// Fence the updates issued this frame, the space they read from can't be written until the card is past them
+	if(mUploadUsed != mUploadFenced)
+	{
+		UploadFence l_Fence;
+		l_Fence.Sync = ((FenceSyncFunction)mFenceSync)(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		l_Fence.End = mUploadUsed;
+		mUploadFences.push_back(l_Fence);
+		mUploadFenced = mUploadUsed;
+	}
+
+	// Release the space of every earlier frame that has finished, without waiting for the rest
+	while(!mUploadFences.empty())
+	{
+		GLenum l_Result = ((ClientWaitSyncFunction)mClientWaitSync)(mUploadFences.front().Sync, 0, 0);
+		if(l_Result != GL_ALREADY_SIGNALED && l_Result != GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+		((DeleteSyncFunction)mDeleteSync)(mUploadFences.front().Sync);
+		mUploadLock.Lock();
+		mUploadTail = mUploadFences.front().End;
+		mUploadLock.Unlock();
+		mUploadFences.pop_front();
+	}
+	CHECK_ERRORS;
+}
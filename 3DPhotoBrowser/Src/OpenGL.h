@@ -7,6 +7,7 @@
 #define OPENGL_H_
 
 #include "Graphics.h"
+#include "Semaphore.h"
 
 /**
  * OpenGL
@@ -14,6 +15,48 @@
  */
 class OpenGL : public Graphics
 {
+	/**
+	 * TextureKey
+	 * Size and format shared by the textures of a pool
+	 */
+	struct TextureKey
+	{
+		bool operator<(const TextureKey& in_Other) const
+		{
+			if(Width != in_Other.Width)
+				return Width < in_Other.Width;
+			if(Height != in_Other.Height)
+				return Height < in_Other.Height;
+			return Format < in_Other.Format;
+		}
+
+		int Width;
+		int Height;
+		TextureFormat Format;
+	};
+
+	/**
+	 * TexturePool
+	 * Textures of one size and format, with storage allocated, waiting to be filled
+	 */
+	struct TexturePool
+	{
+		TexturePool() : Allocated(0) {}
+
+		vector<TextureHandle> Free;
+		unsigned Allocated;			// Textures allocated for the pool, free or in use
+	};
+
+	/**
+	 * UploadFence
+	 * Fence placed after the uploads of a frame, and the upload stream position released when it signals
+	 */
+	struct UploadFence
+	{
+		void* Sync;					// GLsync
+		unsigned End;
+	};
+
 	/**
 	 * Graphics interface
 	 */
@@ -31,6 +74,10 @@ class OpenGL : public Graphics
 	virtual void Unproject(float in_ScreenX, float in_ScreenY, float in_ScreenZ, float& out_WorldX, float& out_WorldY, float& out_WorldZ);
 
 	virtual TextureHandle CreateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels);
+	virtual bool SupportsTextureFormat(TextureFormat in_Format);
+	virtual TextureFormat GetUploadFormat(bool in_Reduced);
+	virtual bool ReserveUpload(unsigned in_Size, UploadSpan& out_Span);
+	virtual TextureHandle CreateTextureFromUpload(int in_Width, int in_Height, TextureFormat in_Format, const UploadSpan& in_Span);
 	virtual void BindTexture(TextureHandle in_Handle);
 	virtual void FreeTexture(TextureHandle in_Handle);
 
@@ -42,6 +89,11 @@ class OpenGL : public Graphics
 						  float in_ColorR, float in_ColorG, float in_ColorB, 
 						  float in_Width, float in_Height);
 
+	virtual void DrawQuad(float in_CenterX, float in_CenterY, float in_CenterZ,
+						  float in_ColorR, float in_ColorG, float in_ColorB, 
+						  float in_Width, float in_Height,
+						  float in_MinU, float in_MinV, float in_MaxU, float in_MaxV);
+
 	//NEW/MATTHEW
 	virtual void DrawQuadOutline(float in_CenterX, float in_CenterY, float in_CenterZ,
 						  float in_ColorR, float in_ColorG, float in_ColorB, 
@@ -51,6 +103,73 @@ class OpenGL : public Graphics
 
 	virtual void ClearBuffers();
 	virtual void Flush();
+	virtual void EndFrame();
+
+	/**
+	 * CreatePooledTexture
+	 * CreateTexture, reading the pixels from in_UnpackBuffer when it isn't 0, in which case in_Pixels is an offset into it
+	 */
+	TextureHandle CreatePooledTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels, unsigned in_UnpackBuffer);
+
+	/**
+	 * InitUploadBuffer
+	 * Create the persistently mapped upload buffer, if the driver can
+	 */
+	void InitUploadBuffer();
+
+	/**
+	 * AllocateTexture
+	 * Create a texture with storage for the size and format, filled with in_Pixels if they aren't NULL
+	 */
+	TextureHandle AllocateTexture(int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels, unsigned in_UnpackBuffer);
+
+	/**
+	 * UploadTexture
+	 * Replace all the pixels of an allocated texture with a sub-image update, which doesn't allocate
+	 */
+	void UploadTexture(TextureHandle in_Handle, int in_Width, int in_Height, TextureFormat in_Format, const unsigned char* in_Pixels,
+					   unsigned in_UnpackBuffer);
+
+	bool mSupportsS3TC;					// EXT_texture_compression_s3tc, for BC1 and BC3 textures
+	bool mSupportsRGB565;				// ARB_ES2_compatibility, for RGB565 textures
+#ifdef WIN32
+	PROC mCompressedTexImage2D;			// glCompressedTexImage2D and glCompressedTexSubImage2D, which opengl32.lib doesn't export
+	PROC mCompressedTexSubImage2D;
+
+	// Buffer objects and fences for the upload buffer, from OpenGL 3.2 and ARB_buffer_storage
+	PROC mGenBuffers;
+	PROC mBindBuffer;
+	PROC mDeleteBuffers;
+	PROC mBufferStorage;
+	PROC mMapBufferRange;
+	PROC mFenceSync;
+	PROC mClientWaitSync;
+	PROC mDeleteSync;
+#endif // WIN32
+
+	// Textures are created and freed from both the main and the texture loading thread
+	Semaphore mTextureLock;
+	map<TextureKey, TexturePool> mTexturePools;
+	map<TextureHandle, TextureKey> mTextureKeys;		// Size and format of every texture, which is its pool when pooling is on
+	unsigned mTexturePoolSize;							// Bytes of free textures each pool may hold, 0 to allocate every texture
+	unsigned mTextureAllocationCount;
+	unsigned mTextureUploadCount;						// Textures filled by a sub-image update
+	unsigned mDrawCallCount;							// Draws issued this frame (main thread only)
+
+	// Pixel buffer object ring that textures stream through. It is mapped once, for good, so the loader thread writes
+	// into it while the main thread issues the texture updates. Space is released when the frame's fence signals
+	unsigned mUploadBuffer;								// 0 when streaming uploads are off
+	unsigned char* mUploadData;
+	unsigned mUploadSize;
+	Semaphore mUploadLock;								// Protects the reserve position and the released position
+	unsigned mUploadWrite;								// Offset the next span starts at
+	unsigned mUploadHead;								// Upload stream positions: bytes reserved and bytes released, so
+	unsigned mUploadTail;								// mUploadHead - mUploadTail are in use
+	unsigned mUploadUsed;								// End of the last span made into a texture (main thread only)
+	unsigned mUploadFenced;								// End of the last span behind a fence (main thread only)
+	deque<UploadFence> mUploadFences;					// Oldest first (main thread only)
+	unsigned mStreamedUploadCount;
+	unsigned mUploadFullCount;							// Reservations refused because the buffer was full
 };
 
 #endif // OPENGL_H_
@@ -0,0 +1,919 @@
+/**
+ * @file OverviewPyramid.cpp
+ * @brief OverviewPyramid implementation file
+ */
+
+#include "OverviewPyramid.h"
+#include "ImageContext.h"
+#include "ImageTile.h"
+#include "Layout.h"
+#include "TextureLoader.h"
+#include "Tracer.h"
+
+// Tiles are stored as tightly packed RGB
+#define TILE_BYTES_PER_PIXEL 3
+#define TILE_PIXEL_BYTES (OverviewPyramid::TileSize * OverviewPyramid::TileSize * TILE_BYTES_PER_PIXEL)
+
+// The level count is limited by the 12 bits available for each tile coordinate in a tile id
+#define MAX_PYRAMID_LEVELS 9
+
+// Limits on the main thread texture work done for the pyramid
+#define MAX_TILE_UPLOADS_PER_FRAME 4
+#define MAX_RESIDENT_TILES 64
+
+// Where the pyramids are cached, and how many pyramids are kept there. Every layout and preference change gets
+// a pyramid of its own, the least recently built ones are deleted
+#define OVERVIEW_CACHE_FOLDER "data/overview"
+#define MAX_CACHED_PYRAMIDS 4
+
+// The way sprintf is used in this file is perfectly safe
+#ifdef WIN32
+	#pragma warning (disable: 4996)
+#endif // WIN32
+
+/**
+ * HashCombine
+ * Mix a value into a running hash code
+ */
+static unsigned HashCombine(unsigned in_Hash, unsigned in_Value)
+{
+	return ((in_Hash << 5) + in_Hash) ^ in_Value;
+}
+
+/**
+ * HashFloat
+ * Mix the bit pattern of a float into a running hash code
+ */
+static unsigned HashFloat(unsigned in_Hash, float in_Value)
+{
+	unsigned l_Bits;
+	memcpy(&l_Bits, &in_Value, sizeof(l_Bits));
+	return HashCombine(in_Hash, l_Bits);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// OverviewPyramid
+
+OverviewPyramid::OverviewPyramid()
+: mThreadStarted(false)
+, mThreadDone(false)
+, mStopThread(false)
+, mCancelJob(false)
+, mPendingJob(NULL)
+, mReady(false)
+, mReadyKey(0)
+, mReadyLevelCount(0)
+, mWorldMinX(0), mWorldMinY(0)
+, mWorldSpan(0)
+, mCurrentKey(0)
+, mFrameCount(0)
+, mResidentKey(0)
+{
+#ifdef WIN32
+	mWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+	#error Your platform event creation goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+OverviewPyramid::~OverviewPyramid()
+{
+#ifdef WIN32
+	CloseHandle(mWakeEvent);
+#else
+	#error Your platform event destruction goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::Shutdown()
+{
+	// Terminate the build thread routine
+	if(mThreadStarted)
+	{
+		mStopThread = true;
+		WakeThread(); // Wake the thread so it can exit
+		while(!mThreadDone)
+		{
+			Sleep(0); // Yield timeslice
+		}
+	}
+
+	delete mPendingJob;
+	mPendingJob = NULL;
+
+	FreeTextures(false);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::Build(const Layout* in_Layout, ImageContext* in_ImageContext)
+{
+	UserPreferences* l_Prefs = UserPreferences::Instance();
+	if(!l_Prefs->OverviewPyramidEnabled() || in_ImageContext->GetImageCount() == 0)
+	{
+		return;
+	}
+
+	// Snapshot the layout. The worker thread must never touch the ImageTiles directly
+	BuildJob* l_Job = new BuildJob();
+	l_Job->Key = GetLayoutKey(in_Layout);
+	l_Job->LevelCount = max(1, min(l_Prefs->OverviewPyramidLevels(), MAX_PYRAMID_LEVELS));
+	l_Job->Images.resize(in_ImageContext->GetImageCount());
+
+	for(unsigned i = 0; i < in_ImageContext->GetImageCount(); i++)
+	{
+		ImageTile* l_Tile = in_ImageContext->GetImage(i);
+		ImageRecord& l_Record = l_Job->Images[i];
+
+		// Use where the tile is going, not where it currently is
+		float l_PosZ;
+		l_Tile->GetMoveToGoalPosition(l_Record.PosX, l_Record.PosY, l_PosZ);
+		l_Tile->GetSize(l_Record.SizeX, l_Record.SizeY);
+
+		float l_Red, l_Green, l_Blue;
+		l_Tile->GetAverageColor(l_Red, l_Green, l_Blue);
+		l_Record.Red = (unsigned char)(l_Red * 255.0f);
+		l_Record.Green = (unsigned char)(l_Green * 255.0f);
+		l_Record.Blue = (unsigned char)(l_Blue * 255.0f);
+
+		// The smallest readable thumbnail is plenty for a zoomed out view
+		l_Record.Offset = l_Record.Size = 0;
+		l_Record.ScaleShift = 0;
+		if(!l_Tile->GetThumbnailInfo(ThumbnailSize_64x64, l_Record.Filename, l_Record.Offset, l_Record.Size, l_Record.ScaleShift))
+		{
+			l_Tile->GetThumbnailInfo(ThumbnailSize_32x32, l_Record.Filename, l_Record.Offset, l_Record.Size, l_Record.ScaleShift);
+		}
+	}
+
+	// Hand the job to the worker, replacing (and cancelling) any older one
+	mJobLock.Lock();
+	delete mPendingJob;
+	mPendingJob = l_Job;
+	mCancelJob = true;
+	mCurrentKey = l_Job->Key;
+	mJobLock.Unlock();
+
+	if(!mThreadStarted)
+	{
+		Start(true);
+		mThreadStarted = true;
+	}
+
+	WakeThread();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OverviewPyramid::Draw(float in_MinWorldX, float in_MinWorldY, float in_MaxWorldX, float in_MaxWorldY, float in_WorldPerPixel)
+{
+	mFrameCount++;
+
+	mJobLock.Lock();
+
+	// The pyramid can only be used if it was built for the layout on screen
+	if(!mReady || mReadyKey != mCurrentKey || mWorldSpan <= 0)
+	{
+		mJobLock.Unlock();
+		return false;
+	}
+
+	// Tile ids are only unique within a pyramid, the tiles of the previous one are thrown away below
+	unsigned l_Key = mReadyKey;
+	bool l_NewPyramid = mResidentKey != l_Key;
+
+	// Choose the coarsest level that still has at least one tile pixel per screen pixel
+	unsigned l_Level = 0;
+	float l_TileWorldSize = mWorldSpan;
+	while(l_Level + 1 < mReadyLevelCount && l_TileWorldSize / TileSize > in_WorldPerPixel)
+	{
+		l_Level++;
+		l_TileWorldSize *= 0.5f;
+	}
+
+	// Find the range of tiles that overlap the visible region
+	int l_TileCount = 1 << l_Level;
+	int l_MinTileX = (int)floor((in_MinWorldX - mWorldMinX) / l_TileWorldSize);
+	int l_MinTileY = (int)floor((in_MinWorldY - mWorldMinY) / l_TileWorldSize);
+	int l_MaxTileX = (int)floor((in_MaxWorldX - mWorldMinX) / l_TileWorldSize);
+	int l_MaxTileY = (int)floor((in_MaxWorldY - mWorldMinY) / l_TileWorldSize);
+	Clamp(l_MinTileX, 0, l_TileCount - 1);
+	Clamp(l_MinTileY, 0, l_TileCount - 1);
+	Clamp(l_MaxTileX, 0, l_TileCount - 1);
+	Clamp(l_MaxTileY, 0, l_TileCount - 1);
+
+	// Find the visible tiles that aren't resident. Those the worker thread has read are taken for upload, the others
+	// are requested from it. No file or graphics work is done while the lock is held
+	map<unsigned, unsigned> l_VisibleTiles;
+	map<unsigned, LoadedTile> l_Uploads;
+	bool l_Requested = false;
+	for(int y = l_MinTileY; y <= l_MaxTileY; y++)
+	{
+		for(int x = l_MinTileX; x <= l_MaxTileX; x++)
+		{
+			// Skip tiles that don't contain any images
+			unsigned l_TileId = GetTileId(l_Level, x, y);
+			map<unsigned, unsigned>::iterator l_Signature = mTileSignatures.find(l_TileId);
+			if(l_Signature == mTileSignatures.end())
+			{
+				continue;
+			}
+
+			l_VisibleTiles[l_TileId] = l_Signature->second;
+
+			// A rebuild with the same key rewrites the tiles whose signature changed, those must be uploaded again
+			map<unsigned, ResidentTile>::iterator l_Resident = mResidentTiles.find(l_TileId);
+			if(!l_NewPyramid && l_Resident != mResidentTiles.end() && l_Resident->second.Signature == l_Signature->second)
+			{
+				continue;
+			}
+
+			map<unsigned, LoadedTile>::iterator l_Loaded = mLoadedTiles.find(l_TileId);
+			if(l_Loaded != mLoadedTiles.end() && l_Loaded->second.Signature == l_Signature->second)
+			{
+				// Upload the tile if we still have budget this frame. Tiles that couldn't be read stay where they are,
+				// so they aren't requested again every frame
+				if(l_Uploads.size() < MAX_TILE_UPLOADS_PER_FRAME && !l_Loaded->second.Pixels.empty())
+				{
+					LoadedTile& l_Upload = l_Uploads[l_TileId];
+					l_Upload.Signature = l_Loaded->second.Signature;
+					l_Upload.Pixels.swap(l_Loaded->second.Pixels);
+					mLoadedTiles.erase(l_Loaded);
+				}
+			}
+			else if(mTileRequests.find(l_TileId) == mTileRequests.end())
+			{
+				mTileRequests[l_TileId] = l_Signature->second;
+				l_Requested = true;
+			}
+		}
+	}
+
+	// Tiles that scrolled out of view before they were uploaded are read again when they are needed
+	for(map<unsigned, LoadedTile>::iterator It = mLoadedTiles.begin(); It != mLoadedTiles.end();)
+	{
+		if(l_VisibleTiles.find(It->first) == l_VisibleTiles.end())
+		{
+			mLoadedTiles.erase(It++);
+		}
+		else
+		{
+			It++;
+		}
+	}
+
+	// Remember where the tiles go before we release the lock
+	float l_WorldMinX = mWorldMinX;
+	float l_WorldMinY = mWorldMinY;
+
+	mJobLock.Unlock();
+
+	if(l_Requested)
+	{
+		WakeThread();
+	}
+
+	if(l_NewPyramid)
+	{
+		FreeTextures(false);
+		mResidentKey = l_Key;
+	}
+
+	// Upload the tiles the worker thread has read
+	for(map<unsigned, LoadedTile>::iterator It = l_Uploads.begin(); It != l_Uploads.end(); It++)
+	{
+		map<unsigned, ResidentTile>::iterator l_Stale = mResidentTiles.find(It->first);
+		if(l_Stale != mResidentTiles.end())
+		{
+			Graphics::Instance()->FreeTexture(l_Stale->second.Handle);
+		}
+
+		ResidentTile& l_Resident = mResidentTiles[It->first];
+		l_Resident.Handle = Graphics::Instance()->CreateTexture(TileSize, TileSize, TextureFormat_RGB, &It->second.Pixels[0]);
+		l_Resident.Signature = It->second.Signature;
+	}
+
+	// Tiles are drawn at the same depth as the image tiles, so we must not draw anything unless we can draw everything
+	bool l_Complete = true;
+	for(map<unsigned, unsigned>::iterator It = l_VisibleTiles.begin(); It != l_VisibleTiles.end(); It++)
+	{
+		map<unsigned, ResidentTile>::iterator l_Resident = mResidentTiles.find(It->first);
+		if(l_Resident != mResidentTiles.end() && l_Resident->second.Signature == It->second)
+		{
+			l_Resident->second.LastUsedFrame = mFrameCount;
+		}
+		else
+		{
+			l_Complete = false;
+		}
+	}
+
+	// Don't let the resident set grow without bound
+	if(mResidentTiles.size() > MAX_RESIDENT_TILES)
+	{
+		FreeTextures(true);
+	}
+
+	if(!l_Complete)
+	{
+		return false;
+	}
+
+	// Draw the tiles
+	for(map<unsigned, unsigned>::iterator It = l_VisibleTiles.begin(); It != l_VisibleTiles.end(); It++)
+	{
+		unsigned l_TileX = It->first & 0xFFF;
+		unsigned l_TileY = (It->first >> 12) & 0xFFF;
+
+		Graphics::Instance()->BindTexture(mResidentTiles[It->first].Handle);
+		Graphics::Instance()->DrawQuad
+		(
+			l_WorldMinX + (l_TileX + 0.5f) * l_TileWorldSize,	// Position in xy-plane
+			l_WorldMinY + (l_TileY + 0.5f) * l_TileWorldSize,
+			0.0f,
+			1.0f, 1.0f, 1.0f,									// Color
+			l_TileWorldSize, l_TileWorldSize					// Width/Height
+		);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::WakeThread()
+{
+#ifdef WIN32
+	SetEvent(mWakeEvent);
+#else
+	#error Your platform event signal goes here
+#endif // WIN32
+
+	// The thread is created suspended, resuming it once it's running does nothing
+	Resume();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::Run()
+{
+	Tracer::Instance()->SetThreadName("OverviewPyramid");
+
+	// While we should keep working
+	while(!mStopThread)
+	{
+		// Check if there is a job waiting
+		mJobLock.Lock();
+		BuildJob* l_Job = mPendingJob;
+		mPendingJob = NULL;
+		mCancelJob = false;
+		mJobLock.Unlock();
+
+		ServiceTileRequests();
+
+		if(l_Job)
+		{
+			RunJob(*l_Job);
+			delete l_Job;
+		}
+		// Nothing to do, wait for the main thread to request a build or some tiles. The event stays signalled if it
+		// did so since we last looked, so no request is missed
+		else
+		{
+#ifdef WIN32
+			WaitForSingleObject(mWakeEvent, INFINITE);
+#else
+			#error Your platform event wait goes here
+#endif // WIN32
+		}
+	}
+
+	// We are now done
+	mThreadDone = true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::RunJob(BuildJob& in_Job)
+{
+	TRACE_SCOPE("BuildOverview")
+
+	// Find the world region covered by the layout
+	float l_MinX = 0, l_MinY = 0, l_MaxX = 0, l_MaxY = 0;
+	for(unsigned i = 0; i < in_Job.Images.size(); i++)
+	{
+		const ImageRecord& l_Record = in_Job.Images[i];
+		float l_Left = l_Record.PosX - l_Record.SizeX * 0.5f;
+		float l_Bottom = l_Record.PosY - l_Record.SizeY * 0.5f;
+		float l_Right = l_Record.PosX + l_Record.SizeX * 0.5f;
+		float l_Top = l_Record.PosY + l_Record.SizeY * 0.5f;
+
+		l_MinX = i ? min(l_MinX, l_Left) : l_Left;
+		l_MinY = i ? min(l_MinY, l_Bottom) : l_Bottom;
+		l_MaxX = i ? max(l_MaxX, l_Right) : l_Right;
+		l_MaxY = i ? max(l_MaxY, l_Top) : l_Top;
+	}
+
+	// The pyramid covers a square region
+	float l_Span = max(l_MaxX - l_MinX, l_MaxY - l_MinY);
+	if(l_Span <= 0)
+	{
+		return;
+	}
+
+	in_Job.WorldMinX = l_MinX;
+	in_Job.WorldMinY = l_MinY;
+	in_Job.WorldSpan = l_Span;
+
+	unsigned l_LeafLevel = in_Job.LevelCount - 1;
+	unsigned l_LeafCount = 1 << l_LeafLevel;
+	float l_LeafWorldSize = l_Span / l_LeafCount;
+
+	// Sort the images into the leaf tiles they overlap
+	map<unsigned, vector<unsigned> > l_Bins;
+	for(unsigned i = 0; i < in_Job.Images.size(); i++)
+	{
+		const ImageRecord& l_Record = in_Job.Images[i];
+		int l_MinTileX = (int)floor((l_Record.PosX - l_Record.SizeX * 0.5f - l_MinX) / l_LeafWorldSize);
+		int l_MinTileY = (int)floor((l_Record.PosY - l_Record.SizeY * 0.5f - l_MinY) / l_LeafWorldSize);
+		int l_MaxTileX = (int)floor((l_Record.PosX + l_Record.SizeX * 0.5f - l_MinX) / l_LeafWorldSize);
+		int l_MaxTileY = (int)floor((l_Record.PosY + l_Record.SizeY * 0.5f - l_MinY) / l_LeafWorldSize);
+		Clamp(l_MinTileX, 0, (int)l_LeafCount - 1);
+		Clamp(l_MinTileY, 0, (int)l_LeafCount - 1);
+		Clamp(l_MaxTileX, 0, (int)l_LeafCount - 1);
+		Clamp(l_MaxTileY, 0, (int)l_LeafCount - 1);
+
+		for(int y = l_MinTileY; y <= l_MaxTileY; y++)
+		{
+			for(int x = l_MinTileX; x <= l_MaxTileX; x++)
+			{
+				l_Bins[GetTileId(l_LeafLevel, x, y)].push_back(i);
+			}
+		}
+	}
+
+	// Make sure the cache folder exists
+	char l_Buff[64];
+	sprintf(l_Buff, OVERVIEW_CACHE_FOLDER "/%08x", in_Job.Key);
+#ifdef WIN32
+	_mkdir(OVERVIEW_CACHE_FOLDER);
+	_mkdir(l_Buff);
+#else
+	#error Your platform directory creation goes here
+#endif // WIN32
+
+	// Read the signatures of the tiles from the last time this pyramid was built
+	map<unsigned, unsigned> l_OldSignatures;
+	ifstream l_ManifestIn(GetManifestFilename(in_Job.Key).c_str());
+	unsigned l_TileId, l_Signature;
+	while(l_ManifestIn >> l_TileId >> l_Signature)
+	{
+		l_OldSignatures[l_TileId] = l_Signature;
+	}
+	l_ManifestIn.close();
+
+	// Every tile written by this job gets its signature recorded here
+	map<unsigned, unsigned> l_NewSignatures;
+	vector<unsigned char> l_Pixels;
+	unsigned l_TilesRendered = 0;
+
+	// Render the leaf tiles from the thumbnails
+	for(map<unsigned, vector<unsigned> >::iterator It = l_Bins.begin(); It != l_Bins.end(); It++)
+	{
+		if(mCancelJob || mStopThread)
+		{
+			return;
+		}
+
+		// Keep the pyramid on screen streaming while a new one is built
+		ServiceTileRequests();
+
+		unsigned l_TileX = It->first & 0xFFF;
+		unsigned l_TileY = (It->first >> 12) & 0xFFF;
+
+		// The signature covers where the tile is and everything that is drawn into it. If the index changes,
+		// only the tiles containing the changed images get new signatures
+		l_Signature = HashCombine(5381, It->first);
+		l_Signature = HashFloat(l_Signature, l_MinX + l_TileX * l_LeafWorldSize);
+		l_Signature = HashFloat(l_Signature, l_MinY + l_TileY * l_LeafWorldSize);
+		l_Signature = HashFloat(l_Signature, l_LeafWorldSize);
+		for(unsigned i = 0; i < It->second.size(); i++)
+		{
+			const ImageRecord& l_Record = in_Job.Images[It->second[i]];
+			l_Signature = HashFloat(l_Signature, l_Record.PosX);
+			l_Signature = HashFloat(l_Signature, l_Record.PosY);
+			l_Signature = HashFloat(l_Signature, l_Record.SizeX);
+			l_Signature = HashFloat(l_Signature, l_Record.SizeY);
+			l_Signature = HashCombine(l_Signature, HashString(l_Record.Filename.c_str()));
+			l_Signature = HashCombine(l_Signature, l_Record.Offset);
+			l_Signature = HashCombine(l_Signature, l_Record.Size);
+			l_Signature = HashCombine(l_Signature, l_Record.ScaleShift);
+			l_Signature = HashCombine(l_Signature, (l_Record.Red << 16) | (l_Record.Green << 8) | l_Record.Blue);
+		}
+		l_Signature = l_Signature ? l_Signature : 1; // Zero is reserved for empty tiles
+		l_NewSignatures[It->first] = l_Signature;
+
+		// Is the cached tile still good?
+		string l_Filename = GetTileFilename(in_Job.Key, It->first);
+		if(l_OldSignatures[It->first] == l_Signature && ifstream(l_Filename.c_str(), ios_base::in | ios_base::binary).good())
+		{
+			continue;
+		}
+
+		if(RenderLeafTile(in_Job, It->second, l_TileX, l_TileY, l_Pixels) && WriteTile(l_Filename, l_Pixels))
+		{
+			l_TilesRendered++;
+		}
+		else
+		{
+			l_NewSignatures[It->first] = 0; // Force a retry on the next build
+		}
+	}
+
+	// Build each parent level from the level below it
+	for(int l_Level = (int)l_LeafLevel - 1; l_Level >= 0; l_Level--)
+	{
+		// Find the parents of every non-empty tile on the level below
+		map<unsigned, unsigned> l_Parents;
+		for(map<unsigned, unsigned>::iterator It = l_NewSignatures.begin(); It != l_NewSignatures.end(); It++)
+		{
+			if((It->first >> 24) == (unsigned)l_Level + 1)
+			{
+				unsigned l_ParentId = GetTileId(l_Level, (It->first & 0xFFF) >> 1, ((It->first >> 12) & 0xFFF) >> 1);
+				l_Parents[l_ParentId] = HashCombine(l_Parents.count(l_ParentId) ? l_Parents[l_ParentId] : HashCombine(5381, l_ParentId), It->second);
+			}
+		}
+
+		for(map<unsigned, unsigned>::iterator It = l_Parents.begin(); It != l_Parents.end(); It++)
+		{
+			if(mCancelJob || mStopThread)
+			{
+				return;
+			}
+
+			ServiceTileRequests();
+
+			l_Signature = It->second ? It->second : 1;
+			l_NewSignatures[It->first] = l_Signature;
+
+			string l_Filename = GetTileFilename(in_Job.Key, It->first);
+			if(l_OldSignatures[It->first] == l_Signature && ifstream(l_Filename.c_str(), ios_base::in | ios_base::binary).good())
+			{
+				continue;
+			}
+
+			if(RenderParentTile(in_Job.Key, l_Level, It->first & 0xFFF, (It->first >> 12) & 0xFFF, l_Pixels) && WriteTile(l_Filename, l_Pixels))
+			{
+				l_TilesRendered++;
+			}
+			else
+			{
+				l_NewSignatures[It->first] = 0;
+			}
+		}
+	}
+
+	// Save the signatures so the next build can skip unchanged tiles
+	ofstream l_ManifestOut(GetManifestFilename(in_Job.Key).c_str());
+	for(map<unsigned, unsigned>::iterator It = l_NewSignatures.begin(); It != l_NewSignatures.end(); It++)
+	{
+		l_ManifestOut << It->first << " " << It->second << endl;
+	}
+	l_ManifestOut.close();
+
+	// Publish the completed pyramid
+	mJobLock.Lock();
+	mReady = true;
+	mReadyKey = in_Job.Key;
+	mReadyLevelCount = in_Job.LevelCount;
+	mWorldMinX = l_MinX;
+	mWorldMinY = l_MinY;
+	mWorldSpan = l_Span;
+	mTileSignatures.swap(l_NewSignatures);
+	mTileRequests.clear();
+	mLoadedTiles.clear();
+	mJobLock.Unlock();
+
+	logf("Overview pyramid %08x ready: %d tiles rendered", in_Job.Key, l_TilesRendered);
+
+	EvictOldPyramids(in_Job.Key);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::ServiceTileRequests()
+{
+	// Requests stay queued until their tile is loaded, so the main thread doesn't ask for them again
+	mJobLock.Lock();
+	unsigned l_Key = mReadyKey;
+	vector<pair<unsigned, unsigned> > l_Requests(mTileRequests.begin(), mTileRequests.end());
+	mJobLock.Unlock();
+
+	for(unsigned i = 0; i < l_Requests.size(); i++)
+	{
+		LoadedTile l_Tile;
+		l_Tile.Signature = l_Requests[i].second;
+		if(!ReadTile(GetTileFilename(l_Key, l_Requests[i].first), l_Tile.Pixels))
+		{
+			l_Tile.Pixels.clear();
+		}
+
+		// Drop the tile if a new pyramid was published while we were reading it
+		mJobLock.Lock();
+		if(mReadyKey == l_Key && mTileRequests.erase(l_Requests[i].first))
+		{
+			LoadedTile& l_Loaded = mLoadedTiles[l_Requests[i].first];
+			l_Loaded.Signature = l_Tile.Signature;
+			l_Loaded.Pixels.swap(l_Tile.Pixels);
+		}
+		mJobLock.Unlock();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OverviewPyramid::DecodeThumbnail(const ImageRecord& in_Record, DecodedImage& out_Image)
+{
+	// The compressed data goes in the arena along with the decoder's scratch memory
+	mDecodeArena.Reset();
+	unsigned char* l_Data = (unsigned char*)mDecodeArena.Allocate(in_Record.Size);
+	if(!TextureLoader::ReadContainer(in_Record.Filename.c_str(), in_Record.Offset, in_Record.Size, l_Data) ||
+	   !mDecoder.CanDecode(l_Data, in_Record.Size))
+	{
+		return false;
+	}
+
+	return in_Record.ScaleShift > 0 ?
+		mDecoder.DecodeScaled(l_Data, in_Record.Size, in_Record.ScaleShift, out_Image, &mDecodeArena) :
+		mDecoder.Decode(l_Data, in_Record.Size, out_Image, &mDecodeArena);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OverviewPyramid::RenderLeafTile(const BuildJob& in_Job, const vector<unsigned>& in_Images, unsigned in_TileX, unsigned in_TileY, vector<unsigned char>& out_Pixels)
+{
+	float l_LeafWorldSize = in_Job.WorldSpan / (1 << (in_Job.LevelCount - 1));
+	float l_TileMinX = in_Job.WorldMinX + in_TileX * l_LeafWorldSize;
+	float l_TileMinY = in_Job.WorldMinY + in_TileY * l_LeafWorldSize;
+	float l_PixelsPerWorld = TileSize / l_LeafWorldSize;
+
+	// Start from the background color
+	out_Pixels.assign(TILE_PIXEL_BYTES, 255);
+
+	// Reused for every image so its pixel buffer is only reallocated when a larger thumbnail comes along
+	DecodedImage l_Image;
+
+	for(unsigned i = 0; i < in_Images.size(); i++)
+	{
+		const ImageRecord& l_Record = in_Job.Images[in_Images[i]];
+
+		// The image footprint in tile pixels. Pixel row 0 is the bottom of the tile, matching the texture upload
+		float l_Left = (l_Record.PosX - l_Record.SizeX * 0.5f - l_TileMinX) * l_PixelsPerWorld;
+		float l_Bottom = (l_Record.PosY - l_Record.SizeY * 0.5f - l_TileMinY) * l_PixelsPerWorld;
+		float l_Width = l_Record.SizeX * l_PixelsPerWorld;
+		float l_Height = l_Record.SizeY * l_PixelsPerWorld;
+
+		int l_MinPixelX = (int)floor(l_Left);
+		int l_MinPixelY = (int)floor(l_Bottom);
+		int l_MaxPixelX = (int)ceil(l_Left + l_Width);
+		int l_MaxPixelY = (int)ceil(l_Bottom + l_Height);
+		Clamp(l_MinPixelX, 0, (int)TileSize);
+		Clamp(l_MinPixelY, 0, (int)TileSize);
+		Clamp(l_MaxPixelX, 0, (int)TileSize);
+		Clamp(l_MaxPixelY, 0, (int)TileSize);
+
+		// Decode the thumbnail, if there is one
+		bool l_HasImage = !l_Record.Filename.empty() && DecodeThumbnail(l_Record, l_Image);
+		int l_SourceBytesPerPixel = l_Image.Format == TextureFormat_RGBA ? 4 : 3;
+
+		for(int y = l_MinPixelY; y < l_MaxPixelY; y++)
+		{
+			unsigned char* l_Dest = &out_Pixels[(y * TileSize + l_MinPixelX) * TILE_BYTES_PER_PIXEL];
+			for(int x = l_MinPixelX; x < l_MaxPixelX; x++, l_Dest += TILE_BYTES_PER_PIXEL)
+			{
+				if(l_HasImage)
+				{
+					// Nearest sample from the thumbnail, which is stretched over the tile like the textured quad is
+					int l_SourceX = (int)(((x + 0.5f) - l_Left) / l_Width * l_Image.Width);
+					int l_SourceY = (int)(((y + 0.5f) - l_Bottom) / l_Height * l_Image.Height);
+					Clamp(l_SourceX, 0, l_Image.Width - 1);
+					Clamp(l_SourceY, 0, l_Image.Height - 1);
+
+					const unsigned char* l_Source = &l_Image.Pixels[(l_SourceY * l_Image.Width + l_SourceX) * l_SourceBytesPerPixel];
+					l_Dest[0] = l_Source[0];
+					l_Dest[1] = l_Source[1];
+					l_Dest[2] = l_Source[2];
+				}
+				else
+				{
+					l_Dest[0] = l_Record.Red;
+					l_Dest[1] = l_Record.Green;
+					l_Dest[2] = l_Record.Blue;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OverviewPyramid::RenderParentTile(unsigned in_Key, unsigned in_Level, unsigned in_TileX, unsigned in_TileY, vector<unsigned char>& out_Pixels)
+{
+	const int l_HalfSize = TileSize / 2;
+
+	out_Pixels.assign(TILE_PIXEL_BYTES, 255);
+
+	// Each child fills one quadrant of the parent
+	vector<unsigned char> l_Child;
+	for(unsigned l_ChildY = 0; l_ChildY < 2; l_ChildY++)
+	{
+		for(unsigned l_ChildX = 0; l_ChildX < 2; l_ChildX++)
+		{
+			// Empty children were never written, leave their quadrant as background
+			unsigned l_ChildId = GetTileId(in_Level + 1, in_TileX * 2 + l_ChildX, in_TileY * 2 + l_ChildY);
+			if(!ReadTile(GetTileFilename(in_Key, l_ChildId), l_Child))
+			{
+				continue;
+			}
+
+			// 2x2 box filter the child into its quadrant
+			for(int y = 0; y < l_HalfSize; y++)
+			{
+				const unsigned char* l_Row0 = &l_Child[(y * 2 + 0) * TileSize * TILE_BYTES_PER_PIXEL];
+				const unsigned char* l_Row1 = &l_Child[(y * 2 + 1) * TileSize * TILE_BYTES_PER_PIXEL];
+				unsigned char* l_Dest = &out_Pixels[((l_ChildY * l_HalfSize + y) * TileSize + l_ChildX * l_HalfSize) * TILE_BYTES_PER_PIXEL];
+
+				for(int x = 0; x < l_HalfSize * TILE_BYTES_PER_PIXEL; x += TILE_BYTES_PER_PIXEL)
+				{
+					for(int c = 0; c < TILE_BYTES_PER_PIXEL; c++)
+					{
+						*l_Dest++ = (unsigned char)((l_Row0[x * 2 + c] + l_Row0[x * 2 + TILE_BYTES_PER_PIXEL + c] +
+													 l_Row1[x * 2 + c] + l_Row1[x * 2 + TILE_BYTES_PER_PIXEL + c] + 2) >> 2);
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::FreeTextures(bool in_UnusedOnly)
+{
+	for(map<unsigned, ResidentTile>::iterator It = mResidentTiles.begin(); It != mResidentTiles.end();)
+	{
+		if(in_UnusedOnly && It->second.LastUsedFrame == mFrameCount)
+		{
+			It++;
+			continue;
+		}
+
+		Graphics::Instance()->FreeTexture(It->second.Handle);
+		mResidentTiles.erase(It++);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void OverviewPyramid::EvictOldPyramids(unsigned in_Key)
+{
+#ifdef WIN32
+	// Find every other cached pyramid and when it was last built
+	vector<pair<ULONGLONG, string> > l_Pyramids;
+	WIN32_FIND_DATAA l_FindData;
+	HANDLE l_Find = FindFirstFileA(OVERVIEW_CACHE_FOLDER "/*", &l_FindData);
+	if(l_Find == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	char l_KeyName[16];
+	sprintf(l_KeyName, "%08x", in_Key);
+	do
+	{
+		if(!(l_FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || l_FindData.cFileName[0] == '.' ||
+		   _stricmp(l_FindData.cFileName, l_KeyName) == 0)
+		{
+			continue;
+		}
+
+		// A pyramid without a manifest was never completed, it goes first
+		string l_Directory = string(OVERVIEW_CACHE_FOLDER "/") + l_FindData.cFileName;
+		ULONGLONG l_BuildTime = 0;
+		WIN32_FIND_DATAA l_ManifestData;
+		HANDLE l_Manifest = FindFirstFileA((l_Directory + "/manifest.txt").c_str(), &l_ManifestData);
+		if(l_Manifest != INVALID_HANDLE_VALUE)
+		{
+			l_BuildTime = ((ULONGLONG)l_ManifestData.ftLastWriteTime.dwHighDateTime << 32) | l_ManifestData.ftLastWriteTime.dwLowDateTime;
+			FindClose(l_Manifest);
+		}
+		l_Pyramids.push_back(make_pair(l_BuildTime, l_Directory));
+	}
+	while(FindNextFileA(l_Find, &l_FindData));
+	FindClose(l_Find);
+
+	// Keep the most recently built ones, the current pyramid takes up one of the slots
+	sort(l_Pyramids.rbegin(), l_Pyramids.rend());
+	for(unsigned i = MAX_CACHED_PYRAMIDS - 1; i < l_Pyramids.size(); i++)
+	{
+		const string& l_Directory = l_Pyramids[i].second;
+		l_Find = FindFirstFileA((l_Directory + "/*").c_str(), &l_FindData);
+		if(l_Find != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				if(!(l_FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				{
+					DeleteFileA((l_Directory + "/" + l_FindData.cFileName).c_str());
+				}
+			}
+			while(FindNextFileA(l_Find, &l_FindData));
+			FindClose(l_Find);
+		}
+
+		if(RemoveDirectoryA(l_Directory.c_str()))
+		{
+			logf("Evicted overview pyramid '%s'", l_Directory.c_str());
+		}
+	}
+#else
+	#error Your platform directory enumeration goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+unsigned OverviewPyramid::GetLayoutKey(const Layout* in_Layout)
+{
+	UserPreferences* l_Prefs = UserPreferences::Instance();
+
+	// Every preference that affects where the layouts place images. The images themselves are left out, when the
+	// index changes the tile signatures pick out the tiles that must be rendered again
+	stringstream l_Key;
+	l_Key << in_Layout->GetName() << ":" << l_Prefs->OverviewPyramidLevels()
+		  << ":" << l_Prefs->ImageSize()
+		  << ":" << l_Prefs->CalendarRowPitch() << ":" << l_Prefs->CalendarColPitch()
+		  << ":" << l_Prefs->MonthPadding() << ":" << l_Prefs->YearPadding()
+		  << ":" << l_Prefs->CompactRowPitch() << ":" << l_Prefs->CompactColPitch()
+		  << ":" << l_Prefs->CompactDayPadding() << ":" << l_Prefs->CompactYearPadding()
+		  << ":" << l_Prefs->CompactRowCount();
+
+	return HashString(l_Key.str().c_str());
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+string OverviewPyramid::GetTileFilename(unsigned in_Key, unsigned in_TileId)
+{
+	char l_Buff[64];
+	sprintf(l_Buff, OVERVIEW_CACHE_FOLDER "/%08x/%d_%d_%d.dat", in_Key, in_TileId >> 24, in_TileId & 0xFFF, (in_TileId >> 12) & 0xFFF);
+	return l_Buff;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+string OverviewPyramid::GetManifestFilename(unsigned in_Key)
+{
+	char l_Buff[64];
+	sprintf(l_Buff, OVERVIEW_CACHE_FOLDER "/%08x/manifest.txt", in_Key);
+	return l_Buff;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OverviewPyramid::ReadTile(const string& in_Filename, vector<unsigned char>& out_Pixels)
+{
+	ifstream l_File;
+	l_File.open(in_Filename.c_str(), ios_base::in | ios_base::binary);
+	if(l_File.fail())
+	{
+		return false;
+	}
+
+	out_Pixels.resize(TILE_PIXEL_BYTES);
+	l_File.read((char*)&out_Pixels[0], TILE_PIXEL_BYTES);
+	return l_File.gcount() == TILE_PIXEL_BYTES;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool OverviewPyramid::WriteTile(const string& in_Filename, const vector<unsigned char>& in_Pixels)
+{
+	ofstream l_File;
+	l_File.open(in_Filename.c_str(), ios_base::out | ios_base::binary);
+	if(l_File.fail())
+	{
+		logf("Failed to write overview tile '%s'", in_Filename.c_str());
+		return false;
+	}
+
+	l_File.write((const char*)&in_Pixels[0], in_Pixels.size());
+	return !l_File.fail();
+}
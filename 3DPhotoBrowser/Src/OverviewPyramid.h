@@ -0,0 +1,184 @@
+/**
+ * @file OverviewPyramid.h
+ * @brief OverviewPyramid class header file
+ */
+
+#ifndef OVERVIEWPYRAMID_H_
+#define OVERVIEWPYRAMID_H_
+
+#include "Global.h"
+#include "Thread.h"
+#include "Semaphore.h"
+#include "DecodeBuffers.h"
+#include "JpegDecoder.h"
+
+/**
+ * Forwards
+ */
+class Layout;
+class ImageContext;
+
+/**
+ * OverviewPyramid
+ * Singleton used to pre-render the current layout into a pyramid of 256x256 tiles. When the camera is zoomed out
+ * past the thumbnail LODs, the renderer draws a handful of pyramid tiles instead of every image tile.
+ * Tiles are built by a background thread and cached on disk, keyed by the layout and its preferences.
+ */
+class OverviewPyramid : public Thread
+{
+	/**
+	 * ImageRecord
+	 * Snapshot of the layout data for a single image, taken on the main thread when a build is requested
+	 */
+	struct ImageRecord
+	{
+		float PosX, PosY;				// Goal position of the image tile
+		float SizeX, SizeY;				// Size of the image tile
+		unsigned char Red, Green, Blue;	// Average image color, used when there is no thumbnail
+		string Filename;				// Thumbnail container file (empty if there is no thumbnail)
+		unsigned Offset;				// Offset of the thumbnail within the container
+		unsigned Size;					// Size of the thumbnail within the container
+		int ScaleShift;					// The thumbnail is decoded at 1/2^ScaleShift of its stored size
+	};
+
+	/**
+	 * BuildJob
+	 * Everything the worker thread needs to build a pyramid
+	 */
+	struct BuildJob
+	{
+		unsigned Key;					// Layout and preference hash, used to name the cache directory
+		unsigned LevelCount;			// Number of pyramid levels to build
+		vector<ImageRecord> Images;		// Snapshot of the image layout
+
+		float WorldMinX, WorldMinY;		// Bottom left corner of the pyramid, computed by the worker
+		float WorldSpan;				// World width and height covered by the level 0 tile, computed by the worker
+	};
+
+	/**
+	 * ResidentTile
+	 * A pyramid tile that has been uploaded to graphics memory
+	 */
+	struct ResidentTile
+	{
+		TextureHandle Handle;
+		unsigned Signature;				// Signature of the tile contents that were uploaded
+		unsigned LastUsedFrame;
+	};
+
+	/**
+	 * LoadedTile
+	 * A pyramid tile read from the cache by the worker thread, waiting for the main thread to upload it
+	 */
+	struct LoadedTile
+	{
+		unsigned Signature;				// Signature of the tile contents that were read
+		vector<unsigned char> Pixels;	// Tile pixels, empty if the tile couldn't be read
+	};
+
+public:
+
+	/**
+	 * TileSize
+	 * The width and height of every pyramid tile, in pixels
+	 */
+	static const int TileSize = 256;
+
+	/**
+	 * Instance
+	 * Singleton access
+	 */
+	static OverviewPyramid* Instance() { static OverviewPyramid l_Instance; return &l_Instance; }
+
+	/**
+	 * Shutdown
+	 * Stop the worker thread and free any resident tile textures
+	 */
+	void Shutdown();
+
+	/**
+	 * Build
+	 * Request a (re)build of the pyramid for the layout that was just applied to the image context.
+	 * Only tiles whose contents changed since the last build are rendered again
+	 */
+	void Build(const Layout* in_Layout, ImageContext* in_ImageContext);
+
+	/**
+	 * Draw
+	 * Draw the pyramid tiles covering the visible world region. in_WorldPerPixel is the size of one screen pixel
+	 * in world units. Tiles that aren't resident are read by the worker thread and uploaded on a later frame.
+	 * Returns false if the pyramid or any visible tile isn't ready, in which case the caller must draw the image tiles
+	 */
+	bool Draw(float in_MinWorldX, float in_MinWorldY, float in_MaxWorldX, float in_MaxWorldY, float in_WorldPerPixel);
+
+	/**
+	 * Thread interface
+	 */
+	virtual void Run();
+
+private:
+
+	/**
+	 * Helpers
+	 */
+	void WakeThread();
+	void RunJob(BuildJob& in_Job);
+	void ServiceTileRequests();
+	bool DecodeThumbnail(const ImageRecord& in_Record, DecodedImage& out_Image);
+	bool RenderLeafTile(const BuildJob& in_Job, const vector<unsigned>& in_Images, unsigned in_TileX, unsigned in_TileY, vector<unsigned char>& out_Pixels);
+	bool RenderParentTile(unsigned in_Key, unsigned in_Level, unsigned in_TileX, unsigned in_TileY, vector<unsigned char>& out_Pixels);
+	void FreeTextures(bool in_UnusedOnly);
+
+	static void EvictOldPyramids(unsigned in_Key);
+	static unsigned GetLayoutKey(const Layout* in_Layout);
+	static unsigned GetTileId(unsigned in_Level, unsigned in_TileX, unsigned in_TileY) { return (in_Level << 24) | (in_TileY << 12) | in_TileX; }
+	static string GetTileFilename(unsigned in_Key, unsigned in_TileId);
+	static string GetManifestFilename(unsigned in_Key);
+	static bool ReadTile(const string& in_Filename, vector<unsigned char>& out_Pixels);
+	static bool WriteTile(const string& in_Filename, const vector<unsigned char>& in_Pixels);
+
+	// The worker thread decodes thumbnails itself rather than through the TextureLoader, which it may start before.
+	// Thumbnails DevIL would be needed for are drawn in their average color
+	JpegDecoder mDecoder;
+	DecodeArena mDecodeArena;				// Thumbnail decode scratch memory for the worker thread
+
+	bool mThreadStarted;
+	volatile bool mThreadDone;
+	volatile bool mStopThread;
+	volatile bool mCancelJob;				// Set when a newer job replaces the one being built
+
+	Semaphore mJobLock;
+	BuildJob* mPendingJob;					// The next job for the worker thread (protected by mJobLock)
+
+	// Description of the most recently completed pyramid (protected by mJobLock)
+	bool mReady;							// Is there a completed pyramid?
+	unsigned mReadyKey;						// Key of the completed pyramid
+	unsigned mReadyLevelCount;				// Number of levels in the completed pyramid
+	float mWorldMinX, mWorldMinY;			// World position of the bottom left corner of the pyramid
+	float mWorldSpan;						// World width and height covered by the level 0 tile
+	map<unsigned, unsigned> mTileSignatures;// Non-empty tiles in the completed pyramid, by tile id
+
+	// Tile streaming between the main and the worker thread, always for the completed pyramid (protected by mJobLock)
+	map<unsigned, unsigned> mTileRequests;	// Tiles the main thread wants read, by tile id, with their signature
+	map<unsigned, LoadedTile> mLoadedTiles;	// Tiles read by the worker thread, waiting to be uploaded
+
+#ifdef WIN32
+	HANDLE mWakeEvent;						// Signalled when there is a new job or tile requests for the worker thread
+#endif // WIN32
+
+	// Main thread state
+	unsigned mCurrentKey;					// Key of the layout currently on screen
+	unsigned mFrameCount;					// Number of calls to Draw, used to age out textures
+	unsigned mResidentKey;					// Key of the pyramid the resident tiles were uploaded from
+	map<unsigned, ResidentTile> mResidentTiles;	// Uploaded tiles of the mResidentKey pyramid, by tile id
+
+	/**
+	 * Singleton implementation
+	 */
+	OverviewPyramid();
+	~OverviewPyramid();
+	OverviewPyramid(const OverviewPyramid&);
+	const OverviewPyramid& operator=(const OverviewPyramid&);
+};
+
+#endif // OVERVIEWPYRAMID_H_
@@ -8,8 +8,20 @@
 #include "CompactLayout.h"
 #include "ImageTile.h"
 #include "OpenGL.h"
+#include "NullGraphics.h"
+#include "NullWindow.h"
+#include "OverviewPyramid.h"
+#include "Profiler.h"
+#include "Tracer.h"
+#include "Metrics.h"
 #include "IL/il.h"
 
+/**
+ * FRAMERATE_REPORT_INTERVAL
+ * Seconds between updates of the framerate report in the window title
+ */
+#define FRAMERATE_REPORT_INTERVAL 0.5
+
 // Platform specific window
 #ifdef WIN32
 	#include "MSWindow.h"
@@ -27,9 +39,17 @@ PhotoBrowser::PhotoBrowser()
 , mWindowReceivedFocusThisFrame(false)
 , mAllowClickZoomThisFrame(false)
 , mDone(false)
-, mAverageFrameTime(0)
+, mLastReportTime(0)
+, mImageTilesMoving(false)
+, mOverviewDrawn(false)
+, mPrefetchActive(false)
+, mPrefetchRestX(0), mPrefetchRestY(0)
+, mPrefetchThumbnailSize(ThumbnailSize_None)
+, mMarginThumbnailSize(ThumbnailSize_None)
+, mVisibleThumbnailSize(ThumbnailSize_None)
 , mWindow(NULL)
 , mCamera(NULL)
+, mHeadless(false)
 , mCurrentLayoutIndex(-1)
 , mLeftClick(false)
 , mRightClick(false)
@@ -60,8 +80,14 @@ void PhotoBrowser::ReleaseOpenGLWorkerContext()
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
-bool PhotoBrowser::Startup()
+bool PhotoBrowser::Startup(bool in_Headless)
 {
+	mHeadless = in_Headless;
+
+	// Start tracing before any worker thread starts, so the trace covers loading from the first request
+	Tracer::Instance()->SetThreadName("Main");
+	Tracer::Instance()->Configure();
+
 	// Configure the photo browser layouts
 	RegisterLayout<CalendarLayout>();
 	RegisterLayout<CompactLayout>();
@@ -70,11 +96,18 @@ bool PhotoBrowser::Startup()
 	ilInit();
 
 	// Instantiate the platform specific window
+	if(mHeadless)
+	{
+		mWindow = new NullWindow();
+	}
+	else
+	{
 #ifdef WIN32
-	mWindow = new MSWindow();
+		mWindow = new MSWindow();
 #else
 	#error You platform window instantiation goes here
 #endif // WIN32
+	}
 
 	// The way sprintf is used here is perfectly safe
 #ifdef WIN32
@@ -133,7 +166,18 @@ bool PhotoBrowser::Startup()
 	mWindow->EnableVerticalSync(UserPreferences::Instance()->EnableVerticalSync());
 
 	// Configure the graphics renderer for OpenGL
-	Graphics::ConfigureRenderer<OpenGL>();
+	if(mHeadless)
+	{
+		Graphics::ConfigureRenderer<NullGraphics>();
+	}
+	else
+	{
+		Graphics::ConfigureRenderer<OpenGL>();
+	}
+
+	// Create the texture loader on this thread, now the renderer it picks its texture layout from is configured.
+	// Function-local statics aren't constructed thread-safely, and the overview pyramid's thread starts with the first layout
+	TextureLoader::Instance();
 
 	// Initialize the photo browser's camera
 	mCamera = new Camera();
@@ -147,12 +191,19 @@ bool PhotoBrowser::Startup()
 	// Listen for user preference change events
 	l_Prefs->AddUserPreferenceListener(this);
 
+	// Start profiling if the framerate is shown or a report is wanted
+	Profiler::Instance()->Configure();
+
+	// Start writing the stats file if it is wanted
+	Metrics::Instance()->Configure();
+
 	// Set the current layout
 	SelectLayout(l_Prefs->CurrentLayout());
 	mCurrentLayoutChangedThisFrame = false; // This gets set by SelectLayout, but we don't want it to apply on init
 
-	// Check if we should restore the camera position to whatever was saved by the user preferences
-	if(l_Prefs->SaveCameraPosition())
+	// Check if we should restore the camera position to whatever was saved by the user preferences.
+	// A headless browser always starts from the layout's home position
+	if(l_Prefs->SaveCameraPosition() && !mHeadless)
 	{
 		mCamera->SetPosition( l_Prefs->SavedCameraX(),
 							  l_Prefs->SavedCameraY(),
@@ -176,16 +227,40 @@ bool PhotoBrowser::Startup()
 
 bool PhotoBrowser::Shutdown()
 {
+	// Write the profiler report of the last frames
+	if(UserPreferences::Instance()->ProfilerReport() != Profiler::ReportFormat_None)
+	{
+		Profiler::Instance()->WriteReport();
+	}
+
 	// Stop the texture loader thread
 	TextureLoader::Instance()->Shutdown();
 
-	// Save the last camera position in the UserPreferences
-	UserPreferences* l_Prefs = UserPreferences::Instance();
-	float l_PosX, l_PosY, l_PosZ;
-	mCamera->GetPosition(l_PosX, l_PosY, l_PosZ);
-	l_Prefs->SavedCameraX(l_PosX);
-	l_Prefs->SavedCameraY(l_PosY);
-	l_Prefs->SavedCameraZ(l_PosZ);
+	// Stop building overview tiles and free their textures
+	OverviewPyramid::Instance()->Shutdown();
+
+	// With the worker threads stopped, write out everything they traced
+	if(Tracer::Instance()->IsEnabled())
+	{
+		Tracer::Instance()->WriteTrace();
+	}
+
+	// And the final stats
+	if(UserPreferences::Instance()->MetricsInterval() > 0.0f)
+	{
+		Metrics::Instance()->WriteStats();
+	}
+
+	// Save the last camera position in the UserPreferences, unless it was only moved by a script
+	if(!mHeadless)
+	{
+		UserPreferences* l_Prefs = UserPreferences::Instance();
+		float l_PosX, l_PosY, l_PosZ;
+		mCamera->GetPosition(l_PosX, l_PosY, l_PosZ);
+		l_Prefs->SavedCameraX(l_PosX);
+		l_Prefs->SavedCameraY(l_PosY);
+		l_Prefs->SavedCameraZ(l_PosZ);
+	}
 
 	// Free images from the image context
 	ImageContext::Instance()->DestroyContext();
@@ -236,7 +311,7 @@ void PhotoBrowser::SelectLayout(unsigned in_Index)
 	mCurrentLayoutChangedThisFrame = mCurrentLayoutIndex != in_Index;
 	mCurrentLayoutIndex = in_Index;
 	LayoutData& l_Data = mRegisteredLayouts[in_Index];
-	l_Data.LayoutRef->DoLayout(ImageContext::Instance(), mCamera, !l_Data.CameraSaved);
+	ApplyCurrentLayout(!l_Data.CameraSaved);
 
 	// Restore the camera position if one was saved
 	if(l_Data.CameraSaved)
@@ -259,21 +334,27 @@ void PhotoBrowser::MainLoop()
 	{
 		double l_FrameTimeTarget = 1.0f / l_Prefs->FramerateLimit();
 
+		// Frames are profiled from here to here
+		Profiler::Instance()->BeginFrame();
+
 		// Process any queued window messages
-		mWindow->ProcessMessages();
+		PROFILE_BLOCK(ProfilePhase_Messages, mWindow->ProcessMessages();)
 
 		// Compute the amount of time that passed since last frame
 		double l_NewFrameTime = Timer::Instance()->GetSeconds();
 		double l_DeltaTime = l_NewFrameTime - l_LastFrameTime;
 
 		// Clamp our framerate to some target
-		while(l_DeltaTime < l_FrameTimeTarget)
 		{
-			Sleep(0); // Yield timeslice
+			PROFILE_SCOPE(ProfilePhase_Wait)
+			while(l_DeltaTime < l_FrameTimeTarget)
+			{
+				Sleep(0); // Yield timeslice
 
-			// Recompute frame time
-			l_NewFrameTime = Timer::Instance()->GetSeconds();
-			l_DeltaTime = l_NewFrameTime - l_LastFrameTime;
+				// Recompute frame time
+				l_NewFrameTime = Timer::Instance()->GetSeconds();
+				l_DeltaTime = l_NewFrameTime - l_LastFrameTime;
+			}
 		}
 
 		// Store the frametime
@@ -281,18 +362,13 @@ void PhotoBrowser::MainLoop()
 
 		// Process the photo browser frame
 		Tick((float)l_DeltaTime);
+		Metrics::Instance()->EndFrame();
 
-		// Update the average frametime
-		mAverageFrameTime = (mAverageFrameTime * 0.75f) + (float)(l_DeltaTime * 0.25f);
-
-		// Should we show the framerate?
-		if(l_Prefs->ShowFramerate())
+		// Should we show the framerate? The profiler report in the title is only rebuilt a few times a second
+		if(l_Prefs->ShowFramerate() && l_NewFrameTime - mLastReportTime >= FRAMERATE_REPORT_INTERVAL)
 		{
-			stringstream l_Title;
-			
-			l_Title << "AvgFPS=" << setprecision(2) << (1.0f/mAverageFrameTime) << " (" << mAverageFrameTime << " ms)"
-					<< " FPS=" << setprecision(4) << (1.0f/l_DeltaTime) << " (" << l_DeltaTime << " ms)";
-			mWindow->SetTitle(l_Title.str());
+			mLastReportTime = l_NewFrameTime;
+			mWindow->SetTitle(Profiler::Instance()->GetReport());
 		}
 
 #ifdef DEBUG
@@ -317,10 +393,13 @@ void PhotoBrowser::Tick(float in_DeltaTime)
 	bool is_outlined;
 
 	// Update the camera
-	mCamera->Tick(in_DeltaTime);
+	PROFILE_BLOCK(ProfilePhase_Camera, mCamera->Tick(in_DeltaTime);)
+
+	// Hand the textures the loader thread finished since last frame to their image tiles
+	PROFILE_BLOCK(ProfilePhase_Completions, TextureLoader::Instance()->ProcessCompletions();)
 
 	// Update controls
-	UpdateControls(in_DeltaTime);
+	PROFILE_BLOCK(ProfilePhase_Controls, UpdateControls(in_DeltaTime);)
 
 	// Should we follow the closest image this frame?
 	if(mCurrentLayoutChangedThisFrame && UserPreferences::Instance()->LayoutImageFollowMode())
@@ -340,7 +419,7 @@ void PhotoBrowser::Tick(float in_DeltaTime)
 
 	// Clear the frame buffer
 	Graphics* l_Graphics = Graphics::Instance();
-	l_Graphics->ClearBuffers();
+	PROFILE_BLOCK(ProfilePhase_Draw, l_Graphics->ClearBuffers();)
 
 	// Apply the camera transform
 	mCamera->Apply();
@@ -351,73 +430,137 @@ void PhotoBrowser::Tick(float in_DeltaTime)
 
 	// Determine which thumbnail size we should be using at the current camera distance
 	float l_CameraDist = mCamera->GetPositionZ();
-	ThumbnailSize l_ThumbnailSize = ThumbnailSize_None;
+	ThumbnailSize l_ThumbnailSize = GetThumbnailSize(l_CameraDist);
 
-	// @TODO - this algorithm needs to be written, arbitrary constant used for now
-	if(l_CameraDist < 30.0f)
+	// Past the thumbnail LODs, draw the pre-rendered overview tiles instead of every image tile.
+	// The overview shows where the image tiles are going, so wait until they get there
+	bool l_DrawOverview = false;
+	if(l_ThumbnailSize == ThumbnailSize_None && !mImageTilesMoving && UserPreferences::Instance()->OverviewPyramidEnabled())
 	{
-		l_ThumbnailSize = ThumbnailSize_64x64;
+		PROFILE_SCOPE(ProfilePhase_Draw)
+		float l_WorldPerPixel = (l_MaxWorldX - l_MinWorldX) / mCamera->GetViewportSizeX();
+		l_DrawOverview = OverviewPyramid::Instance()->Draw(l_MinWorldX, l_MinWorldY, l_MaxWorldX, l_MaxWorldY, l_WorldPerPixel);
 	}
+	mOverviewDrawn = l_DrawOverview;
+	mImageTilesMoving = false;
+
+	// Tiles within the margin around the view are loaded before they come into view
+	float l_MarginX = (l_MaxWorldX - l_MinWorldX) * UserPreferences::Instance()->PrefetchMargin();
+	float l_MarginY = (l_MaxWorldY - l_MinWorldY) * UserPreferences::Instance()->PrefetchMargin();
+	mMarginCandidates.clear();
 
-	// Image tile processing
+	// Image tile processing. The tiles are all updated before any are culled, so the two are timed separately
 	float l_HalfImageSize = UserPreferences::Instance()->ImageSize() * 0.5f;
 	unsigned l_ImageCount = ImageContext::Instance()->GetImageCount();
-	for(unsigned i = 0; i < l_ImageCount; i++)
 	{
-		float l_X, l_Y;
-		ImageTile* l_Tile = ImageContext::Instance()->GetImage(i);
-
-		// If we are looking for the closest image, see if this image is closest
-		if(l_FindClosest)
+		PROFILE_SCOPE(ProfilePhase_TileTick)
+		for(unsigned i = 0; i < l_ImageCount; i++)
 		{
-			// We need the position BEFORE the image is ticked
-			l_Tile->GetPosition(l_X, l_Y);
+			ImageTile* l_Tile = ImageContext::Instance()->GetImage(i);
 
-			// Find the distance of this image from the current mouse position
-			float l_DistX = l_X - l_MouseWorldX;
-			float l_DistY = l_Y - l_MouseWorldY;
-			float l_Dist = (l_DistX * l_DistX + l_DistY * l_DistY);
-			if(l_Dist < l_ClosestImageDistance)
+			// If we are looking for the closest image, see if this image is closest
+			if(l_FindClosest)
 			{
-				// This is the new closest image
-				l_ClosestImageX = l_X;
-				l_ClosestImageY = l_Y;
-				l_ClosestImageDistance = l_Dist;
-				l_ClosestImage = l_Tile;
+				// We need the position BEFORE the image is ticked
+				float l_X, l_Y;
+				l_Tile->GetPosition(l_X, l_Y);
+
+				// Find the distance of this image from the current mouse position
+				float l_DistX = l_X - l_MouseWorldX;
+				float l_DistY = l_Y - l_MouseWorldY;
+				float l_Dist = (l_DistX * l_DistX + l_DistY * l_DistY);
+				if(l_Dist < l_ClosestImageDistance)
+				{
+					// This is the new closest image
+					l_ClosestImageX = l_X;
+					l_ClosestImageY = l_Y;
+					l_ClosestImageDistance = l_Dist;
+					l_ClosestImage = l_Tile;
+				}
 			}
-		}
 
-		// Update the image
-		l_Tile->Tick(in_DeltaTime);
+			// Update the image
+			l_Tile->Tick(in_DeltaTime);
+			mImageTilesMoving |= l_Tile->IsMoving();
+		}
+	}
 
-		// Check if this image is visible
-		l_Tile->GetPosition(l_X, l_Y);
-		if( l_X + l_HalfImageSize < l_MinWorldX || l_X - l_HalfImageSize > l_MaxWorldX ||
-			l_Y + l_HalfImageSize < l_MinWorldY || l_Y - l_HalfImageSize > l_MaxWorldY )
+	{
+		PROFILE_SCOPE(ProfilePhase_Culling)
+		for(unsigned i = 0; i < l_ImageCount; i++)
 		{
-			// If not, don't bother drawing it
-			continue;
+			float l_X, l_Y;
+			ImageTile* l_Tile = ImageContext::Instance()->GetImage(i);
+
+			// Check if this image is visible
+			l_Tile->GetPosition(l_X, l_Y);
+			if( l_X + l_HalfImageSize < l_MinWorldX || l_X - l_HalfImageSize > l_MaxWorldX ||
+				l_Y + l_HalfImageSize < l_MinWorldY || l_Y - l_HalfImageSize > l_MaxWorldY )
+			{
+				// If it is in the margin, remember how far outside the view it is so the nearest tiles are loaded first
+				if( l_ThumbnailSize != ThumbnailSize_None &&
+					l_X + l_HalfImageSize >= l_MinWorldX - l_MarginX && l_X - l_HalfImageSize <= l_MaxWorldX + l_MarginX &&
+					l_Y + l_HalfImageSize >= l_MinWorldY - l_MarginY && l_Y - l_HalfImageSize <= l_MaxWorldY + l_MarginY )
+				{
+					float l_DistX = max(max(l_MinWorldX - (l_X + l_HalfImageSize), (l_X - l_HalfImageSize) - l_MaxWorldX), 0);
+					float l_DistY = max(max(l_MinWorldY - (l_Y + l_HalfImageSize), (l_Y - l_HalfImageSize) - l_MaxWorldY), 0);
+					mMarginCandidates.push_back(make_pair(max(l_DistX, l_DistY), l_Tile));
+				}
+
+				// Don't bother drawing it
+				continue;
+			}
+
+			// Remember it is visible. Thumbnails are requested and drawn once the whole visible set is known
+			mNextVisibleSet.push_back(i);
 		}
+	}
 
-		// Set the thumbnail size to use, then draw the tile
-		l_Tile->ActivateThumbnail(l_ThumbnailSize);
-		// l_Tile->Draw();
+	// Submit loads, promotions and cancellations for the tiles that changed this frame
+	PROFILE_BLOCK(ProfilePhase_Requests, UpdateVisibleSet(l_ThumbnailSize);)
 
-		//NEW/MATTHEW
-		//Outline image if mouse is over it
-	    is_outlined =  l_Tile->Outline(mMousePosX, mMousePosY);
-		
-		if (is_outlined)	
+	// Draw the visible tiles
+	{
+		PROFILE_SCOPE(ProfilePhase_Draw)
+		for(unsigned i = 0; i < mVisibleSet.size(); i++)
 		{
-			//l_Tile->ActivateThumbnail(ThumbnailSize_1024x1024);
-			outlined_img = l_Tile;
-			//l_Tile->GetPosition(outline_imgX, outline_imgY);
-			//l_Tile->GetSize(outline_imgWidth, outline_imgHeight);
+			ImageTile* l_Tile = ImageContext::Instance()->GetImage(mVisibleSet[i]);
+
+			//NEW/MATTHEW
+			//Outline image if mouse is over it
+		    is_outlined =  l_Tile->Outline(mMousePosX, mMousePosY);
+			
+			if (is_outlined)	
+			{
+				//l_Tile->ActivateThumbnail(ThumbnailSize_1024x1024);
+				outlined_img = l_Tile;
+				//l_Tile->GetPosition(outline_imgX, outline_imgY);
+				//l_Tile->GetSize(outline_imgWidth, outline_imgHeight);
+			}
+			else
+				outlined_img = NULL;
+			
+			// The overview tiles already contain this image
+			if(!l_DrawOverview)
+			{
+				l_Tile->Draw();
+			}
 		}
-		else
-			outlined_img = NULL;
-		
-		l_Tile->Draw();
+	}
+	METRIC_ADD(Metric_TilesDrawn, l_DrawOverview ? 0 : (LONG)mVisibleSet.size())
+	METRIC_ADD(Metric_TilesCulled, (LONG)(l_ImageCount - mVisibleSet.size()))
+
+	{
+		PROFILE_SCOPE(ProfilePhase_Prefetch)
+		TextureLoader::Instance()->BeginBatch();
+
+		// Load the thumbnails that are about to come into view
+		PrefetchMargin(l_ThumbnailSize);
+
+		// Load the thumbnails that will be visible once the camera stops moving
+		PrefetchRestingView(l_HalfImageSize);
+
+		TextureLoader::Instance()->EndBatch();
 	}
 
 	// If there is a closest image, then we need to move towards it
@@ -436,11 +579,14 @@ void PhotoBrowser::Tick(float in_DeltaTime)
 	// Draw the right click selection box
 	if(mRightClick)
 	{
-		DrawRightClickSelectionBox();
+		PROFILE_BLOCK(ProfilePhase_Draw, DrawRightClickSelectionBox();)
 	}
 
 	// Swap the window back buffers
-	mWindow->SwapBuffers();
+	PROFILE_BLOCK(ProfilePhase_Swap, mWindow->SwapBuffers();)
+
+	// Fence this frame's texture uploads and release the upload space of frames that are done
+	PROFILE_BLOCK(ProfilePhase_Uploads, Graphics::Instance()->EndFrame();)
 
 	// Reset frame flags
 	mWindowReceivedFocusThisFrame = false;	// Reset the focus flag
@@ -449,10 +595,36 @@ void PhotoBrowser::Tick(float in_DeltaTime)
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
+unsigned PhotoBrowser::GetUntexturedVisibleCount() const
+{
+	if(mOverviewDrawn)
+	{
+		return 0;
+	}
+
+	// Past the thumbnail LODs nothing is loaded, the tiles wait for the overview pyramid if there is one
+	if(mVisibleThumbnailSize == ThumbnailSize_None)
+	{
+		return UserPreferences::Instance()->OverviewPyramidEnabled() ? mVisibleSet.size() : 0;
+	}
+
+	unsigned l_Count = 0;
+	for(unsigned i = 0; i < mVisibleSet.size(); i++)
+	{
+		if(!ImageContext::Instance()->GetImage(mVisibleSet[i])->IsTextured(mVisibleThumbnailSize))
+		{
+			l_Count++;
+		}
+	}
+	return l_Count;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
 void PhotoBrowser::OnResize(int in_SizeX, int in_SizeY)
 {
 	mCamera->ResizeViewport(in_SizeX, in_SizeY);
-	mRegisteredLayouts[mCurrentLayoutIndex].LayoutRef->DoLayout(ImageContext::Instance(), mCamera, false);
+	ApplyCurrentLayout(false);
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -591,6 +763,14 @@ void PhotoBrowser::OnUserPreferenceUpdate()
 	// Update vsync setting
 	mWindow->EnableVerticalSync(l_Prefs->EnableVerticalSync());
 
+	// Start or stop tracing, profiling and the stats file
+	Tracer::Instance()->Configure();
+	Profiler::Instance()->Configure();
+	Metrics::Instance()->Configure();
+
+	// Texture compression and 16 bit color change the layout thumbnails are decoded in
+	TextureLoader::Instance()->Configure();
+
 	// Whenever a user preference changes while the browser is running, apply the layout again
 	if(!Done())
 	{
@@ -603,7 +783,7 @@ void PhotoBrowser::OnUserPreferenceUpdate()
 		// If not, don't do a select, this messes with the camera. Just redo the layout
 		else
 		{
-			mRegisteredLayouts[l_LayoutIndex].LayoutRef->DoLayout(ImageContext::Instance(), mCamera, false);
+			ApplyCurrentLayout(false);
 		}
 	}
 }
@@ -630,6 +810,255 @@ float PhotoBrowser::CalculateDistanceCorrectedZoomValue(float in_ZoomAount)
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
+void PhotoBrowser::ApplyCurrentLayout(bool in_CenterCamera)
+{
+	// Position the image tiles
+	Layout* l_Layout = mRegisteredLayouts[mCurrentLayoutIndex].LayoutRef;
+	l_Layout->DoLayout(ImageContext::Instance(), mCamera, in_CenterCamera);
+
+	// Bring the overview tiles up to date with the new positions
+	OverviewPyramid::Instance()->Build(l_Layout, ImageContext::Instance());
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+ThumbnailSize PhotoBrowser::GetThumbnailSize(float in_CameraDist)
+{
+	// @TODO - this algorithm needs to be written, arbitrary constant used for now
+	if(in_CameraDist < 30.0f)
+	{
+		return ThumbnailSize_64x64;
+	}
+
+	return ThumbnailSize_None;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void PhotoBrowser::UpdateVisibleSet(ThumbnailSize in_ThumbnailSize)
+{
+	// Both sets are in image index order, so they can be diffed in one pass
+	bool l_ThumbnailSizeChanged = in_ThumbnailSize != mVisibleThumbnailSize;
+	ImageContext* l_Context = ImageContext::Instance();
+
+	TextureLoader::Instance()->BeginBatch();
+
+	unsigned l_Old = 0;
+	unsigned l_New = 0;
+	while(l_Old < mVisibleSet.size() || l_New < mNextVisibleSet.size())
+	{
+		// Entered the view
+		if(l_Old == mVisibleSet.size() || (l_New < mNextVisibleSet.size() && mNextVisibleSet[l_New] < mVisibleSet[l_Old]))
+		{
+			l_Context->GetImage(mNextVisibleSet[l_New++])->ActivateThumbnail(in_ThumbnailSize);
+		}
+		// Left the view
+		else if(l_New == mNextVisibleSet.size() || mVisibleSet[l_Old] < mNextVisibleSet[l_New])
+		{
+			l_Context->GetImage(mVisibleSet[l_Old++])->OnLeaveView();
+		}
+		// Still in view, only needs attention if the LOD changed or its last request didn't stick
+		else
+		{
+			ImageTile* l_Tile = l_Context->GetImage(mNextVisibleSet[l_New]);
+			if(l_ThumbnailSizeChanged || l_Tile->NeedsThumbnailRequest(in_ThumbnailSize))
+			{
+				l_Tile->ActivateThumbnail(in_ThumbnailSize);
+			}
+			l_Old++;
+			l_New++;
+		}
+	}
+
+	TextureLoader::Instance()->EndBatch();
+
+	// The new set becomes the current one
+	mVisibleSet.swap(mNextVisibleSet);
+	mNextVisibleSet.clear();
+	mVisibleThumbnailSize = in_ThumbnailSize;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int PhotoBrowser::GetThumbnailLoadCost(ThumbnailSize in_ThumbnailSize)
+{
+	// In units of 64x64 thumbnails. Each step up in size is four times the pixels to read, decode and upload
+	return in_ThumbnailSize > ThumbnailSize_64x64 ? 1 << (2 * (in_ThumbnailSize - ThumbnailSize_64x64)) : 1;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void PhotoBrowser::PrefetchMargin(ThumbnailSize in_ThumbnailSize)
+{
+	TextureLoader* l_Loader = TextureLoader::Instance();
+
+	// Queued margin loads are for the old thumbnail size once the LOD changes
+	if(in_ThumbnailSize != mMarginThumbnailSize)
+	{
+		l_Loader->CancelRequests(LoadPriority_Margin);
+		mMarginThumbnailSize = in_ThumbnailSize;
+	}
+
+	if(mMarginCandidates.empty())
+	{
+		return;
+	}
+
+	// The budget shrinks as the visible (demand) queue fills, and is gone once it reaches the limit,
+	// so the margin never holds up tiles that are already on screen
+	int l_DemandLimit = UserPreferences::Instance()->PrefetchDemandQueueLimit();
+	float l_BudgetScale = 1.0f;
+	if(l_DemandLimit > 0)
+	{
+		unsigned l_Demand = l_Loader->GetPendingCount(LoadPriority_Visible);
+		l_BudgetScale = max(1.0f - (float)l_Demand / l_DemandLimit, 0.0f);
+	}
+
+	// The budget is measured in 64x64 thumbnails, so fewer of the larger LODs fit
+	int l_Cost = GetThumbnailLoadCost(in_ThumbnailSize);
+	int l_Budget = (int)(UserPreferences::Instance()->PrefetchMarginBudget() * l_BudgetScale);
+	l_Budget -= (int)l_Loader->GetPendingCount(LoadPriority_Margin) * l_Cost;
+
+	// Nearest tiles first
+	sort(mMarginCandidates.begin(), mMarginCandidates.end());
+	for(unsigned i = 0; i < mMarginCandidates.size() && l_Budget >= l_Cost; i++)
+	{
+		if(mMarginCandidates[i].second->PrefetchThumbnail(in_ThumbnailSize, LoadPriority_Margin))
+		{
+			l_Budget -= l_Cost;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void PhotoBrowser::PrefetchRestingView(float in_HalfImageSize)
+{
+	// Only worth doing while the camera is coasting or animating. Tiles moving to a new layout have no stable position to predict
+	if(!UserPreferences::Instance()->PredictivePrefetchEnabled() || !mCamera->IsMoving() || mImageTilesMoving)
+	{
+		mPrefetchActive = false;
+		return;
+	}
+
+	// Where will the camera stop, and which thumbnails will it need there?
+	float l_PosX, l_PosY, l_PosZ;
+	float l_RestX, l_RestY, l_RestZ;
+	mCamera->GetPosition(l_PosX, l_PosY, l_PosZ);
+	mCamera->GetRestingPosition(l_RestX, l_RestY, l_RestZ);
+	ThumbnailSize l_ThumbnailSize = GetThumbnailSize(l_RestZ);
+
+	float l_MinX, l_MinY, l_MaxX, l_MaxY;
+	mCamera->GetVisibleWorldBounds(l_RestX, l_RestY, l_RestZ, l_MinX, l_MinY, l_MaxX, l_MaxY);
+	float l_ViewWidth = l_MaxX - l_MinX;
+	float l_ViewHeight = l_MaxY - l_MinY;
+
+	// If the prediction jumped (e.g. the camera was flung again), anything still queued for the old one is wasted work
+	if(mPrefetchActive &&
+		(fabs(l_RestX - mPrefetchRestX) > l_ViewWidth * 0.5f || fabs(l_RestY - mPrefetchRestY) > l_ViewHeight * 0.5f ||
+		 l_ThumbnailSize != mPrefetchThumbnailSize))
+	{
+		TextureLoader::Instance()->CancelRequests(LoadPriority_Prefetch);
+	}
+	mPrefetchActive = true;
+	mPrefetchRestX = l_RestX;
+	mPrefetchRestY = l_RestY;
+	mPrefetchThumbnailSize = l_ThumbnailSize;
+
+	if(l_ThumbnailSize == ThumbnailSize_None)
+	{
+		return;
+	}
+
+	// Don't flood the loader, prefetches are serviced after every visible load
+	int l_Budget = UserPreferences::Instance()->PrefetchMaxPending() - (int)TextureLoader::Instance()->GetPendingCount(LoadPriority_Prefetch);
+	if(l_Budget <= 0)
+	{
+		return;
+	}
+
+	// Sample view rectangles along the path from the current position to the resting position, resting view first.
+	// Samples are at most half a view apart so they overlap and cover everything the camera will pass over
+	const unsigned MAX_PATH_SAMPLES = 16;
+	float l_PathX = l_RestX - l_PosX;
+	float l_PathY = l_RestY - l_PosY;
+	float l_PathZ = l_RestZ - l_PosZ;
+	unsigned l_SampleCount = (unsigned)ceil(max(fabs(l_PathX) / (l_ViewWidth * 0.5f), fabs(l_PathY) / (l_ViewHeight * 0.5f)));
+	l_SampleCount = min(max(l_SampleCount, 1u), MAX_PATH_SAMPLES);
+
+	float l_SampleBounds[MAX_PATH_SAMPLES][4];
+	float l_UnionBounds[4] = { l_MinX, l_MinY, l_MaxX, l_MaxY };
+	for(unsigned s = 0; s < l_SampleCount; s++)
+	{
+		// Sample 0 is the resting position, the last sample is one step away from the current position
+		float l_T = 1.0f - (float)s / l_SampleCount;
+		float* l_Bounds = l_SampleBounds[s];
+		mCamera->GetVisibleWorldBounds(l_PosX + l_PathX * l_T, l_PosY + l_PathY * l_T, l_PosZ + l_PathZ * l_T,
+									   l_Bounds[0], l_Bounds[1], l_Bounds[2], l_Bounds[3]);
+
+		l_UnionBounds[0] = min(l_UnionBounds[0], l_Bounds[0]);
+		l_UnionBounds[1] = min(l_UnionBounds[1], l_Bounds[1]);
+		l_UnionBounds[2] = max(l_UnionBounds[2], l_Bounds[2]);
+		l_UnionBounds[3] = max(l_UnionBounds[3], l_Bounds[3]);
+	}
+
+	// The tiles visible right now are loaded at visible priority by the tile loop
+	float l_VisibleMinX, l_VisibleMinY, l_VisibleMaxX, l_VisibleMaxY;
+	mCamera->GetVisibleWorldBounds(l_VisibleMinX, l_VisibleMinY, l_VisibleMaxX, l_VisibleMaxY);
+
+	// Find the tiles along the path, keyed by the first sample that contains them
+	vector< pair<unsigned, ImageTile*> > l_Candidates;
+	unsigned l_ImageCount = ImageContext::Instance()->GetImageCount();
+	for(unsigned i = 0; i < l_ImageCount; i++)
+	{
+		float l_X, l_Y;
+		ImageTile* l_Tile = ImageContext::Instance()->GetImage(i);
+		l_Tile->GetPosition(l_X, l_Y);
+
+		float l_TileMinX = l_X - in_HalfImageSize;
+		float l_TileMinY = l_Y - in_HalfImageSize;
+		float l_TileMaxX = l_X + in_HalfImageSize;
+		float l_TileMaxY = l_Y + in_HalfImageSize;
+
+		// Quick rejection against the whole path
+		if( l_TileMaxX < l_UnionBounds[0] || l_TileMinX > l_UnionBounds[2] ||
+			l_TileMaxY < l_UnionBounds[1] || l_TileMinY > l_UnionBounds[3] )
+		{
+			continue;
+		}
+
+		// Already visible
+		if( !(l_TileMaxX < l_VisibleMinX || l_TileMinX > l_VisibleMaxX ||
+			  l_TileMaxY < l_VisibleMinY || l_TileMinY > l_VisibleMaxY) )
+		{
+			continue;
+		}
+
+		for(unsigned s = 0; s < l_SampleCount; s++)
+		{
+			const float* l_Bounds = l_SampleBounds[s];
+			if( !(l_TileMaxX < l_Bounds[0] || l_TileMinX > l_Bounds[2] ||
+				  l_TileMaxY < l_Bounds[1] || l_TileMinY > l_Bounds[3]) )
+			{
+				l_Candidates.push_back(make_pair(s, l_Tile));
+				break;
+			}
+		}
+	}
+
+	// Request the resting view first, then work back along the path (ties stay in image order)
+	sort(l_Candidates.begin(), l_Candidates.end());
+	for(unsigned i = 0; i < l_Candidates.size() && l_Budget > 0; i++)
+	{
+		if(l_Candidates[i].second->PrefetchThumbnail(l_ThumbnailSize))
+		{
+			l_Budget--;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
 void PhotoBrowser::DrawRightClickSelectionBox()
 {
 	// Draw an outlined quad
@@ -788,6 +1217,22 @@ void PhotoBrowser::UpdateControls(float in_DeltaTime)
 		mWindow->ShowUserPreferencesDialog(!mWindow->IsUserPreferencesDialogVisible());
 	}
 
+	// F2 key
+	// Write the profiler report
+	if(mKeys[VirtualKey_F2])
+	{
+		mKeys[VirtualKey_F2] = false;
+		Profiler::Instance()->WriteReport();
+	}
+
+	// F3 key
+	// Write the event trace recorded so far
+	if(mKeys[VirtualKey_F3])
+	{
+		mKeys[VirtualKey_F3] = false;
+		Tracer::Instance()->WriteTrace();
+	}
+
 	// V key
 	// Toggle layout
 	if(mKeys['V'])
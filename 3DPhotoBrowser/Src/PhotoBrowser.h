@@ -60,9 +60,10 @@ public:
 
 	/**
 	 * Startup
-	 * Must be called once before the window message loop begins
+	 * Must be called once before the window message loop begins. A headless browser has no window and draws nothing,
+	 * it is driven by calling Tick and moving its camera directly
 	 */
-	bool Startup();
+	bool Startup(bool in_Headless = false);
 
 	/**
 	 * Shutdown
@@ -125,6 +126,19 @@ public:
 	 */
 	void Tick(float in_DeltaTime);
 
+	/**
+	 * GetCamera
+	 * The application camera, for driving a headless browser
+	 */
+	Camera* GetCamera() { return mCamera; }
+
+	/**
+	 * GetUntexturedVisibleCount
+	 * Number of image tiles visible last frame still waiting for their thumbnail, or for the overview tiles that
+	 * replace them once the camera is past the thumbnail LODs. Zero once the view is fully textured
+	 */
+	unsigned GetUntexturedVisibleCount() const;
+
 	/**
 	 * WindowListener interface
 	 */
@@ -159,6 +173,12 @@ protected:
 	 */
 	float CalculateDistanceCorrectedZoomValue(float in_ZoomAount);
 	void DrawRightClickSelectionBox();	
+	void ApplyCurrentLayout(bool in_CenterCamera);
+	void PrefetchRestingView(float in_HalfImageSize);
+	void PrefetchMargin(ThumbnailSize in_ThumbnailSize);
+	void UpdateVisibleSet(ThumbnailSize in_ThumbnailSize);
+	static ThumbnailSize GetThumbnailSize(float in_CameraDist);
+	static int GetThumbnailLoadCost(ThumbnailSize in_ThumbnailSize);
 	void UpdateControls(float in_DeltaTime);
 	void DebounceKeys();
 
@@ -180,11 +200,29 @@ private:
 
 	string mWindowTitle;					// The application window title
 
-	float mAverageFrameTime;				// The average frame time delta
+	double mLastReportTime;					// When the framerate report in the window title was last updated
+
+	bool mImageTilesMoving;					// Were any image tiles animating to a new layout position last frame?
+	bool mOverviewDrawn;					// Were the overview tiles drawn in place of the image tiles last frame?
+
+	// Predictive prefetch
+	bool mPrefetchActive;					// Were prefetches issued for a predicted camera resting position?
+	float mPrefetchRestX, mPrefetchRestY;	// The predicted resting position the prefetches were issued for
+	ThumbnailSize mPrefetchThumbnailSize;	// The thumbnail size the prefetches were issued for
+
+	// Visible set
+	vector<unsigned> mVisibleSet;			// Indices of the image tiles visible last frame, in increasing order
+	vector<unsigned> mNextVisibleSet;		// Visible set being built for this frame
+	ThumbnailSize mVisibleThumbnailSize;	// The thumbnail size activated on the visible set
+
+	// Margin prefetch
+	ThumbnailSize mMarginThumbnailSize;					// The thumbnail size the queued margin loads were issued for
+	vector< pair<float, ImageTile*> > mMarginCandidates;	// Tiles in the margin this frame, with their distance from the view
 
 	Window* mWindow;						// The application window
 	Camera* mCamera;						// The application camera
 	bool mDone;								// Is the app done yet?
+	bool mHeadless;							// Running without a window, see Startup
 
 	int mCurrentLayoutIndex;				// The current application layout
 	vector<LayoutData> mRegisteredLayouts;	// The registered layouts
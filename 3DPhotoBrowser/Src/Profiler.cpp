@@ -0,0 +1,320 @@
+/**
+ * @file Profiler.cpp
+ * @brief Frame phase profiler implementation file
+ */
+
+#include "Profiler.h"
+#include "Tracer.h"
+
+// Report files
+#define PROFILE_FRAMES_FILENAME "data/Profile.csv"
+#define PROFILE_TRACE_FILENAME "data/Profile.json"
+#define PROFILE_SUMMARY_FILENAME "data/ProfileSummary.csv"
+
+/**
+ * REPORT_SLOWEST_PHASES
+ * How many of the slowest phases the window title report lists
+ */
+#define REPORT_SLOWEST_PHASES 3
+
+static const char* s_PhaseNames[ProfilePhase_MAX] =
+{
+	"Frame",
+	"Messages",
+	"Wait",
+	"Camera",
+	"Completions",
+	"Controls",
+	"TileTick",
+	"Culling",
+	"Requests",
+	"Draw",
+	"Prefetch",
+	"Swap",
+	"Uploads",
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * Percentile
+ * The nearest rank percentile in_Fraction of io_Values, which are reordered
+ */
+static float Percentile(vector<float>& io_Values, float in_Fraction)
+{
+	unsigned l_Rank = (unsigned)ceil(in_Fraction * io_Values.size());
+	unsigned l_Index = l_Rank > 0 ? min(l_Rank - 1, (unsigned)io_Values.size() - 1) : 0;
+	nth_element(io_Values.begin(), io_Values.begin() + l_Index, io_Values.end());
+	return io_Values[l_Index];
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Profiler
+
+Profiler::Profiler()
+: mEnabled(false)
+, mFrameCount(0)
+, mInFrame(false)
+{
+	memset(&mCurrent, 0, sizeof(mCurrent));
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::Configure()
+{
+	UserPreferences* l_Prefs = UserPreferences::Instance();
+#if USE_PROFILER
+	bool l_Enabled = l_Prefs->ShowFramerate() || l_Prefs->ProfilerReport() != ReportFormat_None || Tracer::Instance()->IsEnabled();
+#else
+	bool l_Enabled = false;
+#endif // USE_PROFILER
+	unsigned l_Size = l_Enabled ? (unsigned)max(1, l_Prefs->ProfilerFrameCount()) : 0;
+
+	// Start recording again whenever the ring changes
+	if(l_Enabled != mEnabled || l_Size != mFrames.size())
+	{
+		vector<FrameData>(l_Size).swap(mFrames);
+		mFrameCount = 0;
+		mInFrame = false;
+	}
+	mEnabled = l_Enabled;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::BeginFrame()
+{
+	if(!mEnabled)
+	{
+		return;
+	}
+
+	// The frame lasts until the next one starts
+	double l_Now = Timer::Instance()->GetSeconds();
+	if(mInFrame)
+	{
+		Tracer::Instance()->Complete(s_PhaseNames[ProfilePhase_Frame], mCurrent.Start, l_Now);
+		mCurrent.Time[ProfilePhase_Frame] = (float)(l_Now - mCurrent.Start);
+		mFrames[mFrameCount % mFrames.size()] = mCurrent;
+		mFrameCount++;
+	}
+
+	memset(&mCurrent, 0, sizeof(mCurrent));
+	mCurrent.Start = l_Now;
+	mInFrame = true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Profiler::AddPhase(ProfilePhase in_Phase, double in_Start, double in_End)
+{
+	if(!mInFrame)
+	{
+		return;
+	}
+
+	// A phase that runs more than once in a frame adds up, and keeps the offset of its first run
+	if(mCurrent.Time[in_Phase] == 0.0f)
+	{
+		mCurrent.Offset[in_Phase] = (float)(in_Start - mCurrent.Start);
+	}
+	mCurrent.Time[in_Phase] += (float)(in_End - in_Start);
+
+	// The phases are slices of the main thread in the event trace too
+	Tracer::Instance()->Complete(s_PhaseNames[in_Phase], in_Start, in_End);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+const Profiler::FrameData& Profiler::GetFrame(unsigned in_Index) const
+{
+	// Oldest first. Once the ring has wrapped, the oldest frame is the next one to be overwritten
+	if(mFrameCount <= mFrames.size())
+	{
+		return mFrames[in_Index];
+	}
+	return mFrames[(mFrameCount + in_Index) % mFrames.size()];
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Profiler::Summarize(ProfilePhase in_Phase, ProfileSummary& out_Summary)
+{
+	unsigned l_Count = GetFrameCount();
+	if(l_Count == 0)
+	{
+		return false;
+	}
+
+	mScratch.resize(l_Count);
+	double l_Total = 0.0;
+	for(unsigned i = 0; i < l_Count; i++)
+	{
+		mScratch[i] = GetFrame(i).Time[in_Phase] * 1000.0f;
+		l_Total += mScratch[i];
+	}
+
+	out_Summary.Max = *max_element(mScratch.begin(), mScratch.end());
+	out_Summary.Mean = (float)(l_Total / l_Count);
+	out_Summary.P50 = Percentile(mScratch, 0.50f);
+	out_Summary.P95 = Percentile(mScratch, 0.95f);
+	out_Summary.P99 = Percentile(mScratch, 0.99f);
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+string Profiler::GetReport()
+{
+	ProfileSummary l_Frame;
+	if(!Summarize(ProfilePhase_Frame, l_Frame))
+	{
+		return "";
+	}
+
+	stringstream l_Report;
+	l_Report << fixed << setprecision(1) << "FPS=" << (l_Frame.Mean > 0.0f ? 1000.0f / l_Frame.Mean : 0.0f)
+			 << " Frame p50/p95/p99=" << setprecision(2) << l_Frame.P50 << "/" << l_Frame.P95 << "/" << l_Frame.P99 << " ms";
+
+	// The slowest phases at p95. The framerate limit wait isn't work, so it is left out
+	vector< pair<float, int> > l_Phases;
+	for(int i = ProfilePhase_Frame + 1; i < ProfilePhase_MAX; i++)
+	{
+		ProfileSummary l_Summary;
+		if(i != ProfilePhase_Wait && Summarize((ProfilePhase)i, l_Summary) && l_Summary.P95 > 0.0f)
+		{
+			l_Phases.push_back(make_pair(l_Summary.P95, i));
+		}
+	}
+	sort(l_Phases.begin(), l_Phases.end(), greater< pair<float, int> >());
+
+	l_Report << " | p95";
+	for(unsigned i = 0; i < l_Phases.size() && i < REPORT_SLOWEST_PHASES; i++)
+	{
+		l_Report << " " << s_PhaseNames[l_Phases[i].second] << "=" << l_Phases[i].first;
+	}
+	l_Report << " ms";
+	return l_Report.str();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Profiler::WriteReport()
+{
+	if(GetFrameCount() == 0)
+	{
+		return false;
+	}
+
+	// The report is written on request even without a format preference, as CSV
+	bool l_Written;
+	if(UserPreferences::Instance()->ProfilerReport() == ReportFormat_ChromeTrace)
+	{
+		l_Written = WriteChromeTrace(PROFILE_TRACE_FILENAME);
+	}
+	else
+	{
+		l_Written = WriteFramesCSV(PROFILE_FRAMES_FILENAME);
+	}
+	l_Written = WriteSummaryCSV(PROFILE_SUMMARY_FILENAME) && l_Written;
+
+	logf("Profiler: %s the report of %u frames", l_Written ? "wrote" : "failed to write", GetFrameCount());
+	return l_Written;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Profiler::WriteFramesCSV(const char* in_Filename)
+{
+	ofstream l_File;
+	l_File.open(in_Filename);
+	if(l_File.fail())
+	{
+		return false;
+	}
+
+	// One row per frame, oldest first, with the times in milliseconds
+	l_File << "Index,Start";
+	for(int i = 0; i < ProfilePhase_MAX; i++)
+	{
+		l_File << "," << s_PhaseNames[i];
+	}
+	l_File << endl << fixed << setprecision(3);
+
+	double l_FirstStart = GetFrame(0).Start;
+	for(unsigned f = 0; f < GetFrameCount(); f++)
+	{
+		const FrameData& l_Frame = GetFrame(f);
+		l_File << f << "," << (l_Frame.Start - l_FirstStart) * 1000.0;
+		for(int i = 0; i < ProfilePhase_MAX; i++)
+		{
+			l_File << "," << l_Frame.Time[i] * 1000.0f;
+		}
+		l_File << endl;
+	}
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Profiler::WriteChromeTrace(const char* in_Filename)
+{
+	ofstream l_File;
+	l_File.open(in_Filename);
+	if(l_File.fail())
+	{
+		return false;
+	}
+
+	// Complete events in microseconds, with the phases nested inside their frame on the main thread's track
+	l_File << "{\"traceEvents\":[" << endl
+		   << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Main\"}}";
+	l_File << fixed << setprecision(3);
+
+	double l_FirstStart = GetFrame(0).Start;
+	for(unsigned f = 0; f < GetFrameCount(); f++)
+	{
+		const FrameData& l_Frame = GetFrame(f);
+		double l_FrameStart = (l_Frame.Start - l_FirstStart) * 1000000.0;
+		for(int i = 0; i < ProfilePhase_MAX; i++)
+		{
+			if(l_Frame.Time[i] > 0.0f)
+			{
+				l_File << "," << endl << "{\"name\":\"" << s_PhaseNames[i] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+					   << l_FrameStart + l_Frame.Offset[i] * 1000000.0 << ",\"dur\":" << l_Frame.Time[i] * 1000000.0 << "}";
+			}
+		}
+	}
+	l_File << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Profiler::WriteSummaryCSV(const char* in_Filename)
+{
+	ofstream l_File;
+	l_File.open(in_Filename);
+	if(l_File.fail())
+	{
+		return false;
+	}
+
+	l_File << "Phase,P50,P95,P99,Max,Mean" << endl << fixed << setprecision(3);
+	for(int i = 0; i < ProfilePhase_MAX; i++)
+	{
+		ProfileSummary l_Summary;
+		Summarize((ProfilePhase)i, l_Summary);
+		l_File << s_PhaseNames[i] << "," << l_Summary.P50 << "," << l_Summary.P95 << "," << l_Summary.P99 << ","
+			   << l_Summary.Max << "," << l_Summary.Mean << endl;
+	}
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+const char* Profiler::GetPhaseName(ProfilePhase in_Phase)
+{
+	return s_PhaseNames[in_Phase];
+}
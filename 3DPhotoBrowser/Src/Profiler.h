@@ -0,0 +1,192 @@
+/**
+ * @file Profiler.h
+ * @brief Frame phase profiler header file
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "Global.h"
+
+/**
+ * ProfilePhase
+ * The timed phases of a frame. ProfilePhase_Frame is the whole frame, from one frame start to the next
+ */
+enum ProfilePhase
+{
+	ProfilePhase_Frame,
+	ProfilePhase_Messages,		// Window message processing
+	ProfilePhase_Wait,			// Waiting out the framerate limit
+	ProfilePhase_Camera,		// Camera tick
+	ProfilePhase_Completions,	// Handing finished texture loads to their image tiles
+	ProfilePhase_Controls,		// Mouse and keyboard controls
+	ProfilePhase_TileTick,		// Image tile animation
+	ProfilePhase_Culling,		// Finding the visible and margin tiles
+	ProfilePhase_Requests,		// Submitting loads, promotions and cancellations for the visible set
+	ProfilePhase_Draw,			// Drawing the overview and the visible tiles
+	ProfilePhase_Prefetch,		// Margin and resting view prefetch requests
+	ProfilePhase_Swap,			// Swapping the back buffers
+	ProfilePhase_Uploads,		// Fencing the frame's texture uploads
+	ProfilePhase_MAX,
+};
+
+/**
+ * ProfileSummary
+ * Frame time statistics of one phase over the recorded frames, in milliseconds
+ */
+struct ProfileSummary
+{
+	float P50;
+	float P95;
+	float P99;
+	float Max;
+	float Mean;
+};
+
+/**
+ * Profiler
+ * Singleton recording how long each phase of the last frames took. Each frame is one entry of a ring, so the
+ * report always covers the most recent ProfilerFrameCount frames. Phases are timed with PROFILE_BLOCK or
+ * PROFILE_SCOPE on the main thread; while the profiler is off they cost a flag test.
+ * The report goes to the window title while the framerate is shown, and to a file on F2 and at shutdown when the
+ * ProfilerReport preference asks for one
+ */
+class Profiler
+{
+	/**
+	 * FrameData
+	 * The phase times of one frame, in seconds. Phases that didn't run have a zero time
+	 */
+	struct FrameData
+	{
+		double Start;						// Timer seconds when the frame started
+		float Offset[ProfilePhase_MAX];		// When each phase first started, relative to Start
+		float Time[ProfilePhase_MAX];		// Total time spent in each phase
+	};
+
+public:
+
+	/**
+	 * Instance
+	 * Get the singleton instance
+	 */
+	static Profiler* Instance() { static Profiler l_Instance; return &l_Instance; }
+
+	/**
+	 * ReportFormat
+	 * The ProfilerReport preference values
+	 */
+	enum ReportFormat
+	{
+		ReportFormat_None,
+		ReportFormat_CSV,			// One row per frame, with the phase times in milliseconds
+		ReportFormat_ChromeTrace,	// Trace event JSON, for chrome://tracing
+	};
+
+	/**
+	 * Configure
+	 * Apply the profiler preferences. The profiler runs while the framerate is shown, a report file is wanted or
+	 * events are traced, which record the phases as slices of the main thread. Configure the tracer first
+	 */
+	void Configure();
+
+	/**
+	 * IsEnabled
+	 * Are phases being recorded?
+	 */
+	bool IsEnabled() const { return mEnabled; }
+
+	/**
+	 * BeginFrame
+	 * Start recording a new frame, ending the previous one
+	 */
+	void BeginFrame();
+
+	/**
+	 * AddPhase
+	 * Record that in_Phase ran from in_Start to in_End, in timer seconds, during the current frame
+	 */
+	void AddPhase(ProfilePhase in_Phase, double in_Start, double in_End);
+
+	/**
+	 * GetFrameCount
+	 * The number of complete frames recorded
+	 */
+	unsigned GetFrameCount() const { return min(mFrameCount, (unsigned)mFrames.size()); }
+
+	/**
+	 * Summarize
+	 * Compute the statistics of a phase over the recorded frames. Returns false if no frames are recorded
+	 */
+	bool Summarize(ProfilePhase in_Phase, ProfileSummary& out_Summary);
+
+	/**
+	 * GetReport
+	 * A one line report of the frame time percentiles and the slowest phases, for the window title
+	 */
+	string GetReport();
+
+	/**
+	 * WriteReport
+	 * Write the recorded frames, as a Chrome trace if the ProfilerReport preference asks for one and as CSV otherwise,
+	 * and the phase summaries as CSV next to them
+	 */
+	bool WriteReport();
+
+	/**
+	 * GetPhaseName
+	 * The name of a phase, as used in the reports
+	 */
+	static const char* GetPhaseName(ProfilePhase in_Phase);
+
+private:
+
+	/**
+	 * Helpers
+	 */
+	const FrameData& GetFrame(unsigned in_Index) const;
+	bool WriteFramesCSV(const char* in_Filename);
+	bool WriteChromeTrace(const char* in_Filename);
+	bool WriteSummaryCSV(const char* in_Filename);
+
+	/**
+	 * Singleton implementation
+	 */
+	Profiler();
+	Profiler(const Profiler&);
+	Profiler& operator=(const Profiler&);
+
+	bool mEnabled;					// Are phases being recorded?
+	vector<FrameData> mFrames;		// Ring of the recorded frames
+	unsigned mFrameCount;			// Frames completed since recording started
+	FrameData mCurrent;				// The frame being recorded
+	bool mInFrame;					// Has BeginFrame started mCurrent?
+	vector<float> mScratch;			// Phase times being sorted by Summarize
+};
+
+/**
+ * ProfileScope
+ * Times the rest of the enclosing scope as a phase of the current frame
+ */
+class ProfileScope
+{
+public:
+
+	ProfileScope(ProfilePhase in_Phase)
+		: mPhase(in_Phase), mStart(Profiler::Instance()->IsEnabled() ? Timer::Instance()->GetSeconds() : -1.0) {}
+
+	~ProfileScope()
+	{
+		if(mStart >= 0.0)
+		{
+			Profiler::Instance()->AddPhase(mPhase, mStart, Timer::Instance()->GetSeconds());
+		}
+	}
+
+private:
+
+	ProfilePhase mPhase;
+	double mStart;			// Negative while the profiler is off
+};
+
+#endif // PROFILER_H_
@@ -0,0 +1,562 @@
+/**
+ * @file TextureCompression.cpp
+ * @brief BC1 and BC3 texture compression implementation file
+ *
+ * A BC1 block is two RGB565 endpoint colors and a 2 bit index per pixel into the four colors on the line between
+ * them. BC3 adds an alpha block in front, two 8 bit endpoints and a 3 bit index per pixel into eight alphas.
+ * The encoder takes the bounding box of the block's colors, flips its diagonal to follow the colors' main
+ * direction, insets it to allow for the quantization, then refits the endpoints to the chosen indices by
+ * least squares
+ */
+
+#include "TextureCompression.h"
+
+#if USE_SSE2_TEXTURE_COMPRESSION
+	#include <emmintrin.h>
+#endif // USE_SSE2_TEXTURE_COMPRESSION
+
+/**
+ * REFINE_PASSES
+ * Number of least squares refits of the color endpoints. Each one is kept only if it lowers the error
+ */
+#define REFINE_PASSES 2
+
+/**
+ * s_Weights
+ * Weight of the first and second endpoint in each of the four BC1 palette colors, in thirds
+ */
+static const int s_Weights[4][2] = { { 3, 0 }, { 0, 3 }, { 2, 1 }, { 1, 2 } };
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * PackRGB565 / UnpackRGB565
+ * Convert between 8 bit channels and a 565 color, replicating the top bits into the bottom ones on the way out
+ */
+static inline unsigned short PackRGB565(int in_Red, int in_Green, int in_Blue)
+{
+	return (unsigned short)((((in_Red * 31 + 127) / 255) << 11) | (((in_Green * 63 + 127) / 255) << 5) | ((in_Blue * 31 + 127) / 255));
+}
+
+static inline void UnpackRGB565(unsigned short in_Color, int out_Color[3])
+{
+	int l_Red = (in_Color >> 11) & 31;
+	int l_Green = (in_Color >> 5) & 63;
+	int l_Blue = in_Color & 31;
+	out_Color[0] = (l_Red << 3) | (l_Red >> 2);
+	out_Color[1] = (l_Green << 2) | (l_Green >> 4);
+	out_Color[2] = (l_Blue << 3) | (l_Blue >> 2);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetBlockBounds
+ * Smallest and largest value of each channel over the 16 RGBA pixels of a block
+ */
+static void GetBlockBounds(const unsigned char* in_Pixels, unsigned char out_Min[4], unsigned char out_Max[4])
+{
+#if USE_SSE2_TEXTURE_COMPRESSION
+	// Four pixels per register, then fold the four lanes together
+	__m128i l_Min = _mm_loadu_si128((const __m128i*)in_Pixels);
+	__m128i l_Max = l_Min;
+	for(int i = 1; i < 4; i++)
+	{
+		__m128i l_Pixels = _mm_loadu_si128((const __m128i*)(in_Pixels + i * 16));
+		l_Min = _mm_min_epu8(l_Min, l_Pixels);
+		l_Max = _mm_max_epu8(l_Max, l_Pixels);
+	}
+	l_Min = _mm_min_epu8(l_Min, _mm_shuffle_epi32(l_Min, _MM_SHUFFLE(2, 3, 0, 1)));
+	l_Max = _mm_max_epu8(l_Max, _mm_shuffle_epi32(l_Max, _MM_SHUFFLE(2, 3, 0, 1)));
+	l_Min = _mm_min_epu8(l_Min, _mm_shuffle_epi32(l_Min, _MM_SHUFFLE(1, 0, 3, 2)));
+	l_Max = _mm_max_epu8(l_Max, _mm_shuffle_epi32(l_Max, _MM_SHUFFLE(1, 0, 3, 2)));
+
+	int l_MinPixel = _mm_cvtsi128_si32(l_Min);
+	int l_MaxPixel = _mm_cvtsi128_si32(l_Max);
+	memcpy(out_Min, &l_MinPixel, 4);
+	memcpy(out_Max, &l_MaxPixel, 4);
+#else
+	memcpy(out_Min, in_Pixels, 4);
+	memcpy(out_Max, in_Pixels, 4);
+	for(int i = 1; i < 16; i++)
+	{
+		for(int c = 0; c < 4; c++)
+		{
+			out_Min[c] = min(out_Min[c], in_Pixels[i * 4 + c]);
+			out_Max[c] = max(out_Max[c], in_Pixels[i * 4 + c]);
+		}
+	}
+#endif // USE_SSE2_TEXTURE_COMPRESSION
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetPalette
+ * The four colors a BC1 block with these endpoints decodes to, in four color mode
+ */
+static void GetPalette(unsigned short in_Color0, unsigned short in_Color1, int out_Palette[4][3])
+{
+	UnpackRGB565(in_Color0, out_Palette[0]);
+	UnpackRGB565(in_Color1, out_Palette[1]);
+	for(int c = 0; c < 3; c++)
+	{
+		out_Palette[2][c] = (2 * out_Palette[0][c] + out_Palette[1][c]) / 3;
+		out_Palette[3][c] = (out_Palette[0][c] + 2 * out_Palette[1][c]) / 3;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * ChooseIndices
+ * Pick the nearest palette color for each pixel. Returns the indices packed as they are stored, and the total
+ * squared error in out_Error
+ */
+static unsigned ChooseIndices(const unsigned char* in_Pixels, unsigned short in_Color0, unsigned short in_Color1, unsigned& out_Error)
+{
+	int l_Palette[4][3];
+	GetPalette(in_Color0, in_Color1, l_Palette);
+
+#if USE_SSE2_TEXTURE_COMPRESSION
+	// Four pixels at a time. Each pixel's squared distance is summed from 16 bit channel differences with a
+	// multiply-add, which gives red + green and blue + alpha, and alpha is masked to zero
+	const __m128i l_ColorMask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i l_Zero = _mm_setzero_si128();
+	__m128i l_Palette16[4];
+	for(int j = 0; j < 4; j++)
+	{
+		l_Palette16[j] = _mm_setr_epi16((short)l_Palette[j][0], (short)l_Palette[j][1], (short)l_Palette[j][2], 0,
+										(short)l_Palette[j][0], (short)l_Palette[j][1], (short)l_Palette[j][2], 0);
+	}
+
+	unsigned l_Indices = 0;
+	__m128i l_ErrorSum = l_Zero;
+	for(int i = 0; i < 4; i++)
+	{
+		__m128i l_Pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(in_Pixels + i * 16)), l_ColorMask);
+		__m128i l_Low = _mm_unpacklo_epi8(l_Pixels, l_Zero);
+		__m128i l_High = _mm_unpackhi_epi8(l_Pixels, l_Zero);
+
+		__m128i l_BestError = _mm_set1_epi32(0x7FFFFFFF);
+		__m128i l_BestIndex = l_Zero;
+		for(int j = 0; j < 4; j++)
+		{
+			__m128i l_DifferenceLow = _mm_sub_epi16(l_Low, l_Palette16[j]);
+			__m128i l_DifferenceHigh = _mm_sub_epi16(l_High, l_Palette16[j]);
+			__m128 l_SquaresLow = _mm_castsi128_ps(_mm_madd_epi16(l_DifferenceLow, l_DifferenceLow));
+			__m128 l_SquaresHigh = _mm_castsi128_ps(_mm_madd_epi16(l_DifferenceHigh, l_DifferenceHigh));
+			__m128i l_Error = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(l_SquaresLow, l_SquaresHigh, _MM_SHUFFLE(2, 0, 2, 0))),
+											_mm_castps_si128(_mm_shuffle_ps(l_SquaresLow, l_SquaresHigh, _MM_SHUFFLE(3, 1, 3, 1))));
+
+			// Strictly less, so ties keep the lower index like the scalar version
+			__m128i l_Better = _mm_cmplt_epi32(l_Error, l_BestError);
+			l_BestError = _mm_or_si128(_mm_and_si128(l_Better, l_Error), _mm_andnot_si128(l_Better, l_BestError));
+			l_BestIndex = _mm_or_si128(_mm_and_si128(l_Better, _mm_set1_epi32(j)), _mm_andnot_si128(l_Better, l_BestIndex));
+		}
+		l_ErrorSum = _mm_add_epi32(l_ErrorSum, l_BestError);
+
+		int l_Index[4];
+		_mm_storeu_si128((__m128i*)l_Index, l_BestIndex);
+		l_Indices |= (l_Index[0] | (l_Index[1] << 2) | (l_Index[2] << 4) | (l_Index[3] << 6)) << (i * 8);
+	}
+
+	int l_Errors[4];
+	_mm_storeu_si128((__m128i*)l_Errors, l_ErrorSum);
+	out_Error = l_Errors[0] + l_Errors[1] + l_Errors[2] + l_Errors[3];
+	return l_Indices;
+#else
+	unsigned l_Indices = 0;
+	out_Error = 0;
+	for(int i = 0; i < 16; i++)
+	{
+		const unsigned char* l_Pixel = in_Pixels + i * 4;
+		unsigned l_BestError = ~0u;
+		unsigned l_BestIndex = 0;
+		for(unsigned j = 0; j < 4; j++)
+		{
+			int l_Red = l_Pixel[0] - l_Palette[j][0];
+			int l_Green = l_Pixel[1] - l_Palette[j][1];
+			int l_Blue = l_Pixel[2] - l_Palette[j][2];
+			unsigned l_Error = l_Red * l_Red + l_Green * l_Green + l_Blue * l_Blue;
+			if(l_Error < l_BestError)
+			{
+				l_BestError = l_Error;
+				l_BestIndex = j;
+			}
+		}
+		l_Indices |= l_BestIndex << (i * 2);
+		out_Error += l_BestError;
+	}
+	return l_Indices;
+#endif // USE_SSE2_TEXTURE_COMPRESSION
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * RefitEndpoints
+ * Least squares endpoints for a fixed set of indices. Returns false if every pixel uses the same weights,
+ * which leaves the endpoints undetermined
+ */
+static bool RefitEndpoints(const unsigned char* in_Pixels, unsigned in_Indices, unsigned short& out_Color0, unsigned short& out_Color1)
+{
+	int l_AA = 0, l_BB = 0, l_AB = 0;
+	int l_AX[3] = { 0, 0, 0 };
+	int l_BX[3] = { 0, 0, 0 };
+	for(int i = 0; i < 16; i++)
+	{
+		unsigned l_Index = (in_Indices >> (i * 2)) & 3;
+		int l_A = s_Weights[l_Index][0];
+		int l_B = s_Weights[l_Index][1];
+		l_AA += l_A * l_A;
+		l_BB += l_B * l_B;
+		l_AB += l_A * l_B;
+		for(int c = 0; c < 3; c++)
+		{
+			l_AX[c] += l_A * in_Pixels[i * 4 + c];
+			l_BX[c] += l_B * in_Pixels[i * 4 + c];
+		}
+	}
+
+	int l_Determinant = l_AA * l_BB - l_AB * l_AB;
+	if(l_Determinant == 0)
+	{
+		return false;
+	}
+
+	// The weights are in thirds, which scales the solution by 3
+	int l_Color0[3], l_Color1[3];
+	for(int c = 0; c < 3; c++)
+	{
+		float l_Value0 = 3.0f * (l_AX[c] * l_BB - l_BX[c] * l_AB) / l_Determinant;
+		float l_Value1 = 3.0f * (l_BX[c] * l_AA - l_AX[c] * l_AB) / l_Determinant;
+		l_Color0[c] = min(max((int)(l_Value0 + 0.5f), 0), 255);
+		l_Color1[c] = min(max((int)(l_Value1 + 0.5f), 0), 255);
+	}
+	out_Color0 = PackRGB565(l_Color0[0], l_Color0[1], l_Color0[2]);
+	out_Color1 = PackRGB565(l_Color1[0], l_Color1[1], l_Color1[2]);
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * EncodeColorBlock
+ * Encode the colors of 16 RGBA pixels as an 8 byte BC1 block, always in four color mode
+ */
+static void EncodeColorBlock(const unsigned char* in_Pixels, const unsigned char in_Min[4], const unsigned char in_Max[4], unsigned char* out_Block)
+{
+	int l_Min[3] = { in_Min[0], in_Min[1], in_Min[2] };
+	int l_Max[3] = { in_Max[0], in_Max[1], in_Max[2] };
+
+	// The box diagonal from min to max only suits colors that rise together. Flip red and green against blue to
+	// the diagonal the colors actually follow, judged by the sign of their covariance
+	int l_CovarianceRB = 0;
+	int l_CovarianceGB = 0;
+	for(int i = 0; i < 16; i++)
+	{
+		const unsigned char* l_Pixel = in_Pixels + i * 4;
+		int l_Blue = 2 * l_Pixel[2] - l_Min[2] - l_Max[2];
+		l_CovarianceRB += (2 * l_Pixel[0] - l_Min[0] - l_Max[0]) * l_Blue;
+		l_CovarianceGB += (2 * l_Pixel[1] - l_Min[1] - l_Max[1]) * l_Blue;
+	}
+	if(l_CovarianceRB < 0)
+	{
+		swap(l_Min[0], l_Max[0]);
+	}
+	if(l_CovarianceGB < 0)
+	{
+		swap(l_Min[1], l_Max[1]);
+	}
+
+	// Pull the ends in a little, the extreme colors are rarely worth a palette entry of their own
+	for(int c = 0; c < 3; c++)
+	{
+		int l_Inset = (l_Max[c] - l_Min[c]) / 16;
+		l_Max[c] -= l_Inset;
+		l_Min[c] += l_Inset;
+	}
+
+	unsigned short l_Color0 = PackRGB565(l_Max[0], l_Max[1], l_Max[2]);
+	unsigned short l_Color1 = PackRGB565(l_Min[0], l_Min[1], l_Min[2]);
+	unsigned l_Error;
+	unsigned l_Indices = ChooseIndices(in_Pixels, l_Color0, l_Color1, l_Error);
+
+	for(int l_Pass = 0; l_Pass < REFINE_PASSES && l_Error > 0; l_Pass++)
+	{
+		unsigned short l_Refit0, l_Refit1;
+		if(!RefitEndpoints(in_Pixels, l_Indices, l_Refit0, l_Refit1))
+		{
+			break;
+		}
+		unsigned l_RefitError;
+		unsigned l_RefitIndices = ChooseIndices(in_Pixels, l_Refit0, l_Refit1, l_RefitError);
+		if(l_RefitError >= l_Error)
+		{
+			break;
+		}
+		l_Color0 = l_Refit0;
+		l_Color1 = l_Refit1;
+		l_Indices = l_RefitIndices;
+		l_Error = l_RefitError;
+	}
+
+	// Four color mode needs the first endpoint to be the larger. Swapping the endpoints swaps index 0 with 1
+	// and 2 with 3. Equal endpoints decode in three color mode, where index 0 is still the endpoint color
+	if(l_Color0 < l_Color1)
+	{
+		swap(l_Color0, l_Color1);
+		l_Indices ^= 0x55555555;
+	}
+	else if(l_Color0 == l_Color1)
+	{
+		l_Indices = 0;
+	}
+
+	out_Block[0] = (unsigned char)(l_Color0 & 0xFF);
+	out_Block[1] = (unsigned char)(l_Color0 >> 8);
+	out_Block[2] = (unsigned char)(l_Color1 & 0xFF);
+	out_Block[3] = (unsigned char)(l_Color1 >> 8);
+	out_Block[4] = (unsigned char)(l_Indices & 0xFF);
+	out_Block[5] = (unsigned char)((l_Indices >> 8) & 0xFF);
+	out_Block[6] = (unsigned char)((l_Indices >> 16) & 0xFF);
+	out_Block[7] = (unsigned char)(l_Indices >> 24);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * EncodeAlphaBlock
+ * Encode the alpha of 16 RGBA pixels as the 8 byte alpha block of BC3, in eight alpha mode
+ */
+static void EncodeAlphaBlock(const unsigned char* in_Pixels, int in_Min, int in_Max, unsigned char* out_Block)
+{
+	out_Block[0] = (unsigned char)in_Max;
+	out_Block[1] = (unsigned char)in_Min;
+	memset(out_Block + 2, 0, 6);
+	if(in_Max == in_Min)
+	{
+		return;
+	}
+
+	// The palette runs from the first endpoint (index 0) through indices 2 to 7 to the second endpoint (index 1),
+	// so the nearest step along the range maps to an index
+	int l_Range = in_Max - in_Min;
+	unsigned l_Bits = 0;
+	int l_BitCount = 0;
+	unsigned char* l_Out = out_Block + 2;
+	for(int i = 0; i < 16; i++)
+	{
+		int l_Step = ((in_Max - in_Pixels[i * 4 + 3]) * 7 + l_Range / 2) / l_Range;
+		unsigned l_Index = l_Step == 0 ? 0 : (l_Step == 7 ? 1 : l_Step + 1);
+
+		l_Bits |= l_Index << l_BitCount;
+		l_BitCount += 3;
+		while(l_BitCount >= 8)
+		{
+			*l_Out++ = (unsigned char)(l_Bits & 0xFF);
+			l_Bits >>= 8;
+			l_BitCount -= 8;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * DecodeColorBlock / DecodeAlphaBlock
+ * Expand a block to 16 RGBA pixels. BC3 color blocks are always four color
+ */
+static void DecodeColorBlock(const unsigned char* in_Block, bool in_FourColor, unsigned char* out_Pixels)
+{
+	unsigned short l_Color0 = (unsigned short)(in_Block[0] | (in_Block[1] << 8));
+	unsigned short l_Color1 = (unsigned short)(in_Block[2] | (in_Block[3] << 8));
+	int l_Palette[4][3];
+	int l_Alpha[4] = { 255, 255, 255, 255 };
+	GetPalette(l_Color0, l_Color1, l_Palette);
+	if(!in_FourColor && l_Color0 <= l_Color1)
+	{
+		// Three colors and transparent black
+		for(int c = 0; c < 3; c++)
+		{
+			l_Palette[2][c] = (l_Palette[0][c] + l_Palette[1][c]) / 2;
+			l_Palette[3][c] = 0;
+		}
+		l_Alpha[3] = 0;
+	}
+
+	unsigned l_Indices = in_Block[4] | (in_Block[5] << 8) | (in_Block[6] << 16) | ((unsigned)in_Block[7] << 24);
+	for(int i = 0; i < 16; i++)
+	{
+		unsigned l_Index = (l_Indices >> (i * 2)) & 3;
+		out_Pixels[i * 4 + 0] = (unsigned char)l_Palette[l_Index][0];
+		out_Pixels[i * 4 + 1] = (unsigned char)l_Palette[l_Index][1];
+		out_Pixels[i * 4 + 2] = (unsigned char)l_Palette[l_Index][2];
+		out_Pixels[i * 4 + 3] = (unsigned char)l_Alpha[l_Index];
+	}
+}
+
+static void DecodeAlphaBlock(const unsigned char* in_Block, unsigned char* out_Pixels)
+{
+	int l_Palette[8];
+	l_Palette[0] = in_Block[0];
+	l_Palette[1] = in_Block[1];
+	if(l_Palette[0] > l_Palette[1])
+	{
+		for(int i = 1; i < 7; i++)
+		{
+			l_Palette[i + 1] = ((7 - i) * l_Palette[0] + i * l_Palette[1]) / 7;
+		}
+	}
+	else
+	{
+		for(int i = 1; i < 5; i++)
+		{
+			l_Palette[i + 1] = ((5 - i) * l_Palette[0] + i * l_Palette[1]) / 5;
+		}
+		l_Palette[6] = 0;
+		l_Palette[7] = 255;
+	}
+
+	for(int i = 0; i < 16; i++)
+	{
+		int l_Bit = 16 + i * 3;
+		unsigned l_Bits = in_Block[l_Bit / 8] | (in_Block[l_Bit / 8 + 1] << 8);
+		out_Pixels[i * 4 + 3] = (unsigned char)l_Palette[(l_Bits >> (l_Bit % 8)) & 7];
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void CompressImage(const DecodedImage& in_Image, TextureFormat in_Format, DecodedImage& out_Image)
+{
+	assert((in_Format == TextureFormat_BC1 || in_Format == TextureFormat_BC3) && "CompressImage only produces BC1 and BC3");
+	assert((in_Image.Format == TextureFormat_RGB || in_Image.Format == TextureFormat_RGBA) && "CompressImage needs an RGB or RGBA image");
+
+	out_Image.Allocate(in_Image.Width, in_Image.Height, in_Format);
+	int l_BytesPerPixel = in_Image.Format == TextureFormat_RGBA ? 4 : 3;
+	int l_BlockSize = in_Format == TextureFormat_BC3 ? 16 : 8;
+	unsigned char* l_Out = &out_Image.Pixels[0];
+
+	unsigned char l_Pixels[64];
+	for(int l_BlockY = 0; l_BlockY < in_Image.Height; l_BlockY += 4)
+	{
+		for(int l_BlockX = 0; l_BlockX < in_Image.Width; l_BlockX += 4)
+		{
+			// Gather the block as RGBA, clamping to the image edges
+			for(int y = 0; y < 4; y++)
+			{
+				int l_Y = min(l_BlockY + y, in_Image.Height - 1);
+				for(int x = 0; x < 4; x++)
+				{
+					int l_X = min(l_BlockX + x, in_Image.Width - 1);
+					const unsigned char* l_Source = &in_Image.Pixels[(l_Y * in_Image.Width + l_X) * l_BytesPerPixel];
+					unsigned char* l_Pixel = l_Pixels + (y * 4 + x) * 4;
+					l_Pixel[0] = l_Source[0];
+					l_Pixel[1] = l_Source[1];
+					l_Pixel[2] = l_Source[2];
+					l_Pixel[3] = l_BytesPerPixel == 4 ? l_Source[3] : 255;
+				}
+			}
+
+			unsigned char l_Min[4], l_Max[4];
+			GetBlockBounds(l_Pixels, l_Min, l_Max);
+			if(in_Format == TextureFormat_BC3)
+			{
+				EncodeAlphaBlock(l_Pixels, l_Min[3], l_Max[3], l_Out);
+				EncodeColorBlock(l_Pixels, l_Min, l_Max, l_Out + 8);
+			}
+			else
+			{
+				EncodeColorBlock(l_Pixels, l_Min, l_Max, l_Out);
+			}
+			l_Out += l_BlockSize;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void DecompressImage(const DecodedImage& in_Image, DecodedImage& out_Image)
+{
+	assert((in_Image.Format == TextureFormat_BC1 || in_Image.Format == TextureFormat_BC3) && "DecompressImage needs a BC1 or BC3 image");
+
+	out_Image.Allocate(in_Image.Width, in_Image.Height, TextureFormat_RGBA);
+	bool l_BC3 = in_Image.Format == TextureFormat_BC3;
+	const unsigned char* l_Block = &in_Image.Pixels[0];
+
+	unsigned char l_Pixels[64];
+	for(int l_BlockY = 0; l_BlockY < in_Image.Height; l_BlockY += 4)
+	{
+		for(int l_BlockX = 0; l_BlockX < in_Image.Width; l_BlockX += 4)
+		{
+			if(l_BC3)
+			{
+				DecodeColorBlock(l_Block + 8, true, l_Pixels);
+				DecodeAlphaBlock(l_Block, l_Pixels);
+				l_Block += 16;
+			}
+			else
+			{
+				DecodeColorBlock(l_Block, false, l_Pixels);
+				l_Block += 8;
+			}
+
+			// Only the part of the block inside the image
+			int l_Columns = min(4, in_Image.Width - l_BlockX);
+			for(int y = 0; y < 4 && l_BlockY + y < in_Image.Height; y++)
+			{
+				memcpy(&out_Image.Pixels[((l_BlockY + y) * in_Image.Width + l_BlockX) * 4], l_Pixels + y * 16, l_Columns * 4);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool IsOpaque(const DecodedImage& in_Image)
+{
+	if(in_Image.Format != TextureFormat_RGBA)
+	{
+		return in_Image.Format != TextureFormat_BC3;
+	}
+
+	unsigned l_PixelCount = in_Image.Width * in_Image.Height;
+	for(unsigned i = 0; i < l_PixelCount; i++)
+	{
+		if(in_Image.Pixels[i * 4 + 3] != 255)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+double ComputePSNR(const DecodedImage& in_Reference, const DecodedImage& in_Image)
+{
+	assert(in_Reference.Width == in_Image.Width && in_Reference.Height == in_Image.Height && "ComputePSNR needs images of the same size");
+
+	int l_ReferenceBytes = in_Reference.Format == TextureFormat_RGBA ? 4 : 3;
+	int l_ImageBytes = in_Image.Format == TextureFormat_RGBA ? 4 : 3;
+	unsigned l_PixelCount = in_Image.Width * in_Image.Height;
+
+	double l_SquaredError = 0.0;
+	for(unsigned i = 0; i < l_PixelCount; i++)
+	{
+		for(int c = 0; c < 3; c++)
+		{
+			int l_Difference = in_Reference.Pixels[i * l_ReferenceBytes + c] - in_Image.Pixels[i * l_ImageBytes + c];
+			l_SquaredError += l_Difference * l_Difference;
+		}
+	}
+
+	if(l_SquaredError == 0.0)
+	{
+		return PSNR_IDENTICAL;
+	}
+	double l_MeanSquaredError = l_SquaredError / (l_PixelCount * 3.0);
+	return 10.0 * log10(255.0 * 255.0 / l_MeanSquaredError);
+}
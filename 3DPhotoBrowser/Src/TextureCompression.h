@@ -0,0 +1,53 @@
+/**
+ * @file TextureCompression.h
+ * @brief BC1 and BC3 texture compression header file
+ */
+
+#ifndef TEXTURECOMPRESSION_H_
+#define TEXTURECOMPRESSION_H_
+
+#include "Global.h"
+#include "ImageDecoder.h"
+
+/**
+ * USE_SSE2_TEXTURE_COMPRESSION
+ * Find the block bounds and pick the palette indices with SSE2. The scalar versions produce the same output
+ */
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#define USE_SSE2_TEXTURE_COMPRESSION 1
+#else
+	#define USE_SSE2_TEXTURE_COMPRESSION 0
+#endif
+
+/**
+ * CompressImage
+ * Compress an RGB or RGBA image to TextureFormat_BC1 or TextureFormat_BC3. BC1 drops the alpha channel.
+ * Blocks that run past the right or bottom edge repeat the edge pixels
+ */
+void CompressImage(const DecodedImage& in_Image, TextureFormat in_Format, DecodedImage& out_Image);
+
+/**
+ * DecompressImage
+ * Expand a BC1 or BC3 image to RGBA, the way the graphics card does
+ */
+void DecompressImage(const DecodedImage& in_Image, DecodedImage& out_Image);
+
+/**
+ * IsOpaque
+ * Is every pixel of an uncompressed image fully opaque? An opaque image can use BC1
+ */
+bool IsOpaque(const DecodedImage& in_Image);
+
+/**
+ * ComputePSNR
+ * Peak signal to noise ratio in dB of the red, green and blue channels of in_Image against in_Reference.
+ * Both must be uncompressed and the same size. Identical images give PSNR_IDENTICAL
+ */
+double ComputePSNR(const DecodedImage& in_Reference, const DecodedImage& in_Image);
+
+/**
+ * PSNR_IDENTICAL
+ */
+#define PSNR_IDENTICAL 99.0
+
+#endif // TEXTURECOMPRESSION_H_
@@ -5,7 +5,50 @@
 
 #include "TextureLoader.h"
 #include "PhotoBrowser.h"
-#include "IL/il.h"
+#include "JpegDecoder.h"
+#include "DevILDecoder.h"
+#include "AsyncFileReader.h"
+#include "MappedContainer.h"
+#include "DecodedCache.h"
+#include "TextureCompression.h"
+#include "Tracer.h"
+#include "Metrics.h"
+
+/**
+ * REQUEST_RING_CAPACITY
+ * Maximum number of requests on their way to the worker thread. The worker empties the ring every time it wakes
+ */
+#define REQUEST_RING_CAPACITY 4096
+
+/**
+ * COMPLETION_RING_CAPACITY
+ * Maximum number of finished loads waiting for ProcessCompletions. The worker waits when the ring is full
+ */
+#define COMPLETION_RING_CAPACITY 4096
+
+/**
+ * MAX_BATCH_REQUESTS
+ * Maximum number of requests serviced by one container read
+ */
+#define MAX_BATCH_REQUESTS 16
+
+/**
+ * MAX_BATCH_GAP
+ * Blobs this close to the data already being read are read along with it. Reading the gap costs far less than a seek
+ */
+#define MAX_BATCH_GAP (64 * 1024)
+
+/**
+ * MAX_BATCH_SPAN
+ * Maximum size of a single container read
+ */
+#define MAX_BATCH_SPAN (1024 * 1024)
+
+/**
+ * MAPPED_CONTAINER_CACHE
+ * Number of containers kept mapped when loading from mappings
+ */
+#define MAPPED_CONTAINER_CACHE 16
 
 //-----------------------------------------------------------------------------------------------------------------------------
 // TextureLoader
@@ -14,7 +57,61 @@ TextureLoader::TextureLoader()
 : mThreadStarted(false)
 , mThreadDone(false)
 , mStopThread(false)
+, mRequestRing(REQUEST_RING_CAPACITY)
+, mCompletionRing(COMPLETION_RING_CAPACITY)
+, mBatchDepth(0)
+, mBatchQueued(false)
+, mLoadCount(0)
+, mTextureMemory(0)
+, mUploadTime(0.0)
+, mMaxUploadTime(0.0)
+, mStreamedCount(0)
+, mLastUploadEnd(0)
+, mLastUploadHandle(NULL)
+, mRequestCount(0)
+, mReadCount(0)
+, mDeadlineCount(0)
+, mReadAheadCount(0)
+, mHeadOffset(0)
+, mReader(NULL)
+, mMapContainers(false)
+, mVerifyChecksums(false)
+, mReadAheadBytes(0)
+, mReadAheadStart(0)
+, mReadAheadEnd(0)
+, mDecodedCache(NULL)
+, mDecodedCacheCount(0)
+, mChosenFormatPending(false)
 {
+	mHeadFilename[0] = '\0';
+	mReadAheadFilename[0] = '\0';
+	for(int i = 0; i < LoadPriority_MAX; i++)
+	{
+		mPendingCount[i] = 0;
+	}
+
+#ifdef WIN32
+	mWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+	#error Your platform event creation goes here
+#endif // WIN32
+
+	// Thumbnails are all baseline JPEGs, DevIL picks up anything else
+	RegisterDecoder(new JpegDecoder());
+	RegisterDecoder(new DevILDecoder());
+
+	// The renderer is configured before the first texture is requested
+	mOutputFormat = mChosenFormat = ChooseOutputFormat();
+
+	// Synchronous loads use the decoded cache as well as the worker thread
+	UserPreferences* l_Prefs = UserPreferences::Instance();
+	if(l_Prefs->DecodedCacheFormat() != 0)
+	{
+		TextureFormat l_Format = l_Prefs->DecodedCacheFormat() == 2 ? TextureFormat_RGB565 :
+								 (l_Prefs->DecodedCacheFormat() == 3 ? TextureFormat_BC1 : TextureFormat_RGBA);
+		mDecodedCache = new DecodedCache("data/decoded", l_Format, l_Prefs->DecodedCacheMaxSize(), &mStagingPool);
+	}
+
 #if USE_THREADED_TEXTURE_LOADING
 	StartThread();
 #endif // USE_THREADED_TEXTURE_LOADING
@@ -24,6 +121,17 @@ TextureLoader::TextureLoader()
 
 TextureLoader::~TextureLoader()
 {
+	for(unsigned i = 0; i < mDecoders.size(); i++)
+	{
+		delete mDecoders[i];
+	}
+	mDecoders.clear();
+
+#ifdef WIN32
+	CloseHandle(mWakeEvent);
+#else
+	#error Your platform event destruction goes here
+#endif // WIN32
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -33,16 +141,74 @@ void TextureLoader::Shutdown()
 #if USE_THREADED_TEXTURE_LOADING
 	StopThread();
 #endif // USE_THREADED_TEXTURE_LOADING
-	mRequestQueue.empty();
+
+	// Drop everything still in flight, the listeners are going away
+	RequestData l_Request;
+	while(mRequestRing.TryPop(l_Request))
+	{
+	}
+	CompletionData l_Completion;
+	while(mCompletionRing.TryPop(l_Completion))
+	{
+	}
+	for(int i = 0; i < LoadPriority_MAX; i++)
+	{
+		mRequestQueue[i].clear();
+		mPendingCount[i] = 0;
+	}
+
+	// Once the arenas and pool have warmed up, loading a texture shouldn't touch the heap
+	logf("Texture loader: %u textures loaded, %u arena and %u staging buffer heap allocations", mLoadCount,
+		 mWorkerArena.GetHeapAllocationCount() + mSyncArena.GetHeapAllocationCount(), mStagingPool.GetHeapAllocationCount());
+	logf("Texture loader: %u KB of texture data uploaded, %.3f ms average and %.3f ms worst upload", mTextureMemory,
+		 mLoadCount > 0 ? mUploadTime * 1000.0 / mLoadCount : 0.0, mMaxUploadTime * 1000.0);
+	logf("Texture loader: %u textures streamed through the upload buffer", mStreamedCount);
+	logf("Texture loader: %u requests serviced with %u container reads, %u out of order for the deadline, %u served from read ahead data",
+		 mRequestCount, mReadCount - mReadAheadCount - mDecodedCacheCount, mDeadlineCount, mReadAheadCount);
+
+	if(mDecodedCache)
+	{
+		logf("Decoded cache: %u hits, %u misses, %u thumbnails written, %u dropped, %u batches served without a read",
+			 mDecodedCache->GetHitCount(), mDecodedCache->GetMissCount(), mDecodedCache->GetWriteCount(), mDecodedCache->GetDroppedCount(),
+			 mDecodedCacheCount);
+		delete mDecodedCache;
+		mDecodedCache = NULL;
+	}
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
 void TextureLoader::StartThread()
 {
+	// One batch for each read in flight, or a single batch for synchronous reads
+	UserPreferences* l_Prefs = UserPreferences::Instance();
+	unsigned l_ReadsInFlight = (unsigned)max(0, l_Prefs->AsyncReadsInFlight());
+
+	// Loading from mappings needs no reads at all
+	mMapContainers = l_Prefs->MapThumbnailContainers();
+	mVerifyChecksums = l_Prefs->VerifyThumbnailChecksums();
+	if(mMapContainers)
+	{
+		mMappedContainers.reserve(MAPPED_CONTAINER_CACHE);
+		l_ReadsInFlight = 0;
+	}
+	mReadAheadBytes = (unsigned)max(0, l_Prefs->ThumbnailReadAhead()) * 1024;
+
+	if(l_ReadsInFlight > 0)
+	{
+		mReader = AsyncFileReader::Create(l_ReadsInFlight, mWakeEvent, l_Prefs->AsyncReadThreadPool());
+		logf("Texture loader: %s reader, %u reads in flight", mReader->GetName(), l_ReadsInFlight);
+	}
+
+	mReadBatches.resize(max(1u, l_ReadsInFlight));
+	for(unsigned i = 0; i < mReadBatches.size(); i++)
+	{
+		mReadBatches[i].Requests.reserve(MAX_BATCH_REQUESTS);
+		mFreeReadBatches.push_back(i);
+	}
+
 	Start(true);
 	mThreadStarted = true;
-
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
@@ -51,152 +217,1152 @@ void TextureLoader::StopThread()
 {
 	// Terminate the load thread routine
 	mStopThread = true;
-	Resume(); // Resume the thread so it can exit
+	WakeThread(); // Wake the thread so it can exit
 	while(mThreadStarted && !mThreadDone)
 	{
 		Sleep(0); // Yield timeslice
 	}
+
+	delete mReader;
+	mReader = NULL;
+
+	for(unsigned i = 0; i < mMappedContainers.size(); i++)
+	{
+		delete mMappedContainers[i];
+	}
+	mMappedContainers.clear();
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
-TextureHandle TextureLoader::LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize)
+OutputFormat TextureLoader::ChooseOutputFormat()
 {
-	TextureHandle l_TextureHandle = NULL;
+	// The compressor takes RGB, and so does everything without a renderer
+	UserPreferences* l_Prefs = UserPreferences::Instance();
+	Graphics* l_Graphics = Graphics::Instance();
+	if(!l_Graphics || l_Prefs->CompressTextures())
+	{
+		return OutputFormat();
+	}
 
-	// Try to open the thumbnail file
-	ifstream l_File;
-	l_File.open(in_Filename, ios_base::in | ios_base::binary);
-	if(l_File.fail())
+	// Small thumbnails can do with 16 bit color, unless the decoded cache keeps 8 bit color, which it can't get back
+	int l_SmallSize = max(0, l_Prefs->ReducedColorTextureSize());
+	if(l_Prefs->DecodedCacheFormat() != 0 && l_Prefs->DecodedCacheFormat() != 2)
+	{
+		l_SmallSize = 0;
+	}
+	OutputFormat l_Format(l_Graphics->GetUploadFormat(false), l_Graphics->GetUploadFormat(true), l_SmallSize);
+
+	// This runs whenever a preference changes, the layout is only logged when it changes
+	if(l_Format != mChosenFormat)
+	{
+		const char* l_Names[] = { "RGB", "RGBA", "RGB565" };
+		logf("Texture loader: decoding to %s, %s up to %dpx", l_Names[l_Format.Format], l_Names[l_Format.SmallFormat], l_SmallSize);
+	}
+	return l_Format;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::Configure()
+{
+	OutputFormat l_Format = ChooseOutputFormat();
+	if(l_Format != mChosenFormat)
+	{
+		mChosenFormat = l_Format;
+		SubmitOutputFormat();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::SubmitOutputFormat()
+{
+	// The worker thread reads the format for every decode, so it only changes between requests
+	if(mThreadStarted)
+	{
+		RequestData l_Request;
+		l_Request.Type = RequestType_SetFormat;
+		l_Request.Format = mChosenFormat;
+		mChosenFormatPending = !SubmitRequest(l_Request);
+	}
+	else
+	{
+		mOutputFormat = mChosenFormat;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::RegisterDecoder(ImageDecoder* in_Decoder)
+{
+	mDecoders.push_back(in_Decoder);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::ReadContainer(const char* in_Filename, unsigned in_Offset, unsigned in_Size, unsigned char* out_Data, unsigned in_MinSize,
+								  unsigned* out_BytesRead)
+{
+	// This goes straight to the OS, the C++ streams allocate on every open
+	METRIC_ADD(Metric_Reads, 1)
+#ifdef WIN32
+	HANDLE l_File = CreateFileA(in_Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(l_File == INVALID_HANDLE_VALUE)
 	{
 		logf("Failed to open thumbnail file '%s'", in_Filename);
-		return l_TextureHandle;
+		return false;
 	}
 
-	// Create a temporary buffer to store the thumbnail image data
-	unsigned l_DataSize = in_TextureSize;
-	char* l_Data = new char[l_DataSize];
+	// The read may stop short at the end of the file, as long as the first in_MinSize bytes arrive
+	DWORD l_BytesRead = 0;
+	bool l_Read = SetFilePointer(l_File, in_Offset, NULL, FILE_BEGIN) != INVALID_SET_FILE_POINTER &&
+				  ReadFile(l_File, out_Data, in_Size, &l_BytesRead, NULL) && l_BytesRead >= (in_MinSize > 0 ? min(in_MinSize, in_Size) : in_Size);
+	CloseHandle(l_File);
+	if(out_BytesRead)
+	{
+		*out_BytesRead = l_BytesRead;
+	}
+#else
+	#error Your platform file read goes here
+#endif // WIN32
+	METRIC_ADD(Metric_ReadKB, (l_BytesRead + 1023) / 1024)
 
-	// Seek to where the thumbnail data begins, and read the data into our temporary buffer
-	l_File.seekg(in_TextureOffset);
-	l_File.read(l_Data, l_DataSize);
-	l_File.close();
+	if(!l_Read)
+	{
+		logf("Failed to read %u bytes at offset %u in '%s'", in_Size, in_Offset, in_Filename);
+	}
+	return l_Read;
+}
 
-	// Get DevIL to handle the dirty image loading details
-	unsigned l_ImageHandle;
-	ilGenImages(1, &l_ImageHandle);
-	ilBindImage(l_ImageHandle);
-	if(ilLoadL(IL_TYPE_UNKNOWN, l_Data, l_DataSize))
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::DecodeData(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena& io_Arena, int in_ScaleShift,
+							   const OutputFormat& in_Format)
+{
+	// Try each decoder in turn until one of them understands the data
+	TRACE_SCOPE("Decode")
+	bool l_Success = false;
+	for(unsigned i = 0; i < mDecoders.size() && !l_Success; i++)
 	{
-		int l_Width = ilGetInteger(IL_IMAGE_WIDTH);
-		int l_Height = ilGetInteger(IL_IMAGE_HEIGHT);
-		int l_Format = ilGetInteger(IL_IMAGE_FORMAT);
+		if(mDecoders[i]->CanDecode(in_Data, in_Size))
+		{
+			l_Success = in_ScaleShift > 0 ?
+				mDecoders[i]->DecodeScaled(in_Data, in_Size, in_ScaleShift, out_Image, &io_Arena, in_Format) :
+				mDecoders[i]->Decode(in_Data, in_Size, out_Image, &io_Arena, in_Format);
+		}
+	}
+	if(l_Success)
+	{
+		METRIC_ADD(Metric_Decodes, 1)
+		METRIC_ADD(Metric_DecodedKB, (GetTextureDataSize(out_Image.Width, out_Image.Height, out_Image.Format) + 1023) / 1024)
+	}
+	return l_Success;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle TextureLoader::LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, int in_ScaleShift)
+{
+	// Counted like a load through the worker thread, the tile waits for as long as the load takes
+	double l_Start = Timer::Instance()->GetSeconds();
+	TextureHandle l_TextureHandle = LoadTexture(in_Filename, in_TextureOffset, in_TextureSize, in_ScaleShift, mSyncArena);
+	METRIC_ADD(Metric_LoadsCompleted, 1)
+	METRIC_RECORD(Metric_LoadLatency, (unsigned)((Timer::Instance()->GetSeconds() - l_Start) * 1000000.0))
+	return l_TextureHandle;
+}
 
-		switch(l_Format)
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle TextureLoader::LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, int in_ScaleShift, DecodeArena& io_Arena)
+{
+	// The staging buffers return to the pool when the images go out of scope, after the upload
+	if(mDecodedCache)
+	{
+		DecodedImage l_Cached(&mStagingPool);
+		if(mDecodedCache->Load(in_Filename, in_TextureOffset, in_TextureSize, in_ScaleShift, l_Cached))
 		{
-		case IL_RGB: l_Format = TextureFormat_RGB; break;
-		case IL_RGBA: l_Format = TextureFormat_RGBA; break;
-		default: logf("Warning: unrecognized texture format");
+			return UploadTexture(l_Cached);
 		}
+	}
 
-		// Create the graphics texture resource
-		l_TextureHandle = Graphics::Instance()->CreateTexture(
-			l_Width, l_Height, TextureFormat(l_Format), ilGetData());
+	io_Arena.Reset();
+	unsigned char* l_Data = (unsigned char*)io_Arena.Allocate(in_TextureSize);
+	if(!ReadContainer(in_Filename, in_TextureOffset, in_TextureSize, l_Data))
+	{
+		return NULL;
+	}
 
-		// Wait until the texture is fully loaded into graphics memory
-		Graphics::Instance()->Flush();
+	// As on the worker thread, the decoded cache takes the compressed copy when the texture is compressed to its format anyway
+	TextureHandle l_TextureHandle = NULL;
+	DecodedImage l_Image(&mStagingPool);
+	if(DecodeData(l_Data, in_TextureSize, l_Image, io_Arena, in_ScaleShift, mChosenFormat))
+	{
+		DecodedImage l_Converted(&mStagingPool);
+		const DecodedImage& l_Prepared = PrepareTexture(l_Image, l_Converted);
+		if(mDecodedCache)
+		{
+			mDecodedCache->Store(in_Filename, in_TextureOffset, in_TextureSize, in_ScaleShift,
+								 l_Prepared.Format == mDecodedCache->GetFormat() ? l_Prepared : l_Image);
+		}
+		l_TextureHandle = UploadTexture(l_Prepared);
 	}
-	else
+
+	if(!l_TextureHandle)
 	{
-		ILenum l_Error =  ilGetError();
-		logf("Failed to load texture: ilError=%d", l_Error);
+		logf("Failed to decode thumbnail at offset %u in '%s'", in_TextureOffset, in_Filename);
 	}
+	return l_TextureHandle;
+}
 
-	// Free DevIL resources
-	ilDeleteImages(1, &l_ImageHandle);
+//-----------------------------------------------------------------------------------------------------------------------------
+
+TextureHandle TextureLoader::UploadTexture(const DecodedImage& in_Image)
+{
+	DecodedImage l_Converted(&mStagingPool);
+	const DecodedImage& l_Image = PrepareTexture(in_Image, l_Converted);
+
+	// Create the graphics texture resource
+	TRACE_SCOPE("CreateTexture")
+	double l_Start = Timer::Instance()->GetSeconds();
+	TextureHandle l_TextureHandle = Graphics::Instance()->CreateTexture(
+		l_Image.Width, l_Image.Height, l_Image.Format, &l_Image.Pixels[0]);
 
-	// Release the temporary buffer
-	delete [] l_Data;
+	// Wait until the texture is fully loaded into graphics memory
+	Graphics::Instance()->Flush();
+	double l_UploadTime = Timer::Instance()->GetSeconds() - l_Start;
+	mUploadTime += l_UploadTime;
+	mMaxUploadTime = max(mMaxUploadTime, l_UploadTime);
+	mLoadCount++;
+	mTextureMemory += (GetTextureDataSize(l_Image.Width, l_Image.Height, l_Image.Format) + 1023) / 1024;
 
 	return l_TextureHandle;
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
-void TextureLoader::LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, TextureLoaderListener* in_Listener, void* in_UserData)
+void TextureLoader::StreamTexture(const DecodedImage& in_Image, TextureData& out_Texture)
 {
-	// If we are using a loading thread, queue some work for it to do
-	if(mThreadStarted)
+	DecodedImage l_Converted(&mStagingPool);
+	const DecodedImage& l_Image = PrepareTexture(in_Image, l_Converted);
+
+	// Copy the pixels into the upload buffer and leave the texture update to the main thread. The copy is all this
+	// thread does, and the main thread only queues the update, so neither waits on the driver
+	TRACE_SCOPE("StreamTexture")
+	double l_Start = Timer::Instance()->GetSeconds();
+	unsigned l_Size = GetTextureDataSize(l_Image.Width, l_Image.Height, l_Image.Format);
+	if(!Graphics::Instance()->ReserveUpload(l_Size, out_Texture.Upload))
 	{
-		mQueueLock.Lock();
+		// Streaming is off or the buffer is full, create the texture here instead
+		out_Texture.Handle = UploadTexture(l_Image);
+		out_Texture.Streamed = false;
+		return;
+	}
+	memcpy(out_Texture.Upload.Data, &l_Image.Pixels[0], l_Size);
+	out_Texture.Handle = NULL;
+	out_Texture.Streamed = true;
+	out_Texture.Width = l_Image.Width;
+	out_Texture.Height = l_Image.Height;
+	out_Texture.Format = l_Image.Format;
+
+	double l_UploadTime = Timer::Instance()->GetSeconds() - l_Start;
+	mUploadTime += l_UploadTime;
+	mMaxUploadTime = max(mMaxUploadTime, l_UploadTime);
+	mLoadCount++;
+	mStreamedCount++;
+	mTextureMemory += (l_Size + 1023) / 1024;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+const DecodedImage& TextureLoader::PrepareTexture(const DecodedImage& in_Image, DecodedImage& io_Converted)
+{
+	Graphics* l_Graphics = Graphics::Instance();
+	if(IsCompressedTextureFormat(in_Image.Format))
+	{
+		// From the decoded cache. Without driver support it goes up uncompressed
+		if(!l_Graphics->SupportsTextureFormat(in_Image.Format))
+		{
+			DecompressImage(in_Image, io_Converted);
+			return io_Converted;
+		}
+	}
+	else if(UserPreferences::Instance()->CompressTextures() && in_Image.Format != TextureFormat_RGB565)
+	{
+		// A quarter to a sixth of the memory, so that many more thumbnails stay resident
+		TextureFormat l_Format = IsOpaque(in_Image) ? TextureFormat_BC1 : TextureFormat_BC3;
+		if(l_Graphics->SupportsTextureFormat(l_Format))
+		{
+			TRACE_SCOPE("Compress")
+			CompressImage(in_Image, l_Format, io_Converted);
+			return io_Converted;
+		}
+	}
+	return in_Image;
+}
 
-		// Queue the request data
-		RequestData l_Data;
-		l_Data.UserData = in_UserData;
-		l_Data.Filename = in_Filename;
-		l_Data.Listener = in_Listener;
-		l_Data.TextureSize = in_TextureSize;
-		l_Data.TextureOffset = in_TextureOffset;
-		mRequestQueue.push(l_Data);
+//-----------------------------------------------------------------------------------------------------------------------------
 
-		mQueueLock.Unlock();
+bool TextureLoader::LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, TextureLoaderListener* in_Listener, void* in_UserData,
+								LoadPriority in_Priority, int in_ScaleShift)
+{
+	// If we are using a loading thread, queue some work for it to do
+	if(mThreadStarted)
+	{
+		RequestData l_Request;
+		l_Request.Type = RequestType_Load;
+		l_Request.Priority = in_Priority;
+		l_Request.Listener = in_Listener;
+		l_Request.UserData = in_UserData;
+		l_Request.Filename = in_Filename;
+		l_Request.TextureOffset = in_TextureOffset;
+		l_Request.TextureSize = in_TextureSize;
+		l_Request.ScaleShift = in_ScaleShift;
+		l_Request.SubmitTime = Timer::Instance()->GetSeconds();
+		l_Request.WindowTime = 0.0;
+		l_Request.TraceId = Tracer::Instance()->NewRequestId();
+		TRACE_REQUEST_BEGIN("Load", l_Request.TraceId, "offset", (int)in_TextureOffset)
 
-		// Resume the worker thread
-		Resume();
+		// Count the request before the worker can see it, so the count never goes negative
+		AtomicIncrement(&mPendingCount[in_Priority]);
+		if(!SubmitRequest(l_Request))
+		{
+			AtomicDecrement(&mPendingCount[in_Priority]);
+			TRACE_REQUEST_STEP("RingFull", l_Request.TraceId)
+			TRACE_REQUEST_END("Load", l_Request.TraceId)
+			return false;
+		}
 	}
 	// If not, do a synchronous load right away instead
 	else
 	{
 		// Load the texture then let the listener know
 		in_Listener->OnLoadComplete(
-			LoadTexture(in_Filename, in_TextureOffset, in_TextureSize),
+			LoadTexture(in_Filename, in_TextureOffset, in_TextureSize, in_ScaleShift),
 			in_UserData);
 	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::ProcessCompletions()
+{
+	if(mChosenFormatPending)
+	{
+		SubmitOutputFormat();
+	}
+
+	CompletionData l_Completion;
+	int l_CompletionCount = 0;
+	double l_Now = Timer::Instance()->GetSeconds();
+	while(mCompletionRing.TryPop(l_Completion))
+	{
+		l_CompletionCount++;
+		if(l_Completion.Cancelled)
+		{
+			METRIC_ADD(Metric_LoadsCancelled, 1)
+			l_Completion.Listener->OnLoadCancelled(l_Completion.UserData);
+			TRACE_REQUEST_STEP("Cancelled", l_Completion.TraceId)
+			TRACE_REQUEST_END("Load", l_Completion.TraceId)
+			continue;
+		}
+
+		// Create streamed textures from the upload buffer. Duplicate requests for a blob follow each other and share its upload
+		const TextureData& l_Texture = l_Completion.Texture;
+		TextureHandle l_Handle = l_Texture.Handle;
+		if(l_Texture.Streamed)
+		{
+			if(l_Texture.Upload.End != mLastUploadEnd)
+			{
+				mLastUploadHandle = Graphics::Instance()->CreateTextureFromUpload(l_Texture.Width, l_Texture.Height, l_Texture.Format, l_Texture.Upload);
+				mLastUploadEnd = l_Texture.Upload.End;
+			}
+			l_Handle = mLastUploadHandle;
+		}
+		l_Completion.Listener->OnLoadComplete(l_Handle, l_Completion.UserData);
+		TRACE_REQUEST_END("Load", l_Completion.TraceId)
+
+		// The latency that matters is how long a tile on screen waited for its thumbnail
+		METRIC_ADD(Metric_LoadsCompleted, 1)
+		if(l_Completion.Priority == LoadPriority_Visible)
+		{
+			METRIC_RECORD(Metric_LoadLatency, (unsigned)((l_Now - l_Completion.SubmitTime) * 1000000.0))
+		}
+	}
+
+	TRACE_COUNTER("Completions", l_CompletionCount)
+	TRACE_COUNTER("PendingVisible", (int)GetPendingCount(LoadPriority_Visible))
+	TRACE_COUNTER("PendingMargin", (int)GetPendingCount(LoadPriority_Margin))
+	TRACE_COUNTER("PendingPrefetch", (int)GetPendingCount(LoadPriority_Prefetch))
+	METRIC_SET(Metric_QueueDepth, mPendingCount[LoadPriority_Visible] + mPendingCount[LoadPriority_Margin] + mPendingCount[LoadPriority_Prefetch])
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::BeginBatch()
+{
+	mBatchDepth++;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::EndBatch()
+{
+	assert(mBatchDepth > 0 && "EndBatch called without BeginBatch");
+
+	bool l_Wake = false;
+	if(--mBatchDepth == 0)
+	{
+		l_Wake = mBatchQueued && mThreadStarted;
+		mBatchQueued = false;
+	}
+
+	if(l_Wake)
+	{
+		WakeThread();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::PromoteRequest(void* in_UserData, LoadPriority in_Priority)
+{
+	if(mThreadStarted)
+	{
+		RequestData l_Request;
+		l_Request.Type = RequestType_Promote;
+		l_Request.Priority = in_Priority;
+		l_Request.UserData = in_UserData;
+
+		// If the ring is full the request just keeps its old priority
+		SubmitRequest(l_Request);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::CancelRequest(void* in_UserData)
+{
+	if(mThreadStarted)
+	{
+		RequestData l_Request;
+		l_Request.Type = RequestType_Cancel;
+		l_Request.UserData = in_UserData;
+
+		// If the ring is full the load goes ahead and completes as normal
+		SubmitRequest(l_Request);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::CancelRequests(LoadPriority in_Priority)
+{
+	if(mThreadStarted)
+	{
+		RequestData l_Request;
+		l_Request.Type = RequestType_CancelAll;
+		l_Request.Priority = in_Priority;
+		SubmitRequest(l_Request);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+unsigned TextureLoader::GetPendingCount(LoadPriority in_Priority)
+{
+	return (unsigned)max(mPendingCount[in_Priority], 0L);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::SubmitRequest(const RequestData& in_Request)
+{
+	if(!mRequestRing.TryPush(in_Request))
+	{
+		return false;
+	}
+
+	// Wake the worker thread, or let EndBatch do it once the whole batch is queued
+	if(mBatchDepth > 0)
+	{
+		mBatchQueued = true;
+	}
+	else
+	{
+		WakeThread();
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::WakeThread()
+{
+#ifdef WIN32
+	SetEvent(mWakeEvent);
+#else
+	#error Your platform event signal goes here
+#endif // WIN32
+
+	// The thread is created suspended, resuming it once it's running does nothing
+	Resume();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::ApplyRequest(const RequestData& in_Request)
+{
+	switch(in_Request.Type)
+	{
+	case RequestType_Load:
+
+		mRequestQueue[in_Request.Priority].push_back(in_Request);
+		break;
+
+	case RequestType_Promote:
+
+		// Search the lower priority queues for the request
+		for(int i = in_Request.Priority + 1; i < LoadPriority_MAX; i++)
+		{
+			deque<RequestData>& l_Queue = mRequestQueue[i];
+			deque<RequestData>::iterator It;
+			for(It = l_Queue.begin(); It != l_Queue.end() && It->UserData != in_Request.UserData; It++)
+			{
+			}
+			if(It != l_Queue.end())
+			{
+				RequestData l_Promoted = *It;
+				l_Promoted.Priority = in_Request.Priority;
+
+				// It has only been needed since now, and waits its turn in the new queue before the deadline applies
+				l_Promoted.SubmitTime = Timer::Instance()->GetSeconds();
+				l_Promoted.WindowTime = 0.0;
+				l_Queue.erase(It);
+				mRequestQueue[in_Request.Priority].push_back(l_Promoted);
+				TRACE_REQUEST_STEP("Promoted", l_Promoted.TraceId)
+				AtomicDecrement(&mPendingCount[i]);
+				AtomicIncrement(&mPendingCount[in_Request.Priority]);
+				break;
+			}
+		}
+		break;
+
+	case RequestType_Cancel:
+
+		for(int i = 0; i < LoadPriority_MAX; i++)
+		{
+			deque<RequestData>& l_Queue = mRequestQueue[i];
+			deque<RequestData>::iterator It;
+			for(It = l_Queue.begin(); It != l_Queue.end() && It->UserData != in_Request.UserData; It++)
+			{
+			}
+			if(It != l_Queue.end())
+			{
+				PostCompletion(*It, TextureData(), true);
+				l_Queue.erase(It);
+				AtomicDecrement(&mPendingCount[i]);
+				break;
+			}
+		}
+		break;
+
+	case RequestType_CancelAll:
+		{
+			deque<RequestData>& l_Queue = mRequestQueue[in_Request.Priority];
+			for(unsigned i = 0; i < l_Queue.size(); i++)
+			{
+				PostCompletion(l_Queue[i], TextureData(), true);
+				AtomicDecrement(&mPendingCount[in_Request.Priority]);
+			}
+			l_Queue.clear();
+		}
+		break;
+
+	case RequestType_SetFormat:
+
+		mOutputFormat = in_Request.Format;
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::PostCompletion(const RequestData& in_Request, const TextureData& in_Texture, bool in_Cancelled)
+{
+	CompletionData l_Completion;
+	l_Completion.Listener = in_Request.Listener;
+	l_Completion.UserData = in_Request.UserData;
+	l_Completion.Texture = in_Texture;
+	l_Completion.Cancelled = in_Cancelled;
+	l_Completion.Priority = in_Request.Priority;
+	l_Completion.SubmitTime = in_Request.SubmitTime;
+	l_Completion.TraceId = in_Request.TraceId;
+
+	// Only the worker waits for the main thread, never the other way round
+	while(!mCompletionRing.TryPush(l_Completion) && !mStopThread)
+	{
+		Sleep(1);
+	}
 }
 
 //-----------------------------------------------------------------------------------------------------------------------------
 
 void TextureLoader::Run()
 {
+	Tracer::Instance()->SetThreadName("TextureLoader");
 	PhotoBrowser::Instance()->AcquireOpenGLWorkerContext();
 
-	RequestData l_RequestData;
-
 	// While we should keep working
 	while(!mStopThread)
 	{
-		RequestData* l_Request = NULL;
-
-		// Check if there is anything in the queue
-		mQueueLock.Lock();
-		if(mRequestQueue.size() > 0)
+		// Take in everything that has been submitted since we last looked
+		RequestData l_Request;
+		while(mRequestRing.TryPop(l_Request))
 		{
-			l_RequestData = mRequestQueue.front();
-			l_Request = &l_RequestData;
-			mRequestQueue.pop();
+			ApplyRequest(l_Request);
 		}
-		mQueueLock.Unlock();
+		TRACE_COUNTER("QueuedRequests", (int)(mRequestQueue[LoadPriority_Visible].size() + mRequestQueue[LoadPriority_Margin].size() +
+											  mRequestQueue[LoadPriority_Prefetch].size()))
 
-		// If there is a request, process it
-		if(l_Request)
+		bool l_Loaded = false;
+		if(mReader)
 		{
-			// Load the texture
-			TextureHandle l_Handle = LoadTexture(l_Request->Filename.c_str(), l_Request->TextureOffset, l_Request->TextureSize);
+			// Keep the reader busy, then decode whatever has arrived
+			SubmitReads();
+			l_Loaded = FinishRead();
+		}
+		else
+		{
+			// Find the highest priority request
+			int l_Priority = 0;
+			while(l_Priority < LoadPriority_MAX && mRequestQueue[l_Priority].empty())
+			{
+				l_Priority++;
+			}
 
-			// Notify the requestor that the texture is ready
-			l_Request->Listener->OnLoadComplete(l_Handle, l_Request->UserData);
+			// If there is a request, process it, along with any others that can share its read
+			if(l_Priority < LoadPriority_MAX)
+			{
+				bool l_Deadline = false;
+				unsigned l_Index = SelectRequest(l_Priority, l_Deadline);
+				LoadBatch(l_Priority, l_Index, l_Deadline);
+				l_Loaded = true;
+			}
+		}
 
+		if(l_Loaded)
+		{
 			Sleep(1); // Yield some time before processing next load
 		}
-		// Nothing to do, suspend ourself. Main thread will wake us up when it adds something to the queue
+		// Nothing to do, wait for the main thread to submit more work or a read to finish
 		else
 		{
-			Suspend();
+#ifdef WIN32
+			WaitForSingleObject(mWakeEvent, INFINITE);
+#else
+			#error Your platform event wait goes here
+#endif // WIN32
 		}
 	}
 
+	// The read buffers can't go back to the pool until the reads are done with them
+	if(mReader)
+	{
+		mReader->Drain();
+	}
+	for(unsigned i = 0; i < mReadBatches.size(); i++)
+	{
+		mStagingPool.Release(mReadBatches[i].Data);
+	}
+	mStagingPool.Release(mReadAhead);
+	mReadAheadEnd = mReadAheadStart;
+
 	PhotoBrowser::Instance()->ReleaseOpenGLWorkerContext();
 
 	// We are now done
 	mThreadDone = true;
 }
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+unsigned TextureLoader::SelectRequest(int in_Priority, bool& out_Deadline)
+{
+	deque<RequestData>& l_Queue = mRequestQueue[in_Priority];
+	unsigned l_Window = min((unsigned)max(1, UserPreferences::Instance()->IoScheduleWindow()), (unsigned)l_Queue.size());
+
+	// The deadline runs from when a request entered the window, not from when it was queued. Otherwise everything in
+	// a long backlog is past it by the time it gets into the window, and the elevator order is lost when it matters most
+	double l_Now = Timer::Instance()->GetSeconds();
+	unsigned l_Oldest = 0;
+	for(unsigned i = 0; i < l_Window; i++)
+	{
+		if(l_Queue[i].WindowTime == 0.0)
+		{
+			l_Queue[i].WindowTime = l_Now;
+		}
+		if(l_Queue[i].WindowTime < l_Queue[l_Oldest].WindowTime)
+		{
+			l_Oldest = i;
+		}
+	}
+
+	// A request that has been passed over for too long goes first, the sweep picks up where it was afterwards
+	out_Deadline = l_Queue[l_Oldest].WindowTime < l_Now - UserPreferences::Instance()->IoDeadline();
+	if(out_Deadline)
+	{
+		if(l_Window > 1)
+		{
+			mDeadlineCount++;
+		}
+		return l_Oldest;
+	}
+
+	// Otherwise the nearest request at or after the head. When the sweep reaches the end, it starts again
+	// from the first container rather than reversing, so no part of the library waits two sweeps
+	int l_Ahead = -1;
+	unsigned l_First = 0;
+	for(unsigned i = 0; i < l_Window; i++)
+	{
+		if(CompareLocation(l_Queue[i], mHeadFilename, mHeadOffset) >= 0 &&
+		   (l_Ahead < 0 || CompareLocation(l_Queue[i], l_Queue[l_Ahead].Filename, l_Queue[l_Ahead].TextureOffset) < 0))
+		{
+			l_Ahead = i;
+		}
+		if(CompareLocation(l_Queue[i], l_Queue[l_First].Filename, l_Queue[l_First].TextureOffset) < 0)
+		{
+			l_First = i;
+		}
+	}
+	return l_Ahead >= 0 ? (unsigned)l_Ahead : l_First;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::LoadBatch(int in_Priority, unsigned in_Index, bool in_Deadline)
+{
+	ReadBatch& l_Batch = mReadBatches[0];
+	GatherBatch(in_Priority, in_Index, in_Deadline, l_Batch);
+	if(ServeFromCache(l_Batch))
+	{
+		return;
+	}
+
+	// Decode straight out of the mapping, the arena only holds the decoder scratch
+	if(mMapContainers)
+	{
+		MappedContainer* l_Container = MapContainer(l_Batch.Requests[0].Filename);
+		const unsigned char* l_Data = l_Container ? l_Container->GetData(l_Batch.Start, l_Batch.End - l_Batch.Start) : NULL;
+		if(l_Container && !l_Data)
+		{
+			logf("Thumbnails at offsets %u to %u are outside '%s'", l_Batch.Start, l_Batch.End, l_Batch.Requests[0].Filename);
+		}
+
+		METRIC_ADD(Metric_Reads, 1)
+		METRIC_ADD(Metric_ReadKB, l_Data ? (l_Batch.End - l_Batch.Start + 1023) / 1024 : 0)
+		mWorkerArena.Reset();
+		DecodeBatch(l_Batch, l_Data, l_Data != NULL, l_Container);
+		return;
+	}
+
+	if(DecodeFromReadAhead(l_Batch))
+	{
+		return;
+	}
+
+	// Read the batch and the read ahead data past it into a staging buffer, the arena only holds the decoder scratch
+	unsigned l_Size = l_Batch.End - l_Batch.Start;
+	unsigned l_BytesRead = 0;
+	mStagingPool.Acquire(l_Size + mReadAheadBytes, l_Batch.Data);
+	TRACE_SCOPE("Read")
+	bool l_Read = ReadContainer(l_Batch.Requests[0].Filename, l_Batch.Start, l_Size + mReadAheadBytes, &l_Batch.Data[0], l_Size, &l_BytesRead);
+
+	mWorkerArena.Reset();
+	DecodeBatch(l_Batch, &l_Batch.Data[0], l_Read);
+	if(l_Read)
+	{
+		KeepReadAhead(l_Batch, l_BytesRead);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::SubmitReads()
+{
+	while(!mFreeReadBatches.empty())
+	{
+		// Find the highest priority request
+		int l_Priority = 0;
+		while(l_Priority < LoadPriority_MAX && mRequestQueue[l_Priority].empty())
+		{
+			l_Priority++;
+		}
+		if(l_Priority == LoadPriority_MAX)
+		{
+			break;
+		}
+
+		unsigned l_Index = mFreeReadBatches.back();
+		mFreeReadBatches.pop_back();
+
+		ReadBatch& l_Batch = mReadBatches[l_Index];
+		bool l_Deadline = false;
+		unsigned l_Selected = SelectRequest(l_Priority, l_Deadline);
+		GatherBatch(l_Priority, l_Selected, l_Deadline, l_Batch);
+		if(ServeFromCache(l_Batch) || DecodeFromReadAhead(l_Batch))
+		{
+			mFreeReadBatches.push_back(l_Index);
+			continue;
+		}
+
+		// There is a batch for each read the reader allows in flight, so the submit can't be refused.
+		// The read ahead data past the batch may be cut short by the end of the container
+		unsigned l_Size = l_Batch.End - l_Batch.Start;
+		mStagingPool.Acquire(l_Size + mReadAheadBytes, l_Batch.Data);
+		mReader->Submit(l_Batch.Requests[0].Filename, l_Batch.Start, l_Size + mReadAheadBytes, &l_Batch.Data[0], (void*)(size_t)l_Index, l_Size);
+		METRIC_ADD(Metric_Reads, 1)
+		for(unsigned i = 0; i < l_Batch.Requests.size(); i++)
+		{
+			TRACE_REQUEST_STEP("ReadStarted", l_Batch.Requests[i].TraceId)
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::FinishRead()
+{
+	void* l_UserData;
+	bool l_Read;
+	unsigned l_BytesRead;
+	if(!mReader->PollCompletion(l_UserData, l_Read, &l_BytesRead))
+	{
+		return false;
+	}
+
+	// The data stays in its read buffer, the arena only holds the decoder scratch
+	unsigned l_Index = (unsigned)(size_t)l_UserData;
+	ReadBatch& l_Batch = mReadBatches[l_Index];
+	if(!l_Read)
+	{
+		logf("Failed to read %u bytes at offset %u in '%s'", l_Batch.End - l_Batch.Start, l_Batch.Start, l_Batch.Requests[0].Filename);
+	}
+	METRIC_ADD(Metric_ReadKB, (l_BytesRead + 1023) / 1024)
+
+	mWorkerArena.Reset();
+	DecodeBatch(l_Batch, &l_Batch.Data[0], l_Read);
+	if(l_Read)
+	{
+		KeepReadAhead(l_Batch, l_BytesRead);
+	}
+
+	mFreeReadBatches.push_back(l_Index);
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::DecodeFromReadAhead(ReadBatch& io_Batch)
+{
+	if(io_Batch.Start < mReadAheadStart || io_Batch.End > mReadAheadEnd || strcmp(io_Batch.Requests[0].Filename, mReadAheadFilename) != 0)
+	{
+		return false;
+	}
+
+	mWorkerArena.Reset();
+	DecodeBatch(io_Batch, &mReadAhead[io_Batch.Start - mReadAheadStart], true);
+	mReadAheadCount++;
+	METRIC_ADD(Metric_ReadAheadHits, 1)
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::KeepReadAhead(ReadBatch& io_Batch, unsigned in_BytesRead)
+{
+	if(mReadAheadBytes == 0)
+	{
+		return;
+	}
+
+	// The old read ahead buffer becomes the batch's buffer for its next read
+	mReadAhead.swap(io_Batch.Data);
+	strncpy(mReadAheadFilename, io_Batch.Requests[0].Filename, MAX_PATH - 1);
+	mReadAheadFilename[MAX_PATH - 1] = '\0';
+	mReadAheadStart = io_Batch.Start;
+	mReadAheadEnd = io_Batch.Start + in_BytesRead;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::ServeFromCache(ReadBatch& io_Batch)
+{
+	if(!mDecodedCache)
+	{
+		return false;
+	}
+
+	// Look each blob up once. Misses stay in the batch, in blob order, for the read
+	vector<RequestData>& l_Batch = io_Batch.Requests;
+	sort(l_Batch.begin(), l_Batch.end(), CompareBlobs);
+	DecodedImage l_Image(&mStagingPool);
+	TextureData l_Texture;
+	bool l_Cached = false;
+	unsigned l_Kept = 0;
+	for(unsigned i = 0; i < l_Batch.size(); i++)
+	{
+		const RequestData l_Request = l_Batch[i];
+		if(i == 0 || !IsSameBlob(l_Request, l_Batch[i - 1]))
+		{
+			l_Cached = mDecodedCache->Load(l_Request.Filename, l_Request.TextureOffset, l_Request.TextureSize, l_Request.ScaleShift, l_Image);
+			l_Texture = TextureData();
+			if(l_Cached)
+			{
+				StreamTexture(l_Image, l_Texture);
+			}
+		}
+
+		if(l_Cached)
+		{
+			TRACE_REQUEST_STEP("Cached", l_Request.TraceId)
+			PostCompletion(l_Request, l_Texture, false);
+		}
+		else
+		{
+			l_Batch[l_Kept++] = l_Request;
+		}
+	}
+	l_Batch.resize(l_Kept);
+
+	if(l_Batch.empty())
+	{
+		mDecodedCacheCount++;
+		return true;
+	}
+
+	io_Batch.Start = l_Batch[0].TextureOffset;
+	io_Batch.End = 0;
+	for(unsigned i = 0; i < l_Batch.size(); i++)
+	{
+		io_Batch.End = max(io_Batch.End, l_Batch[i].TextureOffset + l_Batch[i].TextureSize);
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::GatherBatch(int in_Priority, unsigned in_Index, bool in_Deadline, ReadBatch& out_Batch)
+{
+	vector<RequestData>& l_Batch = out_Batch.Requests;
+	l_Batch.clear();
+	l_Batch.push_back(mRequestQueue[in_Priority][in_Index]);
+	mRequestQueue[in_Priority].erase(mRequestQueue[in_Priority].begin() + in_Index);
+	AtomicDecrement(&mPendingCount[in_Priority]);
+
+	const RequestData l_First = l_Batch[0];
+	unsigned l_Start = l_First.TextureOffset;
+	unsigned l_End = l_First.TextureOffset + l_First.TextureSize;
+
+	// Take in the queued requests that can share the read. Requests for a blob already in the batch are taken whatever
+	// their priority, it costs nothing to serve them. Nearby blobs are only taken from the same priority, so lower
+	// priority work never delays the request being served. Each pass can extend the span, which brings more blobs
+	// within reach, so keep going until a pass takes nothing
+	bool l_Grew = true;
+	while(l_Grew && l_Batch.size() < MAX_BATCH_REQUESTS)
+	{
+		l_Grew = false;
+		for(int p = 0; p < LoadPriority_MAX; p++)
+		{
+			deque<RequestData>& l_Queue = mRequestQueue[p];
+			for(deque<RequestData>::iterator It = l_Queue.begin(); It != l_Queue.end() && l_Batch.size() < MAX_BATCH_REQUESTS; )
+			{
+				bool l_Take = false;
+				if(IsSameContainer(*It, l_First))
+				{
+					unsigned l_BlobStart = It->TextureOffset;
+					unsigned l_BlobEnd = It->TextureOffset + It->TextureSize;
+					if(p == in_Priority)
+					{
+						l_Take = l_BlobStart <= l_End + MAX_BATCH_GAP && l_BlobEnd + MAX_BATCH_GAP >= l_Start &&
+								 max(l_End, l_BlobEnd) - min(l_Start, l_BlobStart) <= MAX_BATCH_SPAN;
+					}
+					for(unsigned i = 0; i < l_Batch.size() && !l_Take; i++)
+					{
+						l_Take = IsSameBlob(*It, l_Batch[i]);
+					}
+
+					if(l_Take)
+					{
+						l_Start = min(l_Start, l_BlobStart);
+						l_End = max(l_End, l_BlobEnd);
+					}
+				}
+
+				if(l_Take)
+				{
+					l_Batch.push_back(*It);
+					It = l_Queue.erase(It);
+					AtomicDecrement(&mPendingCount[p]);
+					l_Grew = true;
+				}
+				else
+				{
+					++It;
+				}
+			}
+		}
+	}
+
+	// One read covers the whole batch, the gaps between the blobs are read and thrown away
+	out_Batch.Start = l_Start;
+	out_Batch.End = l_End;
+	mReadCount++;
+	mRequestCount += l_Batch.size();
+	for(unsigned i = 0; i < l_Batch.size(); i++)
+	{
+		TRACE_REQUEST_STEP("Dequeued", l_Batch[i].TraceId)
+	}
+
+	// The sweep continues from here, unless this was a detour for the deadline
+	if(!in_Deadline)
+	{
+		strncpy(mHeadFilename, l_First.Filename, MAX_PATH - 1);
+		mHeadFilename[MAX_PATH - 1] = '\0';
+		mHeadOffset = l_End;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+MappedContainer* TextureLoader::MapContainer(const char* in_Filename)
+{
+	// The cache is kept in most recently used order
+	MappedContainer* l_Container = NULL;
+	for(unsigned i = 0; i < mMappedContainers.size() && !l_Container; i++)
+	{
+		if(strcmp(mMappedContainers[i]->GetFilename(), in_Filename) == 0)
+		{
+			l_Container = mMappedContainers[i];
+			mMappedContainers.erase(mMappedContainers.begin() + i);
+		}
+	}
+
+	// Not mapped yet, map it in place of the least recently used container
+	if(!l_Container)
+	{
+		if(mMappedContainers.size() < MAPPED_CONTAINER_CACHE)
+		{
+			l_Container = new MappedContainer();
+		}
+		else
+		{
+			l_Container = mMappedContainers.back();
+			mMappedContainers.pop_back();
+		}
+		l_Container->Open(in_Filename);
+	}
+
+	mMappedContainers.insert(mMappedContainers.begin(), l_Container);
+	return l_Container->IsOpen() ? l_Container : NULL;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void TextureLoader::DecodeBatch(ReadBatch& io_Batch, const unsigned char* in_Data, bool in_Read, const MappedContainer* in_Container)
+{
+	// Decode each blob once, in file order. Duplicate requests get the same texture, which is safe as
+	// thumbnail textures are never freed. The decoder scratch is released after each blob
+	vector<RequestData>& l_Batch = io_Batch.Requests;
+	sort(l_Batch.begin(), l_Batch.end(), CompareBlobs);
+	TextureData l_Texture;
+	for(unsigned i = 0; i < l_Batch.size(); i++)
+	{
+		const RequestData& l_Request = l_Batch[i];
+		TRACE_REQUEST_STEP(in_Read ? "Read" : "ReadFailed", l_Request.TraceId)
+		if(i == 0 || !IsSameBlob(l_Request, l_Batch[i - 1]))
+		{
+			l_Texture = TextureData();
+			if(in_Read && in_Container && mVerifyChecksums && !in_Container->VerifyBlob(l_Request.TextureOffset, l_Request.TextureSize))
+			{
+				logf("Thumbnail at offset %u in '%s' failed its checksum", l_Request.TextureOffset, l_Request.Filename);
+			}
+			else if(in_Read)
+			{
+				// The decoded pixels go to the decoded cache as well as the graphics card. When the texture is
+				// compressed to the cache format anyway, the cache takes the compressed copy
+				unsigned l_Mark = mWorkerArena.GetMark();
+				DecodedImage l_Image(&mStagingPool);
+				if(DecodeData(in_Data + (l_Request.TextureOffset - io_Batch.Start), l_Request.TextureSize, l_Image, mWorkerArena, l_Request.ScaleShift,
+							  mOutputFormat))
+				{
+					TRACE_REQUEST_STEP("Decoded", l_Request.TraceId)
+					DecodedImage l_Converted(&mStagingPool);
+					const DecodedImage& l_Prepared = PrepareTexture(l_Image, l_Converted);
+					if(mDecodedCache)
+					{
+						mDecodedCache->Store(l_Request.Filename, l_Request.TextureOffset, l_Request.TextureSize, l_Request.ScaleShift,
+											 l_Prepared.Format == mDecodedCache->GetFormat() ? l_Prepared : l_Image);
+					}
+					StreamTexture(l_Prepared, l_Texture);
+					TRACE_REQUEST_STEP("Uploaded", l_Request.TraceId)
+				}
+				mWorkerArena.Rewind(l_Mark);
+
+				if(!l_Texture.Handle && !l_Texture.Streamed)
+				{
+					logf("Failed to decode thumbnail at offset %u in '%s'", l_Request.TextureOffset, l_Request.Filename);
+				}
+			}
+		}
+
+		// Hand the texture to the main thread, which notifies the requestor
+		PostCompletion(l_Request, l_Texture, false);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::IsSameContainer(const RequestData& in_A, const RequestData& in_B)
+{
+	// Requests for the same container nearly always share the filename string, so compare the pointers first
+	return in_A.Filename == in_B.Filename || strcmp(in_A.Filename, in_B.Filename) == 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::IsSameBlob(const RequestData& in_A, const RequestData& in_B)
+{
+	return in_A.TextureOffset == in_B.TextureOffset && in_A.TextureSize == in_B.TextureSize && in_A.ScaleShift == in_B.ScaleShift &&
+		   IsSameContainer(in_A, in_B);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool TextureLoader::CompareBlobs(const RequestData& in_A, const RequestData& in_B)
+{
+	// Only used within a batch, where every request is for the same container
+	if(in_A.TextureOffset != in_B.TextureOffset)
+	{
+		return in_A.TextureOffset < in_B.TextureOffset;
+	}
+	if(in_A.TextureSize != in_B.TextureSize)
+	{
+		return in_A.TextureSize < in_B.TextureSize;
+	}
+	return in_A.ScaleShift < in_B.ScaleShift;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int TextureLoader::CompareLocation(const RequestData& in_Request, const char* in_Filename, unsigned in_Offset)
+{
+	// The container names are numbered, so comparing them orders the containers as they were written
+	int l_Compare = strcmp(in_Request.Filename, in_Filename);
+	if(l_Compare != 0)
+	{
+		return l_Compare;
+	}
+	return in_Request.TextureOffset < in_Offset ? -1 : (in_Request.TextureOffset > in_Offset ? 1 : 0);
+}
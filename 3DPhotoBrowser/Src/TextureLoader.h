@@ -8,7 +8,15 @@
 
 #include "Global.h"
 #include "Thread.h"
-#include "Semaphore.h"
+#include "LockFreeRing.h"
+#include "ImageDecoder.h"
+
+/**
+ * Forwards
+ */
+class AsyncFileReader;
+class MappedContainer;
+class DecodedCache;
 
 /**
  * TextureLoaderListener
@@ -23,25 +31,110 @@ public:
 	 * When a texture load completes, this method is called on the listener that requested the load
 	 */
 	virtual void OnLoadComplete(TextureHandle in_Handle, void* in_UserData) = 0;
+
+	/**
+	 * OnLoadCancelled
+	 * When a queued load is cancelled before it starts, this method is called on the listener that requested the load
+	 */
+	virtual void OnLoadCancelled(void* in_UserData) = 0;
+};
+
+/**
+ * LoadPriority
+ * Texture load request priorities. Higher priority requests are always serviced first
+ */
+enum LoadPriority
+{
+	LoadPriority_Visible,		// The texture is needed on screen right now
+	LoadPriority_Margin,		// The texture is just outside the view and will be needed as soon as the camera pans
+	LoadPriority_Prefetch,		// The texture is expected to be needed soon
+	LoadPriority_MAX,
 };
 
 /**
  * TextureLoader
- * Singleton used to manage asynchronous texture load requests
+ * Singleton used to manage asynchronous texture load requests.
+ * Requests go to the worker thread through a lock-free ring, and finished loads come back through another one that
+ * the main thread drains in ProcessCompletions, so listeners are only ever called on the main thread. Neither side
+ * takes a lock, so submitting requests and collecting results never stalls the render thread
  */
 class TextureLoader : public Thread
 {
+	/**
+	 * RequestType
+	 * What a message in the request ring asks the worker thread to do
+	 */
+	enum RequestType
+	{
+		RequestType_Load,
+		RequestType_Promote,		// Move the queued load for UserData to Priority
+		RequestType_Cancel,			// Cancel the queued load for UserData
+		RequestType_CancelAll,		// Cancel every load queued at Priority
+		RequestType_SetFormat,		// Decode in Format from now on
+	};
+
 	/**
 	 * RequestData
 	 * Supporting structure used to queue load requests
 	 */
 	struct RequestData
 	{
+		RequestType Type;
+		LoadPriority Priority;
 		TextureLoaderListener* Listener;
 		void* UserData;
-		string Filename;
+		const char* Filename;		// Owned by the requestor
 		unsigned TextureOffset;
 		unsigned TextureSize;
+		int ScaleShift;
+		double SubmitTime;			// When the load was requested, or promoted to a higher priority
+		double WindowTime;			// When the request entered the schedule window, for the I/O deadline. 0 until it does
+		unsigned TraceId;			// Request id in the event trace, 0 if it isn't traced
+		OutputFormat Format;		// RequestType_SetFormat only
+	};
+
+	/**
+	 * ReadBatch
+	 * Requests served by a single container read (worker thread only)
+	 */
+	struct ReadBatch
+	{
+		vector<RequestData> Requests;
+		unsigned Start;					// Span of the container read for the requests
+		unsigned End;
+		vector<unsigned char> Data;		// Buffer for an asynchronous read, from the staging pool
+	};
+
+	/**
+	 * TextureData
+	 * A texture made by the worker thread. Either it has been created already, or its pixels are in the graphics
+	 * upload buffer and the main thread creates it from there
+	 */
+	struct TextureData
+	{
+		TextureData() : Handle(NULL), Streamed(false) {}
+
+		TextureHandle Handle;
+		bool Streamed;				// Upload, Width, Height and Format are set, Handle isn't
+		UploadSpan Upload;
+		int Width;
+		int Height;
+		TextureFormat Format;
+	};
+
+	/**
+	 * CompletionData
+	 * A finished or cancelled load, waiting for the main thread to notify the listener
+	 */
+	struct CompletionData
+	{
+		TextureLoaderListener* Listener;
+		void* UserData;
+		TextureData Texture;
+		bool Cancelled;
+		LoadPriority Priority;		// Priority the load was served at
+		double SubmitTime;			// When the load was requested
+		unsigned TraceId;
 	};
 
 public:
@@ -70,17 +163,85 @@ public:
 	 */
 	void StopThread();
 
+	/**
+	 * RegisterDecoder
+	 * Add a decoder to the end of the list tried for each thumbnail. The loader takes ownership of the decoder
+	 */
+	void RegisterDecoder(ImageDecoder* in_Decoder);
+
+	/**
+	 * ReadContainer
+	 * Read in_Size bytes at in_Offset of a container file, failing if fewer than in_MinSize arrive (all of them if 0).
+	 * Doesn't touch the loader, so it may be called from any thread before the singleton exists
+	 */
+	static bool ReadContainer(const char* in_Filename, unsigned in_Offset, unsigned in_Size, unsigned char* out_Data, unsigned in_MinSize = 0,
+							  unsigned* out_BytesRead = NULL);
+
 	/**
 	 * LoadTexture
 	 * Synchronous texture load
 	 */
-	TextureHandle LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize);
+	TextureHandle LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, int in_ScaleShift = 0);
 
 	/**
 	 * LoadTexture
-	 * Request an asynchronous texture load
+	 * Request an asynchronous texture load. in_Filename isn't copied, it must stay valid until the listener is notified.
+	 * May be called from any thread. Returns false if the request ring is full, in which case nothing was queued
+	 */
+	bool LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, TextureLoaderListener* in_Listener, void* in_UserData,
+					 LoadPriority in_Priority = LoadPriority_Visible, int in_ScaleShift = 0);
+
+	/**
+	 * ProcessCompletions
+	 * Notify the listeners of every load that has finished or been cancelled since the last call. Main thread only
 	 */
-	void LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, TextureLoaderListener* in_Listener, void* in_UserData);
+	void ProcessCompletions();
+
+	/**
+	 * BeginBatch
+	 * Begin submitting a batch of requests from the main thread. A suspended worker thread isn't woken
+	 * for each request, only once when the batch ends. Batches may be nested
+	 */
+	void BeginBatch();
+
+	/**
+	 * EndBatch
+	 * Finish a batch of requests and wake the worker thread once if anything was queued
+	 */
+	void EndBatch();
+
+	/**
+	 * PromoteRequest
+	 * Move a queued request to a higher priority. in_UserData identifies the request.
+	 * The worker thread applies this when it next looks at the queue; if the load has already started nothing happens
+	 */
+	void PromoteRequest(void* in_UserData, LoadPriority in_Priority);
+
+	/**
+	 * CancelRequest
+	 * Cancel a single queued request, identified by in_UserData. If the request was still queued when the worker thread
+	 * sees this, the listener receives OnLoadCancelled from ProcessCompletions, otherwise the load completes as normal
+	 */
+	void CancelRequest(void* in_UserData);
+
+	/**
+	 * CancelRequests
+	 * Cancel all requests queued at the specified priority. Listeners receive OnLoadCancelled for each request
+	 */
+	void CancelRequests(LoadPriority in_Priority);
+
+	/**
+	 * GetPendingCount
+	 * Get the number of requests submitted at (or promoted to) the specified priority that haven't started loading yet
+	 */
+	unsigned GetPendingCount(LoadPriority in_Priority);
+
+	/**
+	 * Configure
+	 * Choose the layout textures are decoded in again, after the user preferences change. Main thread only.
+	 * Textures already loaded keep the layout they were decoded in
+	 */
+	void Configure();
 
 	/**
 	 * Thread interface
@@ -89,12 +250,162 @@ public:
 
 private:
 
+	/**
+	 * LoadTexture
+	 * Upload a texture from the decoded cache, or read, decode and upload it using the calling thread's arena and store it in
+	 * the cache. The staging buffers go back to the pool once uploaded
+	 */
+	TextureHandle LoadTexture(const char* in_Filename, unsigned in_TextureOffset, unsigned in_TextureSize, int in_ScaleShift, DecodeArena& io_Arena);
+
+	/**
+	 * SelectRequest
+	 * Pick the request in the in_Priority queue to serve next (worker thread only). The oldest IoScheduleWindow
+	 * requests are served in elevator order by (container, offset), sweeping forward from the end of the last read
+	 * so the disk head moves one way through the containers. A request that has been in the window for longer than
+	 * IoDeadline goes first, and out_Deadline is set so the sweep isn't moved by it
+	 */
+	unsigned SelectRequest(int in_Priority, bool& out_Deadline);
+
+	/**
+	 * GatherBatch
+	 * Take request in_Index of the in_Priority queue, along with every queued request for the same blob and the same
+	 * priority requests for nearby blobs in the same container, which can all be served by a single read. The sweep
+	 * continues from the end of the batch unless in_Deadline is set
+	 */
+	void GatherBatch(int in_Priority, unsigned in_Index, bool in_Deadline, ReadBatch& out_Batch);
+
+	/**
+	 * DecodeBatch
+	 * Decode and upload each blob in a batch from the data read for it, then post the completions.
+	 * in_Read is false if the read failed, the requests then complete without a texture. When the data is in a
+	 * mapped container, each blob is checked against its checksum first if VerifyThumbnailChecksums is set
+	 */
+	void DecodeBatch(ReadBatch& io_Batch, const unsigned char* in_Data, bool in_Read, const MappedContainer* in_Container = NULL);
+
+	/**
+	 * MapContainer
+	 * Find or map a container in the mapped container cache. Returns NULL if it can't be mapped
+	 */
+	MappedContainer* MapContainer(const char* in_Filename);
+
+	/**
+	 * LoadBatch
+	 * Gather, read and decode a batch with a blocking read, when there is no asynchronous reader
+	 */
+	void LoadBatch(int in_Priority, unsigned in_Index, bool in_Deadline);
+
+	/**
+	 * DecodeFromReadAhead
+	 * Decode a batch that lies within the data read ahead of the last read, returning false if it doesn't
+	 */
+	bool DecodeFromReadAhead(ReadBatch& io_Batch);
+
+	/**
+	 * KeepReadAhead
+	 * Keep the data of a finished read, which runs ThumbnailReadAhead past the end of its batch. In a container of
+	 * whole LOD chains that is the image's next sizes up, so zooming in on a tile usually needs no read at all
+	 */
+	void KeepReadAhead(ReadBatch& io_Batch, unsigned in_BytesRead);
+
+	/**
+	 * ServeFromCache
+	 * Upload the blobs of a batch that are in the decoded cache and post their completions, leaving the rest in the
+	 * batch with its span shrunk to fit them. Returns true if the cache served the whole batch
+	 */
+	bool ServeFromCache(ReadBatch& io_Batch);
+
+	/**
+	 * SubmitReads / FinishRead
+	 * With an asynchronous reader, SubmitReads gathers batches and starts their reads until as many reads are in flight
+	 * as the reader allows. FinishRead decodes a batch whose read has finished, returning false if none has
+	 */
+	void SubmitReads();
+	bool FinishRead();
+
+	/**
+	 * ChooseOutputFormat
+	 * Pick the layout textures are decoded in from what the graphics card takes without converting
+	 */
+	OutputFormat ChooseOutputFormat();
+
+	/**
+	 * SubmitOutputFormat
+	 * Send mChosenFormat to the worker thread. If the request ring is full it is sent again from ProcessCompletions
+	 */
+	void SubmitOutputFormat();
+
+	/**
+	 * Helpers
+	 */
+	bool DecodeData(const unsigned char* in_Data, unsigned in_Size, DecodedImage& out_Image, DecodeArena& io_Arena, int in_ScaleShift,
+					const OutputFormat& in_Format);
+	TextureHandle UploadTexture(const DecodedImage& in_Image);
+	void StreamTexture(const DecodedImage& in_Image, TextureData& out_Texture);
+	const DecodedImage& PrepareTexture(const DecodedImage& in_Image, DecodedImage& io_Converted);
+	bool SubmitRequest(const RequestData& in_Request);
+	void WakeThread();
+	void ApplyRequest(const RequestData& in_Request);
+	void PostCompletion(const RequestData& in_Request, const TextureData& in_Texture, bool in_Cancelled);
+
+	static bool IsSameContainer(const RequestData& in_A, const RequestData& in_B);
+	static bool IsSameBlob(const RequestData& in_A, const RequestData& in_B);
+	static bool CompareBlobs(const RequestData& in_A, const RequestData& in_B);
+	static int CompareLocation(const RequestData& in_Request, const char* in_Filename, unsigned in_Offset);
+
 	bool mThreadStarted;
-	bool mThreadDone;
-	bool mStopThread;
+	volatile bool mThreadDone;
+	volatile bool mStopThread;
+
+	MpscRing<RequestData> mRequestRing;					// Requests on their way to the worker thread
+	SpscRing<CompletionData> mCompletionRing;			// Results on their way back to the main thread
+	deque<RequestData> mRequestQueue[LoadPriority_MAX];	// Requests accepted by the worker, one queue per priority (worker thread only)
+	AtomicLong mPendingCount[LoadPriority_MAX];			// Loads submitted at each priority that haven't started yet
+	char mHeadFilename[MAX_PATH];						// Container and offset just past the last read, where the
+	unsigned mHeadOffset;								// elevator sweep continues from (worker thread only)
+
+	AsyncFileReader* mReader;							// Keeps several reads in flight, NULL for blocking reads
+	vector<ReadBatch> mReadBatches;						// One per read in flight (worker thread only)
+	vector<unsigned> mFreeReadBatches;					// Batches with no read in flight
+
+	bool mMapContainers;								// Decode straight out of mapped containers instead of reading
+	bool mVerifyChecksums;								// Check mapped blobs against their table of contents checksums
+	vector<MappedContainer*> mMappedContainers;			// Most recently used first (worker thread only)
+
+	unsigned mReadAheadBytes;							// How far past the end of each batch to read
+	vector<unsigned char> mReadAhead;					// Data of the last read, from the staging pool (worker thread only)
+	char mReadAheadFilename[MAX_PATH];
+	unsigned mReadAheadStart;							// Span of the container in mReadAhead
+	unsigned mReadAheadEnd;
+
+	DecodedCache* mDecodedCache;						// Decoded thumbnails from earlier sessions, NULL if off
+	unsigned mDecodedCacheCount;						// Number of batches the cache served without a read
+
+#ifdef WIN32
+	HANDLE mWakeEvent;		// Signalled when there are new requests for the worker thread
+#endif // WIN32
+
+	int mBatchDepth;		// Nesting depth of BeginBatch calls (main thread only)
+	bool mBatchQueued;		// Was anything queued during the current batch?
+
+	vector<ImageDecoder*> mDecoders;	// Decoders in the order they are tried
+	OutputFormat mOutputFormat;			// Layout textures are decoded in (worker thread only, once it has started)
+	OutputFormat mChosenFormat;			// Layout last chosen, which synchronous loads use (main thread only)
+	bool mChosenFormatPending;			// Has mChosenFormat still to reach the worker thread?
 
-	Semaphore mQueueLock;
-	queue<RequestData> mRequestQueue;
+	DecodeArena mWorkerArena;			// Decode scratch memory for the worker thread
+	DecodeArena mSyncArena;				// Decode scratch memory for synchronous loads on the main thread
+	StagingBufferPool mStagingPool;		// Decoded pixels waiting to be uploaded
+	unsigned mLoadCount;				// Number of textures loaded, for the allocation statistics
+	unsigned mTextureMemory;			// Kilobytes of texture data uploaded
+	double mUploadTime;					// Seconds spent creating and uploading textures, or copying them to the upload buffer,
+	double mMaxUploadTime;				// in total and the longest
+	unsigned mStreamedCount;			// Number of textures the worker sent through the upload buffer
+	unsigned mLastUploadEnd;			// Most recent streamed texture, which duplicate requests share (main thread only)
+	TextureHandle mLastUploadHandle;
+	unsigned mRequestCount;				// Number of requests serviced by the worker thread
+	unsigned mReadCount;				// Number of container reads made by the worker thread
+	unsigned mDeadlineCount;			// Number of reads served out of elevator order because a request hit the deadline
+	unsigned mReadAheadCount;			// Number of batches served from the read ahead data without a read
 
 	/**
 	 * Singleton implementation
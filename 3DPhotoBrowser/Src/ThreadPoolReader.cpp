@@ -0,0 +1,144 @@
+/**
+ * @file ThreadPoolReader.cpp
+ * @brief ThreadPoolReader implementation file
+ */
+
+#include "ThreadPoolReader.h"
+#include "Tracer.h"
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// ThreadPoolReader
+
+ThreadPoolReader::ThreadPoolReader(unsigned in_MaxInFlight, HANDLE in_NotifyEvent)
+: AsyncFileReader(in_MaxInFlight, in_NotifyEvent)
+, mRunningCount(0)
+, mStopThreads(false)
+, mJobs(in_MaxInFlight, (ReadData*)NULL)
+, mJobHead(0)
+, mJobCount(0)
+{
+#ifdef WIN32
+	mJobSemaphore = CreateSemaphore(NULL, 0, in_MaxInFlight * 2, NULL);
+#else
+	#error Your platform semaphore creation goes here
+#endif // WIN32
+
+	for(unsigned i = 0; i < in_MaxInFlight; i++)
+	{
+		mThreads.push_back(new ReadThread(this));
+		AtomicIncrement(&mRunningCount);
+		mThreads.back()->Start(false);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+ThreadPoolReader::~ThreadPoolReader()
+{
+	// Wake every thread, they see the stop flag and exit
+	mStopThreads = true;
+	for(unsigned i = 0; i < mThreads.size(); i++)
+	{
+#ifdef WIN32
+		ReleaseSemaphore(mJobSemaphore, 1, NULL);
+#else
+		#error Your platform semaphore signal goes here
+#endif // WIN32
+	}
+	while(mRunningCount > 0)
+	{
+		Sleep(0); // Yield timeslice
+	}
+
+	for(unsigned i = 0; i < mThreads.size(); i++)
+	{
+		delete mThreads[i];
+	}
+
+#ifdef WIN32
+	CloseHandle(mJobSemaphore);
+#else
+	#error Your platform semaphore destruction goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+DWORD ThreadPoolReader::GetOpenFlags() const
+{
+	return FILE_FLAG_OVERLAPPED;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool ThreadPoolReader::StartRead(ReadData* io_Read)
+{
+	// There is room for every read in flight, so the queue is never full
+	mJobLock.Lock();
+	mJobs[(mJobHead + mJobCount) % mJobs.size()] = io_Read;
+	mJobCount++;
+	mJobLock.Unlock();
+
+#ifdef WIN32
+	ReleaseSemaphore(mJobSemaphore, 1, NULL);
+#else
+	#error Your platform semaphore signal goes here
+#endif // WIN32
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void ThreadPoolReader::RunThread()
+{
+	Tracer::Instance()->SetThreadName("ReadThread");
+
+	// Each thread waits for its reads on its own event
+#ifdef WIN32
+	HANDLE l_ReadEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+#else
+	#error Your platform event creation goes here
+#endif // WIN32
+
+	for(;;)
+	{
+#ifdef WIN32
+		WaitForSingleObject(mJobSemaphore, INFINITE);
+#else
+		#error Your platform semaphore wait goes here
+#endif // WIN32
+		if(mStopThreads)
+		{
+			break;
+		}
+
+		mJobLock.Lock();
+		ReadData* l_Read = mJobs[mJobHead];
+		mJobHead = (mJobHead + 1) % mJobs.size();
+		mJobCount--;
+		mJobLock.Unlock();
+
+		// The offset in the OVERLAPPED positions the read. The handle is overlapped, so reads by the other threads
+		// on the same file proceed at the same time rather than queueing behind this one
+		DWORD l_BytesRead = 0;
+		bool l_Success;
+		{
+			TRACE_SCOPE("Read")
+#ifdef WIN32
+			l_Read->Overlapped.hEvent = l_ReadEvent;
+			l_Success = (ReadFile(l_Read->File, l_Read->Buffer, l_Read->Size, NULL, &l_Read->Overlapped) || GetLastError() == ERROR_IO_PENDING) &&
+						GetOverlappedResult(l_Read->File, &l_Read->Overlapped, &l_BytesRead, TRUE);
+#else
+			#error Your platform positioned file read goes here
+#endif // WIN32
+		}
+		CompleteRead(l_Read, l_Success, l_BytesRead);
+	}
+
+#ifdef WIN32
+	CloseHandle(l_ReadEvent);
+#else
+	#error Your platform event destruction goes here
+#endif // WIN32
+	AtomicDecrement(&mRunningCount);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file ThreadPoolReader.h
+ * @brief ThreadPoolReader class header file
+ */
+
+#ifndef THREADPOOLREADER_H_
+#define THREADPOOLREADER_H_
+
+#include "Global.h"
+#include "AsyncFileReader.h"
+#include "Semaphore.h"
+#include "Thread.h"
+
+/**
+ * ThreadPoolReader
+ * Blocking positioned reads, one read thread per read in flight. For when a completion port isn't available,
+ * and as a baseline to measure it against. The files are opened for overlapped I/O, otherwise the system would
+ * serialize the reads the threads make on a shared handle, and each thread waits for its own read
+ */
+class ThreadPoolReader : public AsyncFileReader
+{
+public:
+
+	ThreadPoolReader(unsigned in_MaxInFlight, HANDLE in_NotifyEvent);
+	virtual ~ThreadPoolReader();
+
+	/**
+	 * AsyncFileReader interface
+	 */
+	virtual const char* GetName() const { return "thread pool"; }
+
+protected:
+
+	/**
+	 * AsyncFileReader backend interface
+	 */
+	virtual DWORD GetOpenFlags() const;
+	virtual bool StartRead(ReadData* io_Read);
+
+private:
+
+	/**
+	 * ReadThread
+	 * A thread of the pool
+	 */
+	class ReadThread : public Thread
+	{
+	public:
+		ReadThread(ThreadPoolReader* in_Owner) : mOwner(in_Owner) {}
+		virtual void Run() { mOwner->RunThread(); }
+	private:
+		ThreadPoolReader* mOwner;
+	};
+
+	/**
+	 * RunThread
+	 * Read thread routine, does reads until the pool stops
+	 */
+	void RunThread();
+
+	vector<ReadThread*> mThreads;
+	AtomicLong mRunningCount;			// Threads that haven't exited yet
+	volatile bool mStopThreads;
+
+	Semaphore mJobLock;					// Protects the job queue
+	vector<ReadData*> mJobs;			// Circular queue of reads waiting for a thread, one entry per read in flight
+	unsigned mJobHead;
+	unsigned mJobCount;
+
+#ifdef WIN32
+	HANDLE mJobSemaphore;				// Counts the jobs, the threads sleep on it
+#endif // WIN32
+};
+
+#endif // THREADPOOLREADER_H_
@@ -0,0 +1,554 @@
+/**
+ * @file Tracer.cpp
+ * @brief Event tracer implementation file
+ */
+
+#include "Tracer.h"
+
+// Trace file
+#define TRACE_FILENAME "data/Trace.json"
+
+/**
+ * TRACE_MAX_FULL_BUFFERS
+ * Full buffers that may wait for the writer thread. Once this many are waiting, a thread whose buffer fills up
+ * drops its events until the writer catches up
+ */
+#define TRACE_MAX_FULL_BUFFERS 8
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Tracer
+
+Tracer::Tracer()
+: mEnabled(false)
+, mStartTime(Timer::Instance()->GetSeconds())
+, mNextRequestId(0)
+, mEventCapacity(0)
+, mEventBufferCount(0)
+, mHandOffCount(0)
+, mThreadStarted(false)
+, mThreadDone(false)
+, mStopThread(false)
+, mFileFailed(false)
+, mFileEntries(0)
+, mFileEvents(0)
+, mFooterWritten(false)
+{
+#ifdef WIN32
+	mBufferIndex = TlsAlloc();
+	mWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+#else
+	#error Your platform thread local storage and event allocation go here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+Tracer::~Tracer()
+{
+	// The writer finishes the buffers handed to it before it stops
+	if(mThreadStarted)
+	{
+		mStopThread = true;
+#ifdef WIN32
+		SetEvent(mWakeEvent);
+#else
+		#error Your platform event signal goes here
+#endif // WIN32
+		while(!mThreadDone)
+		{
+			Sleep(0); // Yield timeslice
+		}
+	}
+
+	for(unsigned i = 0; i < mBuffers.size(); i++)
+	{
+		delete [] mBuffers[i]->Events;
+		delete mBuffers[i];
+	}
+	for(unsigned i = 0; i < mFullBuffers.size(); i++)
+	{
+		delete [] mFullBuffers[i].Events;
+	}
+	for(unsigned i = 0; i < mSpareEvents.size(); i++)
+	{
+		delete [] mSpareEvents[i];
+	}
+
+#ifdef WIN32
+	TlsFree(mBufferIndex);
+	CloseHandle(mWakeEvent);
+#else
+	#error Your platform thread local storage and event release go here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::Configure()
+{
+#if USE_TRACING
+	bool l_Enabled = UserPreferences::Instance()->TraceEvents();
+#else
+	bool l_Enabled = false;
+#endif // USE_TRACING
+	if(l_Enabled != mEnabled)
+	{
+		logf("Tracer: event recording %s", l_Enabled ? "started" : "stopped");
+	}
+
+	// Every buffer is the same size, so the writer's spares fit any thread
+	if(l_Enabled && !mThreadStarted)
+	{
+		mEventCapacity = (unsigned)max(1, UserPreferences::Instance()->TraceBufferSize());
+		mThreadStarted = true;
+		Start(false);
+	}
+	mEnabled = l_Enabled;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::SetThreadName(const char* in_Name)
+{
+	GetThreadBuffer()->ThreadName = in_Name;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::Complete(const char* in_Name, double in_Start, double in_End)
+{
+	if(!mEnabled)
+	{
+		return;
+	}
+
+	ThreadBuffer* l_Buffer = GetThreadBuffer();
+	Event* l_Event = AddEvent(l_Buffer, EventType_Complete, in_Name, in_Start);
+	if(l_Event)
+	{
+		l_Event->Duration = (float)(in_End - in_Start);
+		PublishEvent(l_Buffer);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::Counter(const char* in_Name, int in_Value)
+{
+	if(!mEnabled)
+	{
+		return;
+	}
+
+	ThreadBuffer* l_Buffer = GetThreadBuffer();
+	Event* l_Event = AddEvent(l_Buffer, EventType_Counter, in_Name, Timer::Instance()->GetSeconds());
+	if(l_Event)
+	{
+		l_Event->ArgName = "value";
+		l_Event->Value = in_Value;
+		PublishEvent(l_Buffer);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+unsigned Tracer::NewRequestId()
+{
+	return mEnabled ? (unsigned)AtomicIncrement(&mNextRequestId) : 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::RequestBegin(const char* in_Name, unsigned in_Id, const char* in_ArgName, int in_Value)
+{
+	if(!mEnabled || in_Id == 0)
+	{
+		return;
+	}
+
+	ThreadBuffer* l_Buffer = GetThreadBuffer();
+	Event* l_Event = AddEvent(l_Buffer, EventType_RequestBegin, in_Name, Timer::Instance()->GetSeconds());
+	if(l_Event)
+	{
+		l_Event->Id = in_Id;
+		l_Event->ArgName = in_ArgName;
+		l_Event->Value = in_Value;
+		PublishEvent(l_Buffer);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::RequestStep(const char* in_Step, unsigned in_Id, double in_Time)
+{
+	if(!mEnabled || in_Id == 0)
+	{
+		return;
+	}
+
+	ThreadBuffer* l_Buffer = GetThreadBuffer();
+	Event* l_Event = AddEvent(l_Buffer, EventType_RequestStep, in_Step, in_Time >= 0.0 ? in_Time : Timer::Instance()->GetSeconds());
+	if(l_Event)
+	{
+		l_Event->Id = in_Id;
+		PublishEvent(l_Buffer);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::RequestEnd(const char* in_Name, unsigned in_Id)
+{
+	if(!mEnabled || in_Id == 0)
+	{
+		return;
+	}
+
+	ThreadBuffer* l_Buffer = GetThreadBuffer();
+	Event* l_Event = AddEvent(l_Buffer, EventType_RequestEnd, in_Name, Timer::Instance()->GetSeconds());
+	if(l_Event)
+	{
+		l_Event->Id = in_Id;
+		PublishEvent(l_Buffer);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+Tracer::ThreadBuffer* Tracer::GetThreadBuffer()
+{
+#ifdef WIN32
+	ThreadBuffer* l_Buffer = (ThreadBuffer*)TlsGetValue(mBufferIndex);
+#else
+	#error Your platform thread local storage lookup goes here
+#endif // WIN32
+	if(l_Buffer)
+	{
+		return l_Buffer;
+	}
+
+	// First use on this thread. The events themselves are only allocated once the thread records one
+	l_Buffer = new ThreadBuffer;
+	l_Buffer->ThreadName = NULL;
+	l_Buffer->Events = NULL;
+	l_Buffer->Count = 0;
+	l_Buffer->Written = 0;
+	l_Buffer->Dropped = 0;
+#ifdef WIN32
+	l_Buffer->ThreadId = GetCurrentThreadId();
+	TlsSetValue(mBufferIndex, l_Buffer);
+#else
+	#error Your platform thread id and thread local storage store go here
+#endif // WIN32
+
+	mBufferLock.Lock();
+	mBuffers.push_back(l_Buffer);
+	mBufferLock.Unlock();
+	return l_Buffer;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+Tracer::Event* Tracer::AddEvent(ThreadBuffer* io_Buffer, char in_Type, const char* in_Name, double in_Time)
+{
+	if(!io_Buffer->Events)
+	{
+		Event* l_Events = AcquireEvents();
+		mQueueLock.Lock();
+		io_Buffer->Events = l_Events;
+		mQueueLock.Unlock();
+	}
+
+	// A full buffer is swapped for a spare and written out by the writer thread, this thread only moves pointers
+	unsigned l_Count = (unsigned)io_Buffer->Count;
+	if(l_Count >= mEventCapacity)
+	{
+		if(!HandOffBuffer(io_Buffer))
+		{
+			io_Buffer->Dropped++;
+			return NULL;
+		}
+		l_Count = 0;
+	}
+
+	Event* l_Event = &io_Buffer->Events[l_Count];
+	l_Event->Time = in_Time;
+	l_Event->Duration = 0.0f;
+	l_Event->Type = in_Type;
+	l_Event->Name = in_Name;
+	l_Event->ArgName = NULL;
+	l_Event->Value = 0;
+	l_Event->Id = 0;
+	return l_Event;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::PublishEvent(ThreadBuffer* io_Buffer)
+{
+	// The event is only visible to the trace writer once it is complete
+	AtomicStore(&io_Buffer->Count, io_Buffer->Count + 1);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+Tracer::Event* Tracer::AcquireEvents()
+{
+	mQueueLock.Lock();
+	Event* l_Events = NULL;
+	if(!mSpareEvents.empty())
+	{
+		l_Events = mSpareEvents.back();
+		mSpareEvents.pop_back();
+	}
+	else
+	{
+		mEventBufferCount++;
+	}
+	mQueueLock.Unlock();
+
+	return l_Events ? l_Events : new Event[mEventCapacity];
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Tracer::HandOffBuffer(ThreadBuffer* io_Buffer)
+{
+	mQueueLock.Lock();
+	bool l_Backlogged = mFullBuffers.size() >= TRACE_MAX_FULL_BUFFERS;
+	mQueueLock.Unlock();
+	if(l_Backlogged)
+	{
+		return false;
+	}
+
+	Event* l_Spare = AcquireEvents();
+
+	// WriteTrace takes the same lock to read Events and Written, so it sees the buffer on one side of the swap or the other
+	FullBuffer l_Full;
+	l_Full.Owner = io_Buffer;
+	l_Full.Events = io_Buffer->Events;
+	l_Full.Count = (unsigned)io_Buffer->Count;
+	mQueueLock.Lock();
+	l_Full.Written = io_Buffer->Written;
+	mFullBuffers.push_back(l_Full);
+	mHandOffCount++;
+	io_Buffer->Events = l_Spare;
+	io_Buffer->Written = 0;
+	AtomicStore(&io_Buffer->Count, 0);
+	mQueueLock.Unlock();
+
+#ifdef WIN32
+	SetEvent(mWakeEvent);
+#else
+	#error Your platform event signal goes here
+#endif // WIN32
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::Run()
+{
+	for(;;)
+	{
+#ifdef WIN32
+		WaitForSingleObject(mWakeEvent, INFINITE);
+#else
+		#error Your platform event wait goes here
+#endif // WIN32
+
+		// If the file can't be written the buffers keep waiting, WriteTrace tries the file again
+		mFileLock.Lock();
+		if(PrepareTraceFile())
+		{
+			WriteFullBuffers();
+			mFile.flush();
+		}
+		mFileLock.Unlock();
+
+		if(mStopThread)
+		{
+			break;
+		}
+	}
+
+	mThreadDone = true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Tracer::PrepareTraceFile()
+{
+	if(mFileFailed)
+	{
+		return false;
+	}
+
+	if(!mFile.is_open())
+	{
+		mFile.open(TRACE_FILENAME);
+		if(mFile.fail())
+		{
+			logf("Tracer: failed to write '%s', events are dropped when a thread's buffer is full", TRACE_FILENAME);
+			mFile.close();
+			mFile.clear();
+			mFileFailed = true;
+			return false;
+		}
+
+		// Times in microseconds from when the tracer started
+		mFile << "{\"traceEvents\":[" << fixed << setprecision(3);
+		mFileEntries = 0;
+		mFileEvents = 0;
+		mFooterWritten = false;
+	}
+
+	// Write over the footer of the last WriteTrace. What follows is always longer, so no stale footer is left behind
+	if(mFooterWritten)
+	{
+		mFile.seekp(mFooterPos);
+		mFooterWritten = false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::WriteFullBuffers()
+{
+	// Called with mFileLock held, so WriteTrace can't be writing one of these buffers at the same time
+	for(;;)
+	{
+		mQueueLock.Lock();
+		if(mFullBuffers.empty())
+		{
+			mQueueLock.Unlock();
+			break;
+		}
+		FullBuffer l_Full = mFullBuffers.front();
+		mFullBuffers.pop_front();
+		mQueueLock.Unlock();
+
+		WriteEvents(l_Full.Owner, l_Full.Events, l_Full.Written, l_Full.Count);
+
+		mQueueLock.Lock();
+		mSpareEvents.push_back(l_Full.Events);
+		mQueueLock.Unlock();
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void Tracer::WriteEvents(const ThreadBuffer* in_Owner, const Event* in_Events, unsigned in_Begin, unsigned in_End)
+{
+	for(unsigned i = in_Begin; i < in_End; i++)
+	{
+		const Event& l_Event = in_Events[i];
+		mFile << (mFileEntries++ ? "," : "") << endl << "{\"name\":\"" << l_Event.Name << "\",\"ph\":\"" << l_Event.Type << "\",\"pid\":1,\"tid\":" << in_Owner->ThreadId
+			  << ",\"ts\":" << (l_Event.Time - mStartTime) * 1000000.0;
+		if(l_Event.Type == EventType_Complete)
+		{
+			mFile << ",\"dur\":" << l_Event.Duration * 1000000.0;
+		}
+		if(l_Event.Id != 0)
+		{
+			mFile << ",\"cat\":\"request\",\"id\":" << l_Event.Id;
+		}
+		if(l_Event.ArgName)
+		{
+			mFile << ",\"args\":{\"" << l_Event.ArgName << "\":" << l_Event.Value << "}";
+		}
+		mFile << "}";
+		mFileEvents++;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool Tracer::WriteTrace()
+{
+	mBufferLock.Lock();
+	vector<ThreadBuffer*> l_Buffers = mBuffers;
+	mBufferLock.Unlock();
+
+	unsigned l_DroppedCount = 0;
+	for(unsigned b = 0; b < l_Buffers.size(); b++)
+	{
+		l_DroppedCount += l_Buffers[b]->Dropped;
+	}
+
+	// Try the file again, it may have been locked or missing when the writer thread last used it
+	mFileLock.Lock();
+	mFileFailed = false;
+	if(!PrepareTraceFile())
+	{
+		mFileLock.Unlock();
+		logf("Tracer: %u events dropped so far", l_DroppedCount);
+		return false;
+	}
+
+	// Whatever the writer thread hasn't got to yet, then what each thread has recorded since
+	WriteFullBuffers();
+	for(unsigned b = 0; b < l_Buffers.size(); b++)
+	{
+		ThreadBuffer* l_Buffer = l_Buffers[b];
+
+		// Named again on every write, in case the thread was named after the last one
+		mFile << (mFileEntries++ ? "," : "") << endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << l_Buffer->ThreadId
+			  << ",\"args\":{\"name\":\"";
+		if(l_Buffer->ThreadName)
+		{
+			mFile << l_Buffer->ThreadName;
+		}
+		else
+		{
+			mFile << "Thread " << l_Buffer->ThreadId;
+		}
+		mFile << "\"}}";
+
+		// The thread keeps recording while its events are written. If it fills the buffer meanwhile, the buffer is
+		// queued for the writer, which can't get to it before this is done, and only needs to know what was written
+		mQueueLock.Lock();
+		const Event* l_Events = l_Buffer->Events;
+		unsigned l_Begin = l_Buffer->Written;
+		unsigned l_End = (unsigned)l_Buffer->Count;
+		mQueueLock.Unlock();
+
+		WriteEvents(l_Buffer, l_Events, l_Begin, l_End);
+
+		mQueueLock.Lock();
+		if(l_Buffer->Events == l_Events)
+		{
+			l_Buffer->Written = l_End;
+		}
+		else
+		{
+			for(unsigned i = 0; i < mFullBuffers.size(); i++)
+			{
+				if(mFullBuffers[i].Events == l_Events)
+				{
+					mFullBuffers[i].Written = l_End;
+				}
+			}
+		}
+		mQueueLock.Unlock();
+	}
+
+	mFooterPos = mFile.tellp();
+	mFooterWritten = true;
+	mFile << endl << "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":\"" << l_DroppedCount << "\"}}" << endl;
+	mFile.flush();
+	bool l_Written = !mFile.fail();
+	unsigned l_EventCount = mFileEvents;
+	mFileLock.Unlock();
+
+	mQueueLock.Lock();
+	unsigned l_HandOffCount = mHandOffCount;
+	unsigned l_EventBufferCount = mEventBufferCount;
+	mQueueLock.Unlock();
+
+	logf("Tracer: wrote %u events from %u threads to '%s', %u dropped. %u full buffers handed to the writer thread, %u buffers allocated",
+		 l_EventCount, (unsigned)l_Buffers.size(), TRACE_FILENAME, l_DroppedCount, l_HandOffCount, l_EventBufferCount);
+	return l_Written;
+}
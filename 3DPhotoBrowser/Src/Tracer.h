@@ -0,0 +1,251 @@
+/**
+ * @file Tracer.h
+ * @brief Event tracer header file
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include "Global.h"
+#include "Atomic.h"
+#include "Semaphore.h"
+#include "Thread.h"
+
+/**
+ * Tracer
+ * Singleton recording timed events from any thread into a trace file for chrome://tracing or Perfetto.
+ * Each thread records into its own buffer, found through thread local storage, so recording an event never takes
+ * a lock or touches memory another thread writes. A buffer takes a lock when its thread records its first event,
+ * and when it fills up and is swapped for a spare. The full buffer is handed to the tracer's own thread, which
+ * appends it to the trace file, so no recording thread ever formats or writes events. Events are only dropped if
+ * the writer falls too far behind or the trace file can't be written. The trace can be written while the threads
+ * keep recording.
+ *
+ * Besides timed slices and counters, each texture load request gets an id and its own track in the trace, marked
+ * when it is queued, read, decoded, uploaded and finally applied to its image tile on the main thread
+ */
+class Tracer : public Thread
+{
+	/**
+	 * EventType
+	 * Trace event phases, as the trace file spells them
+	 */
+	enum EventType
+	{
+		EventType_Complete = 'X',		// A slice of time on the recording thread
+		EventType_Counter = 'C',		// A counter value
+		EventType_RequestBegin = 'b',	// A request track starts
+		EventType_RequestStep = 'n',	// Something happened to a request
+		EventType_RequestEnd = 'e',		// A request track ends
+	};
+
+	/**
+	 * Event
+	 * A recorded event. Names are string literals, so nothing is copied or allocated
+	 */
+	struct Event
+	{
+		double Time;				// Timer seconds
+		float Duration;				// Seconds, for complete events
+		char Type;
+		const char* Name;
+		const char* ArgName;		// Argument recorded with Value, NULL for none
+		int Value;
+		unsigned Id;				// Request id, for request events
+	};
+
+	/**
+	 * ThreadBuffer
+	 * The events recorded by one thread. Only the owning thread writes the events and Count
+	 */
+	struct ThreadBuffer
+	{
+		unsigned ThreadId;
+		const char* ThreadName;
+		Event* Events;				// mEventCapacity events. Only swapped with mQueueLock held
+		AtomicLong Count;			// Events written so far, stored after each event is complete
+		unsigned Written;			// Events already in the trace file. Only used with mQueueLock held
+		unsigned Dropped;			// Events lost because the writer was too far behind to take the full buffer
+	};
+
+	/**
+	 * FullBuffer
+	 * A thread's full events, waiting for the writer thread
+	 */
+	struct FullBuffer
+	{
+		ThreadBuffer* Owner;
+		Event* Events;
+		unsigned Count;
+		unsigned Written;			// Events WriteTrace already wrote before the buffer filled up
+	};
+
+public:
+
+	/**
+	 * Instance
+	 * Get the singleton instance
+	 */
+	static Tracer* Instance() { static Tracer l_Instance; return &l_Instance; }
+
+	/**
+	 * Configure
+	 * Start or stop recording as the TraceEvents preference says. The buffer size is fixed when recording first starts
+	 */
+	void Configure();
+
+	/**
+	 * IsEnabled
+	 * Are events being recorded?
+	 */
+	bool IsEnabled() const { return mEnabled; }
+
+	/**
+	 * SetThreadName
+	 * Name the calling thread's track in the trace
+	 */
+	void SetThreadName(const char* in_Name);
+
+	/**
+	 * Complete
+	 * Record a slice of time on the calling thread, from in_Start to in_End in timer seconds
+	 */
+	void Complete(const char* in_Name, double in_Start, double in_End);
+
+	/**
+	 * Counter
+	 * Record the value of a counter
+	 */
+	void Counter(const char* in_Name, int in_Value);
+
+	/**
+	 * NewRequestId
+	 * A new request id for the request events, or 0 while tracing is off. May be called from any thread
+	 */
+	unsigned NewRequestId();
+
+	/**
+	 * RequestBegin / RequestStep / RequestEnd
+	 * Start a request's track, mark a step of it at in_Time (now if negative), and end it. Begin and end must use
+	 * the same name. Requests with id 0 were made while tracing was off and are ignored
+	 */
+	void RequestBegin(const char* in_Name, unsigned in_Id, const char* in_ArgName, int in_Value);
+	void RequestStep(const char* in_Step, unsigned in_Id, double in_Time = -1.0);
+	void RequestEnd(const char* in_Name, unsigned in_Id);
+
+	/**
+	 * WriteTrace
+	 * Add the events every thread has recorded since the last write to the trace file, and finish the file so it
+	 * can be loaded. Returns false if it can't be written
+	 */
+	bool WriteTrace();
+
+	/**
+	 * Thread interface
+	 */
+	virtual void Run();
+
+private:
+
+	/**
+	 * Helpers
+	 */
+	ThreadBuffer* GetThreadBuffer();
+	Event* AddEvent(ThreadBuffer* io_Buffer, char in_Type, const char* in_Name, double in_Time);
+	static void PublishEvent(ThreadBuffer* io_Buffer);
+	Event* AcquireEvents();
+	bool HandOffBuffer(ThreadBuffer* io_Buffer);
+	bool PrepareTraceFile();
+	void WriteFullBuffers();
+	void WriteEvents(const ThreadBuffer* in_Owner, const Event* in_Events, unsigned in_Begin, unsigned in_End);
+
+	/**
+	 * Singleton implementation
+	 */
+	Tracer();
+	~Tracer();
+	Tracer(const Tracer&);
+	Tracer& operator=(const Tracer&);
+
+	bool mEnabled;						// Are events being recorded?
+	double mStartTime;					// Timer seconds that trace times are relative to
+	AtomicLong mNextRequestId;
+
+#ifdef WIN32
+	DWORD mBufferIndex;					// Thread local storage index of each thread's buffer
+#else
+	#error Your platform thread local storage index goes here
+#endif // WIN32
+
+	Semaphore mBufferLock;				// Protects mBuffers while a thread registers
+	vector<ThreadBuffer*> mBuffers;		// Every thread's buffer, in the order the threads first recorded
+
+	unsigned mEventCapacity;			// Events in each buffer
+
+	Semaphore mQueueLock;				// Protects the full and spare buffers, and each thread's Events and Written
+	deque<FullBuffer> mFullBuffers;		// Waiting for the writer thread, oldest first
+	vector<Event*> mSpareEvents;		// Buffers the writer is done with
+	unsigned mEventBufferCount;			// Buffers allocated, spare or not
+	unsigned mHandOffCount;				// Buffers handed to the writer thread
+
+	bool mThreadStarted;
+	volatile bool mThreadDone;
+	volatile bool mStopThread;
+#ifdef WIN32
+	HANDLE mWakeEvent;					// Set when a full buffer is handed off, the writer thread sleeps on it
+#else
+	#error Your platform event goes here
+#endif // WIN32
+
+	Semaphore mFileLock;				// Protects the trace file. Held by the writer thread and WriteTrace while they write
+	ofstream mFile;						// The trace file, open once anything has been written to it
+	bool mFileFailed;					// Couldn't the trace file be opened? Full buffers wait until WriteTrace retries
+	unsigned mFileEntries;				// Entries in the trace file, events and thread names
+	unsigned mFileEvents;				// Events in the trace file
+	bool mFooterWritten;				// Has WriteTrace finished the file? Later events are written over the footer
+	streampos mFooterPos;				// Where the footer starts
+};
+
+/**
+ * TraceScope
+ * Records the rest of the enclosing scope as a slice on the calling thread
+ */
+class TraceScope
+{
+public:
+
+	TraceScope(const char* in_Name)
+		: mName(in_Name), mStart(Tracer::Instance()->IsEnabled() ? Timer::Instance()->GetSeconds() : -1.0) {}
+
+	~TraceScope()
+	{
+		if(mStart >= 0.0)
+		{
+			Tracer::Instance()->Complete(mName, mStart, Timer::Instance()->GetSeconds());
+		}
+	}
+
+private:
+
+	const char* mName;
+	double mStart;			// Negative while tracing is off
+};
+
+// Macros
+#if USE_TRACING
+	#define TRACE_SCOPE(name) TraceScope l_TraceScope(name);
+	#define TRACE_COUNTER(name, value) { if(Tracer::Instance()->IsEnabled()) { Tracer::Instance()->Counter(name, value); } }
+	#define TRACE_REQUEST_BEGIN(name, id, argName, value) { if(id) { Tracer::Instance()->RequestBegin(name, id, argName, value); } }
+	#define TRACE_REQUEST_STEP(step, id) { if(id) { Tracer::Instance()->RequestStep(step, id); } }
+	#define TRACE_REQUEST_STEP_AT(step, id, time) { if(id) { Tracer::Instance()->RequestStep(step, id, time); } }
+	#define TRACE_REQUEST_END(name, id) { if(id) { Tracer::Instance()->RequestEnd(name, id); } }
+#else
+	#define TRACE_SCOPE(name)
+	#define TRACE_COUNTER(name, value)
+	#define TRACE_REQUEST_BEGIN(name, id, argName, value)
+	#define TRACE_REQUEST_STEP(step, id)
+	#define TRACE_REQUEST_STEP_AT(step, id, time)
+	#define TRACE_REQUEST_END(name, id)
+#endif // USE_TRACING
+
+#endif // TRACER_H_
@@ -45,6 +45,32 @@ class PreferenceData;
 	REGISTER_PREFERENCE(true,	float,			CameraZoomWheelTime,		0.25f,		"Wheel Zoom Time")			\
 	REGISTER_PREFERENCE(true,	float,			CameraZoomMagnification,	100.0f,		"Click Zoom Magnification")	\
 	REGISTER_PREFERENCE(true,	float,			CameraZoomTime,				0.5f,		"Click Zoom Time")			\
+	REGISTER_PREFERENCE(true,	bool,			PredictivePrefetchEnabled,	true,		"Predictive Prefetch")		\
+	REGISTER_PREFERENCE(false,	int,			PrefetchMaxPending,			128,		"Prefetch Max Pending Loads")	\
+	REGISTER_PREFERENCE(true,	float,			PrefetchMargin,				0.25f,		"Prefetch Margin (View Fraction)")	\
+	REGISTER_PREFERENCE(false,	int,			PrefetchMarginBudget,		64,			"Prefetch Margin Budget")	\
+	REGISTER_PREFERENCE(false,	int,			PrefetchDemandQueueLimit,	32,			"Prefetch Demand Queue Limit")	\
+	REGISTER_PREFERENCE(false,	int,			IoScheduleWindow,			32,			"I/O Schedule Window")		\
+	REGISTER_PREFERENCE(false,	float,			IoDeadline,					0.5f,		"I/O Deadline (Seconds)")	\
+	REGISTER_PREFERENCE(false,	int,			AsyncReadsInFlight,			8,			"Async Reads In Flight")	\
+	REGISTER_PREFERENCE(false,	bool,			AsyncReadThreadPool,		false,		"Async Reads Use Thread Pool")	\
+	REGISTER_PREFERENCE(false,	bool,			MapThumbnailContainers,		false,		"Map Thumbnail Containers")	\
+	REGISTER_PREFERENCE(false,	bool,			VerifyThumbnailChecksums,	true,		"Verify Thumbnail Checksums")	\
+	REGISTER_PREFERENCE(false,	int,			ThumbnailReadAhead,			128,		"Thumbnail Read Ahead (KB)")	\
+	REGISTER_PREFERENCE(false,	int,			DecodedCacheFormat,			0,			"Decoded Cache Format (0 Off, 1 RGBA8, 2 RGB565, 3 BC1)")	\
+	REGISTER_PREFERENCE(false,	int,			DecodedCacheMaxSize,		256,		"Decoded Cache Max Size")	\
+	REGISTER_PREFERENCE(false,	bool,			CompressTextures,			false,		"Compress Textures (BC1, BC3 with alpha)")	\
+	REGISTER_PREFERENCE(false,	int,			TexturePoolSize,			256,		"Texture Pool Size (KB per size, 0 Off)")	\
+	REGISTER_PREFERENCE(false,	int,			StreamingUploadBufferSize,	8192,		"Streaming Upload Buffer Size (KB, 0 Off)")	\
+	REGISTER_PREFERENCE(false,	int,			ReducedColorTextureSize,	64,			"16 Bit Color Texture Max Size (0 Off)")	\
+	REGISTER_PREFERENCE(false,	int,			ProfilerReport,				0,			"Profiler Report (0 Off, 1 CSV, 2 Chrome Trace)")	\
+	REGISTER_PREFERENCE(false,	int,			ProfilerFrameCount,			1024,		"Profiler Frame History")	\
+	REGISTER_PREFERENCE(false,	bool,			TraceEvents,				false,		"Record Trace Events")		\
+	REGISTER_PREFERENCE(false,	int,			TraceBufferSize,			131072,		"Trace Events Per Thread")	\
+	REGISTER_PREFERENCE(false,	float,			MetricsInterval,			0.0f,		"Metrics File Interval (seconds, 0 Off)")	\
+	REGISTER_PREFERENCE(true,	bool,			ShowImagePreviews,			true,		"Show Image Previews")		\
+	REGISTER_PREFERENCE(true,	bool,			OverviewPyramidEnabled,		true,		"Overview Pyramid Enabled")	\
+	REGISTER_PREFERENCE(false,	int,			OverviewPyramidLevels,		6,			"Overview Pyramid Levels")	\
 	REGISTER_PREFERENCE(true,	bool,			SaveCameraPosition,			false,		"Save Current View")		\
 	REGISTER_PREFERENCE(false,	float,			SavedCameraX,				0.0f,		"Saved Camera PosX")		\
 	REGISTER_PREFERENCE(false,	float,			SavedCameraY,				0.0f,		"Saved Camera PosY")		\
@@ -63,6 +63,8 @@ public:
 		VirtualKey_PageUp,
 		VirtualKey_PageDown,
 		VirtualKey_F1,
+		VirtualKey_F2,
+		VirtualKey_F3,
 	};
 
 	virtual void OnKeyDown(unsigned in_Key) = 0;
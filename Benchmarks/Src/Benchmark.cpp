@@ -0,0 +1,110 @@
+/**
+ * @file Benchmark.cpp
+ * @brief Shared benchmark helpers
+ */
+
+#include "Benchmark.h"
+#include "ContainerFormat.h"
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool LoadThumbnailSet(const string& in_DataDirectory, const string& in_Name, ThumbnailSet& out_Set)
+{
+	out_Set.Name = in_Name;
+	out_Set.ContainerCount = 0;
+	out_Set.ContainerFilenames.clear();
+	out_Set.ContainerStarts.clear();
+	out_Set.Data.clear();
+	out_Set.Blobs.clear();
+
+	// Read every container file in the directory
+	string l_Directory = in_DataDirectory + "/" + in_Name + "/";
+#ifdef WIN32
+	WIN32_FIND_DATAA l_FindData;
+	HANDLE l_Find = FindFirstFileA((l_Directory + "container*.dat").c_str(), &l_FindData);
+	if(l_Find == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	vector<string> l_Filenames;
+	do
+	{
+		l_Filenames.push_back(l_Directory + l_FindData.cFileName);
+	}
+	while(FindNextFileA(l_Find, &l_FindData));
+	FindClose(l_Find);
+#else
+	#error Your platform directory listing goes here
+#endif // WIN32
+
+	sort(l_Filenames.begin(), l_Filenames.end());
+	for(unsigned i = 0; i < l_Filenames.size(); i++)
+	{
+		ifstream l_File(l_Filenames[i].c_str(), ios_base::in | ios_base::binary);
+		if(l_File.fail())
+		{
+			continue;
+		}
+
+		l_File.seekg(0, ios_base::end);
+		unsigned l_Size = (unsigned)l_File.tellg();
+		l_File.seekg(0, ios_base::beg);
+		if(l_Size == 0)
+		{
+			continue;
+		}
+
+		unsigned l_Start = (unsigned)out_Set.Data.size();
+		out_Set.Data.resize(l_Start + l_Size);
+		l_File.read((char*)&out_Set.Data[l_Start], l_Size);
+		out_Set.ContainerCount++;
+		out_Set.ContainerFilenames.push_back(l_Filenames[i]);
+		out_Set.ContainerStarts.push_back(l_Start);
+
+		// A version 2 container says where each thumbnail is
+		if(IsContainerV2(&out_Set.Data[l_Start], l_Size))
+		{
+			ContainerHeader l_Header;
+			memcpy(&l_Header, &out_Set.Data[l_Start], sizeof(l_Header));
+			for(unsigned j = 0; j < l_Header.EntryCount && sizeof(ContainerHeader) + (j + 1) * sizeof(ContainerEntry) <= l_Size; j++)
+			{
+				ContainerEntry l_Entry;
+				memcpy(&l_Entry, &out_Set.Data[l_Start + sizeof(ContainerHeader) + j * sizeof(ContainerEntry)], sizeof(l_Entry));
+				if(l_Entry.Offset <= l_Size && l_Entry.Size <= l_Size - l_Entry.Offset)
+				{
+					out_Set.Blobs.push_back(make_pair(l_Start + l_Entry.Offset, l_Entry.Size));
+				}
+			}
+			continue;
+		}
+
+		// Otherwise there's no index to say where each thumbnail starts, so split the container at every JPEG SOI marker.
+		// The byte sequence FF D8 FF can't appear inside entropy coded data, where every FF is followed by 00 or a RST marker
+		unsigned l_BlobStart = l_Start;
+		for(unsigned j = l_Start + 1; j + 2 < l_Start + l_Size; j++)
+		{
+			if(out_Set.Data[j] == 0xFF && out_Set.Data[j + 1] == 0xD8 && out_Set.Data[j + 2] == 0xFF)
+			{
+				out_Set.Blobs.push_back(make_pair(l_BlobStart, j - l_BlobStart));
+				l_BlobStart = j;
+			}
+		}
+		out_Set.Blobs.push_back(make_pair(l_BlobStart, l_Start + l_Size - l_BlobStart));
+	}
+
+	return !out_Set.Blobs.empty();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+unsigned GetProcessorCount()
+{
+#ifdef WIN32
+	SYSTEM_INFO l_Info;
+	GetSystemInfo(&l_Info);
+	return max(1, (int)l_Info.dwNumberOfProcessors);
+#else
+	#error Your platform processor count goes here
+#endif // WIN32
+}
@@ -0,0 +1,56 @@
+/**
+ * @file Benchmark.h
+ * @brief Shared benchmark helpers
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "Global.h"
+
+/**
+ * DATA_DIRECTORY
+ * Default location of the photo browser data, relative to the benchmark working directory
+ */
+#define DATA_DIRECTORY "../3DPhotoBrowser/Binaries/data"
+
+/**
+ * ThumbnailSet
+ * Every thumbnail blob of one LOD directory, read into memory
+ */
+struct ThumbnailSet
+{
+	string Name;							// Directory name, e.g. "thumbnails64"
+	unsigned ContainerCount;				// Number of container files read
+	vector<string> ContainerFilenames;		// Path of each container file read
+	vector<unsigned> ContainerStarts;		// Offset into Data of each container file
+	vector<unsigned char> Data;				// The contents of every container file, back to back
+	vector< pair<unsigned, unsigned> > Blobs;	// Offset into Data and size of each thumbnail
+};
+
+/**
+ * LoadThumbnailSet
+ * Read every container file in in_DataDirectory/in_Name and split the containers into thumbnails.
+ * Returns false if no containers were found
+ */
+bool LoadThumbnailSet(const string& in_DataDirectory, const string& in_Name, ThumbnailSet& out_Set);
+
+/**
+ * GetProcessorCount
+ * Number of logical processors, used as the default benchmark thread count
+ */
+unsigned GetProcessorCount();
+
+/**
+ * Benchmark entry points. Each receives the arguments following the benchmark name and returns the process exit code
+ */
+int RunDecodeBenchmark(int argc, char* argv[]);
+int RunLoadBenchmark(int argc, char* argv[]);
+int RunQueueBenchmark(int argc, char* argv[]);
+int RunReadBenchmark(int argc, char* argv[]);
+int RunContainerBenchmark(int argc, char* argv[]);
+int RunCompressBenchmark(int argc, char* argv[]);
+int RunUploadBenchmark(int argc, char* argv[]);
+int RunFlyThroughBenchmark(int argc, char* argv[]);
+
+#endif // BENCHMARK_H_
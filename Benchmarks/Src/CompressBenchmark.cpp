@@ -0,0 +1,238 @@
+/**
+ * @file CompressBenchmark.cpp
+ * @brief BC1 and BC3 texture compression benchmark
+ *
+ * First checks the encoder on synthetic images with known results, then decodes every thumbnail in the 64px and
+ * 256px containers and compresses them to BC1 and BC3. Reports megapixels/s, the texture memory saved and the
+ * PSNR of each thumbnail decompressed again against the original. Exits with an error if a check fails or the
+ * average quality drops below MIN_AVERAGE_PSNR
+ */
+
+#include "Benchmark.h"
+#include "JpegDecoder.h"
+#include "TextureCompression.h"
+
+/**
+ * MIN_AVERAGE_PSNR
+ * Lowest acceptable average PSNR in dB of the compressed thumbnails
+ */
+#define MIN_AVERAGE_PSNR 30.0
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * MakeTestImage
+ * Fill an RGBA image with a synthetic pattern: 0 solid color, 1 smooth gradient, 2 two colors, 3 alpha ramp
+ */
+static void MakeTestImage(int in_Pattern, int in_Width, int in_Height, DecodedImage& out_Image)
+{
+	out_Image.Allocate(in_Width, in_Height, TextureFormat_RGBA);
+	for(int y = 0; y < in_Height; y++)
+	{
+		for(int x = 0; x < in_Width; x++)
+		{
+			unsigned char* l_Pixel = &out_Image.Pixels[(y * in_Width + x) * 4];
+			switch(in_Pattern)
+			{
+			case 0: l_Pixel[0] = 200; l_Pixel[1] = 120; l_Pixel[2] = 40; l_Pixel[3] = 255; break;
+			case 1: l_Pixel[0] = (unsigned char)(x * 255 / (in_Width - 1)); l_Pixel[1] = (unsigned char)(y * 255 / (in_Height - 1));
+					l_Pixel[2] = 128; l_Pixel[3] = 255; break;
+			case 2: l_Pixel[0] = l_Pixel[1] = l_Pixel[2] = ((x / 2 + y / 3) & 1) ? 255 : 0; l_Pixel[3] = 255; break;
+			default: l_Pixel[0] = l_Pixel[1] = l_Pixel[2] = 90; l_Pixel[3] = (unsigned char)(x * 255 / (in_Width - 1)); break;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * CheckEncoder
+ * Round trip the synthetic images and check the results. Odd sizes test the partial blocks at the edges.
+ * Returns the number of failed checks
+ */
+static unsigned CheckEncoder()
+{
+	struct Check
+	{
+		const char* Name;
+		int Pattern;
+		TextureFormat Format;
+		double MinPSNR;				// Color quality
+		int MaxAlphaError;			// Largest alpha difference, for BC3
+	};
+	static const Check s_Checks[] =
+	{
+		{ "solid color BC1", 0, TextureFormat_BC1, 40.0, 255 },
+		{ "gradient BC1", 1, TextureFormat_BC1, 32.0, 255 },
+		{ "two colors BC1", 2, TextureFormat_BC1, PSNR_IDENTICAL, 255 },
+		{ "gradient BC3", 1, TextureFormat_BC3, 32.0, 0 },
+		{ "alpha ramp BC3", 3, TextureFormat_BC3, 40.0, 255 / 14 + 1 },
+	};
+
+	unsigned l_Failures = 0;
+	for(unsigned i = 0; i < sizeof(s_Checks) / sizeof(s_Checks[0]); i++)
+	{
+		const Check& l_Check = s_Checks[i];
+		DecodedImage l_Original, l_Compressed, l_Decompressed;
+		MakeTestImage(l_Check.Pattern, 37, 22, l_Original);
+		CompressImage(l_Original, l_Check.Format, l_Compressed);
+		DecompressImage(l_Compressed, l_Decompressed);
+
+		double l_PSNR = ComputePSNR(l_Original, l_Decompressed);
+		int l_AlphaError = 0;
+		for(unsigned p = 3; p < l_Original.Pixels.size(); p += 4)
+		{
+			int l_Expected = l_Check.Format == TextureFormat_BC1 ? 255 : l_Original.Pixels[p];
+			l_AlphaError = max(l_AlphaError, abs(l_Expected - l_Decompressed.Pixels[p]));
+		}
+
+		bool l_Passed = l_Compressed.Pixels.size() == GetTextureDataSize(37, 22, l_Check.Format) && l_PSNR >= l_Check.MinPSNR &&
+						l_AlphaError <= l_Check.MaxAlphaError;
+		cout << "  " << left << setw(18) << l_Check.Name << right << fixed << setprecision(1) << setw(6) << l_PSNR << " dB, alpha error "
+			 << setw(3) << l_AlphaError << (l_Passed ? "  ok" : "  FAILED") << endl;
+		if(!l_Passed)
+		{
+			l_Failures++;
+		}
+	}
+	return l_Failures;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * MeasureFormat
+ * Compress every image in_Iterations times, keeping the fastest, then decompress them and compare with the originals.
+ * Returns the average PSNR
+ */
+static double MeasureFormat(const vector<DecodedImage*>& in_Images, TextureFormat in_Format, unsigned in_Iterations)
+{
+	DecodedImage l_Compressed, l_Decompressed;
+	double l_Best = 0.0;
+	double l_Pixels = 0.0;
+	double l_UncompressedBytes = 0.0;
+	double l_CompressedBytes = 0.0;
+	for(unsigned l_Iteration = 0; l_Iteration < in_Iterations; l_Iteration++)
+	{
+		l_Pixels = 0.0;
+		l_UncompressedBytes = 0.0;
+		l_CompressedBytes = 0.0;
+		double l_Start = Timer::Instance()->GetSeconds();
+		for(unsigned i = 0; i < in_Images.size(); i++)
+		{
+			CompressImage(*in_Images[i], in_Format, l_Compressed);
+			l_Pixels += in_Images[i]->Width * in_Images[i]->Height;
+			l_UncompressedBytes += in_Images[i]->Pixels.size();
+			l_CompressedBytes += l_Compressed.Pixels.size();
+		}
+		double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+		if(l_Iteration == 0 || l_Time < l_Best)
+		{
+			l_Best = l_Time;
+		}
+	}
+
+	double l_TotalPSNR = 0.0;
+	double l_MinPSNR = PSNR_IDENTICAL;
+	for(unsigned i = 0; i < in_Images.size(); i++)
+	{
+		CompressImage(*in_Images[i], in_Format, l_Compressed);
+		DecompressImage(l_Compressed, l_Decompressed);
+		double l_PSNR = ComputePSNR(*in_Images[i], l_Decompressed);
+		l_TotalPSNR += l_PSNR;
+		l_MinPSNR = min(l_MinPSNR, l_PSNR);
+	}
+	double l_AveragePSNR = l_TotalPSNR / in_Images.size();
+
+	cout << "  " << (in_Format == TextureFormat_BC1 ? "BC1" : "BC3") << ": "
+		 << fixed << setprecision(1) << setw(7) << l_Pixels / 1000000.0 / l_Best << " MP/s"
+		 << setprecision(2) << setw(9) << l_Best * 1000000.0 / in_Images.size() << " us/image"
+		 << setprecision(1) << setw(8) << l_UncompressedBytes / (1024.0 * 1024.0) << " MB ->" << setw(7) << l_CompressedBytes / (1024.0 * 1024.0)
+		 << " MB (" << l_UncompressedBytes / l_CompressedBytes << "x)"
+		 << setprecision(2) << "  PSNR average " << l_AveragePSNR << " dB, worst " << l_MinPSNR << " dB" << endl;
+	return l_AveragePSNR;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunCompressBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	unsigned l_Iterations = argc > 1 ? max(1, atoi(argv[1])) : 3;
+
+	cout << "Encoder checks:" << endl;
+	unsigned l_Failures = CheckEncoder();
+	cout << endl;
+
+	JpegDecoder l_Decoder;
+	const char* l_SetNames[] = { "thumbnails64", "thumbnails256" };
+	bool l_AnyFound = false;
+
+	for(int s = 0; s < 2; s++)
+	{
+		ThumbnailSet l_Set;
+		if(!LoadThumbnailSet(l_DataDirectory, l_SetNames[s], l_Set))
+		{
+			cout << l_SetNames[s] << ": no containers found, skipped" << endl << endl;
+			continue;
+		}
+		l_AnyFound = true;
+
+		// Decode everything up front, as RGB for BC1 and with an alpha channel for BC3
+		vector<DecodedImage*> l_Images;
+		vector<DecodedImage*> l_AlphaImages;
+		DecodeArena l_Arena;
+		for(unsigned i = 0; i < l_Set.Blobs.size(); i++)
+		{
+			DecodedImage* l_Image = new DecodedImage();
+			l_Arena.Reset();
+			if(!l_Decoder.Decode(&l_Set.Data[l_Set.Blobs[i].first], l_Set.Blobs[i].second, *l_Image, &l_Arena))
+			{
+				delete l_Image;
+				continue;
+			}
+			l_Images.push_back(l_Image);
+
+			DecodedImage* l_AlphaImage = new DecodedImage();
+			l_AlphaImage->Allocate(l_Image->Width, l_Image->Height, TextureFormat_RGBA);
+			for(int p = 0; p < l_Image->Width * l_Image->Height; p++)
+			{
+				memcpy(&l_AlphaImage->Pixels[p * 4], &l_Image->Pixels[p * 3], 3);
+				l_AlphaImage->Pixels[p * 4 + 3] = (unsigned char)(p % l_Image->Width * 255 / max(1, l_Image->Width - 1));
+			}
+			l_AlphaImages.push_back(l_AlphaImage);
+		}
+
+		cout << l_Set.Name << ": " << l_Images.size() << " images, best of " << l_Iterations << endl;
+		if(!l_Images.empty())
+		{
+			if(MeasureFormat(l_Images, TextureFormat_BC1, l_Iterations) < MIN_AVERAGE_PSNR)
+			{
+				l_Failures++;
+			}
+			if(MeasureFormat(l_AlphaImages, TextureFormat_BC3, l_Iterations) < MIN_AVERAGE_PSNR)
+			{
+				l_Failures++;
+			}
+		}
+		cout << endl;
+
+		for(unsigned i = 0; i < l_Images.size(); i++)
+		{
+			delete l_Images[i];
+			delete l_AlphaImages[i];
+		}
+	}
+
+	if(!l_AnyFound)
+	{
+		cout << "No thumbnail containers found in '" << l_DataDirectory << "'" << endl;
+	}
+	if(l_Failures > 0)
+	{
+		cout << l_Failures << " checks failed" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,418 @@
+/**
+ * @file ContainerBenchmark.cpp
+ * @brief Container format read benchmark
+ *
+ * Writes every thumbnail out twice to a temporary directory, as version 1 containers (blobs back to back) and as
+ * version 2 containers (table of contents, blobs aligned), then reads each thumbnail from both in a shuffled order:
+ *	Cached: positioned ReadFile calls on open files. The files were just written, so they come from the file cache
+ *	Unbuffered: FILE_FLAG_NO_BUFFERING reads, which skip the cache and must cover whole sectors. Reports the bytes
+ *				transferred for each thumbnail, which alignment keeps down to the thumbnail's own pages
+ *	Mapped: MappedContainer, checksumming each thumbnail in place, which touches every byte. Reports the pages touched
+ */
+
+#include "Benchmark.h"
+#include "MappedContainer.h"
+
+/**
+ * BENCHMARK_SECTOR_SIZE
+ * Unbuffered reads are rounded out to this, which covers every sector size in use
+ */
+#define BENCHMARK_SECTOR_SIZE 4096
+
+/**
+ * ContainerBlobLocation
+ * Where a thumbnail is in the containers written for the benchmark
+ */
+struct ContainerBlobLocation
+{
+	unsigned Container;
+	unsigned Offset;
+	unsigned Size;
+};
+
+/**
+ * ContainerSetFiles
+ * The containers of one format
+ */
+struct ContainerSetFiles
+{
+	const char* Name;
+	vector<string> Filenames;
+	vector<ContainerBlobLocation> Locations;	// Shuffled
+	unsigned MaxSize;
+	double BlobBytes;							// Total size of the thumbnails, without padding or tables of contents
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * WriteBenchmarkFile
+ * Write a whole file, returning false on failure
+ */
+static bool WriteBenchmarkFile(const string& in_Filename, const vector<unsigned char>& in_Data)
+{
+	HANDLE l_File = CreateFileA(in_Filename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(l_File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	DWORD l_Written = 0;
+	bool l_Success = in_Data.empty() || (WriteFile(l_File, &in_Data[0], (DWORD)in_Data.size(), &l_Written, NULL) && l_Written == in_Data.size());
+	CloseHandle(l_File);
+	return l_Success;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * WriteContainerSets
+ * Write each container of in_Set as version 1 and version 2 with in_Alignment, filling in where every thumbnail went
+ */
+static bool WriteContainerSets(const ThumbnailSet& in_Set, const string& in_Directory, unsigned in_Alignment,
+							   ContainerSetFiles& out_V1, ContainerSetFiles& out_V2)
+{
+	out_V1.Name = "Version 1";
+	out_V2.Name = "Version 2";
+	ContainerSetFiles* l_Sets[] = { &out_V1, &out_V2 };
+	for(int s = 0; s < 2; s++)
+	{
+		l_Sets[s]->Filenames.clear();
+		l_Sets[s]->Locations.clear();
+		l_Sets[s]->MaxSize = 0;
+		l_Sets[s]->BlobBytes = 0.0;
+	}
+
+	unsigned l_Blob = 0;
+	for(unsigned c = 0; c < in_Set.ContainerCount; c++)
+	{
+		unsigned l_ContainerEnd = c + 1 < in_Set.ContainerCount ? in_Set.ContainerStarts[c + 1] : (unsigned)in_Set.Data.size();
+
+		vector<ContainerBlob> l_Blobs;
+		vector<unsigned char> l_V1;
+		for(; l_Blob < in_Set.Blobs.size() && in_Set.Blobs[l_Blob].first < l_ContainerEnd; l_Blob++)
+		{
+			ContainerBlob l_ContainerBlob;
+			l_ContainerBlob.Data = &in_Set.Data[in_Set.Blobs[l_Blob].first];
+			l_ContainerBlob.Size = in_Set.Blobs[l_Blob].second;
+			l_ContainerBlob.SourceOffset = (unsigned)l_V1.size();
+			l_Blobs.push_back(l_ContainerBlob);
+			l_V1.insert(l_V1.end(), l_ContainerBlob.Data, l_ContainerBlob.Data + l_ContainerBlob.Size);
+		}
+
+		vector<unsigned char> l_V2;
+		vector<ContainerEntry> l_Entries;
+		WriteContainerV2(l_Blobs, in_Alignment, l_V2, l_Entries);
+
+		stringstream l_Number;
+		l_Number << setfill('0') << setw(5) << c << ".dat";
+		out_V1.Filenames.push_back(in_Directory + "v1_" + l_Number.str());
+		out_V2.Filenames.push_back(in_Directory + "v2_" + l_Number.str());
+		if(!WriteBenchmarkFile(out_V1.Filenames.back(), l_V1) || !WriteBenchmarkFile(out_V2.Filenames.back(), l_V2))
+		{
+			return false;
+		}
+
+		for(unsigned i = 0; i < l_Blobs.size(); i++)
+		{
+			ContainerBlobLocation l_Location;
+			l_Location.Container = c;
+			l_Location.Size = l_Blobs[i].Size;
+
+			l_Location.Offset = l_Blobs[i].SourceOffset;
+			out_V1.Locations.push_back(l_Location);
+			l_Location.Offset = l_Entries[i].Offset;
+			out_V2.Locations.push_back(l_Location);
+		}
+	}
+
+	// Both formats are read in the same shuffled order
+	for(int s = 0; s < 2; s++)
+	{
+		srand(1);
+		vector<ContainerBlobLocation>& l_Locations = l_Sets[s]->Locations;
+		for(unsigned i = (unsigned)l_Locations.size(); i > 1; i--)
+		{
+			swap(l_Locations[i - 1], l_Locations[((unsigned)rand() * (RAND_MAX + 1u) + (unsigned)rand()) % i]);
+		}
+		for(unsigned i = 0; i < l_Locations.size(); i++)
+		{
+			l_Sets[s]->MaxSize = max(l_Sets[s]->MaxSize, l_Locations[i].Size);
+			l_Sets[s]->BlobBytes += l_Locations[i].Size;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * OpenContainers
+ * Open every container of a set with the given CreateFile flags
+ */
+static bool OpenContainers(const ContainerSetFiles& in_Files, DWORD in_Flags, vector<HANDLE>& out_Handles)
+{
+	out_Handles.clear();
+	for(unsigned i = 0; i < in_Files.Filenames.size(); i++)
+	{
+		HANDLE l_File = CreateFileA(in_Files.Filenames[i].c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | in_Flags, NULL);
+		if(l_File == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		out_Handles.push_back(l_File);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * CloseContainers
+ */
+static void CloseContainers(vector<HANDLE>& io_Handles)
+{
+	for(unsigned i = 0; i < io_Handles.size(); i++)
+	{
+		CloseHandle(io_Handles[i]);
+	}
+	io_Handles.clear();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeCachedReads
+ * Read every thumbnail with a positioned read. Returns the time in seconds
+ */
+static double TimeCachedReads(const ContainerSetFiles& in_Files, unsigned& out_Failures)
+{
+	out_Failures = 0;
+	vector<HANDLE> l_Handles;
+	if(!OpenContainers(in_Files, 0, l_Handles))
+	{
+		out_Failures = (unsigned)in_Files.Locations.size();
+		CloseContainers(l_Handles);
+		return 0.0;
+	}
+
+	vector<unsigned char> l_Buffer(in_Files.MaxSize);
+	double l_Start = Timer::Instance()->GetSeconds();
+	for(unsigned i = 0; i < in_Files.Locations.size(); i++)
+	{
+		const ContainerBlobLocation& l_Location = in_Files.Locations[i];
+		OVERLAPPED l_Overlapped;
+		memset(&l_Overlapped, 0, sizeof(l_Overlapped));
+		l_Overlapped.Offset = l_Location.Offset;
+
+		DWORD l_BytesRead = 0;
+		if(!ReadFile(l_Handles[l_Location.Container], &l_Buffer[0], l_Location.Size, &l_BytesRead, &l_Overlapped) || l_BytesRead != l_Location.Size)
+		{
+			out_Failures++;
+		}
+	}
+	double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+
+	CloseContainers(l_Handles);
+	return l_Time;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeUnbufferedReads
+ * Read every thumbnail with an unbuffered read of the whole sectors it covers. Returns the time in seconds
+ */
+static double TimeUnbufferedReads(const ContainerSetFiles& in_Files, double& out_BytesTransferred, unsigned& out_Failures)
+{
+	out_Failures = 0;
+	out_BytesTransferred = 0.0;
+	vector<HANDLE> l_Handles;
+	if(!OpenContainers(in_Files, FILE_FLAG_NO_BUFFERING, l_Handles))
+	{
+		out_Failures = (unsigned)in_Files.Locations.size();
+		CloseContainers(l_Handles);
+		return 0.0;
+	}
+
+	// Unbuffered reads need a sector aligned buffer, VirtualAlloc returns page aligned memory
+	unsigned l_BufferSize = (in_Files.MaxSize + 2 * BENCHMARK_SECTOR_SIZE) & ~(BENCHMARK_SECTOR_SIZE - 1);
+	unsigned char* l_Buffer = (unsigned char*)VirtualAlloc(NULL, l_BufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+	double l_Start = Timer::Instance()->GetSeconds();
+	for(unsigned i = 0; i < in_Files.Locations.size(); i++)
+	{
+		const ContainerBlobLocation& l_Location = in_Files.Locations[i];
+		unsigned l_First = l_Location.Offset & ~(BENCHMARK_SECTOR_SIZE - 1);
+		unsigned l_End = (l_Location.Offset + l_Location.Size + BENCHMARK_SECTOR_SIZE - 1) & ~(BENCHMARK_SECTOR_SIZE - 1);
+
+		OVERLAPPED l_Overlapped;
+		memset(&l_Overlapped, 0, sizeof(l_Overlapped));
+		l_Overlapped.Offset = l_First;
+
+		// The last sector of the file comes back short
+		DWORD l_BytesRead = 0;
+		if(!ReadFile(l_Handles[l_Location.Container], l_Buffer, l_End - l_First, &l_BytesRead, &l_Overlapped) ||
+		   l_First + l_BytesRead < l_Location.Offset + l_Location.Size)
+		{
+			out_Failures++;
+		}
+		out_BytesTransferred += l_End - l_First;
+	}
+	double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+
+	VirtualFree(l_Buffer, 0, MEM_RELEASE);
+	CloseContainers(l_Handles);
+	return l_Time;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeMappedReads
+ * Checksum every thumbnail in place in the mapped containers. Returns the time in seconds
+ */
+static double TimeMappedReads(const ContainerSetFiles& in_Files, double& out_PagesTouched, unsigned& out_Failures)
+{
+	out_Failures = 0;
+	out_PagesTouched = 0.0;
+	vector<MappedContainer*> l_Containers;
+	for(unsigned i = 0; i < in_Files.Filenames.size(); i++)
+	{
+		l_Containers.push_back(new MappedContainer());
+		l_Containers.back()->Open(in_Files.Filenames[i].c_str());
+	}
+
+	unsigned l_Checksum = 0;
+	double l_Start = Timer::Instance()->GetSeconds();
+	for(unsigned i = 0; i < in_Files.Locations.size(); i++)
+	{
+		const ContainerBlobLocation& l_Location = in_Files.Locations[i];
+		const unsigned char* l_Data = l_Containers[l_Location.Container]->GetData(l_Location.Offset, l_Location.Size);
+		if(!l_Data)
+		{
+			out_Failures++;
+			continue;
+		}
+		l_Checksum = ContainerChecksum(l_Data, l_Location.Size, l_Checksum);
+
+		unsigned l_FirstPage = l_Location.Offset / CONTAINER_PAGE_SIZE;
+		unsigned l_EndPage = (l_Location.Offset + l_Location.Size + CONTAINER_PAGE_SIZE - 1) / CONTAINER_PAGE_SIZE;
+		out_PagesTouched += l_EndPage - l_FirstPage;
+	}
+	double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+
+	for(unsigned i = 0; i < l_Containers.size(); i++)
+	{
+		delete l_Containers[i];
+	}
+
+	// Keep the checksums from being optimized away
+	if(l_Checksum == 0x12345678)
+	{
+		cout << "";
+	}
+	return l_Time;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * PrintContainerResult
+ * Print one line of the results table. in_Extra is printed after in_ExtraName if in_ExtraName isn't NULL
+ */
+static void PrintContainerResult(const ContainerSetFiles& in_Files, const char* in_Method, double in_Seconds, unsigned in_Failures,
+								 const char* in_ExtraName, double in_Extra)
+{
+	double l_Reads = (double)in_Files.Locations.size();
+	cout << "  " << left << setw(10) << in_Files.Name << setw(11) << in_Method << right
+		 << fixed << setprecision(0) << setw(9) << l_Reads / in_Seconds << " reads/s"
+		 << setprecision(1) << setw(8) << in_Files.BlobBytes / in_Seconds / (1024.0 * 1024.0) << " MB/s";
+	if(in_ExtraName)
+	{
+		cout << setprecision(2) << setw(8) << in_Extra / l_Reads << " " << in_ExtraName;
+	}
+	if(in_Failures)
+	{
+		cout << "  (" << in_Failures << " failed)";
+	}
+	cout << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunContainerBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	unsigned l_Alignment = argc > 1 ? (unsigned)max(1, atoi(argv[1])) : CONTAINER_PAGE_SIZE;
+	if(l_Alignment & (l_Alignment - 1))
+	{
+		cout << "The alignment must be a power of two" << endl;
+		return 1;
+	}
+
+	char l_TempPath[MAX_PATH];
+	GetTempPathA(MAX_PATH, l_TempPath);
+	string l_Directory = string(l_TempPath) + "ContainerBenchmark\\";
+	CreateDirectoryA(l_Directory.c_str(), NULL);
+
+	const char* l_SetNames[] = { "thumbnails64", "thumbnails256" };
+	bool l_AnyFound = false;
+
+	for(int s = 0; s < 2; s++)
+	{
+		ThumbnailSet l_Set;
+		if(!LoadThumbnailSet(l_DataDirectory, l_SetNames[s], l_Set))
+		{
+			cout << l_SetNames[s] << ": no containers found, skipped" << endl << endl;
+			continue;
+		}
+		l_AnyFound = true;
+
+		ContainerSetFiles l_V1;
+		ContainerSetFiles l_V2;
+		bool l_Written = WriteContainerSets(l_Set, l_Directory, l_Alignment, l_V1, l_V2);
+		if(l_Written)
+		{
+			cout << l_Set.Name << ": " << l_V1.Locations.size() << " reads from " << l_Set.ContainerCount << " containers, shuffled, version 2 aligned to "
+				 << l_Alignment << " bytes" << endl;
+
+			ContainerSetFiles* l_Formats[] = { &l_V1, &l_V2 };
+			for(int f = 0; f < 2; f++)
+			{
+				unsigned l_Failures = 0;
+				double l_Extra = 0.0;
+				double l_Time = TimeCachedReads(*l_Formats[f], l_Failures);
+				PrintContainerResult(*l_Formats[f], "Cached", l_Time, l_Failures, NULL, 0.0);
+
+				l_Time = TimeUnbufferedReads(*l_Formats[f], l_Extra, l_Failures);
+				PrintContainerResult(*l_Formats[f], "Unbuffered", l_Time, l_Failures, "KB/read", l_Extra / 1024.0);
+
+				l_Time = TimeMappedReads(*l_Formats[f], l_Extra, l_Failures);
+				PrintContainerResult(*l_Formats[f], "Mapped", l_Time, l_Failures, "pages/read", l_Extra);
+			}
+		}
+		else
+		{
+			cout << l_Set.Name << ": failed to write the containers to '" << l_Directory << "'" << endl;
+		}
+		cout << endl;
+
+		for(unsigned i = 0; i < l_V1.Filenames.size(); i++)
+		{
+			DeleteFileA(l_V1.Filenames[i].c_str());
+		}
+		for(unsigned i = 0; i < l_V2.Filenames.size(); i++)
+		{
+			DeleteFileA(l_V2.Filenames[i].c_str());
+		}
+	}
+
+	RemoveDirectoryA(l_Directory.c_str());
+
+	if(!l_AnyFound)
+	{
+		cout << "No thumbnail containers found in '" << l_DataDirectory << "'" << endl;
+		return 1;
+	}
+	return 0;
+}
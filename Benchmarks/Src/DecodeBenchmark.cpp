@@ -0,0 +1,357 @@
+/**
+ * @file DecodeBenchmark.cpp
+ * @brief Thumbnail decode throughput benchmark
+ *
+ * Decodes every thumbnail in the 64px and 256px containers with each decoder and reports images/s,
+ * compressed MB/s and microseconds per image. Thread-safe decoders are also run on every processor, and the
+ * JPEG decoder's DCT scaled 1/2, 1/4 and 1/8 decodes are timed. Finally the decoders' output is compared
+ * against DevIL's, which is the reference.
+ * Before any of that, flat gray images with unusual chroma sampling factors are decoded at every scale, since the
+ * thumbnails the indexer writes are all 4:2:0
+ */
+
+#include "Benchmark.h"
+#include "JpegDecoder.h"
+#include "DevILDecoder.h"
+#include "Thread.h"
+
+/**
+ * DecodeWorker
+ * Decodes thumbnails from a shared counter until there are none left
+ */
+class DecodeWorker : public Thread
+{
+public:
+
+	DecodeWorker(const ThumbnailSet* in_Set, ImageDecoder* in_Decoder, volatile LONG* in_NextBlob)
+		: mSet(in_Set), mDecoder(in_Decoder), mNextBlob(in_NextBlob), mFailures(0) {}
+
+	/**
+	 * Thread interface
+	 */
+	virtual void Run()
+	{
+		DecodedImage l_Image;
+		LONG l_BlobCount = (LONG)mSet->Blobs.size();
+		for(LONG l_Index = InterlockedIncrement(mNextBlob) - 1; l_Index < l_BlobCount; l_Index = InterlockedIncrement(mNextBlob) - 1)
+		{
+			const pair<unsigned, unsigned>& l_Blob = mSet->Blobs[l_Index];
+			mArena.Reset();
+			if(!mDecoder->Decode(&mSet->Data[l_Blob.first], l_Blob.second, l_Image, &mArena))
+			{
+				mFailures++;
+			}
+		}
+	}
+
+	/**
+	 * Wait
+	 * Wait for the thread to finish
+	 */
+	void Wait()
+	{
+#ifdef WIN32
+		WaitForSingleObject(mThreadHandle, INFINITE);
+		CloseHandle(mThreadHandle);
+#else
+		#error Your platform thread join goes here
+#endif // WIN32
+	}
+
+	unsigned GetFailures() const { return mFailures; }
+
+private:
+
+	const ThumbnailSet* mSet;
+	ImageDecoder* mDecoder;
+	volatile LONG* mNextBlob;
+	unsigned mFailures;
+	DecodeArena mArena;
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeDecoder
+ * Decode the whole set in_Iterations times and return the fastest time in seconds
+ */
+static double TimeDecoder(const ThumbnailSet& in_Set, ImageDecoder* in_Decoder, unsigned in_ThreadCount, unsigned in_Iterations, unsigned& out_Failures,
+						  int in_ScaleShift = 0)
+{
+	double l_Best = 0.0;
+	for(unsigned l_Iteration = 0; l_Iteration < in_Iterations; l_Iteration++)
+	{
+		out_Failures = 0;
+		double l_Start = Timer::Instance()->GetSeconds();
+
+		if(in_ThreadCount <= 1)
+		{
+			DecodedImage l_Image;
+			DecodeArena l_Arena;
+			for(unsigned i = 0; i < in_Set.Blobs.size(); i++)
+			{
+				l_Arena.Reset();
+				if(!in_Decoder->DecodeScaled(&in_Set.Data[in_Set.Blobs[i].first], in_Set.Blobs[i].second, in_ScaleShift, l_Image, &l_Arena))
+				{
+					out_Failures++;
+				}
+			}
+		}
+		else
+		{
+			volatile LONG l_NextBlob = 0;
+			vector<DecodeWorker*> l_Workers;
+			for(unsigned i = 0; i < in_ThreadCount; i++)
+			{
+				l_Workers.push_back(new DecodeWorker(&in_Set, in_Decoder, &l_NextBlob));
+				l_Workers.back()->Start(false);
+			}
+			for(unsigned i = 0; i < in_ThreadCount; i++)
+			{
+				l_Workers[i]->Wait();
+				out_Failures += l_Workers[i]->GetFailures();
+				delete l_Workers[i];
+			}
+		}
+
+		double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+		if(l_Iteration == 0 || l_Time < l_Best)
+		{
+			l_Best = l_Time;
+		}
+	}
+	return l_Best;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * PrintResult
+ * Print one line of the results table
+ */
+static void PrintResult(const ThumbnailSet& in_Set, const char* in_Name, unsigned in_ThreadCount, double in_Seconds, unsigned in_Failures, double in_BaselineSeconds)
+{
+	double l_Images = (double)in_Set.Blobs.size();
+	double l_Megabytes = in_Set.Data.size() / (1024.0 * 1024.0);
+
+	cout << "  " << left << setw(10) << in_Name << right << setw(3) << in_ThreadCount << (in_ThreadCount == 1 ? " thread : " : " threads: ")
+		 << fixed << setprecision(0) << setw(8) << l_Images / in_Seconds << " images/s"
+		 << setprecision(1) << setw(8) << l_Megabytes / in_Seconds << " MB/s"
+		 << setprecision(2) << setw(9) << in_Seconds * 1000000.0 / l_Images << " us/image"
+		 << setprecision(2) << setw(7) << in_BaselineSeconds / in_Seconds << "x";
+	if(in_Failures)
+	{
+		cout << "  (" << in_Failures << " failed)";
+	}
+	cout << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * CompareDecoders
+ * Decode every thumbnail with both decoders and report how far apart the results are
+ */
+static void CompareDecoders(const ThumbnailSet& in_Set, ImageDecoder* in_Decoder, ImageDecoder* in_Reference)
+{
+	DecodedImage l_Image, l_ReferenceImage;
+	unsigned l_Mismatches = 0;
+	int l_MaxDifference = 0;
+	double l_SquaredError = 0.0;
+	double l_SampleCount = 0.0;
+
+	for(unsigned i = 0; i < in_Set.Blobs.size(); i++)
+	{
+		const unsigned char* l_Data = &in_Set.Data[in_Set.Blobs[i].first];
+		unsigned l_Size = in_Set.Blobs[i].second;
+		bool l_Decoded = in_Decoder->Decode(l_Data, l_Size, l_Image);
+		bool l_ReferenceDecoded = in_Reference->Decode(l_Data, l_Size, l_ReferenceImage);
+		if(!l_Decoded || !l_ReferenceDecoded || l_Image.Width != l_ReferenceImage.Width || l_Image.Height != l_ReferenceImage.Height ||
+			l_Image.Format != l_ReferenceImage.Format)
+		{
+			l_Mismatches++;
+			continue;
+		}
+
+		for(unsigned j = 0; j < l_Image.Pixels.size(); j++)
+		{
+			int l_Difference = abs((int)l_Image.Pixels[j] - (int)l_ReferenceImage.Pixels[j]);
+			l_MaxDifference = max(l_MaxDifference, l_Difference);
+			l_SquaredError += l_Difference * l_Difference;
+		}
+		l_SampleCount += (double)l_Image.Pixels.size();
+	}
+
+	cout << "  " << in_Decoder->GetName() << " vs " << in_Reference->GetName() << ": max difference " << l_MaxDifference;
+	if(l_SquaredError > 0.0)
+	{
+		cout << ", PSNR " << fixed << setprecision(1) << 10.0 * log10(255.0 * 255.0 * l_SampleCount / l_SquaredError) << " dB";
+	}
+	else
+	{
+		cout << ", identical";
+	}
+	cout << ", " << l_Mismatches << " images not comparable" << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * BuildFlatJpeg
+ * Build a baseline JPEG of in_Width x in_Height with three components, the first sampled in_LumaX x in_LumaY and the
+ * other two 1x1, where every block has all its coefficients zero. Huffman tables with a single one bit code make every
+ * block two zero bits, so the image decodes to flat gray (128) whatever the sampling
+ */
+static void BuildFlatJpeg(int in_Width, int in_Height, int in_LumaX, int in_LumaY, vector<unsigned char>& out_Data)
+{
+	static const unsigned char s_Header[] =
+	{
+		0xFF, 0xD8,														// SOI
+		0xFF, 0xDB, 0x00, 0x43, 0x00,									// DQT, table 0, all ones
+		1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+		1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+		1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+		1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+		0xFF, 0xC4, 0x00, 0x14, 0x00,									// DHT, DC table 0: one code, category 0
+		1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+		0xFF, 0xC4, 0x00, 0x14, 0x10,									// DHT, AC table 0: one code, end of block
+		1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00,
+	};
+	out_Data.assign(s_Header, s_Header + sizeof(s_Header));
+
+	unsigned char l_Frame[] =
+	{
+		0xFF, 0xC0, 0x00, 0x11, 0x08,									// SOF0, 8 bit
+		(unsigned char)(in_Height >> 8), (unsigned char)in_Height, (unsigned char)(in_Width >> 8), (unsigned char)in_Width, 3,
+		1, (unsigned char)((in_LumaX << 4) | in_LumaY), 0,
+		2, 0x11, 0,
+		3, 0x11, 0,
+		0xFF, 0xDA, 0x00, 0x0C, 3, 1, 0x00, 2, 0x00, 3, 0x00, 0, 63, 0,	// SOS, all components on tables 0
+	};
+	out_Data.insert(out_Data.end(), l_Frame, l_Frame + sizeof(l_Frame));
+
+	// Two zero bits a block, padded out with ones
+	int l_McusX = (in_Width + in_LumaX * 8 - 1) / (in_LumaX * 8);
+	int l_McusY = (in_Height + in_LumaY * 8 - 1) / (in_LumaY * 8);
+	unsigned l_Bits = (unsigned)(l_McusX * l_McusY * (in_LumaX * in_LumaY + 2)) * 2;
+	out_Data.insert(out_Data.end(), l_Bits / 8, 0);
+	if(l_Bits % 8)
+	{
+		out_Data.push_back((unsigned char)(0xFF >> (l_Bits % 8)));
+	}
+
+	out_Data.push_back(0xFF);
+	out_Data.push_back(0xD9);										// EOI
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * CheckSamplingFactors
+ * Decode flat images with several chroma sampling factors at every scale, including factors of 3 that scaled decodes
+ * can't reconstruct at a larger block size. Returns false if any decode fails or isn't flat gray
+ */
+static bool CheckSamplingFactors(ImageDecoder* in_Decoder)
+{
+	static const int s_Sampling[][2] = { { 1, 1 }, { 2, 1 }, { 2, 2 }, { 3, 3 }, { 3, 1 }, { 4, 4 }, { 4, 2 } };
+	bool l_Passed = true;
+
+	cout << "Sampling factors:";
+	for(unsigned s = 0; s < sizeof(s_Sampling) / sizeof(s_Sampling[0]); s++)
+	{
+		vector<unsigned char> l_Data;
+		BuildFlatJpeg(64, 64, s_Sampling[s][0], s_Sampling[s][1], l_Data);
+
+		bool l_Flat = true;
+		for(int l_Shift = 0; l_Shift <= 3; l_Shift++)
+		{
+			DecodedImage l_Image;
+			DecodeArena l_Arena;
+			int l_Size = (64 + (1 << l_Shift) - 1) >> l_Shift;
+			if(!in_Decoder->DecodeScaled(&l_Data[0], (unsigned)l_Data.size(), l_Shift, l_Image, &l_Arena) ||
+			   l_Image.Width != l_Size || l_Image.Height != l_Size)
+			{
+				l_Flat = false;
+				continue;
+			}
+			for(unsigned i = 0; i < l_Image.Pixels.size(); i++)
+			{
+				l_Flat &= abs((int)l_Image.Pixels[i] - 128) <= 1;
+			}
+		}
+
+		cout << " " << s_Sampling[s][0] << "x" << s_Sampling[s][1] << (l_Flat ? " ok" : " FAILED");
+		l_Passed &= l_Flat;
+	}
+	cout << endl << endl;
+
+	return l_Passed;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunDecodeBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	unsigned l_Iterations = argc > 1 ? max(1, atoi(argv[1])) : 3;
+	unsigned l_ThreadCount = GetProcessorCount();
+
+	JpegDecoder l_JpegDecoder;
+	DevILDecoder l_DevILDecoder;
+
+	// Not worth timing anything if the decoder gets these wrong
+	if(!CheckSamplingFactors(&l_JpegDecoder))
+	{
+		return 1;
+	}
+
+	const char* l_SetNames[] = { "thumbnails64", "thumbnails256" };
+	bool l_AnyFound = false;
+
+	for(int s = 0; s < 2; s++)
+	{
+		ThumbnailSet l_Set;
+		if(!LoadThumbnailSet(l_DataDirectory, l_SetNames[s], l_Set))
+		{
+			cout << l_SetNames[s] << ": no containers found, skipped" << endl << endl;
+			continue;
+		}
+		l_AnyFound = true;
+
+		cout << l_Set.Name << ": " << l_Set.Blobs.size() << " images in " << l_Set.ContainerCount << " containers, "
+			 << fixed << setprecision(1) << l_Set.Data.size() / (1024.0 * 1024.0) << " MB, best of " << l_Iterations << endl;
+
+		// DevIL is serialized internally, so it only gets a single threaded run. It's the baseline for the speedups
+		unsigned l_Failures = 0;
+		double l_DevILTime = TimeDecoder(l_Set, &l_DevILDecoder, 1, l_Iterations, l_Failures);
+		PrintResult(l_Set, l_DevILDecoder.GetName(), 1, l_DevILTime, l_Failures, l_DevILTime);
+
+		double l_JpegTime = TimeDecoder(l_Set, &l_JpegDecoder, 1, l_Iterations, l_Failures);
+		PrintResult(l_Set, l_JpegDecoder.GetName(), 1, l_JpegTime, l_Failures, l_DevILTime);
+
+		if(l_ThreadCount > 1)
+		{
+			double l_ThreadedTime = TimeDecoder(l_Set, &l_JpegDecoder, l_ThreadCount, l_Iterations, l_Failures);
+			PrintResult(l_Set, l_JpegDecoder.GetName(), l_ThreadCount, l_ThreadedTime, l_Failures, l_DevILTime);
+		}
+
+		// Scaled decodes, the speedup is relative to the full size JPEG decode
+		for(int l_Shift = 1; l_Shift <= 3; l_Shift++)
+		{
+			stringstream l_Name;
+			l_Name << l_JpegDecoder.GetName() << " 1/" << (1 << l_Shift);
+			double l_ScaledTime = TimeDecoder(l_Set, &l_JpegDecoder, 1, l_Iterations, l_Failures, l_Shift);
+			PrintResult(l_Set, l_Name.str().c_str(), 1, l_ScaledTime, l_Failures, l_JpegTime);
+		}
+
+		CompareDecoders(l_Set, &l_JpegDecoder, &l_DevILDecoder);
+		cout << endl;
+	}
+
+	if(!l_AnyFound)
+	{
+		cout << "No thumbnail containers found in '" << l_DataDirectory << "'" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,644 @@
+/**
+ * @file FlyThroughBenchmark.cpp
+ * @brief Headless scripted camera fly-through benchmark
+ *
+ * Runs the whole photo browser without a window: the index is loaded, the current layout applied, and the camera is
+ * driven along scripted paths through the same Camera calls the mouse controls make, while the NullGraphics renderer
+ * stands in for the graphics card. Frames are paced at the framerate limit like the main loop, so the camera moves in
+ * real time and the texture loader has the time between frames it would have on screen.
+ * For each path it reports the frame time percentiles, how long each settle took to reach a fully textured view, and
+ * the reads, decodes and loads the path caused. The results are printed and written to a JSON file.
+ * The paths run one after another in a single session, so later paths find what earlier ones left in the caches
+ */
+
+#include "Benchmark.h"
+#include "PhotoBrowser.h"
+#include "Metrics.h"
+#include "Profiler.h"
+
+/**
+ * DEFAULT_OUTPUT_FILENAME
+ * Where the results go when no output file is given, relative to the benchmark working directory
+ */
+#define DEFAULT_OUTPUT_FILENAME "FlyThrough.json"
+
+/**
+ * DEFAULT_SETTLE_TIMEOUT
+ * Seconds a settle waits for the view to be fully textured before giving up
+ */
+#define DEFAULT_SETTLE_TIMEOUT 10.0f
+
+/**
+ * s_DefaultScript
+ * The paths run when no script file is given. Day positions are fractions of the way through the library's days and
+ * zoom points fractions of the viewport, so the script suits any library
+ */
+static const char* s_DefaultScript =
+	"# Zoom out to the whole library and back\n"
+	"path zoomout\n"
+	"settle\n"
+	"overview 2\n"
+	"settle\n"
+	"home 2\n"
+	"settle\n"
+	"\n"
+	"# Fast pans back and forth at thumbnail distance\n"
+	"path pan\n"
+	"day 0.5 20 1\n"
+	"settle\n"
+	"swipe 40 0 30\n"
+	"wait 30\n"
+	"swipe -60 0 30\n"
+	"wait 30\n"
+	"swipe 0 40 20\n"
+	"swipe 0 -40 20\n"
+	"settle\n"
+	"\n"
+	"# Fly to days across the library and zoom into their first image\n"
+	"path days\n"
+	"day 0.1 20 1\n"
+	"settle\n"
+	"zoom 0.5 0.5 100 0.5\n"
+	"settle\n"
+	"day 0.3 20 1\n"
+	"settle\n"
+	"zoom 0.5 0.5 100 0.5\n"
+	"settle\n"
+	"day 0.7 20 1\n"
+	"settle\n"
+	"zoom 0.5 0.5 100 0.5\n"
+	"settle\n"
+	"day 0.9 20 1\n"
+	"settle\n"
+	"zoom 0.5 0.5 100 0.5\n"
+	"settle\n";
+
+/**
+ * s_ReportedMetrics
+ * The counters reported for each path, as the difference over the path
+ */
+static const MetricId s_ReportedMetrics[] =
+{
+	Metric_DrawCalls,
+	Metric_TilesDrawn,
+	Metric_Reads,
+	Metric_ReadKB,
+	Metric_ReadAheadHits,
+	Metric_DecodedCacheHits,
+	Metric_DecodedCacheMisses,
+	Metric_Decodes,
+	Metric_DecodedKB,
+	Metric_LoadsCompleted,
+	Metric_LoadsCancelled,
+};
+
+static const int s_ReportedMetricCount = sizeof(s_ReportedMetrics) / sizeof(s_ReportedMetrics[0]);
+
+/**
+ * FlyCommandType
+ * The script commands
+ */
+enum FlyCommandType
+{
+	FlyCommand_Path,			// path <name>: start a new path, reported on its own
+	FlyCommand_MoveTo,			// moveto <x> <y> <z> <seconds>: move the camera to a world position
+	FlyCommand_Home,			// home <seconds>: move the camera back to where the layout put it
+	FlyCommand_Overview,		// overview <seconds>: move the camera out until the whole library is in view
+	FlyCommand_Day,				// day <fraction> <z> <seconds>: move over the first image of a day, a fraction of the way through the days
+	FlyCommand_Swipe,			// swipe <dx> <dy> <frames>: swipe by a screen delta in pixels every frame, as a mouse drag does
+	FlyCommand_Zoom,			// zoom <x> <y> <amount> <seconds>: zoom towards a point given as fractions of the viewport
+	FlyCommand_Wait,			// wait <frames>
+	FlyCommand_Settle,			// settle [timeout]: run until the camera is at rest and the view is fully textured
+};
+
+/**
+ * FlyCommand
+ * One parsed script command
+ */
+struct FlyCommand
+{
+	FlyCommandType Type;
+	string Name;				// Path name
+	float Args[4];
+};
+
+/**
+ * SettleResult
+ * How long a settle took. Seconds runs from the start of the settle, so after a move it includes the rest of the move.
+ * RestToTextured runs from when the camera came to rest
+ */
+struct SettleResult
+{
+	float Seconds;
+	float RestToTextured;
+	bool Complete;				// False if the settle timed out with tiles still untextured
+};
+
+/**
+ * PathResult
+ * Everything measured over one path
+ */
+struct PathResult
+{
+	string Name;
+	vector<float> FrameTimes;					// Milliseconds spent in each frame, not counting the wait for the framerate limit
+	vector<SettleResult> Settles;
+	LONG MetricDeltas[Metric_MAX];
+};
+
+/**
+ * FlyThrough
+ * The state of a running fly-through
+ */
+struct FlyThrough
+{
+	PhotoBrowser* Browser;
+	Camera* View;
+	double LastFrameTime;
+	float HomeX, HomeY, HomeZ;					// Where the layout put the camera
+	float MinWorldX, MinWorldY;					// Bounds of the laid out library
+	float MaxWorldX, MaxWorldY;
+	vector<unsigned> Days;						// Index of the first image of each day, in date order
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * ParseScript
+ * Parse the script commands, one to a line. Blank lines and lines starting with # are skipped.
+ * Returns false with a message if a line can't be parsed
+ */
+static bool ParseScript(istream& in_Script, vector<FlyCommand>& out_Commands, string& out_Error)
+{
+	out_Commands.clear();
+
+	string l_Line;
+	for(unsigned l_LineNumber = 1; getline(in_Script, l_Line); l_LineNumber++)
+	{
+		istringstream l_Stream(l_Line);
+		string l_Command;
+		if(!(l_Stream >> l_Command) || l_Command[0] == '#')
+		{
+			continue;
+		}
+
+		FlyCommand l_Fly;
+		l_Fly.Args[0] = l_Fly.Args[1] = l_Fly.Args[2] = l_Fly.Args[3] = 0;
+		int l_ArgCount = 0;
+		bool l_Valid = true;
+		if(l_Command == "path")			{ l_Fly.Type = FlyCommand_Path; l_Valid = !(l_Stream >> l_Fly.Name).fail(); }
+		else if(l_Command == "moveto")	{ l_Fly.Type = FlyCommand_MoveTo; l_ArgCount = 4; }
+		else if(l_Command == "home")	{ l_Fly.Type = FlyCommand_Home; l_ArgCount = 1; }
+		else if(l_Command == "overview"){ l_Fly.Type = FlyCommand_Overview; l_ArgCount = 1; }
+		else if(l_Command == "day")		{ l_Fly.Type = FlyCommand_Day; l_ArgCount = 3; }
+		else if(l_Command == "swipe")	{ l_Fly.Type = FlyCommand_Swipe; l_ArgCount = 3; }
+		else if(l_Command == "zoom")	{ l_Fly.Type = FlyCommand_Zoom; l_ArgCount = 4; }
+		else if(l_Command == "wait")	{ l_Fly.Type = FlyCommand_Wait; l_ArgCount = 1; }
+		else if(l_Command == "settle")
+		{
+			l_Fly.Type = FlyCommand_Settle;
+			if(!(l_Stream >> l_Fly.Args[0]))
+			{
+				l_Fly.Args[0] = DEFAULT_SETTLE_TIMEOUT;
+			}
+		}
+		else
+		{
+			l_Valid = false;
+		}
+
+		for(int i = 0; i < l_ArgCount && l_Valid; i++)
+		{
+			l_Valid = !(l_Stream >> l_Fly.Args[i]).fail();
+		}
+
+		if(!l_Valid)
+		{
+			ostringstream l_Error;
+			l_Error << "line " << l_LineNumber << ": can't parse '" << l_Line << "'";
+			out_Error = l_Error.str();
+			return false;
+		}
+		out_Commands.push_back(l_Fly);
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetParentDirectory
+ * The directory holding in_Path, which is the browser's working directory when in_Path is its data directory
+ */
+static string GetParentDirectory(string in_Path)
+{
+	while(in_Path.size() > 1 && (in_Path[in_Path.size() - 1] == '/' || in_Path[in_Path.size() - 1] == '\\'))
+	{
+		in_Path.erase(in_Path.size() - 1);
+	}
+
+	size_t l_Slash = in_Path.find_last_of("/\\");
+	if(l_Slash == string::npos)
+	{
+		return ".";
+	}
+	return l_Slash == 0 ? in_Path.substr(0, 1) : in_Path.substr(0, l_Slash);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * FindLibraryExtents
+ * The bounds of the laid out image tiles and the first image of each day, for the overview and day commands
+ */
+static void FindLibraryExtents(FlyThrough& io_Fly)
+{
+	ImageContext* l_Context = ImageContext::Instance();
+	float l_HalfImageSize = UserPreferences::Instance()->ImageSize() * 0.5f;
+
+	// Keyed by date, each day holds its earliest image
+	map<unsigned, pair<unsigned, unsigned> > l_Days;
+	for(unsigned i = 0; i < l_Context->GetImageCount(); i++)
+	{
+		ImageTile* l_Tile = l_Context->GetImage(i);
+
+		// The tiles may still be on their way into the layout
+		float l_X, l_Y, l_Z;
+		l_Tile->GetMoveToGoalPosition(l_X, l_Y, l_Z);
+		if(i == 0)
+		{
+			io_Fly.MinWorldX = io_Fly.MaxWorldX = l_X;
+			io_Fly.MinWorldY = io_Fly.MaxWorldY = l_Y;
+		}
+		io_Fly.MinWorldX = min(io_Fly.MinWorldX, l_X - l_HalfImageSize);
+		io_Fly.MinWorldY = min(io_Fly.MinWorldY, l_Y - l_HalfImageSize);
+		io_Fly.MaxWorldX = max(io_Fly.MaxWorldX, l_X + l_HalfImageSize);
+		io_Fly.MaxWorldY = max(io_Fly.MaxWorldY, l_Y + l_HalfImageSize);
+
+		unsigned l_TimeOfDay, l_DayOfYear, l_Year;
+		l_Tile->GetTimeStamp(l_TimeOfDay, l_DayOfYear, l_Year);
+		unsigned l_Date = l_Year * 400 + l_DayOfYear;
+		map<unsigned, pair<unsigned, unsigned> >::iterator l_Found = l_Days.find(l_Date);
+		if(l_Found == l_Days.end() || l_TimeOfDay < l_Found->second.first)
+		{
+			l_Days[l_Date] = make_pair(l_TimeOfDay, i);
+		}
+	}
+
+	io_Fly.Days.clear();
+	for(map<unsigned, pair<unsigned, unsigned> >::iterator It = l_Days.begin(); It != l_Days.end(); It++)
+	{
+		io_Fly.Days.push_back(It->second.second);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * RunFrame
+ * Wait out the framerate limit as the main loop does, then run one browser frame and record its time
+ */
+static void RunFrame(FlyThrough& io_Fly, PathResult& io_Result)
+{
+	double l_FrameTimeTarget = 1.0 / max(UserPreferences::Instance()->FramerateLimit(), 1);
+	double l_Now = Timer::Instance()->GetSeconds();
+	while(l_Now - io_Fly.LastFrameTime < l_FrameTimeTarget)
+	{
+		Sleep(0);
+		l_Now = Timer::Instance()->GetSeconds();
+	}
+	double l_DeltaTime = l_Now - io_Fly.LastFrameTime;
+	io_Fly.LastFrameTime = l_Now;
+
+	Profiler::Instance()->BeginFrame();
+	io_Fly.Browser->Tick((float)l_DeltaTime);
+	Metrics::Instance()->EndFrame();
+
+	io_Result.FrameTimes.push_back((float)((Timer::Instance()->GetSeconds() - l_Now) * 1000.0));
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * Settle
+ * Run frames until the camera is at rest and the view is fully textured, or the timeout runs out
+ */
+static void Settle(FlyThrough& io_Fly, float in_Timeout, PathResult& io_Result)
+{
+	double l_Start = Timer::Instance()->GetSeconds();
+	double l_RestTime = -1;
+
+	SettleResult l_Settle;
+	l_Settle.Complete = false;
+	while(true)
+	{
+		RunFrame(io_Fly, io_Result);
+		double l_Now = Timer::Instance()->GetSeconds();
+
+		if(io_Fly.View->IsMoving())
+		{
+			l_RestTime = -1;
+		}
+		else
+		{
+			if(l_RestTime < 0)
+			{
+				l_RestTime = l_Now;
+			}
+			if(io_Fly.Browser->GetUntexturedVisibleCount() == 0)
+			{
+				l_Settle.Complete = true;
+			}
+		}
+
+		if(l_Settle.Complete || l_Now - l_Start >= in_Timeout)
+		{
+			l_Settle.Seconds = (float)(l_Now - l_Start);
+			l_Settle.RestToTextured = l_RestTime < 0 ? 0.0f : (float)(l_Now - l_RestTime);
+			break;
+		}
+	}
+
+	io_Result.Settles.push_back(l_Settle);
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * RunCommand
+ * Carry out one script command on the current path
+ */
+static void RunCommand(FlyThrough& io_Fly, const FlyCommand& in_Command, PathResult& io_Result)
+{
+	Camera* l_Camera = io_Fly.View;
+	const float* l_Args = in_Command.Args;
+
+	switch(in_Command.Type)
+	{
+	case FlyCommand_MoveTo:
+		l_Camera->MoveTo(l_Args[0], l_Args[1], l_Args[2], l_Args[3]);
+		break;
+
+	case FlyCommand_Home:
+		l_Camera->MoveTo(io_Fly.HomeX, io_Fly.HomeY, io_Fly.HomeZ, l_Args[0]);
+		break;
+
+	case FlyCommand_Overview:
+		{
+			// The distance at which the whole library fits the viewport, as Camera::ZoomExtents finds it
+			float l_Width = io_Fly.MaxWorldX - io_Fly.MinWorldX;
+			float l_Height = io_Fly.MaxWorldY - io_Fly.MinWorldY;
+			float l_TanHalfFovy = (float)tan(l_Camera->GetFovy() * 0.5f * DEG_TO_RAD);
+			float l_Z = max(l_Width / l_Camera->GetAspectRatio(), l_Height) * 0.5f / l_TanHalfFovy;
+			l_Camera->MoveTo((io_Fly.MinWorldX + io_Fly.MaxWorldX) * 0.5f, (io_Fly.MinWorldY + io_Fly.MaxWorldY) * 0.5f, l_Z, l_Args[0]);
+		}
+		break;
+
+	case FlyCommand_Day:
+		if(!io_Fly.Days.empty())
+		{
+			unsigned l_Day = min((unsigned)(max(l_Args[0], 0.0f) * io_Fly.Days.size()), (unsigned)io_Fly.Days.size() - 1);
+			float l_X, l_Y, l_Z;
+			ImageContext::Instance()->GetImage(io_Fly.Days[l_Day])->GetMoveToGoalPosition(l_X, l_Y, l_Z);
+			l_Camera->MoveTo(l_X, l_Y, l_Args[1], l_Args[2]);
+		}
+		break;
+
+	case FlyCommand_Swipe:
+		for(int i = 0; i < (int)l_Args[2]; i++)
+		{
+			l_Camera->Swipe(l_Args[0], l_Args[1]);
+			RunFrame(io_Fly, io_Result);
+		}
+		break;
+
+	case FlyCommand_Zoom:
+		l_Camera->ZoomScreenPoint(l_Args[0] * l_Camera->GetViewportSizeX(), l_Args[1] * l_Camera->GetViewportSizeY(), l_Args[2], l_Args[3]);
+		break;
+
+	case FlyCommand_Wait:
+		for(int i = 0; i < (int)l_Args[0]; i++)
+		{
+			RunFrame(io_Fly, io_Result);
+		}
+		break;
+
+	case FlyCommand_Settle:
+		Settle(io_Fly, l_Args[0], io_Result);
+		break;
+
+	default:
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetPercentile
+ * The nearest rank percentile of sorted values
+ */
+static float GetPercentile(const vector<float>& in_Sorted, float in_Percentile)
+{
+	if(in_Sorted.empty())
+	{
+		return 0;
+	}
+	unsigned l_Rank = (unsigned)ceil(in_Percentile * in_Sorted.size());
+	return in_Sorted[min(max(l_Rank, 1u), (unsigned)in_Sorted.size()) - 1];
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * WriteResults
+ * Print each path's results and write them all as JSON
+ */
+static void WriteResults(const vector<PathResult>& in_Results, const string& in_Layout, unsigned in_ImageCount, ostream& out_Json)
+{
+	out_Json << "{" << endl;
+	out_Json << "\t\"Layout\": \"" << in_Layout << "\"," << endl;
+	out_Json << "\t\"Images\": " << in_ImageCount << "," << endl;
+	out_Json << "\t\"Paths\":" << endl << "\t[" << endl;
+
+	cout << setw(10) << left << "Path" << right << setw(8) << "Frames" << setw(8) << "P50" << setw(8) << "P95" << setw(8) << "P99"
+		 << setw(8) << "Max" << setw(10) << "Textured" << setw(10) << "ReadKB" << setw(9) << "Decodes" << setw(8) << "Hits" << endl;
+
+	for(unsigned p = 0; p < in_Results.size(); p++)
+	{
+		const PathResult& l_Result = in_Results[p];
+
+		vector<float> l_Sorted = l_Result.FrameTimes;
+		sort(l_Sorted.begin(), l_Sorted.end());
+		double l_Total = 0;
+		for(unsigned i = 0; i < l_Sorted.size(); i++)
+		{
+			l_Total += l_Sorted[i];
+		}
+
+		// The slowest settle is the one that matters for the summary
+		float l_WorstSettle = 0;
+		bool l_AllComplete = true;
+		for(unsigned i = 0; i < l_Result.Settles.size(); i++)
+		{
+			l_WorstSettle = max(l_WorstSettle, l_Result.Settles[i].Seconds);
+			l_AllComplete &= l_Result.Settles[i].Complete;
+		}
+
+		out_Json << "\t\t{" << endl;
+		out_Json << "\t\t\t\"Name\": \"" << l_Result.Name << "\"," << endl;
+		out_Json << "\t\t\t\"Frames\": " << l_Sorted.size() << "," << endl;
+		out_Json << "\t\t\t\"FrameTimeMs\": { \"Mean\": " << (l_Sorted.empty() ? 0.0 : l_Total / l_Sorted.size())
+				 << ", \"P50\": " << GetPercentile(l_Sorted, 0.5f) << ", \"P95\": " << GetPercentile(l_Sorted, 0.95f)
+				 << ", \"P99\": " << GetPercentile(l_Sorted, 0.99f) << ", \"Max\": " << (l_Sorted.empty() ? 0.0f : l_Sorted.back()) << " }," << endl;
+		out_Json << "\t\t\t\"Settles\": [";
+		for(unsigned i = 0; i < l_Result.Settles.size(); i++)
+		{
+			const SettleResult& l_Settle = l_Result.Settles[i];
+			out_Json << (i ? ", " : " ") << "{ \"Seconds\": " << l_Settle.Seconds << ", \"RestToTextured\": " << l_Settle.RestToTextured
+					 << ", \"Complete\": " << (l_Settle.Complete ? "true" : "false") << " }";
+		}
+		out_Json << (l_Result.Settles.empty() ? "" : " ") << "]," << endl;
+		out_Json << "\t\t\t\"Metrics\": {";
+		for(int i = 0; i < s_ReportedMetricCount; i++)
+		{
+			out_Json << (i ? ", " : " ") << "\"" << Metrics::GetMetricName(s_ReportedMetrics[i]) << "\": " << l_Result.MetricDeltas[s_ReportedMetrics[i]];
+		}
+		out_Json << " }" << endl;
+		out_Json << "\t\t}" << (p + 1 < in_Results.size() ? "," : "") << endl;
+
+		cout << setw(10) << left << l_Result.Name << right << setw(8) << l_Sorted.size() << fixed << setprecision(2)
+			 << setw(8) << GetPercentile(l_Sorted, 0.5f) << setw(8) << GetPercentile(l_Sorted, 0.95f)
+			 << setw(8) << GetPercentile(l_Sorted, 0.99f) << setw(8) << (l_Sorted.empty() ? 0.0f : l_Sorted.back())
+			 << setw(9) << l_WorstSettle << (l_AllComplete ? " " : "*")
+			 << setw(10) << l_Result.MetricDeltas[Metric_ReadKB] << setw(9) << l_Result.MetricDeltas[Metric_Decodes]
+			 << setw(8) << l_Result.MetricDeltas[Metric_DecodedCacheHits] << endl;
+	}
+
+	out_Json << "\t]," << endl;
+
+	// Load latency over the whole run
+	HistogramSummary l_Latency;
+	if(!Metrics::Instance()->Summarize(Metric_LoadLatency, l_Latency))
+	{
+		l_Latency.Count = 0;
+		l_Latency.P50 = l_Latency.P95 = l_Latency.P99 = l_Latency.Max = 0;
+	}
+	out_Json << "\t\"LoadLatencyMs\": { \"Count\": " << l_Latency.Count << ", \"P50\": " << l_Latency.P50 << ", \"P95\": " << l_Latency.P95
+			 << ", \"P99\": " << l_Latency.P99 << ", \"Max\": " << l_Latency.Max << " }" << endl;
+	out_Json << "}" << endl;
+
+	cout << "Frame times in ms, Textured is the slowest settle in seconds (* if one timed out)" << endl;
+	cout << "Load latency: P50 " << l_Latency.P50 << " ms, P95 " << l_Latency.P95 << " ms, P99 " << l_Latency.P99 << " ms over "
+		 << l_Latency.Count << " loads" << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunFlyThroughBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	string l_OutputFilename = argc > 1 ? argv[1] : DEFAULT_OUTPUT_FILENAME;
+
+	// The script and the output file are relative to where we were started, not the browser's directory
+	vector<FlyCommand> l_Commands;
+	string l_Error;
+	if(argc > 2)
+	{
+		ifstream l_Script(argv[2]);
+		if(l_Script.fail())
+		{
+			cout << "Failed to open script '" << argv[2] << "'" << endl;
+			return 1;
+		}
+		if(!ParseScript(l_Script, l_Commands, l_Error))
+		{
+			cout << "Script '" << argv[2] << "', " << l_Error << endl;
+			return 1;
+		}
+	}
+	else
+	{
+		istringstream l_Script(s_DefaultScript);
+		ParseScript(l_Script, l_Commands, l_Error);
+	}
+
+	ofstream l_Output(l_OutputFilename.c_str());
+	if(l_Output.fail())
+	{
+		cout << "Failed to create '" << l_OutputFilename << "'" << endl;
+		return 1;
+	}
+
+	// The browser finds its data relative to the working directory
+	string l_BrowserDirectory = GetParentDirectory(l_DataDirectory);
+	if(_chdir(l_BrowserDirectory.c_str()) != 0 || ifstream("data/photo_index.dat").fail())
+	{
+		cout << "No photo index found in '" << l_DataDirectory << "'" << endl;
+		return 1;
+	}
+
+	FlyThrough l_Fly;
+	l_Fly.Browser = PhotoBrowser::Instance();
+	if(!l_Fly.Browser->Startup(true))
+	{
+		cout << "Failed to start the browser" << endl;
+		return 1;
+	}
+
+	unsigned l_ImageCount = ImageContext::Instance()->GetImageCount();
+	if(l_ImageCount == 0)
+	{
+		cout << "The photo index in '" << l_DataDirectory << "' has no images" << endl;
+		l_Fly.Browser->Shutdown();
+		return 1;
+	}
+	string l_Layout = l_Fly.Browser->GetRegisteredLayout(UserPreferences::Instance()->CurrentLayout())->GetName();
+	cout << "Fly-through of " << l_ImageCount << " images in the " << l_Layout << " layout" << endl << endl;
+
+	l_Fly.View = l_Fly.Browser->GetCamera();
+	l_Fly.View->GetPosition(l_Fly.HomeX, l_Fly.HomeY, l_Fly.HomeZ);
+	l_Fly.LastFrameTime = Timer::Instance()->GetSeconds();
+	FindLibraryExtents(l_Fly);
+
+	// Commands before the first path command make up a path of their own
+	vector<PathResult> l_Results;
+	LONG l_PathStart[Metric_MAX];
+	for(unsigned i = 0; i < l_Commands.size(); i++)
+	{
+		if(l_Results.empty() || l_Commands[i].Type == FlyCommand_Path)
+		{
+			l_Results.push_back(PathResult());
+			l_Results.back().Name = l_Commands[i].Type == FlyCommand_Path ? l_Commands[i].Name : "script";
+			for(int m = 0; m < Metric_MAX; m++)
+			{
+				l_PathStart[m] = Metrics::Instance()->GetValue((MetricId)m);
+			}
+		}
+
+		RunCommand(l_Fly, l_Commands[i], l_Results.back());
+
+		// Keep the totals up to date, the path ends at the next path command or the end of the script
+		for(int m = 0; m < Metric_MAX; m++)
+		{
+			l_Results.back().MetricDeltas[m] = Metrics::Instance()->GetValue((MetricId)m) - l_PathStart[m];
+		}
+	}
+
+	WriteResults(l_Results, l_Layout, l_ImageCount, l_Output);
+	cout << endl << "Results written to '" << l_OutputFilename << "'" << endl;
+
+	// Every load is counted whichever way it went, so counters still at zero since startup mean the metrics are broken
+	Metrics* l_Metrics = Metrics::Instance();
+	bool l_Counted = l_Metrics->GetValue(Metric_LoadsCompleted) > 0 &&
+					 l_Metrics->GetValue(Metric_Reads) + l_Metrics->GetValue(Metric_DecodedCacheHits) > 0;
+
+	l_Fly.Browser->Shutdown();
+	if(!l_Counted)
+	{
+		cout << "FAILED: no thumbnail loads or reads were counted, the results above are meaningless" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,286 @@
+/**
+ * @file LoadBenchmark.cpp
+ * @brief Texture loader decode path allocation benchmark
+ *
+ * Runs the thumbnails through the TextureLoader's decode path (copy the compressed data out of the container,
+ * decode it, hand the pixels to the upload) two ways: with a fresh heap buffer for every step, as the loader used
+ * to, and with a per-worker DecodeArena and a shared StagingBufferPool. Reports images/s and the number of heap
+ * allocations per thumbnail once the buffers have warmed up, single threaded and on every processor
+ */
+
+#include "Benchmark.h"
+#include "JpegDecoder.h"
+#include "Thread.h"
+#include <new>
+
+/**
+ * s_AllocationCount
+ * Every operator new in the process is counted, which covers the decode path's vectors and buffers
+ */
+static volatile LONG s_AllocationCount = 0;
+
+void* operator new(size_t in_Size)
+{
+	InterlockedIncrement(&s_AllocationCount);
+	void* l_Memory = malloc(in_Size ? in_Size : 1);
+	if(!l_Memory)
+	{
+		throw bad_alloc();
+	}
+	return l_Memory;
+}
+
+void* operator new[](size_t in_Size)
+{
+	return operator new(in_Size);
+}
+
+void operator delete(void* in_Memory)
+{
+	free(in_Memory);
+}
+
+void operator delete[](void* in_Memory)
+{
+	free(in_Memory);
+}
+
+/**
+ * LoadPath
+ * The two ways of getting a thumbnail from compressed data to pixels ready for upload
+ */
+enum LoadPath
+{
+	LoadPath_Heap,		// New compressed data buffer, decoder scratch and pixel buffer for every thumbnail
+	LoadPath_Pooled,	// Per-worker arena for the compressed data and scratch, pooled pixel buffers
+};
+
+/**
+ * LoadWorker
+ * Loads thumbnails from a shared counter until there are none left, like the TextureLoader worker thread does
+ */
+class LoadWorker : public Thread
+{
+public:
+
+	LoadWorker(const ThumbnailSet* in_Set, ImageDecoder* in_Decoder, LoadPath in_Path, StagingBufferPool* in_Pool, volatile LONG* in_NextBlob)
+		: mSet(in_Set), mDecoder(in_Decoder), mPath(in_Path), mPool(in_Pool), mNextBlob(in_NextBlob), mFailures(0) {}
+
+	/**
+	 * Thread interface
+	 */
+	virtual void Run()
+	{
+		mFailures = 0;
+		LONG l_BlobCount = (LONG)mSet->Blobs.size();
+		for(LONG l_Index = InterlockedIncrement(mNextBlob) - 1; l_Index < l_BlobCount; l_Index = InterlockedIncrement(mNextBlob) - 1)
+		{
+			if(!Load(l_Index))
+			{
+				mFailures++;
+			}
+		}
+	}
+
+	/**
+	 * Load
+	 * Load a single thumbnail. The pixels are released straight away, as they would be after the upload
+	 */
+	bool Load(unsigned in_Index)
+	{
+		const pair<unsigned, unsigned>& l_Blob = mSet->Blobs[in_Index];
+		const unsigned char* l_Source = &mSet->Data[l_Blob.first];
+		bool l_Success;
+
+		if(mPath == LoadPath_Heap)
+		{
+			unsigned char* l_Data = new unsigned char[l_Blob.second];
+			memcpy(l_Data, l_Source, l_Blob.second);
+			DecodedImage l_Image;
+			l_Success = mDecoder->Decode(l_Data, l_Blob.second, l_Image);
+			delete [] l_Data;
+		}
+		else
+		{
+			mArena.Reset();
+			unsigned char* l_Data = (unsigned char*)mArena.Allocate(l_Blob.second);
+			memcpy(l_Data, l_Source, l_Blob.second);
+			DecodedImage l_Image(mPool);
+			l_Success = mDecoder->Decode(l_Data, l_Blob.second, l_Image, &mArena);
+		}
+
+		return l_Success;
+	}
+
+	/**
+	 * Wait
+	 * Wait for the thread to finish
+	 */
+	void Wait()
+	{
+#ifdef WIN32
+		WaitForSingleObject(mThreadHandle, INFINITE);
+		CloseHandle(mThreadHandle);
+#else
+		#error Your platform thread join goes here
+#endif // WIN32
+	}
+
+	unsigned GetFailures() const { return mFailures; }
+
+private:
+
+	const ThumbnailSet* mSet;
+	ImageDecoder* mDecoder;
+	LoadPath mPath;
+	StagingBufferPool* mPool;
+	volatile LONG* mNextBlob;
+	unsigned mFailures;
+	DecodeArena mArena;
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeLoadPath
+ * Load the whole set in_Iterations times after a warm up pass and return the fastest time in seconds, along with
+ * the heap allocations per thumbnail of that pass. The workers, and so their arenas, live across the passes
+ */
+static double TimeLoadPath(const ThumbnailSet& in_Set, ImageDecoder* in_Decoder, LoadPath in_Path, unsigned in_ThreadCount, unsigned in_Iterations,
+						   double& out_AllocationsPerImage, unsigned& out_Failures)
+{
+	StagingBufferPool l_Pool;
+	vector<LoadWorker*> l_Workers;
+	volatile LONG l_NextBlob = 0;
+	for(unsigned i = 0; i < in_ThreadCount; i++)
+	{
+		l_Workers.push_back(new LoadWorker(&in_Set, in_Decoder, in_Path, &l_Pool, &l_NextBlob));
+	}
+
+	double l_Best = 0.0;
+	for(unsigned l_Iteration = 0; l_Iteration <= in_Iterations; l_Iteration++)
+	{
+		out_Failures = 0;
+		LONG l_Allocations = s_AllocationCount;
+		double l_Start = Timer::Instance()->GetSeconds();
+
+		if(in_ThreadCount <= 1)
+		{
+			for(unsigned i = 0; i < in_Set.Blobs.size(); i++)
+			{
+				if(!l_Workers[0]->Load(i))
+				{
+					out_Failures++;
+				}
+			}
+		}
+		else
+		{
+			// Thread starts allocate too, so they are left out of the count
+			l_NextBlob = 0;
+			for(unsigned i = 0; i < in_ThreadCount; i++)
+			{
+				l_Workers[i]->Start(true);
+			}
+			l_Allocations = s_AllocationCount;
+			l_Start = Timer::Instance()->GetSeconds();
+			for(unsigned i = 0; i < in_ThreadCount; i++)
+			{
+				l_Workers[i]->Resume();
+			}
+			for(unsigned i = 0; i < in_ThreadCount; i++)
+			{
+				l_Workers[i]->Wait();
+				out_Failures += l_Workers[i]->GetFailures();
+			}
+		}
+
+		double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+		double l_AllocationsPerImage = (s_AllocationCount - l_Allocations) / (double)in_Set.Blobs.size();
+
+		// The first pass warms up the arenas and the pool
+		if(l_Iteration == 1 || (l_Iteration > 1 && l_Time < l_Best))
+		{
+			l_Best = l_Time;
+			out_AllocationsPerImage = l_AllocationsPerImage;
+		}
+	}
+
+	for(unsigned i = 0; i < in_ThreadCount; i++)
+	{
+		delete l_Workers[i];
+	}
+	return l_Best;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * PrintLoadResult
+ * Print one line of the results table
+ */
+static void PrintLoadResult(const ThumbnailSet& in_Set, const char* in_Name, unsigned in_ThreadCount, double in_Seconds, double in_AllocationsPerImage,
+							unsigned in_Failures, double in_BaselineSeconds)
+{
+	double l_Images = (double)in_Set.Blobs.size();
+
+	cout << "  " << left << setw(7) << in_Name << right << setw(3) << in_ThreadCount << (in_ThreadCount == 1 ? " thread : " : " threads: ")
+		 << fixed << setprecision(0) << setw(8) << l_Images / in_Seconds << " images/s"
+		 << setprecision(2) << setw(9) << in_Seconds * 1000000.0 / l_Images << " us/image"
+		 << setprecision(2) << setw(7) << in_AllocationsPerImage << " allocations/image"
+		 << setprecision(2) << setw(7) << in_BaselineSeconds / in_Seconds << "x";
+	if(in_Failures)
+	{
+		cout << "  (" << in_Failures << " failed)";
+	}
+	cout << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunLoadBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	unsigned l_Iterations = argc > 1 ? max(1, atoi(argv[1])) : 3;
+	unsigned l_ThreadCount = GetProcessorCount();
+
+	JpegDecoder l_Decoder;
+
+	const char* l_SetNames[] = { "thumbnails64", "thumbnails256" };
+	bool l_AnyFound = false;
+
+	for(int s = 0; s < 2; s++)
+	{
+		ThumbnailSet l_Set;
+		if(!LoadThumbnailSet(l_DataDirectory, l_SetNames[s], l_Set))
+		{
+			cout << l_SetNames[s] << ": no containers found, skipped" << endl << endl;
+			continue;
+		}
+		l_AnyFound = true;
+
+		cout << l_Set.Name << ": " << l_Set.Blobs.size() << " images, best of " << l_Iterations << " after a warm up pass" << endl;
+
+		// Single threaded, then on every processor. The speedups are relative to the heap path on the same number of threads
+		unsigned l_ThreadCounts[] = { 1, l_ThreadCount };
+		for(int t = 0; t < (l_ThreadCount > 1 ? 2 : 1); t++)
+		{
+			unsigned l_Threads = l_ThreadCounts[t];
+			unsigned l_Failures = 0;
+			double l_Allocations = 0.0;
+			double l_HeapTime = TimeLoadPath(l_Set, &l_Decoder, LoadPath_Heap, l_Threads, l_Iterations, l_Allocations, l_Failures);
+			PrintLoadResult(l_Set, "Heap", l_Threads, l_HeapTime, l_Allocations, l_Failures, l_HeapTime);
+
+			double l_PooledTime = TimeLoadPath(l_Set, &l_Decoder, LoadPath_Pooled, l_Threads, l_Iterations, l_Allocations, l_Failures);
+			PrintLoadResult(l_Set, "Pooled", l_Threads, l_PooledTime, l_Allocations, l_Failures, l_HeapTime);
+		}
+		cout << endl;
+	}
+
+	if(!l_AnyFound)
+	{
+		cout << "No thumbnail containers found in '" << l_DataDirectory << "'" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * Benchmarks
+ * Command line performance benchmarks for the 3DPhotoBrowser subsystems
+ */
+
+#include "Benchmark.h"
+#include "IL/il.h"
+
+/**
+ * BenchmarkEntry
+ * A benchmark that can be selected from the command line
+ */
+struct BenchmarkEntry
+{
+	const char* Name;
+	const char* Description;
+	int (*Run)(int argc, char* argv[]);
+};
+
+static const BenchmarkEntry s_Benchmarks[] =
+{
+	{ "decode", "decode [data directory] [iterations]: thumbnail decode throughput for each decoder", RunDecodeBenchmark },
+	{ "load", "load [data directory] [iterations]: texture loader decode path throughput and heap allocations per thumbnail", RunLoadBenchmark },
+	{ "queue", "queue [items per producer] [max producers]: texture loader request and completion queue stress test", RunQueueBenchmark },
+	{ "read", "read [data directory] [max reads in flight]: container read throughput, blocking and with each asynchronous reader", RunReadBenchmark },
+	{ "container", "container [data directory] [alignment]: version 1 and 2 container reads, cached, unbuffered and mapped", RunContainerBenchmark },
+	{ "compress", "compress [data directory] [iterations]: BC1 and BC3 texture compression throughput and quality", RunCompressBenchmark },
+	{ "upload", "upload [data directory] [iterations]: decode and texture upload speed of RGB, RGBA and RGB565 thumbnails", RunUploadBenchmark },
+	{ "flythrough", "flythrough [data directory] [output file] [script]: headless camera fly-through frame times, time to a textured view, reads and decodes", RunFlyThroughBenchmark },
+};
+
+static const int s_BenchmarkCount = sizeof(s_Benchmarks) / sizeof(s_Benchmarks[0]);
+
+void PrintUsage()
+{
+	cout << "Usage: Benchmarks <benchmark> [arguments]" << endl;
+	for(int i = 0; i < s_BenchmarkCount; i++)
+	{
+		cout << "  " << s_Benchmarks[i].Description << endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for(int i = 0; i < s_BenchmarkCount; i++)
+	{
+		if(strcmp(argv[1], s_Benchmarks[i].Name) == 0)
+		{
+			// The DevIL decoder is benchmarked too
+			ilInit();
+			int l_Result = s_Benchmarks[i].Run(argc - 2, argv + 2);
+			ilShutDown();
+			return l_Result;
+		}
+	}
+
+	cout << "Unknown benchmark '" << argv[1] << "'" << endl;
+	PrintUsage();
+	return 1;
+}
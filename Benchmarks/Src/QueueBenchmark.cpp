@@ -0,0 +1,270 @@
+/**
+ * @file QueueBenchmark.cpp
+ * @brief Texture loader queue stress benchmark
+ *
+ * Hammers the rings the TextureLoader uses to pass requests and completions between threads, and the locked deque
+ * they replaced. Several producers push into one consumer (the request path), then one producer feeds one consumer
+ * (the completion path). Reports operations/s, how often producers lost the race for a slot, and the worst time
+ * producer 0 (standing in for the render thread) spent in a single push. The consumer checks every producer's items
+ * arrive complete and in order
+ */
+
+#include "Benchmark.h"
+#include "LockFreeRing.h"
+#include "Semaphore.h"
+#include "Thread.h"
+
+/**
+ * QueueItem
+ * What goes through the queues: which producer sent it and its position in that producer's stream
+ */
+struct QueueItem
+{
+	unsigned Producer;
+	unsigned Sequence;
+};
+
+/**
+ * LockedQueue
+ * The queue the TextureLoader used before the rings: a deque behind a critical section
+ */
+class LockedQueue
+{
+public:
+
+	LockedQueue(unsigned) {}
+
+	bool TryPush(const QueueItem& in_Item)
+	{
+		mLock.Lock();
+		mItems.push_back(in_Item);
+		mLock.Unlock();
+		return true;
+	}
+
+	bool TryPop(QueueItem& out_Item)
+	{
+		mLock.Lock();
+		bool l_Found = !mItems.empty();
+		if(l_Found)
+		{
+			out_Item = mItems.front();
+			mItems.pop_front();
+		}
+		mLock.Unlock();
+		return l_Found;
+	}
+
+	unsigned GetRetryCount() const { return 0; }
+
+private:
+
+	Semaphore mLock;
+	deque<QueueItem> mItems;
+};
+
+/**
+ * SpscRingAdapter
+ * Gives the SPSC ring the same interface as the others
+ */
+class SpscRingAdapter : public SpscRing<QueueItem>
+{
+public:
+
+	SpscRingAdapter(unsigned in_Capacity) : SpscRing<QueueItem>(in_Capacity) {}
+	unsigned GetRetryCount() const { return 0; }
+};
+
+/**
+ * QueueThread
+ * Base for the producer and consumer threads
+ */
+class QueueThread : public Thread
+{
+public:
+
+	/**
+	 * Wait
+	 * Wait for the thread to finish
+	 */
+	void Wait()
+	{
+#ifdef WIN32
+		WaitForSingleObject(mThreadHandle, INFINITE);
+		CloseHandle(mThreadHandle);
+#else
+		#error Your platform thread join goes here
+#endif // WIN32
+	}
+};
+
+/**
+ * ProducerThread
+ * Pushes in_Count items, spinning while the queue is full
+ */
+template <typename Queue>
+class ProducerThread : public QueueThread
+{
+public:
+
+	ProducerThread(Queue* in_Queue, unsigned in_Producer, unsigned in_Count)
+		: mQueue(in_Queue), mProducer(in_Producer), mCount(in_Count), mFullCount(0), mWorstPush(0.0) {}
+
+	virtual void Run()
+	{
+		Timer* l_Timer = Timer::Instance();
+		QueueItem l_Item;
+		l_Item.Producer = mProducer;
+		for(l_Item.Sequence = 0; l_Item.Sequence < mCount; l_Item.Sequence++)
+		{
+			double l_Start = l_Timer->GetSeconds();
+			while(!mQueue->TryPush(l_Item))
+			{
+				// Waiting on the consumer isn't part of the push time
+				mFullCount++;
+				Sleep(0);
+				l_Start = l_Timer->GetSeconds();
+			}
+			mWorstPush = max(mWorstPush, l_Timer->GetSeconds() - l_Start);
+		}
+	}
+
+	unsigned GetFullCount() const { return mFullCount; }
+	double GetWorstPush() const { return mWorstPush; }
+
+private:
+
+	Queue* mQueue;
+	unsigned mProducer;
+	unsigned mCount;
+	unsigned mFullCount;	// Pushes that found the queue full
+	double mWorstPush;		// Longest single successful push, in seconds
+};
+
+/**
+ * ConsumerThread
+ * Pops until every producer's items have arrived, checking each producer's items come in order
+ */
+template <typename Queue>
+class ConsumerThread : public QueueThread
+{
+public:
+
+	ConsumerThread(Queue* in_Queue, unsigned in_ProducerCount, unsigned in_Count)
+		: mQueue(in_Queue), mNextSequence(in_ProducerCount, 0), mRemaining(in_ProducerCount * in_Count), mErrors(0) {}
+
+	virtual void Run()
+	{
+		QueueItem l_Item;
+		while(mRemaining > 0)
+		{
+			if(!mQueue->TryPop(l_Item))
+			{
+				continue;
+			}
+
+			if(l_Item.Producer >= mNextSequence.size() || l_Item.Sequence != mNextSequence[l_Item.Producer])
+			{
+				mErrors++;
+			}
+			else
+			{
+				mNextSequence[l_Item.Producer]++;
+			}
+			mRemaining--;
+		}
+	}
+
+	unsigned GetErrors() const { return mErrors; }
+
+private:
+
+	Queue* mQueue;
+	vector<unsigned> mNextSequence;	// Next sequence number expected from each producer
+	unsigned mRemaining;
+	unsigned mErrors;
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * RunQueueTest
+ * Push in_Count items from each of in_ProducerCount threads through a queue to one consumer and print the results
+ */
+template <typename Queue>
+static void RunQueueTest(const char* in_Name, unsigned in_ProducerCount, unsigned in_Count, unsigned in_Capacity)
+{
+	Queue l_Queue(in_Capacity);
+	ConsumerThread<Queue> l_Consumer(&l_Queue, in_ProducerCount, in_Count);
+	vector< ProducerThread<Queue>* > l_Producers;
+	for(unsigned i = 0; i < in_ProducerCount; i++)
+	{
+		l_Producers.push_back(new ProducerThread<Queue>(&l_Queue, i, in_Count));
+	}
+
+	// Create every thread suspended so they all start together
+	l_Consumer.Start(true);
+	for(unsigned i = 0; i < in_ProducerCount; i++)
+	{
+		l_Producers[i]->Start(true);
+	}
+
+	double l_Start = Timer::Instance()->GetSeconds();
+	l_Consumer.Resume();
+	for(unsigned i = 0; i < in_ProducerCount; i++)
+	{
+		l_Producers[i]->Resume();
+	}
+
+	unsigned l_FullCount = 0;
+	for(unsigned i = 0; i < in_ProducerCount; i++)
+	{
+		l_Producers[i]->Wait();
+		l_FullCount += l_Producers[i]->GetFullCount();
+	}
+	l_Consumer.Wait();
+	double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+
+	double l_Items = (double)in_ProducerCount * in_Count;
+	cout << "  " << left << setw(10) << in_Name << right << setw(3) << in_ProducerCount << (in_ProducerCount == 1 ? " producer : " : " producers: ")
+		 << fixed << setprecision(2) << setw(7) << l_Items / l_Time / 1000000.0 << " Mops/s"
+		 << setprecision(3) << setw(8) << l_Queue.GetRetryCount() / l_Items << " retries/push"
+		 << setprecision(3) << setw(8) << l_FullCount / l_Items << " full/push"
+		 << setprecision(1) << setw(9) << l_Producers[0]->GetWorstPush() * 1000000.0 << " us worst push";
+	if(l_Consumer.GetErrors())
+	{
+		cout << "  (" << l_Consumer.GetErrors() << " out of order)";
+	}
+	cout << endl;
+
+	for(unsigned i = 0; i < in_ProducerCount; i++)
+	{
+		delete l_Producers[i];
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunQueueBenchmark(int argc, char* argv[])
+{
+	unsigned l_Count = argc > 0 ? max(1, atoi(argv[0])) : 1000000;
+	unsigned l_MaxProducers = argc > 1 ? max(1, atoi(argv[1])) : GetProcessorCount() * 2;
+
+	// The capacities the TextureLoader uses
+	const unsigned l_Capacity = 4096;
+
+	cout << "Request path, " << l_Count << " items per producer, ring capacity " << l_Capacity << endl;
+	for(unsigned l_Producers = 1; l_Producers <= l_MaxProducers; l_Producers *= 2)
+	{
+		RunQueueTest<MpscRing<QueueItem> >("MPSC ring", l_Producers, l_Count, l_Capacity);
+		RunQueueTest<LockedQueue>("Locked", l_Producers, l_Count, l_Capacity);
+	}
+	cout << endl;
+
+	cout << "Completion path, " << l_Count << " items" << endl;
+	RunQueueTest<SpscRingAdapter>("SPSC ring", 1, l_Count, l_Capacity);
+	RunQueueTest<LockedQueue>("Locked", 1, l_Count, l_Capacity);
+	cout << endl;
+
+	return 0;
+}
@@ -0,0 +1,219 @@
+/**
+ * @file ReadBenchmark.cpp
+ * @brief Container read throughput benchmark
+ *
+ * Reads every thumbnail out of its container, in a shuffled order like the scattered requests of a viewport being
+ * filled. First one blocking read at a time, opening the container for each read as the TextureLoader used to,
+ * then through each AsyncFileReader backend with more and more reads in flight. Reports reads/s and MB/s.
+ * The containers are read into memory first to split them into thumbnails, so unless the file cache is flushed
+ * between runs this measures the cached read path. Run it against a network share or after a reboot for the disk
+ */
+
+#include "Benchmark.h"
+#include "AsyncFileReader.h"
+
+/**
+ * BlobLocation
+ * Where a thumbnail is in the containers
+ */
+struct BlobLocation
+{
+	const char* Filename;
+	unsigned Offset;
+	unsigned Size;
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GetBlobLocations
+ * Find each thumbnail's container and offset, in a shuffled order that is the same on every run
+ */
+static void GetBlobLocations(const ThumbnailSet& in_Set, vector<BlobLocation>& out_Locations, unsigned& out_MaxSize)
+{
+	out_Locations.clear();
+	out_MaxSize = 0;
+	for(unsigned i = 0; i < in_Set.Blobs.size(); i++)
+	{
+		unsigned l_Container = (unsigned)(upper_bound(in_Set.ContainerStarts.begin(), in_Set.ContainerStarts.end(), in_Set.Blobs[i].first) -
+										  in_Set.ContainerStarts.begin()) - 1;
+
+		BlobLocation l_Location;
+		l_Location.Filename = in_Set.ContainerFilenames[l_Container].c_str();
+		l_Location.Offset = in_Set.Blobs[i].first - in_Set.ContainerStarts[l_Container];
+		l_Location.Size = in_Set.Blobs[i].second;
+		out_Locations.push_back(l_Location);
+		out_MaxSize = max(out_MaxSize, l_Location.Size);
+	}
+
+	srand(1);
+	for(unsigned i = (unsigned)out_Locations.size(); i > 1; i--)
+	{
+		swap(out_Locations[i - 1], out_Locations[((unsigned)rand() * (RAND_MAX + 1u) + (unsigned)rand()) % i]);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeBlockingReads
+ * Read every thumbnail with a blocking read, opening the container each time. Returns the time in seconds
+ */
+static double TimeBlockingReads(const vector<BlobLocation>& in_Locations, unsigned in_MaxSize, unsigned& out_Failures)
+{
+	vector<unsigned char> l_Buffer(in_MaxSize);
+	out_Failures = 0;
+
+	double l_Start = Timer::Instance()->GetSeconds();
+	for(unsigned i = 0; i < in_Locations.size(); i++)
+	{
+		const BlobLocation& l_Location = in_Locations[i];
+		HANDLE l_File = CreateFileA(l_Location.Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		DWORD l_BytesRead = 0;
+		if(l_File == INVALID_HANDLE_VALUE ||
+		   SetFilePointer(l_File, l_Location.Offset, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+		   !ReadFile(l_File, &l_Buffer[0], l_Location.Size, &l_BytesRead, NULL) || l_BytesRead != l_Location.Size)
+		{
+			out_Failures++;
+		}
+		if(l_File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(l_File);
+		}
+	}
+	return Timer::Instance()->GetSeconds() - l_Start;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * TimeAsyncReads
+ * Read every thumbnail through an AsyncFileReader, keeping as many reads in flight as it allows. Returns the time in seconds
+ */
+static double TimeAsyncReads(const vector<BlobLocation>& in_Locations, unsigned in_MaxSize, unsigned in_ReadsInFlight, bool in_UseThreadPool,
+							 string& out_Name, unsigned& out_Failures)
+{
+	HANDLE l_Event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	AsyncFileReader* l_Reader = AsyncFileReader::Create(in_ReadsInFlight, l_Event, in_UseThreadPool);
+	out_Name = l_Reader->GetName();
+	out_Failures = 0;
+
+	// A buffer for each read in flight
+	vector<unsigned char> l_Buffers(in_MaxSize * in_ReadsInFlight);
+	vector<unsigned> l_FreeBuffers;
+	for(unsigned i = 0; i < in_ReadsInFlight; i++)
+	{
+		l_FreeBuffers.push_back(i);
+	}
+
+	double l_Start = Timer::Instance()->GetSeconds();
+	unsigned l_Next = 0;
+	unsigned l_Done = 0;
+	while(l_Done < in_Locations.size())
+	{
+		while(l_Next < in_Locations.size() && !l_FreeBuffers.empty())
+		{
+			unsigned l_Buffer = l_FreeBuffers.back();
+			l_FreeBuffers.pop_back();
+			const BlobLocation& l_Location = in_Locations[l_Next++];
+			l_Reader->Submit(l_Location.Filename, l_Location.Offset, l_Location.Size, &l_Buffers[l_Buffer * in_MaxSize], (void*)(size_t)l_Buffer);
+		}
+
+		void* l_UserData;
+		bool l_Success;
+		if(l_Reader->PollCompletion(l_UserData, l_Success))
+		{
+			l_FreeBuffers.push_back((unsigned)(size_t)l_UserData);
+			l_Done++;
+			if(!l_Success)
+			{
+				out_Failures++;
+			}
+		}
+		else
+		{
+			WaitForSingleObject(l_Event, INFINITE);
+		}
+	}
+	double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+
+	delete l_Reader;
+	CloseHandle(l_Event);
+	return l_Time;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * PrintReadResult
+ * Print one line of the results table
+ */
+static void PrintReadResult(const vector<BlobLocation>& in_Locations, const string& in_Name, unsigned in_ReadsInFlight, double in_Seconds,
+							unsigned in_Failures, double in_BaselineSeconds)
+{
+	double l_Bytes = 0.0;
+	for(unsigned i = 0; i < in_Locations.size(); i++)
+	{
+		l_Bytes += in_Locations[i].Size;
+	}
+
+	cout << "  " << left << setw(16) << in_Name << right << setw(3) << in_ReadsInFlight << " in flight: "
+		 << fixed << setprecision(0) << setw(8) << in_Locations.size() / in_Seconds << " reads/s"
+		 << setprecision(1) << setw(8) << l_Bytes / in_Seconds / (1024.0 * 1024.0) << " MB/s"
+		 << setprecision(2) << setw(7) << in_BaselineSeconds / in_Seconds << "x";
+	if(in_Failures)
+	{
+		cout << "  (" << in_Failures << " failed)";
+	}
+	cout << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunReadBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	unsigned l_MaxInFlight = argc > 1 ? max(1, atoi(argv[1])) : 32;
+
+	const char* l_SetNames[] = { "thumbnails64", "thumbnails256" };
+	bool l_AnyFound = false;
+
+	for(int s = 0; s < 2; s++)
+	{
+		ThumbnailSet l_Set;
+		if(!LoadThumbnailSet(l_DataDirectory, l_SetNames[s], l_Set))
+		{
+			cout << l_SetNames[s] << ": no containers found, skipped" << endl << endl;
+			continue;
+		}
+		l_AnyFound = true;
+
+		vector<BlobLocation> l_Locations;
+		unsigned l_MaxSize;
+		GetBlobLocations(l_Set, l_Locations, l_MaxSize);
+		cout << l_Set.Name << ": " << l_Locations.size() << " reads from " << l_Set.ContainerCount << " containers, shuffled" << endl;
+
+		// The speedups are relative to a blocking read at a time
+		unsigned l_Failures = 0;
+		double l_BlockingTime = TimeBlockingReads(l_Locations, l_MaxSize, l_Failures);
+		PrintReadResult(l_Locations, "Blocking", 1, l_BlockingTime, l_Failures, l_BlockingTime);
+
+		for(int l_UseThreadPool = 1; l_UseThreadPool >= 0; l_UseThreadPool--)
+		{
+			for(unsigned l_InFlight = 1; l_InFlight <= l_MaxInFlight; l_InFlight *= 2)
+			{
+				string l_Name;
+				double l_Time = TimeAsyncReads(l_Locations, l_MaxSize, l_InFlight, l_UseThreadPool != 0, l_Name, l_Failures);
+				PrintReadResult(l_Locations, l_Name, l_InFlight, l_Time, l_Failures, l_BlockingTime);
+			}
+		}
+		cout << endl;
+	}
+
+	if(!l_AnyFound)
+	{
+		cout << "No thumbnail containers found in '" << l_DataDirectory << "'" << endl;
+		return 1;
+	}
+	return 0;
+}
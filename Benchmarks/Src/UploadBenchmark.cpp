@@ -0,0 +1,322 @@
+/**
+ * @file UploadBenchmark.cpp
+ * @brief Texture upload format benchmark
+ *
+ * Decodes the thumbnails in the 64px and 256px containers to RGB, padded RGBA and RGB565, timing the decode to each
+ * layout, then times uploading them into textures of the matching sized internal format with glTexSubImage2D, the
+ * way the pooled textures are filled. The upload runs on whatever OpenGL driver the hidden window gets, so dropping
+ * Mesa's opengl32.dll next to the executable measures llvmpipe
+ */
+
+#include "Benchmark.h"
+#include "JpegDecoder.h"
+#include <GL/GL.h>
+
+// OpenGL 1.2 packed pixels and the ARB_ES2_compatibility 5:6:5 internal format, which the Windows headers stop short of
+#ifndef GL_UNSIGNED_SHORT_5_6_5
+	#define GL_UNSIGNED_SHORT_5_6_5 0x8363
+#endif // GL_UNSIGNED_SHORT_5_6_5
+#ifndef GL_RGB565
+	#define GL_RGB565 0x8D62
+#endif // GL_RGB565
+
+/**
+ * UploadFormat
+ * A decoded layout and the OpenGL formats it goes up with, as OpenGL::CreateTexture uses them
+ */
+struct UploadFormat
+{
+	const char* Name;
+	TextureFormat Format;
+	GLint InternalFormat;
+	GLenum PixelFormat;
+	GLenum PixelType;
+};
+
+static const UploadFormat s_Formats[] =
+{
+	{ "RGB", TextureFormat_RGB, GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE },
+	{ "RGBA", TextureFormat_RGBA, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+	{ "RGB565", TextureFormat_RGB565, GL_RGB565, GL_RGB, GL_UNSIGNED_SHORT_5_6_5 },
+};
+
+static const int s_FormatCount = sizeof(s_Formats) / sizeof(s_Formats[0]);
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * GLContext
+ * A hidden window with an OpenGL context current on the calling thread
+ */
+class GLContext
+{
+public:
+
+	GLContext();
+	~GLContext();
+
+	/**
+	 * IsValid
+	 * Was the context created and made current?
+	 */
+	bool IsValid() const { return mValid; }
+
+private:
+
+	bool mValid;
+
+#ifdef WIN32
+	HWND mWindow;
+	HDC mDeviceContext;
+	HGLRC mContext;
+#endif // WIN32
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+GLContext::GLContext()
+: mValid(false)
+{
+#ifdef WIN32
+	WNDCLASSA l_Class;
+	memset(&l_Class, 0, sizeof(l_Class));
+	l_Class.style = CS_OWNDC;
+	l_Class.lpfnWndProc = DefWindowProcA;
+	l_Class.hInstance = GetModuleHandle(NULL);
+	l_Class.lpszClassName = "UploadBenchmark";
+	RegisterClassA(&l_Class);
+
+	mWindow = CreateWindowA("UploadBenchmark", "UploadBenchmark", WS_OVERLAPPEDWINDOW, 0, 0, 64, 64, NULL, NULL, l_Class.hInstance, NULL);
+	mDeviceContext = mWindow ? GetDC(mWindow) : NULL;
+	mContext = NULL;
+	if(!mDeviceContext)
+	{
+		return;
+	}
+
+	PIXELFORMATDESCRIPTOR l_Descriptor;
+	memset(&l_Descriptor, 0, sizeof(l_Descriptor));
+	l_Descriptor.nSize = sizeof(l_Descriptor);
+	l_Descriptor.nVersion = 1;
+	l_Descriptor.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+	l_Descriptor.iPixelType = PFD_TYPE_RGBA;
+	l_Descriptor.cColorBits = 32;
+	l_Descriptor.cDepthBits = 24;
+	int l_PixelFormat = ChoosePixelFormat(mDeviceContext, &l_Descriptor);
+	if(!l_PixelFormat || !SetPixelFormat(mDeviceContext, l_PixelFormat, &l_Descriptor))
+	{
+		return;
+	}
+
+	mContext = wglCreateContext(mDeviceContext);
+	mValid = mContext && wglMakeCurrent(mDeviceContext, mContext);
+#else
+	#error Your platform OpenGL context creation goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+GLContext::~GLContext()
+{
+#ifdef WIN32
+	if(mContext)
+	{
+		wglMakeCurrent(NULL, NULL);
+		wglDeleteContext(mContext);
+	}
+	if(mDeviceContext)
+	{
+		ReleaseDC(mWindow, mDeviceContext);
+	}
+	if(mWindow)
+	{
+		DestroyWindow(mWindow);
+	}
+	UnregisterClassA("UploadBenchmark", GetModuleHandle(NULL));
+#else
+	#error Your platform OpenGL context destruction goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * DecodeSet
+ * Decode every thumbnail of a set to in_Format, in_Iterations times, keeping the fastest. Returns the seconds taken
+ * and leaves the images of the last pass in out_Images
+ */
+static double DecodeSet(const ThumbnailSet& in_Set, TextureFormat in_Format, unsigned in_Iterations, vector<DecodedImage*>& out_Images)
+{
+	JpegDecoder l_Decoder;
+	DecodeArena l_Arena;
+	OutputFormat l_Format(in_Format, in_Format, 0);
+	double l_Best = 0.0;
+	for(unsigned l_Iteration = 0; l_Iteration < in_Iterations; l_Iteration++)
+	{
+		for(unsigned i = 0; i < out_Images.size(); i++)
+		{
+			delete out_Images[i];
+		}
+		out_Images.clear();
+
+		double l_Start = Timer::Instance()->GetSeconds();
+		for(unsigned i = 0; i < in_Set.Blobs.size(); i++)
+		{
+			DecodedImage* l_Image = new DecodedImage();
+			l_Arena.Reset();
+			if(l_Decoder.Decode(&in_Set.Data[in_Set.Blobs[i].first], in_Set.Blobs[i].second, *l_Image, &l_Arena, l_Format) &&
+			   l_Image->Format == in_Format)
+			{
+				out_Images.push_back(l_Image);
+			}
+			else
+			{
+				delete l_Image;
+			}
+		}
+		double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+		if(l_Iteration == 0 || l_Time < l_Best)
+		{
+			l_Best = l_Time;
+		}
+	}
+	return l_Best;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * UploadImages
+ * Upload every image into a texture of its size in_Iterations times, finishing each pass, keeping the fastest.
+ * Returns the seconds taken, or a negative number if OpenGL reported an error
+ */
+static double UploadImages(const vector<DecodedImage*>& in_Images, const UploadFormat& in_Format, unsigned in_Iterations)
+{
+	// One texture per size, allocated up front like the texture pools
+	map< pair<int, int>, GLuint > l_Textures;
+	for(unsigned i = 0; i < in_Images.size(); i++)
+	{
+		pair<int, int> l_Size(in_Images[i]->Width, in_Images[i]->Height);
+		if(l_Textures.find(l_Size) == l_Textures.end())
+		{
+			GLuint l_Texture;
+			glGenTextures(1, &l_Texture);
+			glBindTexture(GL_TEXTURE_2D, l_Texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, in_Format.InternalFormat, l_Size.first, l_Size.second, 0, in_Format.PixelFormat, in_Format.PixelType, NULL);
+			l_Textures[l_Size] = l_Texture;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glFinish();
+
+	double l_Best = 0.0;
+	for(unsigned l_Iteration = 0; l_Iteration < in_Iterations; l_Iteration++)
+	{
+		double l_Start = Timer::Instance()->GetSeconds();
+		for(unsigned i = 0; i < in_Images.size(); i++)
+		{
+			const DecodedImage& l_Image = *in_Images[i];
+			glBindTexture(GL_TEXTURE_2D, l_Textures[make_pair(l_Image.Width, l_Image.Height)]);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, l_Image.Width, l_Image.Height, in_Format.PixelFormat, in_Format.PixelType, &l_Image.Pixels[0]);
+		}
+		glFinish();
+		double l_Time = Timer::Instance()->GetSeconds() - l_Start;
+		if(l_Iteration == 0 || l_Time < l_Best)
+		{
+			l_Best = l_Time;
+		}
+	}
+
+	bool l_Failed = glGetError() != GL_NO_ERROR;
+	for(map< pair<int, int>, GLuint >::iterator It = l_Textures.begin(); It != l_Textures.end(); ++It)
+	{
+		glDeleteTextures(1, &It->second);
+	}
+	return l_Failed ? -1.0 : l_Best;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+int RunUploadBenchmark(int argc, char* argv[])
+{
+	string l_DataDirectory = argc > 0 ? argv[0] : DATA_DIRECTORY;
+	unsigned l_Iterations = argc > 1 ? max(1, atoi(argv[1])) : 3;
+
+	GLContext l_Context;
+	if(l_Context.IsValid())
+	{
+		cout << "OpenGL: " << (const char*)glGetString(GL_RENDERER) << ", " << (const char*)glGetString(GL_VERSION) << endl << endl;
+	}
+	else
+	{
+		cout << "No OpenGL context, measuring the decode only" << endl << endl;
+	}
+
+	const char* l_SetNames[] = { "thumbnails64", "thumbnails256" };
+	bool l_AnyFound = false;
+	unsigned l_Failures = 0;
+
+	for(int s = 0; s < 2; s++)
+	{
+		ThumbnailSet l_Set;
+		if(!LoadThumbnailSet(l_DataDirectory, l_SetNames[s], l_Set))
+		{
+			cout << l_SetNames[s] << ": no containers found, skipped" << endl << endl;
+			continue;
+		}
+		l_AnyFound = true;
+
+		cout << l_Set.Name << ": " << l_Set.Blobs.size() << " thumbnails, best of " << l_Iterations << endl;
+		for(int f = 0; f < s_FormatCount; f++)
+		{
+			const UploadFormat& l_Format = s_Formats[f];
+			vector<DecodedImage*> l_Images;
+			double l_DecodeTime = DecodeSet(l_Set, l_Format.Format, l_Iterations, l_Images);
+
+			double l_Pixels = 0.0;
+			double l_Bytes = 0.0;
+			for(unsigned i = 0; i < l_Images.size(); i++)
+			{
+				l_Pixels += l_Images[i]->Width * l_Images[i]->Height;
+				l_Bytes += l_Images[i]->Pixels.size();
+			}
+
+			cout << "  " << left << setw(7) << l_Format.Name << right << fixed
+				 << setprecision(1) << setw(7) << l_Bytes / (1024.0 * 1024.0) << " MB"
+				 << "  decode" << setw(7) << l_Pixels / 1000000.0 / l_DecodeTime << " MP/s";
+			if(l_Context.IsValid() && !l_Images.empty())
+			{
+				double l_UploadTime = UploadImages(l_Images, l_Format, l_Iterations);
+				if(l_UploadTime < 0.0)
+				{
+					cout << "  upload FAILED";
+					l_Failures++;
+				}
+				else
+				{
+					cout << "  upload" << setw(8) << l_Bytes / (1024.0 * 1024.0) / l_UploadTime << " MB/s"
+						 << setprecision(2) << setw(8) << l_UploadTime * 1000000.0 / l_Images.size() << " us/texture";
+				}
+			}
+			cout << endl;
+
+			for(unsigned i = 0; i < l_Images.size(); i++)
+			{
+				delete l_Images[i];
+			}
+		}
+		cout << endl;
+	}
+
+	if(!l_AnyFound)
+	{
+		cout << "No thumbnail containers found in '" << l_DataDirectory << "'" << endl;
+	}
+	if(l_Failures > 0)
+	{
+		cout << l_Failures << " uploads failed" << endl;
+		return 1;
+	}
+	return 0;
+}
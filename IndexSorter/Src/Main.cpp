@@ -5,11 +5,35 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <vector>
 #include <map>
+#include <set>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef WIN32
+	#include <direct.h>
+#endif // WIN32
 using namespace std;
 
+#include "IL/il.h"
+#include "ContainerFormat.h"
+
+/**
+ * PREVIEW_SIZE
+ * Width and height of the micro-thumbnail written to the preview file for each image
+ */
+#define PREVIEW_SIZE 8
+
+/**
+ * DATA_DIRECTORY
+ * Location of the photo browser data, relative to the IndexSorter working directory
+ */
+#define DATA_DIRECTORY "../3DPhotoBrowser/Binaries/data"
+
 /**
  * IndexFileImageData
  * The format of each image in the index file
@@ -58,15 +82,109 @@ struct IndexFileImageData
 bool ParseIndexFile(const char* in_File);
 bool WriteSortedIndexFile(const char* in_File);
 bool WriteIndexCountFile(const char* in_File);
+bool WritePreviewFile(const char* in_File);
+bool MakePreview(const IndexFileImageData& in_Data, unsigned char* out_Pixels);
+bool ConvertContainers(unsigned in_Alignment, vector<pair<string, string>>& out_NewFiles, vector<string>& out_OldFiles);
+bool RepackContainers(unsigned in_ContainerBytes, unsigned in_Alignment, bool in_LodChains, vector<pair<string, string>>& out_NewFiles, vector<string>& out_OldFiles);
+bool WriteContainerFile(const string& in_Filename, const vector<unsigned char>& in_Data);
+bool ReplaceFiles(const vector<pair<string, string>>& in_NewFiles, const vector<string>& in_OldFiles, bool& out_Unchanged);
+void RemoveTempFiles(const vector<pair<string, string>>& in_NewFiles);
+double GetContainersPerWindow(unsigned in_SizeIndex, unsigned in_Window);
+string GetContainerFilename(unsigned in_ContainerIndex);
 
 vector<IndexFileImageData> gImageData;
 map<short, vector<unsigned>> gDayCounts;
 
+//-----------------------------------------------------------------------------------------------------------------------------
+
 int main(int argc, char* argv[])
 {
+	// --container-v2 [alignment] converts the thumbnail containers to version 2 before the index is written
+	// --repack [container KB] rewrites the thumbnail containers in date order before the index is written, as version 2
+	// if --container-v2 is also given. Without a size the containers of each thumbnail size stay about the same size
+	// --lod-chains repacks like --repack, but keeps every size of an image together, smallest first, in data/thumbnails
+	bool l_ConvertContainers = false;
+	bool l_RepackContainers = false;
+	bool l_LodChains = false;
+	unsigned l_Alignment = CONTAINER_PAGE_SIZE;
+	unsigned l_ContainerBytes = 0;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--container-v2") == 0)
+		{
+			l_ConvertContainers = true;
+			if(i + 1 < argc && atoi(argv[i + 1]) > 0)
+			{
+				l_Alignment = (unsigned)atoi(argv[++i]);
+			}
+		}
+		else if(strcmp(argv[i], "--repack") == 0 || strcmp(argv[i], "--lod-chains") == 0)
+		{
+			l_RepackContainers = true;
+			l_LodChains = l_LodChains || strcmp(argv[i], "--lod-chains") == 0;
+			if(i + 1 < argc && atoi(argv[i + 1]) > 0)
+			{
+				l_ContainerBytes = (unsigned)atoi(argv[++i]) * 1024;
+			}
+		}
+	}
+	if(l_Alignment & (l_Alignment - 1))
+	{
+		cerr << "The container alignment must be a power of two" << endl;
+		return 1;
+	}
+
 	cout << "Sorting..." << endl;
 	const char* l_IndexFileName = "../3DPhotoBrowser/Binaries/data/photo_index.dat";
-	if( ParseIndexFile(l_IndexFileName) && WriteSortedIndexFile(l_IndexFileName) )
+	bool l_Parsed = ParseIndexFile(l_IndexFileName);
+
+	// Converted and repacked containers are written under temporary names, nothing is replaced until the index is too
+	vector<pair<string, string>> l_NewFiles;	// Temporary file and the file it replaces
+	vector<string> l_OldFiles;					// Containers that are replaced or no longer used
+	if( l_Parsed && l_RepackContainers )
+	{
+		cout << "Repacking containers..." << endl;
+		if( !RepackContainers(l_ContainerBytes, l_ConvertContainers ? l_Alignment : 0, l_LodChains, l_NewFiles, l_OldFiles) )
+		{
+			RemoveTempFiles(l_NewFiles);
+			cerr << "Failed. The index and containers are unchanged." << endl;
+			return 1;
+		}
+	}
+	else if( l_Parsed && l_ConvertContainers )
+	{
+		cout << "Converting containers..." << endl;
+		if( !ConvertContainers(l_Alignment, l_NewFiles, l_OldFiles) )
+		{
+			RemoveTempFiles(l_NewFiles);
+			cerr << "Failed. The index and containers are unchanged." << endl;
+			return 1;
+		}
+	}
+
+	// The index points into the new containers, so it goes in with them or not at all
+	if( l_Parsed && !l_NewFiles.empty() )
+	{
+		string l_TempIndexFileName = string(l_IndexFileName) + ".new";
+		l_NewFiles.push_back(make_pair(l_TempIndexFileName, string(l_IndexFileName)));
+
+		bool l_Unchanged = true;
+		if( !WriteSortedIndexFile(l_TempIndexFileName.c_str()) || !ReplaceFiles(l_NewFiles, l_OldFiles, l_Unchanged) )
+		{
+			RemoveTempFiles(l_NewFiles);
+			if( l_Unchanged )
+			{
+				cerr << "Failed. The index and containers are unchanged." << endl;
+			}
+			else
+			{
+				cerr << "Failed. The files that couldn't be restored are left with a '.old' extension." << endl;
+			}
+			return 1;
+		}
+		cout << "Complete. Wrote '" << l_IndexFileName << "'" << endl;
+	}
+	else if( l_Parsed && WriteSortedIndexFile(l_IndexFileName) )
 	{
 		cout << "Complete. Wrote '" << l_IndexFileName << "'" << endl;
 	}
@@ -86,11 +204,24 @@ int main(int argc, char* argv[])
 		cerr << "Failed." << endl;
 	}
 
+	cout << "Generating previews..." << endl;
+	const char* l_PreviewFileName = "../3DPhotoBrowser/Binaries/data/photo_index_previews.dat";
+	if( WritePreviewFile(l_PreviewFileName) )
+	{
+		cout << "Complete. Wrote '" << l_PreviewFileName << "'" << endl;
+	}
+	else
+	{
+		cerr << "Failed." << endl;
+	}
+
 	cout << "Press enter to continue..." << endl;
 	cin.ignore(0x7FFFFFFF, '\n');
 	return 0;
 }
 
+//-----------------------------------------------------------------------------------------------------------------------------
+
 bool ParseIndexFile(const char* in_File)
 {
 	// Try to open the index file
@@ -127,6 +258,8 @@ bool ParseIndexFile(const char* in_File)
 	return true;
 }
 
+//-----------------------------------------------------------------------------------------------------------------------------
+
 bool WriteSortedIndexFile(const char* in_File)
 {
 	// Sort image data in ascending order
@@ -154,9 +287,16 @@ bool WriteSortedIndexFile(const char* in_File)
 	}
 
 	l_File.close();
+	if(l_File.fail())
+	{
+		cerr << "Failed to write index file" << endl;
+		return false;
+	}
 	return true;
 }
 
+//-----------------------------------------------------------------------------------------------------------------------------
+
 bool WriteIndexCountFile(const char* in_File)
 {
 	// Try to open the file
@@ -191,4 +331,645 @@ bool WriteIndexCountFile(const char* in_File)
 
 	l_File.close();
 	return true;
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool WritePreviewFile(const char* in_File)
+{
+	// Try to open the file
+	ofstream l_File;
+	l_File.open(in_File, ios::binary | ios::out);
+	if(l_File.fail())
+	{
+		cerr << "Failed to open preview file for writing" << endl;
+		return false;
+	}
+
+	// Write the number of images, followed by the preview size
+	// The browser ignores the file if the image count doesn't match the index file
+	unsigned l_ImageCount = gImageData.size();
+	unsigned l_PreviewSize = PREVIEW_SIZE;
+	l_File.write((char*)&l_ImageCount, sizeof(l_ImageCount));
+	l_File.write((char*)&l_PreviewSize, sizeof(l_PreviewSize));
+
+	ilInit();
+
+	// For each image, in the same (sorted) order as the index file
+	unsigned l_Missing = 0;
+	unsigned char l_Preview[PREVIEW_SIZE * PREVIEW_SIZE * 3];
+	for(unsigned i = 0; i < l_ImageCount; i++)
+	{
+		IndexFileImageData& l_Data = gImageData[i];
+
+		// If the thumbnail can't be read, the best we can do is the average color
+		if(!MakePreview(l_Data, l_Preview))
+		{
+			for(unsigned p = 0; p < PREVIEW_SIZE * PREVIEW_SIZE; p++)
+			{
+				l_Preview[p * 3 + 0] = l_Data.AverageRed;
+				l_Preview[p * 3 + 1] = l_Data.AverageGreen;
+				l_Preview[p * 3 + 2] = l_Data.AverageBlue;
+			}
+			l_Missing++;
+		}
+
+		l_File.write((char*)l_Preview, sizeof(l_Preview));
+	}
+
+	ilShutDown();
+
+	if(l_Missing > 0)
+	{
+		cerr << l_Missing << " image(s) had no readable thumbnail, used the average color instead" << endl;
+	}
+
+	l_File.close();
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool MakePreview(const IndexFileImageData& in_Data, unsigned char* out_Pixels)
+{
+	// Find the smallest thumbnail. The lower 3 bits of the container index are the thumbnail size index,
+	// beginning at 1024x1024 for index 0 and halving each time the index increases
+	int l_Thumbnail = -1;
+	unsigned l_SizeIndex = 0;
+	for(int i = 0; i < 6; i++)
+	{
+		unsigned l_Index = in_Data.Thumbnails[i].ThumbContainerIndex & 0x07;
+		if(in_Data.Thumbnails[i].ThumbImageSize > 0 && (l_Thumbnail < 0 || l_Index > l_SizeIndex))
+		{
+			l_Thumbnail = i;
+			l_SizeIndex = l_Index;
+		}
+	}
+
+	if(l_Thumbnail < 0)
+	{
+		return false;
+	}
+
+	// Read the thumbnail out of its container
+	ifstream l_File;
+	l_File.open(GetContainerFilename(in_Data.Thumbnails[l_Thumbnail].ThumbContainerIndex).c_str(), ios::binary | ios::in);
+	if(l_File.fail())
+	{
+		return false;
+	}
+
+	vector<char> l_Blob(in_Data.Thumbnails[l_Thumbnail].ThumbImageSize);
+	l_File.seekg(in_Data.Thumbnails[l_Thumbnail].ThumbFileOffset);
+	l_File.read(&l_Blob[0], l_Blob.size());
+	l_File.close();
+
+	// Decode it
+	bool l_Success = false;
+	unsigned l_ImageHandle;
+	ilGenImages(1, &l_ImageHandle);
+	ilBindImage(l_ImageHandle);
+	if(ilLoadL(IL_TYPE_UNKNOWN, &l_Blob[0], l_Blob.size()) && ilConvertImage(IL_RGB, IL_UNSIGNED_BYTE))
+	{
+		int l_Width = ilGetInteger(IL_IMAGE_WIDTH);
+		int l_Height = ilGetInteger(IL_IMAGE_HEIGHT);
+		const unsigned char* l_Pixels = ilGetData();
+
+		// Box filter the thumbnail down to the preview size. Rows are kept in the order DevIL decodes them,
+		// which is the order the browser uploads thumbnails in
+		for(int y = 0; y < PREVIEW_SIZE; y++)
+		{
+			int l_MinY = y * l_Height / PREVIEW_SIZE;
+			int l_MaxY = max(l_MinY + 1, (y + 1) * l_Height / PREVIEW_SIZE);
+
+			for(int x = 0; x < PREVIEW_SIZE; x++)
+			{
+				int l_MinX = x * l_Width / PREVIEW_SIZE;
+				int l_MaxX = max(l_MinX + 1, (x + 1) * l_Width / PREVIEW_SIZE);
+
+				unsigned l_Sum[3] = { 0, 0, 0 };
+				for(int sy = l_MinY; sy < l_MaxY; sy++)
+				{
+					for(int sx = l_MinX; sx < l_MaxX; sx++)
+					{
+						const unsigned char* l_Source = &l_Pixels[(sy * l_Width + sx) * 3];
+						l_Sum[0] += l_Source[0];
+						l_Sum[1] += l_Source[1];
+						l_Sum[2] += l_Source[2];
+					}
+				}
+
+				unsigned l_Count = (l_MaxX - l_MinX) * (l_MaxY - l_MinY);
+				unsigned char* l_Dest = &out_Pixels[(y * PREVIEW_SIZE + x) * 3];
+				l_Dest[0] = (unsigned char)(l_Sum[0] / l_Count);
+				l_Dest[1] = (unsigned char)(l_Sum[1] / l_Count);
+				l_Dest[2] = (unsigned char)(l_Sum[2] / l_Count);
+			}
+		}
+
+		l_Success = true;
+	}
+	ilDeleteImages(1, &l_ImageHandle);
+
+	return l_Success;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+string GetContainerFilename(unsigned in_ContainerIndex)
+{
+	// The lower 3 bits are the thumbnail size index, beginning at 1024x1024 for index 0, the rest is the file number.
+	// Containers of LOD chains hold every size, so they have a directory of their own
+	stringstream l_Filename;
+	l_Filename << DATA_DIRECTORY << "/thumbnails";
+	if(!(in_ContainerIndex & CONTAINER_LOD_CHAIN_FLAG))
+	{
+		l_Filename << (1024 >> (in_ContainerIndex & 0x07));
+	}
+	l_Filename << "/container" << setfill('0') << setw(5) << ((in_ContainerIndex & ~CONTAINER_LOD_CHAIN_FLAG) >> 3) << ".dat";
+	return l_Filename.str();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool ConvertContainers(unsigned in_Alignment, vector<pair<string, string>>& out_NewFiles, vector<string>& out_OldFiles)
+{
+	// Find the offset and size of every thumbnail in each container. Only thumbnails the index refers to are kept.
+	// A blob may be shared by several images
+	map<unsigned, map<unsigned, unsigned>> l_ContainerBlobs;
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		for(int t = 0; t < 6; t++)
+		{
+			if(gImageData[i].Thumbnails[t].ThumbImageSize > 0)
+			{
+				unsigned& l_BlobSize = l_ContainerBlobs[gImageData[i].Thumbnails[t].ThumbContainerIndex][gImageData[i].Thumbnails[t].ThumbFileOffset];
+				l_BlobSize = max(l_BlobSize, gImageData[i].Thumbnails[t].ThumbImageSize);
+			}
+		}
+	}
+
+	// Write the new containers alongside the old ones, the caller swaps them in along with the index
+	map<unsigned, map<unsigned, unsigned>> l_NewOffsets;	// Old offset to new offset, for each converted container
+	unsigned l_ConvertedCount = 0;
+	unsigned l_AlreadyConverted = 0;
+	unsigned long long l_OldBytes = 0;
+	unsigned long long l_NewBytes = 0;
+	for(map<unsigned, map<unsigned, unsigned>>::iterator It = l_ContainerBlobs.begin(); It != l_ContainerBlobs.end(); It++)
+	{
+		string l_Filename = GetContainerFilename(It->first);
+		ifstream l_File;
+		l_File.open(l_Filename.c_str(), ios::binary | ios::in);
+		if(l_File.fail())
+		{
+			cerr << "Failed to open container '" << l_Filename << "'" << endl;
+			return false;
+		}
+
+		l_File.seekg(0, ios::end);
+		unsigned l_Size = (unsigned)l_File.tellg();
+		l_File.seekg(0, ios::beg);
+		vector<unsigned char> l_Data(l_Size);
+		if(l_Size > 0)
+		{
+			l_File.read((char*)&l_Data[0], l_Size);
+		}
+		l_File.close();
+
+		// The index of a converted container already points at the new offsets
+		if(IsContainerV2(l_Data.empty() ? NULL : &l_Data[0], l_Size))
+		{
+			l_AlreadyConverted++;
+			continue;
+		}
+
+		// The blobs keep their order, each running from its offset to the size recorded in the index
+		vector<ContainerBlob> l_Blobs;
+		for(map<unsigned, unsigned>::iterator l_BlobIt = It->second.begin(); l_BlobIt != It->second.end(); l_BlobIt++)
+		{
+			ContainerBlob l_Blob;
+			l_Blob.SourceOffset = l_BlobIt->first;
+			l_Blob.Size = l_BlobIt->second;
+			if(l_Blob.SourceOffset > l_Size || l_Blob.Size > l_Size - l_Blob.SourceOffset)
+			{
+				cerr << "Thumbnail at offset " << l_Blob.SourceOffset << " runs past the end of '" << l_Filename << "'" << endl;
+				return false;
+			}
+			l_Blob.Data = &l_Data[l_Blob.SourceOffset];
+			l_Blobs.push_back(l_Blob);
+		}
+
+		vector<unsigned char> l_NewData;
+		vector<ContainerEntry> l_Entries;
+		WriteContainerV2(l_Blobs, in_Alignment, l_NewData, l_Entries);
+
+		string l_TempFilename = l_Filename + ".v2";
+		out_NewFiles.push_back(make_pair(l_TempFilename, l_Filename));
+		if(!WriteContainerFile(l_TempFilename, l_NewData))
+		{
+			return false;
+		}
+
+		map<unsigned, unsigned>& l_Remap = l_NewOffsets[It->first];
+		for(unsigned i = 0; i < l_Entries.size(); i++)
+		{
+			l_Remap[l_Entries[i].SourceOffset] = l_Entries[i].Offset;
+		}
+		out_OldFiles.push_back(l_Filename);
+		l_ConvertedCount++;
+		l_OldBytes += l_Size;
+		l_NewBytes += l_NewData.size();
+	}
+
+	// Point the index at the new offsets
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		for(int t = 0; t < 6; t++)
+		{
+			map<unsigned, map<unsigned, unsigned>>::iterator l_Remap = l_NewOffsets.find(gImageData[i].Thumbnails[t].ThumbContainerIndex);
+			if(gImageData[i].Thumbnails[t].ThumbImageSize > 0 && l_Remap != l_NewOffsets.end())
+			{
+				gImageData[i].Thumbnails[t].ThumbFileOffset = l_Remap->second[gImageData[i].Thumbnails[t].ThumbFileOffset];
+			}
+		}
+	}
+
+	cout << "Converted " << l_ConvertedCount << " container(s) (" << l_OldBytes << " to " << l_NewBytes << " bytes), "
+		 << l_AlreadyConverted << " already converted" << endl;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool WriteContainerFile(const string& in_Filename, const vector<unsigned char>& in_Data)
+{
+	ofstream l_File;
+	l_File.open(in_Filename.c_str(), ios::binary | ios::out);
+	if(!in_Data.empty())
+	{
+		l_File.write((const char*)&in_Data[0], in_Data.size());
+	}
+	l_File.close();
+	if(l_File.fail())
+	{
+		cerr << "Failed to write container '" << in_Filename << "'" << endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+double GetContainersPerWindow(unsigned in_SizeIndex, unsigned in_Window)
+{
+	// The average number of containers holding the in_SizeIndex thumbnails of in_Window images in a row,
+	// which is about how many files loading a screen of images at that size opens
+	vector<unsigned> l_Containers;
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		for(int t = 0; t < 6; t++)
+		{
+			if(gImageData[i].Thumbnails[t].ThumbImageSize > 0 && (gImageData[i].Thumbnails[t].ThumbContainerIndex & 0x07) == in_SizeIndex)
+			{
+				l_Containers.push_back(gImageData[i].Thumbnails[t].ThumbContainerIndex);
+				break;
+			}
+		}
+	}
+	if(l_Containers.empty())
+	{
+		return 0.0;
+	}
+
+	unsigned l_Windows = 0;
+	unsigned l_Total = 0;
+	for(unsigned l_Start = 0; l_Start < l_Containers.size(); l_Start += in_Window)
+	{
+		vector<unsigned> l_Window(l_Containers.begin() + l_Start, l_Containers.begin() + min((unsigned)l_Containers.size(), l_Start + in_Window));
+		sort(l_Window.begin(), l_Window.end());
+		l_Total += unique(l_Window.begin(), l_Window.end()) - l_Window.begin();
+		l_Windows++;
+	}
+	return (double)l_Total / l_Windows;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool RepackContainers(unsigned in_ContainerBytes, unsigned in_Alignment, bool in_LodChains, vector<pair<string, string>>& out_NewFiles, vector<string>& out_OldFiles)
+{
+	// Thumbnails are written in the order the sorted index lists the images, so images that are next to each other
+	// on screen are next to each other on disk. This is the order WriteSortedIndexFile writes
+	sort(gImageData.begin(), gImageData.end());
+
+	// Containers of LOD chains go in a directory of their own
+	if(in_LodChains)
+	{
+#ifdef WIN32
+		_mkdir(DATA_DIRECTORY "/thumbnails");
+#else
+		#error Your platform directory creation goes here
+#endif // WIN32
+	}
+
+	// Each thumbnail size is repacked separately, or all together as LOD chains. A blob may be shared by several images,
+	// it is written once
+	typedef pair<unsigned, unsigned> BlobLocation;	// Container index and offset
+	const unsigned l_Window = 100;
+	map<BlobLocation, BlobLocation> l_NewLocations;
+
+	// Bytes of thumbnails of every size in each old container, which the new containers match by default
+	map<string, unsigned long long> l_OldContainerBytes;
+	set<BlobLocation> l_Counted;
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		for(int t = 0; t < 6; t++)
+		{
+			BlobLocation l_Location(gImageData[i].Thumbnails[t].ThumbContainerIndex, gImageData[i].Thumbnails[t].ThumbFileOffset);
+			if(gImageData[i].Thumbnails[t].ThumbImageSize > 0 && l_Counted.insert(l_Location).second)
+			{
+				l_OldContainerBytes[GetContainerFilename(l_Location.first)] += gImageData[i].Thumbnails[t].ThumbImageSize;
+			}
+		}
+	}
+	for(unsigned l_SizeIndex = 0; l_SizeIndex < (in_LodChains ? 1u : 8u); l_SizeIndex++)
+	{
+		// Every blob of this size in sorted order, with the largest size the index records for it.
+		// An image's LOD chain runs from its highest size index, the smallest thumbnail, down
+		vector<BlobLocation> l_Blobs;
+		map<BlobLocation, unsigned> l_BlobSizes;
+		set<string> l_OldContainers;
+		for(unsigned i = 0; i < gImageData.size(); i++)
+		{
+			vector<pair<unsigned, int>> l_Order;	// Size index and thumbnail
+			for(int t = 0; t < 6; t++)
+			{
+				l_Order.push_back(make_pair(gImageData[i].Thumbnails[t].ThumbContainerIndex & 0x07, t));
+			}
+			sort(l_Order.rbegin(), l_Order.rend());
+
+			for(int o = 0; o < 6; o++)
+			{
+				int t = l_Order[o].second;
+				if(gImageData[i].Thumbnails[t].ThumbImageSize == 0 || (!in_LodChains && (gImageData[i].Thumbnails[t].ThumbContainerIndex & 0x07) != l_SizeIndex))
+				{
+					continue;
+				}
+
+				BlobLocation l_Location(gImageData[i].Thumbnails[t].ThumbContainerIndex, gImageData[i].Thumbnails[t].ThumbFileOffset);
+				map<BlobLocation, unsigned>::iterator l_Size = l_BlobSizes.find(l_Location);
+				if(l_Size == l_BlobSizes.end())
+				{
+					l_Blobs.push_back(l_Location);
+					l_BlobSizes[l_Location] = gImageData[i].Thumbnails[t].ThumbImageSize;
+				}
+				else
+				{
+					l_Size->second = max(l_Size->second, gImageData[i].Thumbnails[t].ThumbImageSize);
+				}
+			}
+		}
+		if(l_Blobs.empty())
+		{
+			continue;
+		}
+
+		for(unsigned i = 0; i < l_Blobs.size(); i++)
+		{
+			l_OldContainers.insert(GetContainerFilename(l_Blobs[i].first));
+		}
+
+		// Version 2 containers stay version 2 with the same alignment, unless an alignment was given
+		unsigned l_Alignment = in_Alignment;
+		if(l_Alignment == 0)
+		{
+			ifstream l_File;
+			l_File.open(l_OldContainers.begin()->c_str(), ios::binary | ios::in);
+			ContainerHeader l_Header;
+			l_File.read((char*)&l_Header, sizeof(l_Header));
+			if(!l_File.fail() && IsContainerV2((const unsigned char*)&l_Header, sizeof(l_Header)))
+			{
+				l_Alignment = l_Header.Alignment;
+			}
+		}
+
+		// Without a size, the new containers are as big as the old ones were on average
+		unsigned long long l_ContainerBytes = in_ContainerBytes;
+		if(l_ContainerBytes == 0)
+		{
+			for(set<string>::iterator It = l_OldContainers.begin(); It != l_OldContainers.end(); It++)
+			{
+				l_ContainerBytes += l_OldContainerBytes[*It];
+			}
+			l_ContainerBytes = (l_ContainerBytes + l_OldContainers.size() - 1) / l_OldContainers.size();
+		}
+
+		// Copy the blobs into new containers in order, starting a new container when the next blob would overflow it.
+		// The old containers are read a blob at a time, so the file stays open while the blobs come from the same one
+		ifstream l_Source;
+		unsigned l_SourceContainer = 0;
+		bool l_SourceOpen = false;
+		vector<unsigned char> l_Data;
+		vector<ContainerBlob> l_ContainerBlobs;
+		vector<BlobLocation> l_ContainerLocations;
+		unsigned l_NewContainer = 0;
+		unsigned long long l_NewBytes = 0;
+		for(unsigned i = 0; i <= l_Blobs.size(); i++)
+		{
+			unsigned l_Size = i < l_Blobs.size() ? l_BlobSizes[l_Blobs[i]] : 0;
+			if(!l_ContainerBlobs.empty() && (i == l_Blobs.size() || l_Data.size() + l_Size > l_ContainerBytes))
+			{
+				// Write the container, blobs back to back for version 1 or through the version 2 writer
+				unsigned l_ContainerIndex = (l_NewContainer << 3) | (in_LodChains ? CONTAINER_LOD_CHAIN_FLAG : l_SizeIndex);
+				vector<unsigned char> l_File;
+				vector<ContainerEntry> l_Entries;
+				if(l_Alignment > 0)
+				{
+					for(unsigned b = 0; b < l_ContainerBlobs.size(); b++)
+					{
+						l_ContainerBlobs[b].Data = &l_Data[l_ContainerBlobs[b].SourceOffset];
+					}
+					WriteContainerV2(l_ContainerBlobs, l_Alignment, l_File, l_Entries);
+				}
+				else
+				{
+					l_File.swap(l_Data);
+				}
+
+				string l_Filename = GetContainerFilename(l_ContainerIndex);
+				out_NewFiles.push_back(make_pair(l_Filename + ".repack", l_Filename));
+				if(!WriteContainerFile(l_Filename + ".repack", l_File))
+				{
+					return false;
+				}
+
+				for(unsigned b = 0; b < l_ContainerLocations.size(); b++)
+				{
+					unsigned l_Offset = l_Alignment > 0 ? l_Entries[b].Offset : l_ContainerBlobs[b].SourceOffset;
+					l_NewLocations[l_ContainerLocations[b]] = BlobLocation(l_ContainerIndex | (l_ContainerLocations[b].first & 0x07), l_Offset);
+				}
+
+				l_NewBytes += l_File.size();
+				l_NewContainer++;
+				l_Data.clear();
+				l_ContainerBlobs.clear();
+				l_ContainerLocations.clear();
+			}
+			if(i == l_Blobs.size())
+			{
+				break;
+			}
+
+			if(!l_SourceOpen || l_SourceContainer != l_Blobs[i].first)
+			{
+				l_Source.close();
+				l_Source.clear();
+				l_Source.open(GetContainerFilename(l_Blobs[i].first).c_str(), ios::binary | ios::in);
+				l_SourceContainer = l_Blobs[i].first;
+				l_SourceOpen = true;
+			}
+
+			ContainerBlob l_Blob;
+			l_Blob.Data = NULL;
+			l_Blob.Size = l_Size;
+			l_Blob.SourceOffset = (unsigned)l_Data.size();		// Where the blob is in l_Data until the container is written
+			l_Data.resize(l_Data.size() + l_Size);
+			l_Source.seekg(l_Blobs[i].second);
+			l_Source.read((char*)&l_Data[l_Blob.SourceOffset], l_Size);
+			if(l_Source.fail())
+			{
+				cerr << "Failed to read the thumbnail at offset " << l_Blobs[i].second << " of '" << GetContainerFilename(l_Blobs[i].first) << "'" << endl;
+				return false;
+			}
+			l_ContainerBlobs.push_back(l_Blob);
+			l_ContainerLocations.push_back(l_Blobs[i]);
+		}
+
+		for(set<string>::iterator It = l_OldContainers.begin(); It != l_OldContainers.end(); It++)
+		{
+			out_OldFiles.push_back(*It);
+		}
+
+		if(in_LodChains)
+		{
+			cout << "  LOD chains: ";
+		}
+		else
+		{
+			cout << "  " << (1024 >> l_SizeIndex) << "px: ";
+		}
+		cout << l_Blobs.size() << " thumbnails, " << l_OldContainers.size() << " to "
+			 << l_NewContainer << " container(s), " << l_NewBytes << " bytes, " << (l_Alignment > 0 ? "version 2" : "version 1") << endl;
+	}
+
+	// Point the index at the new locations, then see how many containers a screen of images touches now
+	map<unsigned, double> l_OldLocality;
+	for(unsigned l_SizeIndex = 0; l_SizeIndex < 8; l_SizeIndex++)
+	{
+		l_OldLocality[l_SizeIndex] = GetContainersPerWindow(l_SizeIndex, l_Window);
+	}
+
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		for(int t = 0; t < 6; t++)
+		{
+			if(gImageData[i].Thumbnails[t].ThumbImageSize > 0)
+			{
+				BlobLocation& l_Location = l_NewLocations[BlobLocation(gImageData[i].Thumbnails[t].ThumbContainerIndex, gImageData[i].Thumbnails[t].ThumbFileOffset)];
+				gImageData[i].Thumbnails[t].ThumbContainerIndex = l_Location.first;
+				gImageData[i].Thumbnails[t].ThumbFileOffset = l_Location.second;
+			}
+		}
+	}
+
+	for(unsigned l_SizeIndex = 0; l_SizeIndex < 8; l_SizeIndex++)
+	{
+		if(l_OldLocality[l_SizeIndex] > 0.0)
+		{
+			cout << "  " << (1024 >> l_SizeIndex) << "px: " << fixed << setprecision(2) << l_OldLocality[l_SizeIndex] << " to "
+				 << GetContainersPerWindow(l_SizeIndex, l_Window) << " containers per " << l_Window << " images in a row" << endl;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool ReplaceFiles(const vector<pair<string, string>>& in_NewFiles, const vector<string>& in_OldFiles, bool& out_Unchanged)
+{
+	// Every old file, and anything else in the way of a new file, is renamed to ".old" rather than deleted,
+	// so it can be put back if a later step fails
+	set<string> l_Aside(in_OldFiles.begin(), in_OldFiles.end());
+	for(unsigned i = 0; i < in_NewFiles.size(); i++)
+	{
+		l_Aside.insert(in_NewFiles[i].second);
+	}
+
+	vector<string> l_Moved;
+	vector<string> l_Placed;
+	bool l_Success = true;
+	for(set<string>::iterator It = l_Aside.begin(); It != l_Aside.end() && l_Success; It++)
+	{
+		if(!ifstream(It->c_str(), ios::binary | ios::in).good())
+		{
+			continue;
+		}
+
+		remove((*It + ".old").c_str());
+		if(rename(It->c_str(), (*It + ".old").c_str()) != 0)
+		{
+			cerr << "Failed to move '" << *It << "' aside" << endl;
+			l_Success = false;
+			break;
+		}
+		l_Moved.push_back(*It);
+	}
+
+	// Move the new files in
+	for(unsigned i = 0; i < in_NewFiles.size() && l_Success; i++)
+	{
+		if(rename(in_NewFiles[i].first.c_str(), in_NewFiles[i].second.c_str()) != 0)
+		{
+			cerr << "Failed to replace '" << in_NewFiles[i].second << "'" << endl;
+			l_Success = false;
+			break;
+		}
+		l_Placed.push_back(in_NewFiles[i].second);
+	}
+
+	// Everything is in place, the old files can go
+	if(l_Success)
+	{
+		for(unsigned i = 0; i < l_Moved.size(); i++)
+		{
+			remove((l_Moved[i] + ".old").c_str());
+		}
+		out_Unchanged = false;
+		return true;
+	}
+
+	// Roll back: take out the new files that made it in, and put the old ones back
+	out_Unchanged = true;
+	for(unsigned i = 0; i < l_Placed.size(); i++)
+	{
+		remove(l_Placed[i].c_str());
+	}
+	for(unsigned i = 0; i < l_Moved.size(); i++)
+	{
+		if(rename((l_Moved[i] + ".old").c_str(), l_Moved[i].c_str()) != 0)
+		{
+			cerr << "Failed to restore '" << l_Moved[i] << "' from '" << l_Moved[i] << ".old'" << endl;
+			out_Unchanged = false;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void RemoveTempFiles(const vector<pair<string, string>>& in_NewFiles)
+{
+	for(unsigned i = 0; i < in_NewFiles.size(); i++)
+	{
+		remove(in_NewFiles[i].first.c_str());
+	}
+}
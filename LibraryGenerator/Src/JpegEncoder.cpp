@@ -0,0 +1,423 @@
+/**
+ * @file JpegEncoder.cpp
+ * @brief JpegEncoder implementation file
+ */
+
+#include "JpegEncoder.h"
+
+/**
+ * s_ZigZag
+ * Maps the coefficient order in the file to natural (row major) order
+ */
+static const unsigned char s_ZigZag[64] =
+{
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/**
+ * s_BaseQuantTables
+ * The example luminance and chrominance tables of the JPEG standard, annex K, in natural order. Quality 50 uses them as they are
+ */
+static const unsigned char s_BaseQuantTables[2][64] =
+{
+	{
+		16, 11, 10, 16,  24,  40,  51,  61,
+		12, 12, 14, 19,  26,  58,  60,  55,
+		14, 13, 16, 24,  40,  57,  69,  56,
+		14, 17, 22, 29,  51,  87,  80,  62,
+		18, 22, 37, 56,  68, 109, 103,  77,
+		24, 35, 55, 64,  81, 104, 113,  92,
+		49, 64, 78, 87, 103, 121, 120, 101,
+		72, 92, 95, 98, 112, 100, 103,  99
+	},
+	{
+		17, 18, 24, 47, 99, 99, 99, 99,
+		18, 21, 26, 66, 99, 99, 99, 99,
+		24, 26, 56, 99, 99, 99, 99, 99,
+		47, 66, 99, 99, 99, 99, 99, 99,
+		99, 99, 99, 99, 99, 99, 99, 99,
+		99, 99, 99, 99, 99, 99, 99, 99,
+		99, 99, 99, 99, 99, 99, 99, 99,
+		99, 99, 99, 99, 99, 99, 99, 99
+	}
+};
+
+/**
+ * s_DCCounts / s_DCSymbols / s_ACCounts / s_ACSymbols
+ * The standard huffman tables of annex K, luminance then chrominance, as DHT code counts and symbols
+ */
+static const unsigned char s_DCCounts[2][16] =
+{
+	{ 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }
+};
+
+static const unsigned char s_DCSymbols[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const unsigned char s_ACCounts[2][16] =
+{
+	{ 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D },
+	{ 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 }
+};
+
+static const unsigned char s_ACSymbols[2][162] =
+{
+	{
+		0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+		0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+		0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+		0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+		0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+		0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+		0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+		0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+		0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+		0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+		0xF9, 0xFA
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+		0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+		0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+		0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+		0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+		0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+		0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+		0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+		0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+		0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+		0xF9, 0xFA
+	}
+};
+
+/**
+ * s_AanScale
+ * Row and column scale factors of the AAN DCT, which are folded into the quantization divisors
+ */
+static const float s_AanScale[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// Entropy coding
+
+/**
+ * BitWriter
+ * Appends huffman coded bits to the output, stuffing a zero byte after every 0xFF
+ */
+struct BitWriter
+{
+	BitWriter(vector<unsigned char>& io_Data) : Data(io_Data), Buffer(0), Count(0) {}
+
+	void Put(unsigned in_Bits, int in_Length)
+	{
+		Buffer = (Buffer << in_Length) | (in_Bits & ((1 << in_Length) - 1));
+		Count += in_Length;
+		while(Count >= 8)
+		{
+			unsigned char l_Byte = (unsigned char)(Buffer >> (Count - 8));
+			Data.push_back(l_Byte);
+			if(l_Byte == 0xFF)
+			{
+				Data.push_back(0);
+			}
+			Count -= 8;
+		}
+	}
+
+	/**
+	 * Flush
+	 * Pad the last byte with one bits
+	 */
+	void Flush()
+	{
+		if(Count > 0)
+		{
+			Put(0x7F, 8 - Count);
+		}
+	}
+
+	vector<unsigned char>& Data;
+	unsigned Buffer;
+	int Count;
+};
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * ForwardDct
+ * The AAN floating point DCT of a block, in place. The output is scaled by s_AanScale for each row and column, and by 8
+ */
+static void ForwardDct(float* io_Block)
+{
+	// Rows, then columns
+	for(int l_Pass = 0; l_Pass < 2; l_Pass++)
+	{
+		const int l_Step = l_Pass == 0 ? 1 : 8;
+		for(int i = 0; i < 8; i++)
+		{
+			float* d = l_Pass == 0 ? io_Block + i * 8 : io_Block + i;
+
+			float l_Tmp0 = d[0 * l_Step] + d[7 * l_Step];
+			float l_Tmp7 = d[0 * l_Step] - d[7 * l_Step];
+			float l_Tmp1 = d[1 * l_Step] + d[6 * l_Step];
+			float l_Tmp6 = d[1 * l_Step] - d[6 * l_Step];
+			float l_Tmp2 = d[2 * l_Step] + d[5 * l_Step];
+			float l_Tmp5 = d[2 * l_Step] - d[5 * l_Step];
+			float l_Tmp3 = d[3 * l_Step] + d[4 * l_Step];
+			float l_Tmp4 = d[3 * l_Step] - d[4 * l_Step];
+
+			// Even part
+			float l_Tmp10 = l_Tmp0 + l_Tmp3;
+			float l_Tmp13 = l_Tmp0 - l_Tmp3;
+			float l_Tmp11 = l_Tmp1 + l_Tmp2;
+			float l_Tmp12 = l_Tmp1 - l_Tmp2;
+
+			d[0 * l_Step] = l_Tmp10 + l_Tmp11;
+			d[4 * l_Step] = l_Tmp10 - l_Tmp11;
+
+			float l_Z1 = (l_Tmp12 + l_Tmp13) * 0.707106781f;
+			d[2 * l_Step] = l_Tmp13 + l_Z1;
+			d[6 * l_Step] = l_Tmp13 - l_Z1;
+
+			// Odd part
+			l_Tmp10 = l_Tmp4 + l_Tmp5;
+			l_Tmp11 = l_Tmp5 + l_Tmp6;
+			l_Tmp12 = l_Tmp6 + l_Tmp7;
+
+			float l_Z5 = (l_Tmp10 - l_Tmp12) * 0.382683433f;
+			float l_Z2 = 0.541196100f * l_Tmp10 + l_Z5;
+			float l_Z4 = 1.306562965f * l_Tmp12 + l_Z5;
+			float l_Z3 = l_Tmp11 * 0.707106781f;
+
+			float l_Z11 = l_Tmp7 + l_Z3;
+			float l_Z13 = l_Tmp7 - l_Z3;
+
+			d[5 * l_Step] = l_Z13 + l_Z2;
+			d[3 * l_Step] = l_Z13 - l_Z2;
+			d[1 * l_Step] = l_Z11 + l_Z4;
+			d[7 * l_Step] = l_Z11 - l_Z4;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * PutValue
+ * Write the extra bits of a coefficient of in_Category bits: the value itself if positive, one less if negative
+ */
+static inline void PutValue(BitWriter& io_Writer, int in_Value, int in_Category)
+{
+	if(in_Category > 0)
+	{
+		io_Writer.Put(in_Value < 0 ? in_Value + (1 << in_Category) - 1 : in_Value, in_Category);
+	}
+}
+
+/**
+ * GetCategory
+ * Number of bits in the magnitude of a coefficient
+ */
+static inline int GetCategory(int in_Value)
+{
+	unsigned l_Magnitude = in_Value < 0 ? -in_Value : in_Value;
+	int l_Category = 0;
+	while(l_Magnitude)
+	{
+		l_Category++;
+		l_Magnitude >>= 1;
+	}
+	return l_Category;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+// JpegEncoder
+
+JpegEncoder::JpegEncoder(int in_Quality)
+{
+	in_Quality = in_Quality < 1 ? 1 : (in_Quality > 100 ? 100 : in_Quality);
+	int l_Scale = in_Quality < 50 ? 5000 / in_Quality : 200 - in_Quality * 2;
+
+	for(int t = 0; t < 2; t++)
+	{
+		for(int i = 0; i < 64; i++)
+		{
+			int l_Value = (s_BaseQuantTables[t][i] * l_Scale + 50) / 100;
+			l_Value = l_Value < 1 ? 1 : (l_Value > 255 ? 255 : l_Value);
+			mDivisors[t][i] = l_Value * s_AanScale[i / 8] * s_AanScale[i % 8] * 8.0f;
+		}
+		for(int k = 0; k < 64; k++)
+		{
+			int l_Value = (s_BaseQuantTables[t][s_ZigZag[k]] * l_Scale + 50) / 100;
+			mQuantTables[t][k] = (unsigned char)(l_Value < 1 ? 1 : (l_Value > 255 ? 255 : l_Value));
+		}
+
+		BuildHuffmanCodes(s_DCCounts[t], s_DCSymbols, mDCCodes[t]);
+		BuildHuffmanCodes(s_ACCounts[t], s_ACSymbols[t], mACCodes[t]);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void JpegEncoder::BuildHuffmanCodes(const unsigned char* in_Counts, const unsigned char* in_Symbols, HuffmanCode* out_Codes)
+{
+	// Canonical codes: each length's codes follow on from the last, shifted left a bit per length
+	unsigned l_Code = 0;
+	int l_Symbol = 0;
+	for(int l_Length = 1; l_Length <= 16; l_Length++)
+	{
+		for(int i = 0; i < in_Counts[l_Length - 1]; i++)
+		{
+			out_Codes[in_Symbols[l_Symbol]].Code = (unsigned short)l_Code;
+			out_Codes[in_Symbols[l_Symbol]].Length = (unsigned char)l_Length;
+			l_Symbol++;
+			l_Code++;
+		}
+		l_Code <<= 1;
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void JpegEncoder::Encode(const unsigned char* in_Pixels, int in_Width, int in_Height, vector<unsigned char>& out_Data) const
+{
+	out_Data.clear();
+	out_Data.reserve(1024 + in_Width * in_Height / 4);
+
+	// SOI and a JFIF header, 1:1 pixel aspect
+	static const unsigned char s_Header[] =
+	{
+		0xFF, 0xD8,
+		0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+	};
+	out_Data.insert(out_Data.end(), s_Header, s_Header + sizeof(s_Header));
+
+	// Quantization tables
+	const unsigned char l_Dqt[] = { 0xFF, 0xDB, 0x00, 2 + 65 * 2 };
+	out_Data.insert(out_Data.end(), l_Dqt, l_Dqt + sizeof(l_Dqt));
+	for(int t = 0; t < 2; t++)
+	{
+		out_Data.push_back((unsigned char)t);
+		out_Data.insert(out_Data.end(), mQuantTables[t], mQuantTables[t] + 64);
+	}
+
+	// Frame: Y sampled 2x2, Cb and Cr 1x1 with the chrominance table
+	const unsigned char l_Sof[] =
+	{
+		0xFF, 0xC0, 0x00, 17, 8,
+		(unsigned char)(in_Height >> 8), (unsigned char)in_Height, (unsigned char)(in_Width >> 8), (unsigned char)in_Width,
+		3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1
+	};
+	out_Data.insert(out_Data.end(), l_Sof, l_Sof + sizeof(l_Sof));
+
+	// Huffman tables, DC then AC for each of luminance and chrominance
+	const unsigned l_DhtLength = 2 + 4 * 17 + 12 * 2 + 162 * 2;
+	const unsigned char l_Dht[] = { 0xFF, 0xC4, (unsigned char)(l_DhtLength >> 8), (unsigned char)l_DhtLength };
+	out_Data.insert(out_Data.end(), l_Dht, l_Dht + sizeof(l_Dht));
+	for(int t = 0; t < 2; t++)
+	{
+		out_Data.push_back((unsigned char)t);
+		out_Data.insert(out_Data.end(), s_DCCounts[t], s_DCCounts[t] + 16);
+		out_Data.insert(out_Data.end(), s_DCSymbols, s_DCSymbols + 12);
+		out_Data.push_back((unsigned char)(0x10 | t));
+		out_Data.insert(out_Data.end(), s_ACCounts[t], s_ACCounts[t] + 16);
+		out_Data.insert(out_Data.end(), s_ACSymbols[t], s_ACSymbols[t] + 162);
+	}
+
+	// Scan of all three components
+	static const unsigned char s_Sos[] = { 0xFF, 0xDA, 0x00, 12, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 };
+	out_Data.insert(out_Data.end(), s_Sos, s_Sos + sizeof(s_Sos));
+
+	// Each 16x16 MCU is four luminance blocks then one block each of Cb and Cr, averaged over 2x2 pixels.
+	// Pixels past the right and bottom edges repeat the last column and row
+	BitWriter l_Writer(out_Data);
+	int l_LastDC[3] = { 0, 0, 0 };
+	float l_Blocks[6][64];
+	for(int l_McuY = 0; l_McuY < in_Height; l_McuY += 16)
+	{
+		for(int l_McuX = 0; l_McuX < in_Width; l_McuX += 16)
+		{
+			for(int i = 0; i < 64; i++)
+			{
+				l_Blocks[4][i] = 0.0f;
+				l_Blocks[5][i] = 0.0f;
+			}
+
+			for(int y = 0; y < 16; y++)
+			{
+				int l_Y = l_McuY + y < in_Height ? l_McuY + y : in_Height - 1;
+				for(int x = 0; x < 16; x++)
+				{
+					int l_X = l_McuX + x < in_Width ? l_McuX + x : in_Width - 1;
+					const unsigned char* l_Pixel = &in_Pixels[(l_Y * in_Width + l_X) * 3];
+					float r = l_Pixel[0];
+					float g = l_Pixel[1];
+					float b = l_Pixel[2];
+
+					l_Blocks[(y / 8) * 2 + x / 8][(y % 8) * 8 + x % 8] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+					int l_Chroma = (y / 2) * 8 + x / 2;
+					l_Blocks[4][l_Chroma] += 0.25f * (-0.168736f * r - 0.331264f * g + 0.5f * b);
+					l_Blocks[5][l_Chroma] += 0.25f * (0.5f * r - 0.418688f * g - 0.081312f * b);
+				}
+			}
+
+			for(int l_Block = 0; l_Block < 6; l_Block++)
+			{
+				int l_Component = l_Block < 4 ? 0 : l_Block - 3;
+				int l_Table = l_Component == 0 ? 0 : 1;
+				float* l_Data = l_Blocks[l_Block];
+				ForwardDct(l_Data);
+
+				int l_Coefficients[64];
+				for(int k = 0; k < 64; k++)
+				{
+					float l_Value = l_Data[s_ZigZag[k]] / mDivisors[l_Table][s_ZigZag[k]];
+					l_Coefficients[k] = (int)(l_Value < 0.0f ? l_Value - 0.5f : l_Value + 0.5f);
+				}
+
+				// DC is coded as the difference from the last block of the component
+				int l_Diff = l_Coefficients[0] - l_LastDC[l_Component];
+				l_LastDC[l_Component] = l_Coefficients[0];
+				int l_Category = GetCategory(l_Diff);
+				l_Writer.Put(mDCCodes[l_Table][l_Category].Code, mDCCodes[l_Table][l_Category].Length);
+				PutValue(l_Writer, l_Diff, l_Category);
+
+				// AC as runs of zeros and a value, 0xF0 for sixteen zeros and 0x00 to end the block early
+				int l_Run = 0;
+				for(int k = 1; k < 64; k++)
+				{
+					if(l_Coefficients[k] == 0)
+					{
+						l_Run++;
+						continue;
+					}
+					while(l_Run >= 16)
+					{
+						l_Writer.Put(mACCodes[l_Table][0xF0].Code, mACCodes[l_Table][0xF0].Length);
+						l_Run -= 16;
+					}
+					l_Category = GetCategory(l_Coefficients[k]);
+					const HuffmanCode& l_Code = mACCodes[l_Table][(l_Run << 4) | l_Category];
+					l_Writer.Put(l_Code.Code, l_Code.Length);
+					PutValue(l_Writer, l_Coefficients[k], l_Category);
+					l_Run = 0;
+				}
+				if(l_Run > 0)
+				{
+					l_Writer.Put(mACCodes[l_Table][0x00].Code, mACCodes[l_Table][0x00].Length);
+				}
+			}
+		}
+	}
+	l_Writer.Flush();
+
+	// EOI
+	out_Data.push_back(0xFF);
+	out_Data.push_back(0xD9);
+}
@@ -0,0 +1,58 @@
+/**
+ * @file JpegEncoder.h
+ * @brief JpegEncoder class header file
+ */
+
+#ifndef JPEGENCODER_H_
+#define JPEGENCODER_H_
+
+#include <vector>
+using namespace std;
+
+/**
+ * JpegEncoder
+ * Encoder for baseline JPEG files with 4:2:0 chroma and the standard huffman tables, the same layout as the thumbnails
+ * the indexer writes. The quantization tables are built once, after which Encode keeps no state, so any number of
+ * threads may encode with one encoder at once
+ */
+class JpegEncoder
+{
+public:
+
+	/**
+	 * Constructor
+	 * in_Quality runs from 1 to 100, scaling the standard quantization tables the way the IJG library does
+	 */
+	JpegEncoder(int in_Quality);
+
+	/**
+	 * Encode
+	 * Encode in_Width x in_Height RGB pixels, top row first, replacing the contents of out_Data
+	 */
+	void Encode(const unsigned char* in_Pixels, int in_Width, int in_Height, vector<unsigned char>& out_Data) const;
+
+private:
+
+	/**
+	 * HuffmanCode
+	 * Code and length in bits of one huffman symbol
+	 */
+	struct HuffmanCode
+	{
+		unsigned short Code;
+		unsigned char Length;
+	};
+
+	/**
+	 * BuildHuffmanCodes
+	 * Expand a DHT style table of code counts and symbols into the code of each symbol
+	 */
+	static void BuildHuffmanCodes(const unsigned char* in_Counts, const unsigned char* in_Symbols, HuffmanCode* out_Codes);
+
+	unsigned char mQuantTables[2][64];		// Luminance then chrominance, in zigzag order as written to the file
+	float mDivisors[2][64];					// The same tables with the DCT scale factors folded in, in natural order
+	HuffmanCode mDCCodes[2][12];
+	HuffmanCode mACCodes[2][256];
+};
+
+#endif // JPEGENCODER_H_
@@ -0,0 +1,960 @@
+/**
+ * LibraryGenerator
+ * Write a synthetic photo library--the index, count, stats and preview files and the thumbnail containers of every
+ * size--so the 3DPhotoBrowser can be tested at scales no real library on hand reaches
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifdef WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <direct.h>
+#endif // WIN32
+using namespace std;
+
+#include "ContainerFormat.h"
+#include "JpegEncoder.h"
+
+/**
+ * PREVIEW_SIZE
+ * Width and height of the micro-thumbnail written to the preview file for each image
+ */
+#define PREVIEW_SIZE 8
+
+/**
+ * DATA_DIRECTORY
+ * Default location of the photo browser data, relative to the LibraryGenerator working directory
+ */
+#define DATA_DIRECTORY "../3DPhotoBrowser/Binaries/data"
+
+/**
+ * THUMBNAIL_SIZES
+ * Thumbnail sizes the index can describe, 1024x1024 for size index 0 down to 32x32 for size index 5
+ */
+#define THUMBNAIL_SIZES 6
+
+/**
+ * IndexFileImageData
+ * The format of each image in the index file
+ */
+struct IndexFileImageData
+{
+	int				Width;
+	int				Height;
+	unsigned		TimeOfDay;
+	short			DayOfYear;
+	short			Year;
+	unsigned char	AverageRed;
+	unsigned char	AverageGreen;
+	unsigned char	AverageBlue;
+	int				FolderIndex;
+	char			Filename[256];
+
+	struct
+	{
+		unsigned ThumbFileOffset;
+		unsigned ThumbContainerIndex;
+		unsigned ThumbImageSize;
+	} Thumbnails[6];
+};
+
+/**
+ * GeneratorOptions
+ * What the library looks like, from the command line
+ */
+struct GeneratorOptions
+{
+	unsigned ImageCount;
+	int FirstYear;
+	int LastYear;
+	float Growth;						// Photos taken each year relative to the year before
+	float ActiveDays;					// Fraction of days with any photos
+	float Burstiness;					// 0 spreads the photos evenly over the active days, higher piles them onto a few
+	float BurstGap;						// Mean seconds between the photos of a burst
+	vector< pair<float, float> > Aspects;	// Width / height and weight of each aspect ratio
+	int LongEdge;						// Pixels along the long edge of every photo
+	vector<unsigned> Palette;			// 0xRRGGBB theme colors, random colors if empty
+	float Saturation;					// Of the random colors
+	int Detail;							// Amplitude of the noise in the thumbnails, which sets how well they compress
+	int Quality;						// JPEG quality
+	unsigned Variants;					// Distinct pictures, shared round the images
+	unsigned SizeMask;					// Bit per size index written
+	unsigned ContainerBytes;
+	unsigned Alignment;					// 0 for version 1 containers
+	bool LodChains;
+	unsigned ThreadCount;
+	unsigned Seed;
+	string DataDirectory;
+};
+
+/**
+ * Random
+ * Small, fast and seedable, so a library can be generated again exactly (splitmix64)
+ */
+struct Random
+{
+	Random(unsigned long long in_Seed) : State(in_Seed) {}
+
+	unsigned Next()
+	{
+		unsigned long long l_Value = (State += 0x9E3779B97F4A7C15ULL);
+		l_Value = (l_Value ^ (l_Value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		l_Value = (l_Value ^ (l_Value >> 27)) * 0x94D049BB133111EBULL;
+		return (unsigned)((l_Value ^ (l_Value >> 31)) >> 32);
+	}
+
+	/**
+	 * NextFloat
+	 * Uniform in [0, 1)
+	 */
+	float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+	unsigned long long State;
+};
+
+/**
+ * Variant
+ * One distinct picture: a two color gradient with a soft disc in front, and some noise
+ */
+struct Variant
+{
+	float Top[3];
+	float Bottom[3];
+	float Disc[3];
+	float Horizon;
+	float DiscX;
+	float DiscY;
+	float DiscRadius;
+	unsigned NoiseSeed;
+};
+
+/**
+ * ContainerJob
+ * A container to write: the images whose thumbnails it holds, and the sizes it holds of each
+ */
+struct ContainerJob
+{
+	unsigned ContainerIndex;			// File number << 3, with CONTAINER_LOD_CHAIN_FLAG or the size index
+	unsigned SizeMask;
+	unsigned FirstImage;
+	unsigned ImageCount;
+};
+
+/**
+ * JobFunction
+ * Does job number in_Job of a RunJobs call
+ */
+typedef void (*JobFunction)(unsigned in_Job);
+
+bool ParseOptions(int argc, char* argv[]);
+void PrintUsage();
+void GenerateImages();
+void MakeVariant(unsigned in_Index, Variant& out_Variant);
+void RenderVariant(const Variant& in_Variant, int in_Size, unsigned char* out_Pixels);
+void EncodeVariant(unsigned in_Variant);
+void LayOutContainers();
+void WriteContainer(unsigned in_Job);
+void RunJobs(JobFunction in_Function, unsigned in_JobCount);
+bool WriteIndexFile(const string& in_File);
+bool WriteIndexCountFile(const string& in_File);
+bool WriteIndexStatsFile(const string& in_File);
+bool WritePreviewFile(const string& in_File);
+string GetContainerFilename(unsigned in_ContainerIndex);
+void MakeDirectory(const string& in_Directory);
+double GetSeconds();
+
+GeneratorOptions gOptions;
+vector<IndexFileImageData> gImageData;
+vector<unsigned> gImageVariants;
+vector< pair<short, short> > gDays;					// Year and day of year of every day with photos, in order
+vector<unsigned> gDayCounts;						// Photos taken each of those days
+vector<Variant> gVariants;
+vector< vector<unsigned char> > gVariantBlobs[THUMBNAIL_SIZES];	// Each variant's thumbnail of each size
+vector<unsigned char> gVariantPreviews;
+JpegEncoder* gEncoder = NULL;
+vector<ContainerJob> gContainerJobs;
+volatile LONG gFailures = 0;
+
+int main(int argc, char* argv[])
+{
+	if(!ParseOptions(argc, argv))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Any containers already there are replaced, the browser only opens the ones the new index refers to
+	MakeDirectory(gOptions.DataDirectory);
+	if(gOptions.LodChains)
+	{
+		MakeDirectory(gOptions.DataDirectory + "/thumbnails");
+	}
+	else
+	{
+		for(unsigned l_SizeIndex = 0; l_SizeIndex < THUMBNAIL_SIZES; l_SizeIndex++)
+		{
+			if(gOptions.SizeMask & (1 << l_SizeIndex))
+			{
+				stringstream l_Directory;
+				l_Directory << gOptions.DataDirectory << "/thumbnails" << (1024 >> l_SizeIndex);
+				MakeDirectory(l_Directory.str());
+			}
+		}
+	}
+
+	double l_StartTime = GetSeconds();
+	cout << "Generating " << gOptions.ImageCount << " images, " << gOptions.FirstYear << " to " << gOptions.LastYear << "..." << endl;
+	GenerateImages();
+	cout << "  " << gDays.size() << " days with photos, up to " << *max_element(gDayCounts.begin(), gDayCounts.end()) << " on one day" << endl;
+
+	// The pictures are encoded once each, then copied into every image that shows them, so the containers hold one
+	// thumbnail per image and size without the time it takes to encode a million of them
+	cout << "Encoding " << gVariants.size() << " variant(s) on " << gOptions.ThreadCount << " thread(s)..." << endl;
+	JpegEncoder l_Encoder(gOptions.Quality);
+	gEncoder = &l_Encoder;
+	for(unsigned l_SizeIndex = 0; l_SizeIndex < THUMBNAIL_SIZES; l_SizeIndex++)
+	{
+		gVariantBlobs[l_SizeIndex].resize(gVariants.size());
+	}
+	gVariantPreviews.resize(gVariants.size() * PREVIEW_SIZE * PREVIEW_SIZE * 3);
+	RunJobs(EncodeVariant, (unsigned)gVariants.size());
+
+	// Each image's average color is its picture's
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		const unsigned char* l_Preview = &gVariantPreviews[gImageVariants[i] * PREVIEW_SIZE * PREVIEW_SIZE * 3];
+		unsigned l_Sum[3] = { 0, 0, 0 };
+		for(unsigned p = 0; p < PREVIEW_SIZE * PREVIEW_SIZE; p++)
+		{
+			l_Sum[0] += l_Preview[p * 3 + 0];
+			l_Sum[1] += l_Preview[p * 3 + 1];
+			l_Sum[2] += l_Preview[p * 3 + 2];
+		}
+		gImageData[i].AverageRed = (unsigned char)(l_Sum[0] / (PREVIEW_SIZE * PREVIEW_SIZE));
+		gImageData[i].AverageGreen = (unsigned char)(l_Sum[1] / (PREVIEW_SIZE * PREVIEW_SIZE));
+		gImageData[i].AverageBlue = (unsigned char)(l_Sum[2] / (PREVIEW_SIZE * PREVIEW_SIZE));
+	}
+
+	cout << "Writing containers..." << endl;
+	LayOutContainers();
+	RunJobs(WriteContainer, (unsigned)gContainerJobs.size());
+	if(gFailures > 0)
+	{
+		cerr << "Failed to write " << gFailures << " container(s)" << endl;
+		return 1;
+	}
+
+	unsigned long long l_ThumbnailBytes = 0;
+	for(unsigned i = 0; i < gImageData.size(); i++)
+	{
+		for(int t = 0; t < 6; t++)
+		{
+			l_ThumbnailBytes += gImageData[i].Thumbnails[t].ThumbImageSize;
+		}
+	}
+	cout << "  " << gContainerJobs.size() << " container(s), " << l_ThumbnailBytes / (1024 * 1024) << " MB of thumbnails, "
+		 << (gOptions.Alignment > 0 ? "version 2" : "version 1") << (gOptions.LodChains ? " LOD chains" : "") << endl;
+
+	// The browser reads the index, the other files follow IndexSorter's formats
+	bool l_Success = WriteIndexFile(gOptions.DataDirectory + "/photo_index.dat");
+	l_Success = WriteIndexCountFile(gOptions.DataDirectory + "/photo_index_counts.dat") && l_Success;
+	l_Success = WriteIndexStatsFile(gOptions.DataDirectory + "/photo_index_stats.dat") && l_Success;
+	l_Success = WritePreviewFile(gOptions.DataDirectory + "/photo_index_previews.dat") && l_Success;
+	if(!l_Success)
+	{
+		cerr << "Failed." << endl;
+		return 1;
+	}
+
+	cout << "Complete in " << fixed << setprecision(1) << GetSeconds() - l_StartTime << " seconds. Wrote '" << gOptions.DataDirectory << "'" << endl;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool ParseOptions(int argc, char* argv[])
+{
+	gOptions.ImageCount = 100000;
+	gOptions.FirstYear = 1998;
+	gOptions.LastYear = 2009;
+	gOptions.Growth = 1.3f;
+	gOptions.ActiveDays = 0.25f;
+	gOptions.Burstiness = 0.7f;
+	gOptions.BurstGap = 20.0f;
+	gOptions.LongEdge = 3072;
+	gOptions.Saturation = 0.4f;
+	gOptions.Detail = 12;
+	gOptions.Quality = 85;
+	gOptions.Variants = 1024;
+	gOptions.SizeMask = (1 << THUMBNAIL_SIZES) - 1;
+	gOptions.ContainerBytes = 2048 * 1024;
+	gOptions.Alignment = CONTAINER_PAGE_SIZE;
+	gOptions.LodChains = false;
+	gOptions.Seed = 1;
+	gOptions.DataDirectory = DATA_DIRECTORY;
+#ifdef WIN32
+	SYSTEM_INFO l_Info;
+	GetSystemInfo(&l_Info);
+	gOptions.ThreadCount = max(1, (int)l_Info.dwNumberOfProcessors);
+#else
+	#error Your platform processor count goes here
+#endif // WIN32
+
+	const char* l_Aspects = "4:3=45,3:2=20,3:4=20,16:9=10,1:1=5";
+	for(int i = 1; i < argc; i++)
+	{
+		string l_Option = argv[i];
+		const char* l_Value = i + 1 < argc ? argv[i + 1] : NULL;
+		if(l_Option == "--v1")
+		{
+			gOptions.Alignment = 0;
+			continue;
+		}
+		if(l_Option == "--lod-chains")
+		{
+			gOptions.LodChains = true;
+			continue;
+		}
+		if(l_Value == NULL)
+		{
+			cerr << "Missing value for '" << l_Option << "'" << endl;
+			return false;
+		}
+		i++;
+
+		if(l_Option == "--count")				gOptions.ImageCount = (unsigned)atoi(l_Value);
+		else if(l_Option == "--years")
+		{
+			if(sscanf(l_Value, "%d-%d", &gOptions.FirstYear, &gOptions.LastYear) != 2)
+			{
+				gOptions.LastYear = gOptions.FirstYear;
+			}
+		}
+		else if(l_Option == "--growth")			gOptions.Growth = (float)atof(l_Value);
+		else if(l_Option == "--active-days")	gOptions.ActiveDays = (float)atof(l_Value);
+		else if(l_Option == "--burstiness")		gOptions.Burstiness = (float)atof(l_Value);
+		else if(l_Option == "--burst-gap")		gOptions.BurstGap = (float)atof(l_Value);
+		else if(l_Option == "--aspects")		l_Aspects = l_Value;
+		else if(l_Option == "--resolution")		gOptions.LongEdge = atoi(l_Value);
+		else if(l_Option == "--saturation")		gOptions.Saturation = (float)atof(l_Value);
+		else if(l_Option == "--detail")			gOptions.Detail = atoi(l_Value);
+		else if(l_Option == "--quality")		gOptions.Quality = atoi(l_Value);
+		else if(l_Option == "--variants")		gOptions.Variants = (unsigned)atoi(l_Value);
+		else if(l_Option == "--container-kb")	gOptions.ContainerBytes = (unsigned)atoi(l_Value) * 1024;
+		else if(l_Option == "--alignment")		gOptions.Alignment = (unsigned)atoi(l_Value);
+		else if(l_Option == "--threads")		gOptions.ThreadCount = (unsigned)atoi(l_Value);
+		else if(l_Option == "--seed")			gOptions.Seed = (unsigned)atoi(l_Value);
+		else if(l_Option == "--out")			gOptions.DataDirectory = l_Value;
+		else if(l_Option == "--colors")
+		{
+			// Comma separated RRGGBB
+			stringstream l_Colors(l_Value);
+			string l_Color;
+			while(getline(l_Colors, l_Color, ','))
+			{
+				gOptions.Palette.push_back((unsigned)strtoul(l_Color.c_str(), NULL, 16) & 0xFFFFFF);
+			}
+		}
+		else if(l_Option == "--sizes")
+		{
+			// Comma separated sizes in pixels
+			gOptions.SizeMask = 0;
+			stringstream l_Sizes(l_Value);
+			string l_Size;
+			while(getline(l_Sizes, l_Size, ','))
+			{
+				unsigned l_SizeIndex = 0;
+				while(l_SizeIndex < THUMBNAIL_SIZES && (1024 >> l_SizeIndex) != atoi(l_Size.c_str()))
+				{
+					l_SizeIndex++;
+				}
+				if(l_SizeIndex == THUMBNAIL_SIZES)
+				{
+					cerr << "Thumbnails are 1024, 512, 256, 128, 64 or 32 pixels, not '" << l_Size << "'" << endl;
+					return false;
+				}
+				gOptions.SizeMask |= 1 << l_SizeIndex;
+			}
+		}
+		else
+		{
+			cerr << "Unknown option '" << l_Option << "'" << endl;
+			return false;
+		}
+	}
+
+	// Aspect ratios are "width:height=weight", the weight defaulting to 1
+	stringstream l_AspectList(l_Aspects);
+	string l_Aspect;
+	while(getline(l_AspectList, l_Aspect, ','))
+	{
+		float l_Width = 0.0f;
+		float l_Height = 0.0f;
+		float l_Weight = 1.0f;
+		if(sscanf(l_Aspect.c_str(), "%f:%f=%f", &l_Width, &l_Height, &l_Weight) < 2 || l_Width <= 0.0f || l_Height <= 0.0f || l_Weight < 0.0f)
+		{
+			cerr << "Aspect ratios are width:height=weight, not '" << l_Aspect << "'" << endl;
+			return false;
+		}
+		gOptions.Aspects.push_back(make_pair(l_Width / l_Height, l_Weight));
+	}
+
+	if(gOptions.ImageCount == 0 || gOptions.LastYear < gOptions.FirstYear || gOptions.Aspects.empty() || gOptions.SizeMask == 0 ||
+	   gOptions.ActiveDays <= 0.0f || gOptions.Variants == 0 || gOptions.ThreadCount == 0 || gOptions.LongEdge <= 0)
+	{
+		cerr << "Invalid options" << endl;
+		return false;
+	}
+	if(gOptions.Alignment & (gOptions.Alignment - 1))
+	{
+		cerr << "The container alignment must be a power of two" << endl;
+		return false;
+	}
+	gOptions.Variants = min(gOptions.Variants, gOptions.ImageCount);
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void PrintUsage()
+{
+	cout << "Usage: LibraryGenerator [options]" << endl
+		 << "  --count n             images (100000)" << endl
+		 << "  --years first-last    date range (1998-2009)" << endl
+		 << "  --growth g            photos each year relative to the year before (1.3)" << endl
+		 << "  --active-days f       fraction of days with photos (0.25)" << endl
+		 << "  --burstiness b        0 spreads photos evenly over the active days, higher piles them onto a few (0.7)" << endl
+		 << "  --burst-gap s         mean seconds between the photos of a burst (20)" << endl
+		 << "  --aspects list        width:height=weight,... (4:3=45,3:2=20,3:4=20,16:9=10,1:1=5)" << endl
+		 << "  --resolution n        pixels along the long edge (3072)" << endl
+		 << "  --colors list         RRGGBB,... theme colors, random if not given" << endl
+		 << "  --saturation s        of the random colors (0.4)" << endl
+		 << "  --detail n            noise amplitude, higher makes larger thumbnails (12)" << endl
+		 << "  --quality n           JPEG quality (85)" << endl
+		 << "  --variants n          distinct pictures shared round the images, up to one per image (1024)" << endl
+		 << "  --sizes list          thumbnail sizes written (1024,512,256,128,64,32)" << endl
+		 << "  --container-kb n      container size (2048)" << endl
+		 << "  --alignment n         version 2 blob alignment (" << CONTAINER_PAGE_SIZE << ")" << endl
+		 << "  --v1                  version 1 containers" << endl
+		 << "  --lod-chains          every size of an image together, in data/thumbnails" << endl
+		 << "  --threads n           (processor count)" << endl
+		 << "  --seed n              (1)" << endl
+		 << "  --out directory       (" << DATA_DIRECTORY << ")" << endl;
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void GenerateImages()
+{
+	// Which days have photos, and how many each. Each year takes more photos than the last, and each active day's share
+	// is drawn from a Pareto distribution, so with any burstiness a few days (holidays, parties) take most of them
+	Random l_Random(gOptions.Seed);
+	vector<double> l_Weights;
+	double l_TotalWeight = 0.0;
+	for(int l_Year = gOptions.FirstYear; l_Year <= gOptions.LastYear; l_Year++)
+	{
+		bool l_LeapYear = (l_Year % 4 == 0 && l_Year % 100 != 0) || l_Year % 400 == 0;
+		double l_YearWeight = pow((double)gOptions.Growth, l_Year - gOptions.FirstYear);
+		for(int l_Day = 1; l_Day <= (l_LeapYear ? 366 : 365); l_Day++)
+		{
+			if(l_Random.NextFloat() < gOptions.ActiveDays)
+			{
+				double l_Weight = l_YearWeight * min(1000.0, pow(1.0 - l_Random.NextFloat(), -(double)gOptions.Burstiness));
+				gDays.push_back(make_pair((short)l_Year, (short)l_Day));
+				l_Weights.push_back(l_Weight);
+				l_TotalWeight += l_Weight;
+			}
+		}
+	}
+	if(gDays.empty())
+	{
+		gDays.push_back(make_pair((short)gOptions.FirstYear, (short)1));
+		l_Weights.push_back(1.0);
+		l_TotalWeight = 1.0;
+	}
+
+	// Rounding the running total shares the images out exactly
+	gDayCounts.resize(gDays.size());
+	double l_RunningWeight = 0.0;
+	unsigned l_Assigned = 0;
+	for(unsigned i = 0; i < gDays.size(); i++)
+	{
+		l_RunningWeight += l_Weights[i];
+		unsigned l_Total = i + 1 == gDays.size() ? gOptions.ImageCount : (unsigned)(gOptions.ImageCount * (l_RunningWeight / l_TotalWeight) + 0.5);
+		gDayCounts[i] = l_Total - l_Assigned;
+		l_Assigned = l_Total;
+	}
+
+	// The pictures are made now, so a library is the same whatever the thread count
+	gVariants.resize(gOptions.Variants);
+	for(unsigned i = 0; i < gVariants.size(); i++)
+	{
+		MakeVariant(i, gVariants[i]);
+	}
+
+	float l_TotalAspectWeight = 0.0f;
+	for(unsigned i = 0; i < gOptions.Aspects.size(); i++)
+	{
+		l_TotalAspectWeight += gOptions.Aspects[i].second;
+	}
+
+	// The images are made in date order, which is the order the index is sorted in. Within a day the photos come in
+	// bursts a few seconds apart, with the odd long break, starting some time in the day. Busy days shorten the gaps
+	// to fit them all in before midnight
+	gImageData.resize(gOptions.ImageCount);
+	gImageVariants.resize(gOptions.ImageCount);
+	memset(&gImageData[0], 0, gImageData.size() * sizeof(IndexFileImageData));
+	unsigned l_Image = 0;
+	for(unsigned d = 0; d < gDays.size(); d++)
+	{
+		double l_Time = (7.0 + l_Random.NextFloat() * 12.0) * 3600.0;
+		double l_Span = gDayCounts[d] * (0.95 * gOptions.BurstGap + 0.05 * 3600.0);
+		double l_GapScale = min(1.0, (86399.0 - l_Time) / max(1.0, l_Span));
+		for(unsigned p = 0; p < gDayCounts[d]; p++, l_Image++)
+		{
+			IndexFileImageData& l_Data = gImageData[l_Image];
+			l_Data.Year = gDays[d].first;
+			l_Data.DayOfYear = gDays[d].second;
+			l_Data.TimeOfDay = (unsigned)(min(l_Time, 86399.999) * 1000.0);
+			l_Data.FolderIndex = l_Data.Year - gOptions.FirstYear;
+			sprintf(l_Data.Filename, "Synthetic/%04d/IMG_%07u.jpg", l_Data.Year, l_Image);
+
+			float l_Gap = -log(1.0f - l_Random.NextFloat());
+			l_Time += (l_Random.NextFloat() < 0.05f ? l_Gap * 3600.0 : l_Gap * gOptions.BurstGap) * l_GapScale;
+
+			float l_Pick = l_Random.NextFloat() * l_TotalAspectWeight;
+			unsigned l_Aspect = 0;
+			while(l_Aspect + 1 < gOptions.Aspects.size() && l_Pick >= gOptions.Aspects[l_Aspect].second)
+			{
+				l_Pick -= gOptions.Aspects[l_Aspect].second;
+				l_Aspect++;
+			}
+			float l_Ratio = gOptions.Aspects[l_Aspect].first;
+			l_Data.Width = l_Ratio >= 1.0f ? gOptions.LongEdge : max(1, (int)(gOptions.LongEdge * l_Ratio + 0.5f));
+			l_Data.Height = l_Ratio >= 1.0f ? max(1, (int)(gOptions.LongEdge / l_Ratio + 0.5f)) : gOptions.LongEdge;
+
+			gImageVariants[l_Image] = gOptions.Variants == gOptions.ImageCount ? l_Image : l_Random.Next() % gOptions.Variants;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void MakeVariant(unsigned in_Index, Variant& out_Variant)
+{
+	Random l_Random(((unsigned long long)gOptions.Seed << 32) ^ (in_Index * 0x2545F491ULL));
+
+	// A theme color from the palette, jittered, or a random hue
+	float l_Color[3];
+	if(!gOptions.Palette.empty())
+	{
+		unsigned l_Theme = gOptions.Palette[l_Random.Next() % gOptions.Palette.size()];
+		for(int c = 0; c < 3; c++)
+		{
+			float l_Value = ((l_Theme >> (16 - c * 8)) & 0xFF) + (l_Random.NextFloat() - 0.5f) * 48.0f;
+			l_Color[c] = max(0.0f, min(255.0f, l_Value));
+		}
+	}
+	else
+	{
+		float l_Hue = l_Random.NextFloat() * 6.0f;
+		float l_Value = 64.0f + l_Random.NextFloat() * 160.0f;
+		float l_Saturation = gOptions.Saturation * (0.5f + l_Random.NextFloat());
+		for(int c = 0; c < 3; c++)
+		{
+			// Distance round the hue circle from this channel's primary
+			float l_Distance = fabs(fmod(l_Hue - c * 2.0f + 9.0f, 6.0f) - 3.0f);
+			float l_Weight = max(0.0f, min(1.0f, l_Distance - 1.0f));
+			l_Color[c] = max(0.0f, min(255.0f, l_Value * (1.0f - l_Saturation * l_Weight)));
+		}
+	}
+
+	for(int c = 0; c < 3; c++)
+	{
+		out_Variant.Top[c] = min(255.0f, l_Color[c] * 1.3f + 20.0f);
+		out_Variant.Bottom[c] = l_Color[c] * 0.6f;
+		out_Variant.Disc[c] = l_Color[(c + 1) % 3];
+	}
+	out_Variant.Horizon = 0.3f + l_Random.NextFloat() * 0.4f;
+	out_Variant.DiscX = 0.2f + l_Random.NextFloat() * 0.6f;
+	out_Variant.DiscY = 0.2f + l_Random.NextFloat() * 0.6f;
+	out_Variant.DiscRadius = 0.1f + l_Random.NextFloat() * 0.25f;
+	out_Variant.NoiseSeed = l_Random.Next();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void RenderVariant(const Variant& in_Variant, int in_Size, unsigned char* out_Pixels)
+{
+	// Pixel centres sample the same picture at every size, so the thumbnails of each size match.
+	// The noise isn't filtered, it is there to give the encoder something to work on
+	for(int y = 0; y < in_Size; y++)
+	{
+		float v = (y + 0.5f) / in_Size;
+		float l_Blend = max(0.0f, min(1.0f, (v - in_Variant.Horizon) * 8.0f + 0.5f));
+		for(int x = 0; x < in_Size; x++)
+		{
+			float u = (x + 0.5f) / in_Size;
+			float l_DiscU = (u - in_Variant.DiscX) / in_Variant.DiscRadius;
+			float l_DiscV = (v - in_Variant.DiscY) / in_Variant.DiscRadius;
+			float l_Disc = max(0.0f, 1.0f - (l_DiscU * l_DiscU + l_DiscV * l_DiscV));
+
+			unsigned l_Hash = (in_Variant.NoiseSeed ^ (x * 0x9E3779B1u)) + y * 0x85EBCA77u;
+			l_Hash = (l_Hash ^ (l_Hash >> 15)) * 0x2C1B3C6Du;
+			l_Hash ^= l_Hash >> 13;
+			float l_Noise = gOptions.Detail * (((l_Hash & 0xFF) / 127.5f) - 1.0f);
+
+			unsigned char* l_Pixel = &out_Pixels[(y * in_Size + x) * 3];
+			for(int c = 0; c < 3; c++)
+			{
+				float l_Value = in_Variant.Top[c] + (in_Variant.Bottom[c] - in_Variant.Top[c]) * l_Blend;
+				l_Value += (in_Variant.Disc[c] - l_Value) * min(1.0f, l_Disc * 2.0f) + l_Noise;
+				l_Pixel[c] = (unsigned char)max(0.0f, min(255.0f, l_Value + 0.5f));
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void EncodeVariant(unsigned in_Variant)
+{
+	// Every variant has its own slot in the pool, so the workers don't need a lock
+	const Variant& l_Variant = gVariants[in_Variant];
+	RenderVariant(l_Variant, PREVIEW_SIZE, &gVariantPreviews[in_Variant * PREVIEW_SIZE * PREVIEW_SIZE * 3]);
+
+	vector<unsigned char> l_Pixels;
+	for(unsigned l_SizeIndex = 0; l_SizeIndex < THUMBNAIL_SIZES; l_SizeIndex++)
+	{
+		if(gOptions.SizeMask & (1 << l_SizeIndex))
+		{
+			int l_Size = 1024 >> l_SizeIndex;
+			l_Pixels.resize(l_Size * l_Size * 3);
+			RenderVariant(l_Variant, l_Size, &l_Pixels[0]);
+			gEncoder->Encode(&l_Pixels[0], l_Size, l_Size, gVariantBlobs[l_SizeIndex][in_Variant]);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void LayOutContainers()
+{
+	// Runs of images, in date order, whose thumbnails fill a container. Without LOD chains each size has containers
+	// of its own, numbered from 0 in its directory
+	const unsigned l_Mask = gOptions.Alignment > 0 ? gOptions.Alignment - 1 : 0;
+	for(unsigned l_SizeIndex = 0; l_SizeIndex < (gOptions.LodChains ? 1u : (unsigned)THUMBNAIL_SIZES); l_SizeIndex++)
+	{
+		ContainerJob l_Job;
+		l_Job.SizeMask = gOptions.LodChains ? gOptions.SizeMask : gOptions.SizeMask & (1 << l_SizeIndex);
+		if(l_Job.SizeMask == 0)
+		{
+			continue;
+		}
+
+		unsigned l_Container = 0;
+		unsigned long long l_Bytes = 0;
+		l_Job.FirstImage = 0;
+		l_Job.ImageCount = 0;
+		for(unsigned i = 0; i < gImageData.size(); i++)
+		{
+			unsigned long long l_ImageBytes = 0;
+			for(unsigned s = 0; s < THUMBNAIL_SIZES; s++)
+			{
+				if(l_Job.SizeMask & (1 << s))
+				{
+					l_ImageBytes += (gVariantBlobs[s][gImageVariants[i]].size() + l_Mask) & ~(unsigned long long)l_Mask;
+				}
+			}
+
+			if(l_Job.ImageCount > 0 && l_Bytes + l_ImageBytes > gOptions.ContainerBytes)
+			{
+				l_Job.ContainerIndex = (l_Container++ << 3) | (gOptions.LodChains ? CONTAINER_LOD_CHAIN_FLAG : l_SizeIndex);
+				gContainerJobs.push_back(l_Job);
+				l_Job.FirstImage = i;
+				l_Job.ImageCount = 0;
+				l_Bytes = 0;
+			}
+			l_Job.ImageCount++;
+			l_Bytes += l_ImageBytes;
+		}
+		l_Job.ContainerIndex = (l_Container << 3) | (gOptions.LodChains ? CONTAINER_LOD_CHAIN_FLAG : l_SizeIndex);
+		gContainerJobs.push_back(l_Job);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void WriteContainer(unsigned in_Job)
+{
+	// Each job has images of its own to point at the container, so the workers don't need a lock.
+	// An image's LOD chain runs from the smallest thumbnail up
+	const ContainerJob& l_Job = gContainerJobs[in_Job];
+	vector<ContainerBlob> l_Blobs;
+	vector< pair<unsigned, unsigned> > l_Thumbnails;		// Image and size index of each blob
+	for(unsigned i = l_Job.FirstImage; i < l_Job.FirstImage + l_Job.ImageCount; i++)
+	{
+		for(int s = THUMBNAIL_SIZES - 1; s >= 0; s--)
+		{
+			if(l_Job.SizeMask & (1 << s))
+			{
+				const vector<unsigned char>& l_Thumbnail = gVariantBlobs[s][gImageVariants[i]];
+				ContainerBlob l_Blob;
+				l_Blob.Data = &l_Thumbnail[0];
+				l_Blob.Size = (unsigned)l_Thumbnail.size();
+				l_Blob.SourceOffset = 0;
+				l_Blobs.push_back(l_Blob);
+				l_Thumbnails.push_back(make_pair(i, (unsigned)s));
+			}
+		}
+	}
+
+	// Blobs back to back for version 1, or through the version 2 writer
+	vector<unsigned char> l_File;
+	vector<ContainerEntry> l_Entries;
+	if(gOptions.Alignment > 0)
+	{
+		WriteContainerV2(l_Blobs, gOptions.Alignment, l_File, l_Entries);
+	}
+	else
+	{
+		l_Entries.resize(l_Blobs.size());
+		for(unsigned b = 0; b < l_Blobs.size(); b++)
+		{
+			l_Entries[b].Offset = (unsigned)l_File.size();
+			l_File.insert(l_File.end(), l_Blobs[b].Data, l_Blobs[b].Data + l_Blobs[b].Size);
+		}
+	}
+
+	for(unsigned b = 0; b < l_Blobs.size(); b++)
+	{
+		IndexFileImageData& l_Data = gImageData[l_Thumbnails[b].first];
+		unsigned l_SizeIndex = l_Thumbnails[b].second;
+		l_Data.Thumbnails[l_SizeIndex].ThumbFileOffset = l_Entries[b].Offset;
+		l_Data.Thumbnails[l_SizeIndex].ThumbContainerIndex = l_Job.ContainerIndex | l_SizeIndex;
+		l_Data.Thumbnails[l_SizeIndex].ThumbImageSize = l_Blobs[b].Size;
+	}
+
+	string l_Filename = GetContainerFilename(l_Job.ContainerIndex);
+	ofstream l_Out;
+	l_Out.open(l_Filename.c_str(), ios::binary | ios::out);
+	if(!l_File.empty())
+	{
+		l_Out.write((const char*)&l_File[0], l_File.size());
+	}
+	l_Out.close();
+	if(l_Out.fail())
+	{
+		InterlockedIncrement(&gFailures);
+	}
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+/**
+ * JobQueue
+ * Jobs shared out by RunJobs, each worker taking the next until there are none left
+ */
+struct JobQueue
+{
+	JobFunction Function;
+	LONG JobCount;
+	volatile LONG NextJob;
+};
+
+#ifdef WIN32
+static DWORD WINAPI JobThreadProc(LPVOID in_Queue)
+{
+	JobQueue* l_Queue = (JobQueue*)in_Queue;
+	for(LONG l_Job = InterlockedIncrement(&l_Queue->NextJob) - 1; l_Job < l_Queue->JobCount; l_Job = InterlockedIncrement(&l_Queue->NextJob) - 1)
+	{
+		l_Queue->Function((unsigned)l_Job);
+	}
+	return 0;
+}
+#endif // WIN32
+
+void RunJobs(JobFunction in_Function, unsigned in_JobCount)
+{
+	JobQueue l_Queue;
+	l_Queue.Function = in_Function;
+	l_Queue.JobCount = (LONG)in_JobCount;
+	l_Queue.NextJob = 0;
+
+#ifdef WIN32
+	vector<HANDLE> l_Threads;
+	for(unsigned t = 0; t < min(gOptions.ThreadCount, in_JobCount); t++)
+	{
+		HANDLE l_Thread = CreateThread(NULL, 0, JobThreadProc, &l_Queue, 0, NULL);
+		if(l_Thread != NULL)
+		{
+			l_Threads.push_back(l_Thread);
+		}
+	}
+
+	// If no thread would start, the main thread does the work. Otherwise it just waits
+	if(l_Threads.empty())
+	{
+		JobThreadProc(&l_Queue);
+	}
+	for(unsigned t = 0; t < l_Threads.size(); t++)
+	{
+		WaitForSingleObject(l_Threads[t], INFINITE);
+		CloseHandle(l_Threads[t]);
+	}
+#else
+	#error Your platform thread creation goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool WriteIndexFile(const string& in_File)
+{
+	// Try to open the file
+	ofstream l_File;
+	l_File.open(in_File.c_str(), ios::binary | ios::out);
+	if(l_File.fail())
+	{
+		cerr << "Failed to open index file writing" << endl;
+		return false;
+	}
+
+	// The number of images, then every image, already in date order
+	unsigned l_ImageCount = (unsigned)gImageData.size();
+	l_File.write((char*)&l_ImageCount, sizeof(l_ImageCount));
+	l_File.write((char*)&gImageData[0], gImageData.size() * sizeof(IndexFileImageData));
+
+	l_File.close();
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool WriteIndexCountFile(const string& in_File)
+{
+	// Try to open the file
+	ofstream l_File;
+	l_File.open(in_File.c_str(), ios::binary | ios::out);
+	if(l_File.fail())
+	{
+		cerr << "Failed to open count file for writing" << endl;
+		return false;
+	}
+
+	// The Year, followed by the day, followed by the count, for each day in order. Don't bother writing zero entries
+	for(unsigned i = 0; i < gDays.size(); i++)
+	{
+		if(gDayCounts[i] > 0)
+		{
+			l_File.write((char*)&gDays[i].first, sizeof(short));
+			l_File.write((char*)&gDays[i].second, sizeof(short));
+			l_File.write((char*)&gDayCounts[i], sizeof(unsigned));
+		}
+	}
+
+	l_File.close();
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool WriteIndexStatsFile(const string& in_File)
+{
+	// Try to open the file
+	ofstream l_File;
+	l_File.open(in_File.c_str(), ios::binary | ios::out);
+	if(l_File.fail())
+	{
+		cerr << "Failed to open stats file for writing" << endl;
+		return false;
+	}
+
+	// The first and last year with photos
+	int l_MinYear = gImageData.front().Year;
+	int l_MaxYear = gImageData.back().Year;
+	l_File.write((char*)&l_MinYear, sizeof(l_MinYear));
+	l_File.write((char*)&l_MaxYear, sizeof(l_MaxYear));
+
+	l_File.close();
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+bool WritePreviewFile(const string& in_File)
+{
+	// Try to open the file
+	ofstream l_File;
+	l_File.open(in_File.c_str(), ios::binary | ios::out);
+	if(l_File.fail())
+	{
+		cerr << "Failed to open preview file for writing" << endl;
+		return false;
+	}
+
+	// The number of images, followed by the preview size, then each image's preview in index order
+	unsigned l_ImageCount = (unsigned)gImageData.size();
+	unsigned l_PreviewSize = PREVIEW_SIZE;
+	l_File.write((char*)&l_ImageCount, sizeof(l_ImageCount));
+	l_File.write((char*)&l_PreviewSize, sizeof(l_PreviewSize));
+	for(unsigned i = 0; i < l_ImageCount; i++)
+	{
+		l_File.write((char*)&gVariantPreviews[gImageVariants[i] * PREVIEW_SIZE * PREVIEW_SIZE * 3], PREVIEW_SIZE * PREVIEW_SIZE * 3);
+	}
+
+	l_File.close();
+	return !l_File.fail();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+string GetContainerFilename(unsigned in_ContainerIndex)
+{
+	// The lower 3 bits are the thumbnail size index, beginning at 1024x1024 for index 0, the rest is the file number.
+	// Containers of LOD chains hold every size, so they have a directory of their own
+	stringstream l_Filename;
+	l_Filename << gOptions.DataDirectory << "/thumbnails";
+	if(!(in_ContainerIndex & CONTAINER_LOD_CHAIN_FLAG))
+	{
+		l_Filename << (1024 >> (in_ContainerIndex & 0x07));
+	}
+	l_Filename << "/container" << setfill('0') << setw(5) << ((in_ContainerIndex & ~CONTAINER_LOD_CHAIN_FLAG) >> 3) << ".dat";
+	return l_Filename.str();
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+void MakeDirectory(const string& in_Directory)
+{
+	// Fails harmlessly if the directory is already there
+#ifdef WIN32
+	_mkdir(in_Directory.c_str());
+#else
+	#error Your platform directory creation goes here
+#endif // WIN32
+}
+
+//-----------------------------------------------------------------------------------------------------------------------------
+
+double GetSeconds()
+{
+#ifdef WIN32
+	LARGE_INTEGER l_Frequency;
+	LARGE_INTEGER l_Counter;
+	QueryPerformanceFrequency(&l_Frequency);
+	QueryPerformanceCounter(&l_Counter);
+	return (double)l_Counter.QuadPart / l_Frequency.QuadPart;
+#else
+	#error Your platform timer goes here
+#endif // WIN32
+}